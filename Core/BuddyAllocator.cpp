@@ -61,6 +61,7 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
     , m_maxBlockSize(maxBlockSize)
     , m_minBlockSize(MinBlockSize)
     , m_pBackingHeap(nullptr)
+    , m_deferredDeletionQueue("Buddy allocator blocks")
 #if defined(PROFILE) || defined(_DEBUG)
     , m_SpaceUsed(0)
     , m_InternalFragmentation(0)
@@ -71,7 +72,7 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
 
     m_maxOrder = UnitSizeToOrder(SizeToUnitSize(maxBlockSize));
 
-    Reset();
+    m_freeBlocks.Initialize(m_maxOrder);
 }
 
 void BuddyAllocator::Initialize()
@@ -96,6 +97,9 @@ void BuddyAllocator::Initialize()
 
 void BuddyAllocator::Destroy()
 {
+    // The GPU is idle, so blocks still waiting on a fence can go too
+    m_deferredDeletionQueue.Flush([this](BuddyBlock* pBlock) { DeallocateInternal(pBlock); });
+
     if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
     {
         m_pBackingHeap->Release();
@@ -106,115 +110,52 @@ void BuddyAllocator::Destroy()
     }
 }
 
-size_t BuddyAllocator::AllocateBlock(UINT order)
+BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData)
 {
-    size_t offset;
-
-    if (order > m_maxOrder)
-    {
-        throw(std::bad_alloc()); // Can't allocate a block that large  
-    }
-
-    auto it = m_freeBlocks[order].begin();
-
-    if (it == m_freeBlocks[order].end())
-    {
-        // No free nodes in the requested pool.  Try to find a higher-order block and split it.  
-        size_t left = AllocateBlock(order + 1);
-
-        size_t size = OrderToUnitSize(order);
-
-        size_t right = left + size;
-
-        m_freeBlocks[order].insert(right); // Add the right block to the free pool  
-
-        offset = left; // Return the left block  
-    }
+    size_t size = numElements * elementSize;
+    size_t unitSize = SizeToUnitSize(size);
+    UINT order = UnitSizeToOrder(unitSize);
 
-    else
+    size_t offset;
+    if (!m_freeBlocks.Allocate(order, offset))
     {
-        offset = *it;
-
-        // Remove the block from the free list  
-        m_freeBlocks[order].erase(it);
+        // There are no blocks available for the requested size so  
+        // return the NULL block type  
+        return new BuddyBlock();
     }
 
-    return offset;
-}
-
-void BuddyAllocator::DeallocateBlock(size_t offset, UINT order)
-{
-    // See if the buddy block is free  
-    size_t size = OrderToUnitSize(order);
+    uint32_t paddedSize = uint32_t(OrderToUnitSize(order) * m_minBlockSize);
 
-    size_t buddy = GetBuddyOffset(offset, size);
+    uint32_t blockOffset = uint32_t(m_baseOffset + (offset * m_minBlockSize));
 
-    auto it = m_freeBlocks[order].find(buddy);
+    INCREASE_BUDDY_COUNTER(m_SpaceUsed, paddedSize);
+    INCREASE_BUDDY_COUNTER(m_InternalFragmentation, (paddedSize - size));
 
-    if (it != m_freeBlocks[order].end())
+    BuddyBlock* pBlock = new BuddyBlock(blockOffset, //offset
+        paddedSize, //total size (padded to fit a block)
+        numElements * elementSize);
+        
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
     {
-        // Deallocate merged blocks  
-        DeallocateBlock(min(offset, buddy), order + 1);
-        // Remove the buddy from the free list  
-        m_freeBlocks[order].erase(it);
+        pBlock->InitPlaced(m_pBackingHeap, numElements, elementSize, initialData);
     }
     else
     {
-        // Add the block to the free list  
-        m_freeBlocks[order].insert(offset); // throw(std::bad_alloc) 
+        //TODO: To be truely thread-safe this operation should be atomic to guard against
+        //      the case in which blocks from this allocator are used on multiple threads 
+        //      (because it's really only 1 resource underneath)
+        pBlock->InitFromResource(&m_BackingResource, numElements, elementSize, initialData);
     }
-}
 
-BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData)
-{
-    size_t size = numElements * elementSize;
-    size_t unitSize = SizeToUnitSize(size);
-    UINT order = UnitSizeToOrder(unitSize);
-
-    try
-    {
-        size_t offset = AllocateBlock(order);
-        uint32_t paddedSize = uint32_t(OrderToUnitSize(order) * m_minBlockSize);
-
-        uint32_t blockOffset = uint32_t(m_baseOffset + (offset * m_minBlockSize));
-
-        INCREASE_BUDDY_COUNTER(m_SpaceUsed, paddedSize);
-        INCREASE_BUDDY_COUNTER(m_InternalFragmentation, (paddedSize - size));
-
-        BuddyBlock* pBlock = new BuddyBlock(blockOffset, //offset
-            paddedSize, //total size (padded to fit a block)
-            numElements * elementSize);
-            
-        if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
-        {
-            pBlock->InitPlaced(m_pBackingHeap, numElements, elementSize, initialData);
-        }
-        else
-        {
-            //TODO: To be truely thread-safe this operation should be atomic to guard against
-            //      the case in which blocks from this allocator are used on multiple threads 
-            //      (because it's really only 1 resource underneath)
-            pBlock->InitFromResource(&m_BackingResource, numElements, elementSize, initialData);
-        }
-
-        return pBlock;
-    }
-
-    catch (std::bad_alloc&)
-    {
-        // There are no blocks available for the requested size so  
-        // return the NULL block type  
-        return new BuddyBlock();
-    }
+    return pBlock;
 }
 
-/*
 void BuddyAllocator::Deallocate(BuddyBlock* pBlock)
 {
-    pBlock->m_fenceValue = g_CommandManager.GetNextFenceValue();
-    m_deferredDeletionQueue.push(pBlock);
+    // The block may be in use by anything submitted so far
+    pBlock->m_fenceValue = g_CommandManager.GetGraphicsQueue().GetNextFenceValue();
+    m_deferredDeletionQueue.Retire(pBlock->m_fenceValue, pBlock);
 }
-*/
 
 void BuddyAllocator::DeallocateInternal(BuddyBlock* pBlock)
 {
@@ -226,39 +167,22 @@ void BuddyAllocator::DeallocateInternal(BuddyBlock* pBlock)
 
     UINT order = UnitSizeToOrder(size);
 
-    try
-    {
-        DeallocateBlock(offset, order); // throw(std::bad_alloc)
+    // The bitmaps are sized up front, so unlike a free list this cannot fail
+    m_freeBlocks.Free(offset, order);
 
-        DECREASE_BUDDY_COUNTER(m_SpaceUsed, size);
-        DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (size - pBlock->m_unpaddedSize));
-        
-        if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
-        {
-            // Release the resource
-            pBlock->Destroy();
-        }
-        delete(pBlock);
-    }
+    DECREASE_BUDDY_COUNTER(m_SpaceUsed, pBlock->GetSize());
+    DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (pBlock->GetSize() - pBlock->m_unpaddedSize));
 
-    catch (std::bad_alloc&)
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
     {
-        // Deallocate failed trying to add the free block to the pool  
-        // resulting in a leak.  Unfortunately there is not much we can do.  
-        // Fortunately this is expected to be extremely rare as the storage  
-        // needed for each deallocate is very small.  
+        // Release the resource
+        pBlock->Destroy();
     }
+    delete(pBlock);
 };
 
-/*
 void BuddyAllocator::CleanUpAllocations()
 {
-    while (m_deferredDeletionQueue.empty() == false &&
-        g_CommandManager.IsFenceComplete(m_deferredDeletionQueue.front()->m_fenceValue))
-    {
-        BuddyBlock* pBlock = m_deferredDeletionQueue.front();
-        m_deferredDeletionQueue.pop();
-
-        DeallocateInternal(pBlock);
-    }
-}*/
+    m_deferredDeletionQueue.ReclaimAll([](uint64_t FenceValue) { return g_CommandManager.IsFenceComplete(FenceValue); },
+        [this](BuddyBlock* pBlock) { DeallocateInternal(pBlock); });
+}
@@ -16,15 +16,18 @@
 // When a block is de-allocated an attempt is made to merge it with it's 
 // neighbour (buddy) if it is contiguous and free.
 // Based on reference implementation by Bill Kristiansen
+//
+// The offsets themselves are managed by BuddyOffsetAllocator; this class only adds the
+// placed resource and sub-allocation strategies on top.
 //  
 
 #pragma once
 
 #include "GpuBuffer.h"
+#include "BuddyOffsetAllocator.h"
+#include "RetirementQueue.h"
 #include <vector>
-#include <queue>
 #include <mutex>
-#include <set>
 
 // Unfortunately the api restricts the minimum size of a placed buffer resource to 64k
 #define MIN_PLACED_BUFFER_SIZE (64 * 1024)
@@ -96,12 +99,8 @@ public:
 
     inline void Reset()
     {
-        // Clear the free blocks collection  
-        m_freeBlocks.clear();
-
-        // Initialize the pool with a free inner block of max inner block size  
-        m_freeBlocks.resize(m_maxOrder + 1);
-        m_freeBlocks[m_maxOrder].insert((size_t)0);
+        // Return the whole range to the pool as one block of max inner block size
+        m_freeBlocks.Reset();
     }
 
     void CleanUpAllocations();
@@ -112,8 +111,8 @@ private:
 
     const D3D12_HEAP_TYPE m_heapType;
 
-    std::queue<BuddyBlock*> m_deferredDeletionQueue;
-    std::vector<std::set<size_t>> m_freeBlocks;
+    RetirementQueue<BuddyBlock*> m_deferredDeletionQueue;
+    BuddyOffsetAllocator<size_t> m_freeBlocks;
     UINT m_maxOrder;
     const size_t m_baseOffset;
     const size_t m_maxBlockSize;
@@ -128,19 +127,12 @@ private:
 
     inline UINT UnitSizeToOrder(size_t size) const
     {
-        return Math::Log2(size); // Log2 rounds up fractions to next whole value
-    }
-
-    inline size_t GetBuddyOffset(const size_t &offset, const size_t &size)
-    {
-        return offset ^ size;
+        return BuddyOffsetAllocator<size_t>::UnitsToOrder(size); // Rounds up fractions to next whole value
     }
 
     void DeallocateInternal(BuddyBlock* pBlock);
 
     size_t OrderToUnitSize(UINT order) const { return ((size_t)1) << order; }
-    size_t AllocateBlock(UINT order);
-    void DeallocateBlock(size_t offset, UINT order);
 
 #if defined(PROFILE) || defined(_DEBUG)
     size_t m_SpaceUsed;
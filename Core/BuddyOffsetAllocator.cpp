@@ -0,0 +1,292 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "BuddyOffsetAllocator.h"
+#include "SystemTime.h"
+
+#include <random>
+#include <set>
+
+namespace
+{
+    // The free list BuddyAllocator used before, kept as the reference
+    class SetBuddyAllocator
+    {
+    public:
+        explicit SetBuddyAllocator( uint32_t MaxOrder ) : m_MaxOrder(MaxOrder), m_FreeBlocks(MaxOrder + 1)
+        {
+            m_FreeBlocks[MaxOrder].insert(0);
+        }
+
+        bool Allocate( uint32_t Order, size_t& Offset )
+        {
+            if (Order > m_MaxOrder)
+                return false;
+
+            auto it = m_FreeBlocks[Order].begin();
+            if (it == m_FreeBlocks[Order].end())
+            {
+                if (!Allocate(Order + 1, Offset))
+                    return false;
+                m_FreeBlocks[Order].insert(Offset + ((size_t)1 << Order));
+                return true;
+            }
+
+            Offset = *it;
+            m_FreeBlocks[Order].erase(it);
+            return true;
+        }
+
+        void Free( size_t Offset, uint32_t Order )
+        {
+            const size_t Buddy = Offset ^ ((size_t)1 << Order);
+            auto it = m_FreeBlocks[Order].find(Buddy);
+            if (Order < m_MaxOrder && it != m_FreeBlocks[Order].end())
+            {
+                m_FreeBlocks[Order].erase(it);
+                Free(std::min(Offset, Buddy), Order + 1);
+            }
+            else
+            {
+                m_FreeBlocks[Order].insert(Offset);
+            }
+        }
+
+        const std::set<size_t>& GetFreeBlocks( uint32_t Order ) const { return m_FreeBlocks[Order]; }
+
+    private:
+        uint32_t m_MaxOrder;
+        std::vector<std::set<size_t>> m_FreeBlocks;
+    };
+
+    struct Operation
+    {
+        bool IsAllocation;
+        uint32_t OrderOrSlot;   // The order to allocate, or which live block to free
+    };
+
+    // Small blocks are the common case, as with vertex and index buffers
+    uint32_t RandomOrder( std::mt19937& rng, uint32_t MaxOrder )
+    {
+        uint32_t Order = 0;
+        while (Order < MaxOrder && (rng() & 3) == 0)
+            ++Order;
+        return (rng() & 15) == 0 ? rng() % (MaxOrder + 2) : Order;
+    }
+
+    // Alternates between filling and draining so both the split and merge paths stay busy
+    std::vector<Operation> MakeOperations( uint32_t Count, uint32_t MaxOrder, uint32_t MaxLive, uint32_t Seed )
+    {
+        std::mt19937 rng(Seed);
+        std::vector<Operation> ops(Count);
+        uint32_t live = 0;
+        bool filling = true;
+        for (Operation& op : ops)
+        {
+            if (live == 0)
+                filling = true;
+            else if (live >= MaxLive)
+                filling = false;
+            else if (rng() % 64 == 0)
+                filling = !filling;
+
+            op.IsAllocation = live == 0 || (rng() % 4 != 0) == filling;
+            op.OrderOrSlot = op.IsAllocation ? RandomOrder(rng, MaxOrder) : rng();
+            if (op.IsAllocation)
+                ++live;
+            else
+                --live;
+        }
+        return ops;
+    }
+
+    struct LiveBlock
+    {
+        size_t Offset;
+        uint32_t Order;
+    };
+
+    // Replays the operations, freeing live blocks by swap and pop.  A failed allocation still
+    // counts as live so both allocators see the same sequence; it is skipped when freed.
+    template <typename AllocateFunc, typename FreeFunc>
+    uint64_t Replay( const std::vector<Operation>& ops, AllocateFunc Allocate, FreeFunc Free )
+    {
+        std::vector<LiveBlock> live;
+        live.reserve(ops.size());
+        uint64_t checksum = 0;
+        for (const Operation& op : ops)
+        {
+            if (op.IsAllocation)
+            {
+                LiveBlock block = { ~(size_t)0, op.OrderOrSlot };
+                if (Allocate(block.Order, block.Offset))
+                    checksum = checksum * 31 + block.Offset + 1;
+                live.push_back(block);
+            }
+            else
+            {
+                const size_t slot = op.OrderOrSlot % live.size();
+                if (live[slot].Offset != ~(size_t)0)
+                    Free(live[slot].Offset, live[slot].Order);
+                live[slot] = live.back();
+                live.pop_back();
+            }
+        }
+        return checksum;
+    }
+
+    // Runs the same operations through both allocators one at a time, comparing every offset,
+    // checking that no two live blocks overlap, and comparing the full free lists now and then.
+    // Returns the number of disagreements.
+    uint32_t Fuzz( uint32_t MaxOrder, uint32_t NumOperations, uint32_t Seed )
+    {
+        const std::vector<Operation> ops = MakeOperations(NumOperations, MaxOrder, 1u << MaxOrder, Seed);
+
+        BuddyOffsetAllocator<size_t> bitmapAllocator(MaxOrder);
+        SetBuddyAllocator setAllocator(MaxOrder);
+        std::vector<uint8_t> used((size_t)1 << MaxOrder, 0);
+        std::vector<LiveBlock> live;
+        uint64_t usedUnits = 0;
+        uint32_t errors = 0;
+
+        for (size_t i = 0; i < ops.size(); ++i)
+        {
+            const Operation& op = ops[i];
+            if (op.IsAllocation)
+            {
+                LiveBlock block = { ~(size_t)0, op.OrderOrSlot };
+                size_t setOffset = ~(size_t)0;
+                const bool bitmapSucceeded = bitmapAllocator.Allocate(block.Order, block.Offset);
+                const bool setSucceeded = setAllocator.Allocate(block.Order, setOffset);
+                if (bitmapSucceeded != setSucceeded || (bitmapSucceeded && block.Offset != setOffset))
+                    ++errors;
+
+                if (bitmapSucceeded)
+                {
+                    const size_t size = (size_t)1 << block.Order;
+                    if (block.Offset % size != 0 || block.Offset + size > used.size())
+                    {
+                        ++errors;
+                        block.Offset = ~(size_t)0;
+                    }
+                    else
+                    {
+                        for (size_t unit = block.Offset; unit < block.Offset + size; ++unit)
+                            errors += used[unit]++;
+                        usedUnits += size;
+                    }
+                }
+                else
+                {
+                    block.Offset = ~(size_t)0;
+                }
+                live.push_back(block);
+            }
+            else
+            {
+                const size_t slot = op.OrderOrSlot % live.size();
+                const LiveBlock block = live[slot];
+                live[slot] = live.back();
+                live.pop_back();
+
+                if (block.Offset != ~(size_t)0)
+                {
+                    bitmapAllocator.Free(block.Offset, block.Order);
+                    setAllocator.Free(block.Offset, block.Order);
+                    const size_t size = (size_t)1 << block.Order;
+                    for (size_t unit = block.Offset; unit < block.Offset + size; ++unit)
+                        --used[unit];
+                    usedUnits -= size;
+                }
+            }
+
+            if (bitmapAllocator.GetFreeUnits() != ((uint64_t)1 << MaxOrder) - usedUnits)
+                ++errors;
+
+            if (i % 997 == 0 || i + 1 == ops.size())
+            {
+                for (uint32_t order = 0; order <= MaxOrder; ++order)
+                {
+                    size_t freeCount = 0;
+                    for (size_t offset = 0; offset < used.size(); offset += (size_t)1 << order)
+                        freeCount += bitmapAllocator.IsFree(offset, order) ? 1 : 0;
+
+                    const std::set<size_t>& expected = setAllocator.GetFreeBlocks(order);
+                    if (freeCount != expected.size())
+                        ++errors;
+                    for (size_t offset : expected)
+                        errors += bitmapAllocator.IsFree(offset, order) ? 0 : 1;
+                }
+            }
+        }
+
+        // Freeing everything must merge back into the whole range
+        for (const LiveBlock& block : live)
+        {
+            if (block.Offset != ~(size_t)0)
+                bitmapAllocator.Free(block.Offset, block.Order);
+        }
+        if (!bitmapAllocator.IsFree(0, MaxOrder) || bitmapAllocator.GetLargestFreeUnits() != ((uint64_t)1 << MaxOrder))
+            ++errors;
+
+        return errors;
+    }
+}
+
+void BenchmarkBuddyAllocator( void )
+{
+    Utility::Printf("Buddy allocator fuzz test\n");
+
+    const uint32_t fuzzOrders[] = { 0, 1, 4, 8, 12 };
+    for (uint32_t maxOrder : fuzzOrders)
+    {
+        uint32_t errors = 0;
+        const uint32_t kSeeds = 8, kOperations = 20000;
+        for (uint32_t seed = 0; seed < kSeeds; ++seed)
+            errors += Fuzz(maxOrder, kOperations, seed + 1);
+
+        Utility::Printf("  order %2u:  %u operations   %s\n", maxOrder, kSeeds * kOperations,
+            errors == 0 ? "identical" : "MISMATCH");
+    }
+
+    // A 4 GB heap of 64 KB blocks has 2^16 units; go a few orders beyond that
+    const uint32_t kMaxOrder = 20;
+    const uint32_t kNumOperations = 4000000;
+    const uint32_t liveCounts[] = { 64, 4096, 65536 };
+
+    Utility::Printf("Buddy allocator benchmark (2^%u units, %u operations)\n", kMaxOrder, kNumOperations);
+
+    for (uint32_t maxLive : liveCounts)
+    {
+        const std::vector<Operation> ops = MakeOperations(kNumOperations, kMaxOrder, maxLive, 7);
+
+        SetBuddyAllocator setAllocator(kMaxOrder);
+        int64_t startTick = SystemTime::GetCurrentTick();
+        const uint64_t setChecksum = Replay(ops,
+            [&]( uint32_t order, size_t& offset ) { return setAllocator.Allocate(order, offset); },
+            [&]( size_t offset, uint32_t order ) { setAllocator.Free(offset, order); });
+        const double setSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        BuddyOffsetAllocator<size_t> bitmapAllocator(kMaxOrder);
+        startTick = SystemTime::GetCurrentTick();
+        const uint64_t bitmapChecksum = Replay(ops,
+            [&]( uint32_t order, size_t& offset ) { return bitmapAllocator.Allocate(order, offset); },
+            [&]( size_t offset, uint32_t order ) { bitmapAllocator.Free(offset, order); });
+        const double bitmapSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        Utility::Printf("  up to %5u live:  std::set %7.2f Mops/s   bitmap %7.2f Mops/s   (%4.1fx, %s)\n",
+            maxLive, kNumOperations / setSeconds * 1e-6, kNumOperations / bitmapSeconds * 1e-6,
+            setSeconds / bitmapSeconds, setChecksum == bitmapChecksum ? "identical" : "MISMATCH");
+    }
+}
@@ -0,0 +1,245 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <intrin.h>
+#include <vector>
+
+//
+// The offset bookkeeping of a buddy allocator, with no knowledge of what the offsets address.
+// The range is 2^MaxOrder units and a block of order N is 2^N units aligned to its own size.
+//
+// Each order keeps a bitmap of its free blocks, summarized by coarser bitmaps in which a bit is
+// set when the 64 bits below it are not all zero.  A mask of the orders that have any free block
+// finds the smallest block that fits with one bit scan, and a few more scans down the summaries
+// find the lowest free block of that order.  Freeing tests the buddy's bit directly, so merges
+// never search.  Nothing allocates after Initialize().
+//
+// Blocks are chosen exactly as a free list ordered by offset would choose them: the lowest free
+// block of the smallest order that fits, split keeping the left half.
+//
+template <typename OffsetType = uint32_t>
+class BuddyOffsetAllocator
+{
+public:
+    static const uint32_t kMaxOrder = 32;
+
+    BuddyOffsetAllocator() : m_MaxOrder(0), m_NonEmptyOrders(0), m_FreeUnits(0) {}
+    explicit BuddyOffsetAllocator( uint32_t MaxOrder ) { Initialize(MaxOrder); }
+
+    // Sizes the bitmaps for a range of 2^MaxOrder units and frees all of it
+    void Initialize( uint32_t MaxOrder )
+    {
+        ASSERT(MaxOrder <= kMaxOrder);
+        ASSERT(sizeof(OffsetType) * 8 >= MaxOrder, "Offset type too small for the range");
+
+        m_MaxOrder = MaxOrder;
+        m_Bitmaps.resize(MaxOrder + 1);
+        for (uint32_t Order = 0; Order <= MaxOrder; ++Order)
+            m_Bitmaps[Order].Initialize(1ull << (MaxOrder - Order));
+
+        Reset();
+    }
+
+    // Frees every block at once
+    void Reset( void )
+    {
+        for (Bitmap& bitmap : m_Bitmaps)
+            bitmap.ClearAll();
+
+        m_NonEmptyOrders = 0;
+        m_FreeUnits = 0;
+
+        if (!m_Bitmaps.empty())
+        {
+            SetFree(m_MaxOrder, 0);
+            m_FreeUnits = 1ull << m_MaxOrder;
+        }
+    }
+
+    // The smallest order whose blocks hold Units
+    static uint32_t UnitsToOrder( uint64_t Units )
+    {
+        unsigned long HighBit;
+        if (Units <= 1 || !_BitScanReverse64(&HighBit, Units - 1))
+            return 0;
+        return HighBit + 1;
+    }
+
+    // Returns false if no free block is large enough
+    bool Allocate( uint32_t Order, OffsetType& Offset )
+    {
+        if (Order > m_MaxOrder)
+            return false;
+
+        unsigned long FoundOrder;
+        if (!_BitScanForward64(&FoundOrder, m_NonEmptyOrders >> Order << Order))
+            return false;
+
+        const uint64_t Index = m_Bitmaps[FoundOrder].FindFirst();
+        ClearFree(FoundOrder, Index);
+        Offset = (OffsetType)(Index << FoundOrder);
+
+        // Split down to the requested size, freeing the right half at each step
+        while (FoundOrder > Order)
+        {
+            --FoundOrder;
+            SetFree(FoundOrder, ((uint64_t)Offset >> FoundOrder) + 1);
+        }
+
+        m_FreeUnits -= 1ull << Order;
+        return true;
+    }
+
+    // Offset and Order must be those of a block returned by Allocate()
+    void Free( OffsetType Offset, uint32_t Order )
+    {
+        ASSERT(Order <= m_MaxOrder);
+        ASSERT(((uint64_t)Offset & ((1ull << Order) - 1)) == 0, "Offset is not aligned to its order");
+        ASSERT(!IsFree(Offset, Order), "Block freed twice");
+
+        m_FreeUnits += 1ull << Order;
+
+        // Merge with the buddy for as long as it is free
+        uint64_t Index = (uint64_t)Offset >> Order;
+        while (Order < m_MaxOrder && m_Bitmaps[Order].Test(Index ^ 1))
+        {
+            ClearFree(Order, Index ^ 1);
+            Index >>= 1;
+            ++Order;
+        }
+
+        SetFree(Order, Index);
+    }
+
+    // True if this exact block is on the free list (not if it is part of a larger free block)
+    bool IsFree( OffsetType Offset, uint32_t Order ) const
+    {
+        return m_Bitmaps[Order].Test((uint64_t)Offset >> Order);
+    }
+
+    uint32_t GetMaxOrder( void ) const { return m_MaxOrder; }
+    uint64_t GetFreeUnits( void ) const { return m_FreeUnits; }
+
+    // The largest block that could be allocated right now, or zero when full
+    uint64_t GetLargestFreeUnits( void ) const
+    {
+        unsigned long HighestOrder;
+        return _BitScanReverse64(&HighestOrder, m_NonEmptyOrders) ? 1ull << HighestOrder : 0;
+    }
+
+private:
+
+    // A bitmap over Count bits with summary levels above it.  Level 0 is the bitmap itself; each
+    // word of level L + 1 has a bit for every word of level L that is not zero.  The top level is
+    // one word.
+    class Bitmap
+    {
+    public:
+        void Initialize( uint64_t Count )
+        {
+            m_NumLevels = 0;
+            uint64_t TotalWords = 0;
+            do
+            {
+                ASSERT(m_NumLevels < kMaxLevels);
+                Count = (Count + 63) / 64;
+                m_LevelStart[m_NumLevels++] = TotalWords;
+                TotalWords += Count;
+            }
+            while (Count > 1);
+
+            m_Words.resize(TotalWords);
+        }
+
+        void ClearAll( void ) { std::fill(m_Words.begin(), m_Words.end(), 0ull); }
+
+        bool Test( uint64_t Index ) const
+        {
+            return (m_Words[Index >> 6] >> (Index & 63) & 1) != 0;
+        }
+
+        // Returns true if the bitmap was empty
+        bool Set( uint64_t Index )
+        {
+            for (uint32_t Level = 0; Level < m_NumLevels; ++Level)
+            {
+                uint64_t& Word = m_Words[m_LevelStart[Level] + (Index >> 6)];
+                const bool WasEmpty = Word == 0;
+                Word |= 1ull << (Index & 63);
+                if (!WasEmpty)
+                    return false;
+                Index >>= 6;
+            }
+            return true;
+        }
+
+        // Returns true if the bitmap is now empty
+        bool Clear( uint64_t Index )
+        {
+            for (uint32_t Level = 0; Level < m_NumLevels; ++Level)
+            {
+                uint64_t& Word = m_Words[m_LevelStart[Level] + (Index >> 6)];
+                Word &= ~(1ull << (Index & 63));
+                if (Word != 0)
+                    return false;
+                Index >>= 6;
+            }
+            return true;
+        }
+
+        // The lowest set bit.  The bitmap must not be empty.
+        uint64_t FindFirst( void ) const
+        {
+            uint64_t Index = 0;
+            for (uint32_t Level = m_NumLevels; Level-- > 0; )
+            {
+                unsigned long Bit;
+                _BitScanForward64(&Bit, m_Words[m_LevelStart[Level] + Index]);
+                Index = Index * 64 + Bit;
+            }
+            return Index;
+        }
+
+    private:
+        // Six levels of 64-bit words cover 2^36 bits
+        static const uint32_t kMaxLevels = 6;
+
+        std::vector<uint64_t> m_Words;
+        uint64_t m_LevelStart[kMaxLevels];
+        uint32_t m_NumLevels;
+    };
+
+    void SetFree( uint32_t Order, uint64_t Index )
+    {
+        if (m_Bitmaps[Order].Set(Index))
+            m_NonEmptyOrders |= 1ull << Order;
+    }
+
+    void ClearFree( uint32_t Order, uint64_t Index )
+    {
+        if (m_Bitmaps[Order].Clear(Index))
+            m_NonEmptyOrders &= ~(1ull << Order);
+    }
+
+    std::vector<Bitmap> m_Bitmaps;
+    uint32_t m_MaxOrder;
+    uint64_t m_NonEmptyOrders;      // Bit N is set when some block of order N is free
+    uint64_t m_FreeUnits;
+};
+
+// Checks randomized allocation sequences against a std::set free list, then times both
+void BenchmarkBuddyAllocator( void );
@@ -14,9 +14,24 @@
 #include "pch.h"
 #include "CommandAllocatorPool.h"
 
+namespace
+{
+    const char* GetRetirementQueueName(D3D12_COMMAND_LIST_TYPE Type)
+    {
+        switch (Type)
+        {
+        case D3D12_COMMAND_LIST_TYPE_DIRECT: return "Direct command allocators";
+        case D3D12_COMMAND_LIST_TYPE_COMPUTE: return "Compute command allocators";
+        case D3D12_COMMAND_LIST_TYPE_COPY: return "Copy command allocators";
+        default: return "Command allocators";
+        }
+    }
+}
+
 CommandAllocatorPool::CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type) :
     m_cCommandListType(Type),
-    m_Device(nullptr)
+    m_Device(nullptr),
+    m_ReadyAllocators(GetRetirementQueueName(Type))
 {
 }
 
@@ -32,6 +47,8 @@ void CommandAllocatorPool::Create(ID3D12Device * pDevice)
 
 void CommandAllocatorPool::Shutdown()
 {
+    m_ReadyAllocators.Flush([](ID3D12CommandAllocator*) {});
+
     for (size_t i = 0; i < m_AllocatorPool.size(); ++i)
         m_AllocatorPool[i]->Release();
 
@@ -40,25 +57,16 @@ void CommandAllocatorPool::Shutdown()
 
 ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(uint64_t CompletedFenceValue)
 {
-    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
-
     ID3D12CommandAllocator* pAllocator = nullptr;
 
-    if (!m_ReadyAllocators.empty())
+    if (m_ReadyAllocators.Reclaim(pAllocator, [CompletedFenceValue](uint64_t FenceValue) { return FenceValue <= CompletedFenceValue; }))
     {
-        std::pair<uint64_t, ID3D12CommandAllocator*>& AllocatorPair = m_ReadyAllocators.front();
-
-        if (AllocatorPair.first <= CompletedFenceValue)
-        {
-            pAllocator = AllocatorPair.second;
-            ASSERT_SUCCEEDED(pAllocator->Reset());
-            m_ReadyAllocators.pop();
-        }
+        ASSERT_SUCCEEDED(pAllocator->Reset());
     }
-
-    // If no allocator's were ready to be reused, create a new one
-    if (pAllocator == nullptr)
+    else
     {
+        // If no allocator's were ready to be reused, create a new one
+        std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
         ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
         wchar_t AllocatorName[32];
         swprintf(AllocatorName, 32, L"CommandAllocator %zu", m_AllocatorPool.size());
@@ -71,8 +79,6 @@ ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(uint64_t Complet
 
 void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator * Allocator)
 {
-    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
-
     // That fence value indicates we are free to reset the allocator
-    m_ReadyAllocators.push(std::make_pair(FenceValue, Allocator));
+    m_ReadyAllocators.Retire(FenceValue, Allocator);
 }
@@ -13,8 +13,8 @@
 
 #pragma once
 
+#include "RetirementQueue.h"
 #include <vector>
-#include <queue>
 #include <mutex>
 #include <stdint.h>
 
@@ -37,6 +37,6 @@ private:
 
     ID3D12Device* m_Device;
     std::vector<ID3D12CommandAllocator*> m_AllocatorPool;
-    std::queue<std::pair<uint64_t, ID3D12CommandAllocator*>> m_ReadyAllocators;
-    std::mutex m_AllocatorMutex;
+    RetirementQueue<ID3D12CommandAllocator*> m_ReadyAllocators;
+    std::mutex m_AllocatorMutex;    // Guards creating allocators
 };
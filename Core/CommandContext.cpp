@@ -557,7 +557,9 @@ uint32_t CommandContext::ReadbackTexture(ReadbackBuffer& DstBuffer, PixelBuffer&
     g_Device->GetCopyableFootprints(&SrcBuffer.GetResource()->GetDesc(), 0, 1, 0,
         &PlacedFootprint, nullptr, nullptr, &CopySize);
 
-    DstBuffer.Create(L"Readback", (uint32_t)CopySize, 1);
+    // Keep the buffer when it already fits so that readbacks can be repeated every frame
+    if (DstBuffer.GetResource() == nullptr || DstBuffer.GetBufferSize() != CopySize)
+        DstBuffer.Create(L"Readback", (uint32_t)CopySize, 1);
 
     TransitionResource(SrcBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE, true);
 
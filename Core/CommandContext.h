@@ -26,6 +26,7 @@
 #include "CommandSignature.h"
 #include "GraphicsCore.h"
 #include <vector>
+#include <queue>
 
 class ColorBuffer;
 class DepthBuffer;
@@ -0,0 +1,127 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "ConcurrentHashMap.h"
+#include "SystemTime.h"
+
+#include <map>
+#include <random>
+
+namespace
+{
+    // The pattern ConcurrentHashMap replaces
+    class LockedMap
+    {
+    public:
+        template <typename CreateFunc>
+        uint64_t GetOrCreate( uint64_t Key, CreateFunc Create )
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto iter = m_Map.find(Key);
+            if (iter != m_Map.end())
+                return iter->second;
+            return m_Map[Key] = Create();
+        }
+
+    private:
+        std::mutex m_Mutex;
+        std::map<uint64_t, uint64_t> m_Map;
+    };
+
+    uint64_t ValueOf( uint64_t Key ) { return Key * 31 + 7; }
+
+    // Runs Lookup on every key of each thread's list at once and returns the elapsed seconds
+    template <typename LookupFunc>
+    double TimeThreads( uint32_t NumThreads, const std::vector<std::vector<uint64_t>>& Keys, LookupFunc Lookup, uint64_t& Checksum )
+    {
+        std::vector<uint64_t> sums(NumThreads, 0);
+        std::vector<std::thread> threads;
+        std::atomic<uint32_t> waiting(NumThreads);
+
+        int64_t startTick = 0;
+        for (uint32_t t = 0; t < NumThreads; ++t)
+        {
+            threads.push_back(std::thread([&, t]( void )
+            {
+                // Start together so the threads actually contend
+                --waiting;
+                while (waiting > 0)
+                    std::this_thread::yield();
+
+                uint64_t sum = 0;
+                for (uint64_t key : Keys[t])
+                    sum += Lookup(key);
+                sums[t] = sum;
+            }));
+        }
+
+        while (waiting > 0)
+            std::this_thread::yield();
+        startTick = SystemTime::GetCurrentTick();
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        double seconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        Checksum = 0;
+        for (uint64_t sum : sums)
+            Checksum += sum;
+        return seconds;
+    }
+}
+
+void BenchmarkConcurrentHashMap( void )
+{
+    const uint32_t kNumKeys = 2048;             // About as many pipelines as a large scene creates
+    const uint32_t kLookupsPerThread = 200000;
+    const uint32_t threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    std::mt19937_64 rng(17);
+    std::vector<uint64_t> keys(kNumKeys);
+    for (uint64_t& key : keys)
+        key = rng();
+
+    Utility::Printf("Concurrent hash map benchmark (%u keys, %u lookups per thread)\n", kNumKeys, kLookupsPerThread);
+
+    for (uint32_t numThreads : threadCounts)
+    {
+        std::vector<std::vector<uint64_t>> threadKeys(numThreads);
+        for (std::vector<uint64_t>& list : threadKeys)
+        {
+            list.resize(kLookupsPerThread);
+            for (uint64_t& key : list)
+                key = keys[rng() % kNumKeys];
+        }
+
+        // Each map starts empty, so the first lookups of every key race to create it
+        std::atomic<uint32_t> lockedCreates(0), concurrentCreates(0);
+        LockedMap lockedMap;
+        ConcurrentHashMap<uint64_t> concurrentMap;
+
+        uint64_t lockedSum = 0, concurrentSum = 0;
+        double lockedSeconds = TimeThreads(numThreads, threadKeys, [&]( uint64_t key )
+            { return lockedMap.GetOrCreate(key, [&]( void ) { ++lockedCreates; return ValueOf(key); }); }, lockedSum);
+        double concurrentSeconds = TimeThreads(numThreads, threadKeys, [&]( uint64_t key )
+            { return concurrentMap.GetOrCreate(key, [&]( void ) { ++concurrentCreates; return ValueOf(key); }); }, concurrentSum);
+
+        const bool identical = lockedSum == concurrentSum && lockedCreates == concurrentCreates &&
+            concurrentCreates == concurrentMap.Size();
+
+        const double lookups = (double)numThreads * kLookupsPerThread;
+        Utility::Printf("  %2u threads:  map + mutex %8.2f Mlookups/s   concurrent %8.2f Mlookups/s   (%4.1fx, %u created, %s)\n",
+            numThreads, lookups / lockedSeconds * 1e-6, lookups / concurrentSeconds * 1e-6, lockedSeconds / concurrentSeconds,
+            (uint32_t)concurrentCreates, identical ? "identical" : "MISMATCH");
+    }
+}
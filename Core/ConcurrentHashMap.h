@@ -0,0 +1,217 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// An insert-only hash map for caches of objects that are expensive to create, such as pipeline
+// states and root signatures, and are looked up far more often than they are added.
+//
+// Keys are split between shards, each an open addressing table of pointers to entries.  Lookups
+// never lock: a table is only ever replaced by a larger copy, and entries never move or change
+// key, so a reader sees either the old table or the new one and both are valid.  Replaced tables
+// are kept until Clear() because a reader may still be walking one.
+//
+// GetOrCreate() runs the creation function exactly once per key, outside of any lock.  Threads
+// asking for a key whose value is still being created wait for it rather than creating another.
+//
+template <typename ValueType>
+class ConcurrentHashMap
+{
+public:
+    ConcurrentHashMap() {}
+    ~ConcurrentHashMap() { Clear(); }
+
+    ConcurrentHashMap( const ConcurrentHashMap& ) = delete;
+    ConcurrentHashMap& operator=( const ConcurrentHashMap& ) = delete;
+
+    // Returns the value stored under Key, calling Create() to make it if no thread has yet.  The
+    // reference stays valid until Clear().
+    template <typename CreateFunc>
+    const ValueType& GetOrCreate( uint64_t Key, CreateFunc Create )
+    {
+        const uint64_t Hash = Mix(Key);
+        Shard& shard = m_Shards[Hash >> (64 - kShardBits)];
+
+        Entry* entry = FindEntry(shard.Current.load(std::memory_order_acquire), Hash, Key);
+        if (entry == nullptr)
+        {
+            bool firstCompile = false;
+            {
+                std::lock_guard<std::mutex> lock(shard.Mutex);
+
+                // Someone else may have inserted it since we looked
+                entry = FindEntry(shard.Current.load(std::memory_order_relaxed), Hash, Key);
+                if (entry == nullptr)
+                {
+                    shard.Entries.emplace_back(new Entry(Key));
+                    entry = shard.Entries.back().get();
+                    Insert(shard, Hash, entry);
+                    firstCompile = true;
+                }
+            }
+
+            if (firstCompile)
+            {
+                entry->Value = Create();
+                entry->Ready.store(true, std::memory_order_release);
+                return entry->Value;
+            }
+        }
+
+        while (!entry->Ready.load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+        return entry->Value;
+    }
+
+    // Returns false if the key is absent or its value is still being created
+    bool Find( uint64_t Key, ValueType& Value ) const
+    {
+        const uint64_t Hash = Mix(Key);
+        const Shard& shard = m_Shards[Hash >> (64 - kShardBits)];
+        const Entry* entry = FindEntry(shard.Current.load(std::memory_order_acquire), Hash, Key);
+        if (entry == nullptr || !entry->Ready.load(std::memory_order_acquire))
+            return false;
+
+        Value = entry->Value;
+        return true;
+    }
+
+    size_t Size( void ) const
+    {
+        size_t count = 0;
+        for (const Shard& shard : m_Shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            count += shard.Entries.size();
+        }
+        return count;
+    }
+
+    // Destroys every value.  No other thread may be using the map.
+    void Clear( void )
+    {
+        for (Shard& shard : m_Shards)
+        {
+            shard.Current.store(nullptr, std::memory_order_relaxed);
+            shard.Tables.clear();
+            shard.Entries.clear();
+        }
+    }
+
+private:
+    static const uint32_t kShardBits = 4;
+    static const uint32_t kNumShards = 1 << kShardBits;
+    static const uint32_t kInitialCapacity = 32;
+
+    struct Entry
+    {
+        explicit Entry( uint64_t Key ) : Key(Key), Ready(false), Value() {}
+
+        const uint64_t Key;
+        std::atomic<bool> Ready;
+        ValueType Value;
+    };
+
+    struct Table
+    {
+        explicit Table( uint32_t Capacity ) : Mask(Capacity - 1), Slots(new std::atomic<Entry*>[Capacity])
+        {
+            for (uint32_t i = 0; i < Capacity; ++i)
+                Slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        const uint32_t Mask;
+        std::unique_ptr<std::atomic<Entry*>[]> Slots;
+    };
+
+    struct Shard
+    {
+        Shard() : Current(nullptr) {}
+
+        std::atomic<Table*> Current;
+        mutable std::mutex Mutex;
+        std::vector<std::unique_ptr<Table>> Tables;     // Every table ever published
+        std::vector<std::unique_ptr<Entry>> Entries;
+    };
+
+    // Keys are often hashes already, but some are small integers.  Mixing makes both spread well.
+    static uint64_t Mix( uint64_t Key )
+    {
+        Key ^= Key >> 33;
+        Key *= 0xFF51AFD7ED558CCDull;
+        Key ^= Key >> 33;
+        Key *= 0xC4CEB9FE1A85EC53ull;
+        Key ^= Key >> 33;
+        return Key;
+    }
+
+    static Entry* FindEntry( const Table* table, uint64_t Hash, uint64_t Key )
+    {
+        if (table == nullptr)
+            return nullptr;
+
+        for (uint32_t Slot = (uint32_t)Hash & table->Mask; ; Slot = (Slot + 1) & table->Mask)
+        {
+            Entry* entry = table->Slots[Slot].load(std::memory_order_acquire);
+            if (entry == nullptr || entry->Key == Key)
+                return entry;
+        }
+    }
+
+    static void Place( Table& table, uint64_t Hash, Entry* entry )
+    {
+        uint32_t Slot = (uint32_t)Hash & table.Mask;
+        while (table.Slots[Slot].load(std::memory_order_relaxed) != nullptr)
+            Slot = (Slot + 1) & table.Mask;
+        table.Slots[Slot].store(entry, std::memory_order_release);
+    }
+
+    // Called with the shard locked after the entry is added to shard.Entries.  Tables are kept
+    // at most half full so probes stay short.
+    static void Insert( Shard& shard, uint64_t Hash, Entry* entry )
+    {
+        Table* table = shard.Current.load(std::memory_order_relaxed);
+        const uint32_t Capacity = table != nullptr ? table->Mask + 1 : 0;
+
+        if (shard.Entries.size() * 2 > Capacity)
+        {
+            shard.Tables.emplace_back(new Table(Capacity > 0 ? Capacity * 2 : kInitialCapacity));
+            Table* grown = shard.Tables.back().get();
+            for (const std::unique_ptr<Entry>& existing : shard.Entries)
+            {
+                if (existing.get() != entry)
+                    Place(*grown, Mix(existing->Key), existing.get());
+            }
+            Place(*grown, Hash, entry);
+            shard.Current.store(grown, std::memory_order_release);
+        }
+        else
+        {
+            Place(*table, Hash, entry);
+        }
+    }
+
+    Shard m_Shards[kNumShards];
+};
+
+// Times lookups from 1 to 64 threads against a std::map guarded by one mutex
+void BenchmarkConcurrentHashMap( void );
@@ -26,26 +26,20 @@ using namespace Graphics;
 
 std::mutex DynamicDescriptorHeap::sm_Mutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap::sm_DescriptorHeapPool[2];
-std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::sm_RetiredDescriptorHeaps[2];
-std::queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_AvailableDescriptorHeaps[2];
+RetirementQueue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_RetiredDescriptorHeaps[2] =
+{
+    { "View descriptor heaps" },
+    { "Sampler descriptor heaps" }
+};
 
 ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
 {
-    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
-
     uint32_t idx = HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
 
-    while (!sm_RetiredDescriptorHeaps[idx].empty() && g_CommandManager.IsFenceComplete(sm_RetiredDescriptorHeaps[idx].front().first))
-    {
-        sm_AvailableDescriptorHeaps[idx].push(sm_RetiredDescriptorHeaps[idx].front().second);
-        sm_RetiredDescriptorHeaps[idx].pop();
-    }
-
-    if (!sm_AvailableDescriptorHeaps[idx].empty())
+    ID3D12DescriptorHeap* RetiredHeapPtr = nullptr;
+    if (sm_RetiredDescriptorHeaps[idx].Reclaim(RetiredHeapPtr, [](uint64_t FenceValue) { return g_CommandManager.IsFenceComplete(FenceValue); }))
     {
-        ID3D12DescriptorHeap* HeapPtr = sm_AvailableDescriptorHeaps[idx].front();
-        sm_AvailableDescriptorHeaps[idx].pop();
-        return HeapPtr;
+        return RetiredHeapPtr;
     }
     else
     {
@@ -56,6 +50,8 @@ ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIP
         HeapDesc.NodeMask = 1;
         Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> HeapPtr;
         ASSERT_SUCCEEDED(g_Device->CreateDescriptorHeap(&HeapDesc, MY_IID_PPV_ARGS(&HeapPtr)));
+
+        std::lock_guard<std::mutex> LockGuard(sm_Mutex);
         sm_DescriptorHeapPool[idx].emplace_back(HeapPtr);
         return HeapPtr.Get();
     }
@@ -64,9 +60,7 @@ ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIP
 void DynamicDescriptorHeap::DiscardDescriptorHeaps( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValue, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps )
 {
     uint32_t idx = HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
-    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
-    for (auto iter = UsedHeaps.begin(); iter != UsedHeaps.end(); ++iter)
-        sm_RetiredDescriptorHeaps[idx].push(std::make_pair(FenceValue, *iter));
+    sm_RetiredDescriptorHeaps[idx].Retire(FenceValue, UsedHeaps.data(), UsedHeaps.size());
 }
 
 void DynamicDescriptorHeap::RetireCurrentHeap( void )
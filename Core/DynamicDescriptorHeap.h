@@ -15,8 +15,8 @@
 
 #include "DescriptorHeap.h"
 #include "RootSignature.h"
+#include "RetirementQueue.h"
 #include <vector>
-#include <queue>
 
 namespace Graphics
 {
@@ -34,6 +34,8 @@ public:
 
     static void DestroyAll(void)
     {
+        sm_RetiredDescriptorHeaps[0].Flush([](ID3D12DescriptorHeap*) {});
+        sm_RetiredDescriptorHeaps[1].Flush([](ID3D12DescriptorHeap*) {});
         sm_DescriptorHeapPool[0].clear();
         sm_DescriptorHeapPool[1].clear();
     }
@@ -82,10 +84,9 @@ private:
 
     // Static members
     static const uint32_t kNumDescriptorsPerHeap = 1024;
-    static std::mutex sm_Mutex;
+    static std::mutex sm_Mutex;     // Guards sm_DescriptorHeapPool
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool[2];
-    static std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> sm_RetiredDescriptorHeaps[2];
-    static std::queue<ID3D12DescriptorHeap*> sm_AvailableDescriptorHeaps[2];
+    static RetirementQueue<ID3D12DescriptorHeap*> sm_RetiredDescriptorHeaps[2];
 
     // Static methods
     static ID3D12DescriptorHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
@@ -466,11 +466,26 @@ namespace EngineProfiling
         {
             Text.DrawFormattedString("1x1: %.2f%%  ", VRS::Percents.num1x1);
             Text.DrawFormattedString("1x2: %.2f%%  ", VRS::Percents.num1x2);
-            Text.DrawFormattedString("2x1: %.2f%%\n", VRS::Percents.num1x2);
+            Text.DrawFormattedString("2x1: %.2f%%\n", VRS::Percents.num2x1);
             Text.DrawFormattedString("2x2: %.2f%%  ", VRS::Percents.num2x2);
             Text.DrawFormattedString("2x4: %.2f%%  ", VRS::Percents.num2x4);
             Text.DrawFormattedString("4x2: %.2f%%\n", VRS::Percents.num4x2);
             Text.DrawFormattedString("4x4: %.2f%%\n", VRS::Percents.num4x4);
+
+            float averagePercents[7], averageWork, minWork, maxWork;
+            VRS::RateHistory.GetAverage(averagePercents, averageWork);
+            VRS::RateHistory.GetWorkRange(minWork, maxWork);
+            Text.DrawFormattedString("Shading work: %.1f%%  Last %u frames: %.1f%% (%.1f%% - %.1f%%)\n",
+                VRS::GetShadingWork(VRS::RateStats.Total) * 100.0f, VRS::RateHistory.GetNumFrames(),
+                averageWork, minWork, maxWork);
+
+            // Shading work of each screen region, top row first
+            for (uint32_t y = 0; y < VRS::RateStats.GridY; ++y)
+            {
+                for (uint32_t x = 0; x < VRS::RateStats.GridX; ++x)
+                    Text.DrawFormattedString("%5.1f%%  ", VRS::GetShadingWork(VRS::RateStats.Cells[y * VRS::RateStats.GridX + x]) * 100.0f);
+                Text.DrawFormattedString("\n");
+            }
         }
 
         // VRS Tier
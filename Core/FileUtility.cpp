@@ -13,6 +13,7 @@
 
 #include "pch.h"
 #include "FileUtility.h"
+#include <atomic>
 #include <fstream>
 #include <mutex>
 #include <zlib.h> // From NuGet package 
@@ -134,3 +135,81 @@ task<ByteArray> Utility::ReadFileAsync(const wstring& fileName)
     shared_ptr<wstring> SharedPtr = make_shared<wstring>(fileName);
     return create_task( [=] { return ReadFileHelperEx(SharedPtr); } );
 }
+
+bool Utility::MappedFile::Open(const wstring& fileName)
+{
+    Close();
+
+    m_File = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_File, &fileSize) || fileSize.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+
+    // PAGE_WRITECOPY lets callers patch the view (e.g. fix up runtime handles) without
+    // needing write access to the file itself.
+    m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (m_Mapping == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    m_View = (byte*)MapViewOfFile(m_Mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (m_View == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    m_Size = (size_t)fileSize.QuadPart;
+    return true;
+}
+
+void Utility::MappedFile::Close(void)
+{
+    if (m_View != nullptr)
+        UnmapViewOfFile(m_View);
+    if (m_Mapping != nullptr)
+        CloseHandle(m_Mapping);
+    if (m_File != INVALID_HANDLE_VALUE)
+        CloseHandle(m_File);
+
+    m_File = INVALID_HANDLE_VALUE;
+    m_Mapping = nullptr;
+    m_View = nullptr;
+    m_Size = 0;
+}
+
+bool Utility::ReplaceMappedFile(const wstring& newFile, const wstring& target)
+{
+    // A file that is open can be renamed when every handle shares delete access, but it cannot
+    // be the target of a replacing move.  So move it out of the way first.
+    static atomic<uint32_t> s_OldFileCounter(0);
+    wchar_t oldSuffix[32];
+    swprintf_s(oldSuffix, L".%u.%u.old", GetCurrentProcessId(), s_OldFileCounter++);
+    const wstring oldFile = target + oldSuffix;
+
+    const bool movedAside = MoveFileExW(target.c_str(), oldFile.c_str(), 0) != 0;
+    if (!movedAside && GetLastError() != ERROR_FILE_NOT_FOUND)
+        return false;
+
+    if (!MoveFileExW(newFile.c_str(), target.c_str(), MOVEFILE_WRITE_THROUGH))
+    {
+        if (movedAside)
+            MoveFileExW(oldFile.c_str(), target.c_str(), 0);
+        return false;
+    }
+
+    // The name goes away once the last view of the old file is closed
+    if (movedAside)
+        DeleteFileW(oldFile.c_str());
+
+    return true;
+}
@@ -34,4 +34,36 @@ namespace Utility
     // Same as previous except that it does not block but instead returns a task.
     task<ByteArray> ReadFileAsync(const wstring& fileName);
 
+    // Maps an entire file into the address space without reading it.  Pages are faulted in
+    // on first access.  The view is copy-on-write:  writes land in private pages and are never
+    // flushed back to the file.  The file is shared for deletion, so ReplaceMappedFile can
+    // replace it while the view is open.
+    class MappedFile
+    {
+    public:
+        MappedFile() : m_File(INVALID_HANDLE_VALUE), m_Mapping(nullptr), m_View(nullptr), m_Size(0) {}
+        ~MappedFile() { Close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const wstring& fileName);
+        void Close(void);
+
+        bool IsOpen(void) const { return m_View != nullptr; }
+        byte* GetData(void) const { return m_View; }
+        size_t GetSize(void) const { return m_Size; }
+
+    private:
+        HANDLE m_File;
+        HANDLE m_Mapping;
+        byte* m_View;
+        size_t m_Size;
+    };
+
+    // Moves newFile to target, replacing any file already there, even one that is still open in
+    // a MappedFile.  The old file is renamed aside and deleted, and its views keep the old
+    // contents until they are closed.  Both paths must be on the same volume.
+    bool ReplaceMappedFile(const wstring& newFile, const wstring& target);
+
 } // namespace Utility
@@ -0,0 +1,342 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "FrameAllocator.h"
+#include "SystemTime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <malloc.h>
+#include <mutex>
+#include <string>
+
+namespace FrameAllocator
+{
+    struct Counts
+    {
+        uint32_t Allocations;
+        uint64_t Bytes;
+        uint32_t Pages;
+        uint32_t OverflowAllocations;
+        uint64_t OverflowBytes;
+
+        void Add( const Counts& Other )
+        {
+            Allocations += Other.Allocations;
+            Bytes += Other.Bytes;
+            Pages += Other.Pages;
+            OverflowAllocations += Other.OverflowAllocations;
+            OverflowBytes += Other.OverflowBytes;
+        }
+    };
+
+    // The page a thread is filling.  BeginFrame takes it back, which is safe because no thread may
+    // allocate during BeginFrame.
+    struct ThreadArena
+    {
+        ThreadArena();
+        ~ThreadArena();
+
+        uint8_t* Page;
+        size_t Offset;
+        Counts FrameCounts;
+    };
+
+    // Everything here is guarded by s_Mutex.  Threads take it only to get a page.
+    std::mutex s_Mutex;
+    uint64_t s_FrameIndex = 0;
+    std::vector<uint8_t*> s_FreePages;
+    std::vector<uint8_t*> s_FramePages[kNumFrames];
+    std::vector<void*> s_FrameOverflows[kNumFrames];
+    std::vector<ThreadArena*> s_Arenas;
+    uint32_t s_PagesInPool = 0;
+    Counts s_ExitedCounts = {};     // From threads that ended during this frame
+    Counts s_LastFrameCounts = {};
+    uint64_t s_PeakBytes = 0;
+
+    thread_local ThreadArena t_Arena;
+
+    ThreadArena::ThreadArena() : Page(nullptr), Offset(0), FrameCounts()
+    {
+        std::lock_guard<std::mutex> lock(s_Mutex);
+        s_Arenas.push_back(this);
+    }
+
+    ThreadArena::~ThreadArena()
+    {
+        std::lock_guard<std::mutex> lock(s_Mutex);
+        s_ExitedCounts.Add(FrameCounts);
+        s_Arenas.erase(std::find(s_Arenas.begin(), s_Arenas.end(), this));
+    }
+
+    uint8_t* AcquirePage( void )
+    {
+        std::lock_guard<std::mutex> lock(s_Mutex);
+
+        uint8_t* Page = nullptr;
+        if (s_FreePages.empty())
+        {
+            Page = (uint8_t*)_aligned_malloc(kPageSize, 4096);
+            ASSERT(Page != nullptr, "Out of memory for frame allocator pages");
+            ++s_PagesInPool;
+        }
+        else
+        {
+            Page = s_FreePages.back();
+            s_FreePages.pop_back();
+        }
+
+        s_FramePages[s_FrameIndex % kNumFrames].push_back(Page);
+        return Page;
+    }
+
+    void* AllocateOverflow( size_t Size, size_t Alignment )
+    {
+        void* Block = _aligned_malloc(Size, Alignment);
+        ASSERT(Block != nullptr, "Out of memory for a %zu byte frame allocation", Size);
+
+        std::lock_guard<std::mutex> lock(s_Mutex);
+        s_FrameOverflows[s_FrameIndex % kNumFrames].push_back(Block);
+        return Block;
+    }
+
+    // Called with s_Mutex held
+    void RecycleFrame( uint32_t Slot )
+    {
+        s_FreePages.insert(s_FreePages.end(), s_FramePages[Slot].begin(), s_FramePages[Slot].end());
+        s_FramePages[Slot].clear();
+
+        for (void* Block : s_FrameOverflows[Slot])
+            _aligned_free(Block);
+        s_FrameOverflows[Slot].clear();
+    }
+}
+
+void* FrameAllocator::Allocate( size_t Size, size_t Alignment )
+{
+    ASSERT(Alignment > 0 && (Alignment & (Alignment - 1)) == 0 && Alignment <= 4096);
+
+    ThreadArena& arena = t_Arena;
+    ++arena.FrameCounts.Allocations;
+    arena.FrameCounts.Bytes += Size;
+
+    if (Size > kMaxPageAllocation)
+    {
+        ++arena.FrameCounts.OverflowAllocations;
+        arena.FrameCounts.OverflowBytes += Size;
+        return AllocateOverflow(Size, Alignment);
+    }
+
+    size_t Offset = (arena.Offset + Alignment - 1) & ~(Alignment - 1);
+    if (arena.Page == nullptr || Offset + Size > kPageSize)
+    {
+        arena.Page = AcquirePage();
+        ++arena.FrameCounts.Pages;
+        Offset = 0;
+    }
+
+    arena.Offset = Offset + Size;
+    return arena.Page + Offset;
+}
+
+void FrameAllocator::BeginFrame( void )
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+
+    Counts total = s_ExitedCounts;
+    s_ExitedCounts = Counts();
+    for (ThreadArena* arena : s_Arenas)
+    {
+        total.Add(arena->FrameCounts);
+        arena->FrameCounts = Counts();
+        arena->Page = nullptr;
+        arena->Offset = 0;
+    }
+    s_LastFrameCounts = total;
+    s_PeakBytes = std::max(s_PeakBytes, total.Bytes);
+
+    ++s_FrameIndex;
+    RecycleFrame(s_FrameIndex % kNumFrames);
+}
+
+void FrameAllocator::Shutdown( void )
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+
+    for (ThreadArena* arena : s_Arenas)
+    {
+        arena->Page = nullptr;
+        arena->Offset = 0;
+    }
+
+    for (uint32_t Slot = 0; Slot < kNumFrames; ++Slot)
+        RecycleFrame(Slot);
+
+    for (uint8_t* Page : s_FreePages)
+        _aligned_free(Page);
+    s_FreePages.clear();
+    s_PagesInPool = 0;
+}
+
+FrameAllocator::Statistics FrameAllocator::GetStatistics( void )
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+
+    Statistics stats;
+    stats.frameIndex = s_FrameIndex;
+    stats.allocations = s_LastFrameCounts.Allocations;
+    stats.bytesAllocated = s_LastFrameCounts.Bytes;
+    stats.pagesUsed = s_LastFrameCounts.Pages;
+    stats.overflowAllocations = s_LastFrameCounts.OverflowAllocations;
+    stats.overflowBytes = s_LastFrameCounts.OverflowBytes;
+    stats.peakBytesAllocated = s_PeakBytes;
+    stats.pagesInPool = s_PagesInPool;
+    return stats;
+}
+
+void FrameAllocator::PrintStatistics( void )
+{
+    Statistics stats = GetStatistics();
+    Utility::Printf("Frame allocator:  last frame %u allocations, %.1f KB in %u pages, %u overflows (%.1f KB), "
+        "peak %.1f KB, %u pages in pool\n", stats.allocations, stats.bytesAllocated / 1024.0, stats.pagesUsed,
+        stats.overflowAllocations, stats.overflowBytes / 1024.0, stats.peakBytesAllocated / 1024.0, stats.pagesInPool);
+}
+
+namespace
+{
+    std::atomic<uint32_t> s_HeapAllocations(0);
+
+    // The default allocator, counting every call
+    template <typename T>
+    class CountingAllocator
+    {
+    public:
+        typedef T value_type;
+
+        CountingAllocator() {}
+        template <typename U> CountingAllocator( const CountingAllocator<U>& ) {}
+
+        T* allocate( size_t Count ) { ++s_HeapAllocations; return std::allocator<T>().allocate(Count); }
+        void deallocate( T* Ptr, size_t Count ) { std::allocator<T>().deallocate(Ptr, Count); }
+
+        template <typename U> bool operator==( const CountingAllocator<U>& ) const { return true; }
+        template <typename U> bool operator!=( const CountingAllocator<U>& ) const { return false; }
+    };
+
+    // What MeshSorter keeps per draw
+    struct DrawObject
+    {
+        const void* mesh;
+        const void* skeleton;
+        uint64_t meshCBV;
+        uint64_t materialCBV;
+        uint64_t bufferPtr;
+    };
+
+    // Grows containers one element at a time the way AddMesh and the UI text do.  Returns a
+    // checksum of what was built.
+    template <template <typename> class Allocator>
+    uint64_t BuildFrame( uint32_t Frame, uint32_t NumDraws, uint32_t NumStrings )
+    {
+        std::vector<uint64_t, Allocator<uint64_t>> keys;
+        std::vector<uint32_t, Allocator<uint32_t>> objectIndices;
+        std::vector<DrawObject, Allocator<DrawObject>> objects;
+
+        for (uint32_t i = 0; i < NumDraws; ++i)
+        {
+            const uint64_t key = (uint64_t)(i * 2654435761u) << 12 | (Frame & 0xFFF);
+            keys.push_back(key);
+            objectIndices.push_back(i);
+            objects.push_back({ nullptr, nullptr, i * 256ull, key, 0 });
+
+            // Opaque draws also go into the depth prepass
+            if ((i & 3) != 0)
+            {
+                keys.push_back(key ^ 1);
+                objectIndices.push_back(i);
+            }
+        }
+
+        uint64_t checksum = keys.size() + objects.size();
+        for (size_t i = 0; i < keys.size(); ++i)
+            checksum += keys[i] ^ objects[objectIndices[i]].meshCBV;
+
+        typedef std::basic_string<char, std::char_traits<char>, Allocator<char>> String;
+        for (uint32_t s = 0; s < NumStrings; ++s)
+        {
+            char number[32];
+            sprintf_s(number, "%u.%03u ms", Frame, s);
+            String text("Profiler scope ");
+            text += number;
+            text += " (CPU) ";
+            text += number;
+            text += " (GPU)\n";
+            checksum += text.size() + (uint8_t)text[text.size() / 2];
+        }
+
+        return checksum;
+    }
+}
+
+void FrameAllocator::Benchmark( void )
+{
+    const uint32_t kNumFramesToRun = 120;
+    const uint32_t kNumStrings = 64;
+    const uint32_t drawCounts[] = { 1000, 10000, 50000 };
+
+    Utility::Printf("Frame allocator benchmark (%u frames each, %u strings per frame)\n", kNumFramesToRun, kNumStrings);
+
+    for (uint32_t numDraws : drawCounts)
+    {
+        uint64_t heapChecksum = 0;
+        s_HeapAllocations = 0;
+        int64_t startTick = SystemTime::GetCurrentTick();
+        for (uint32_t f = 0; f < kNumFramesToRun; ++f)
+            heapChecksum += BuildFrame<CountingAllocator>(f, numDraws, kNumStrings);
+        double heapSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+        const uint32_t heapAllocations = s_HeapAllocations;
+
+        // Warm the page pool the way the first few frames of a run would
+        for (uint32_t f = 0; f < kNumFrames; ++f)
+        {
+            BeginFrame();
+            BuildFrame<FrameStlAllocator>(f, numDraws, kNumStrings);
+        }
+
+        uint64_t frameChecksum = 0;
+        uint64_t frameAllocations = 0, pagesUsed = 0, overflows = 0;
+        const uint32_t pagesBefore = GetStatistics().pagesInPool;
+        startTick = SystemTime::GetCurrentTick();
+        for (uint32_t f = 0; f < kNumFramesToRun; ++f)
+        {
+            BeginFrame();
+            frameChecksum += BuildFrame<FrameStlAllocator>(f, numDraws, kNumStrings);
+        }
+        double frameSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+        BeginFrame();
+
+        // Only pages new to the pool and overflow blocks came from the heap
+        Statistics stats = GetStatistics();
+        frameAllocations = stats.allocations;
+        pagesUsed = stats.pagesUsed;
+        overflows = stats.overflowAllocations;
+        const uint32_t newPages = stats.pagesInPool - pagesBefore;
+
+        Utility::Printf("  %5u draws:  heap %7.1f allocations/frame %7.3f ms/frame   frame allocator %5llu allocations "
+            "from %llu pages, %llu overflows, %u new pages, %7.3f ms/frame   (%4.1fx, %s)\n", numDraws,
+            (double)heapAllocations / kNumFramesToRun, heapSeconds * 1000.0 / kNumFramesToRun, frameAllocations,
+            pagesUsed, overflows, newPages, frameSeconds * 1000.0 / kNumFramesToRun, heapSeconds / frameSeconds,
+            heapChecksum == frameChecksum ? "identical" : "MISMATCH");
+    }
+}
@@ -0,0 +1,93 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// Bump allocation for CPU data that only lives for a frame, such as draw sort keys and text
+// vertices.  LinearAllocator does the same for GPU upload memory.
+//
+// Every thread allocates from its own page, so an allocation is an add and a compare.  Pages come
+// from a shared pool and go back to it kNumFrames frames later, all at once, so nothing is ever
+// freed individually.  Requests too large to share a page get a dedicated block that is released
+// on the same schedule; these are counted as overflows.
+//
+namespace FrameAllocator
+{
+    // Memory allocated during frame N is reused once frame N + kNumFrames begins
+    const uint32_t kNumFrames = 3;
+    const size_t kPageSize = 2 * 1024 * 1024;
+    const size_t kMaxPageAllocation = kPageSize / 4;
+
+    // Starts the next frame and recycles the memory of the frame kNumFrames ago.  No other thread
+    // may be allocating.
+    void BeginFrame( void );
+
+    // Releases every page.  Nothing allocated from the frame allocator may still be in use.
+    void Shutdown( void );
+
+    void* Allocate( size_t Size, size_t Alignment = 16 );
+
+    template <typename T>
+    T* Allocate( size_t Count )
+    {
+        return (T*)Allocate(Count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+    }
+
+    struct Statistics
+    {
+        uint64_t frameIndex;
+        uint32_t allocations;           // These five describe the last completed frame
+        uint64_t bytesAllocated;
+        uint32_t pagesUsed;
+        uint32_t overflowAllocations;
+        uint64_t overflowBytes;
+        uint64_t peakBytesAllocated;    // The most any one frame has allocated
+        uint32_t pagesInPool;           // Every page, whether in flight or free
+    };
+
+    Statistics GetStatistics( void );
+    void PrintStatistics( void );
+
+    // Builds a synthetic frame's worth of sort keys and strings with the heap and with the frame
+    // allocator, counting allocations and timing each frame.  This advances the frame counter,
+    // so only run it before rendering starts.
+    void Benchmark( void );
+}
+
+// Lets STL containers allocate from the frame allocator.  Freeing does nothing, so a container
+// that grows leaves its old storage behind until the frame is recycled.  Reserve when the size is
+// known.
+template <typename T>
+class FrameStlAllocator
+{
+public:
+    typedef T value_type;
+
+    FrameStlAllocator() {}
+    template <typename U> FrameStlAllocator( const FrameStlAllocator<U>& ) {}
+
+    T* allocate( size_t Count ) { return FrameAllocator::Allocate<T>(Count); }
+    void deallocate( T*, size_t ) {}
+
+    template <typename U> bool operator==( const FrameStlAllocator<U>& ) const { return true; }
+    template <typename U> bool operator!=( const FrameStlAllocator<U>& ) const { return false; }
+};
+
+// A vector whose storage is valid until kNumFrames frames after it was allocated
+template <typename T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
@@ -20,12 +20,14 @@
 #include "CommandContext.h"
 #include "PostEffects.h"
 #include "Display.h"
+#include "FrameAllocator.h"
 #include "Util/CommandLineArg.h"
 #include <shellapi.h>
 #include <VersionHelpers.h>
 #include <ShellScalingApi.h>
 #include "../Model/Renderer.h"
 #include "VRS.h"
+#include "VRSBatch.h"
 
 #pragma comment(lib, "runtimeobject.lib") 
 #pragma comment(lib, "Shcore.lib")
@@ -39,10 +41,6 @@ namespace GameCore
 
     void InitializeApplication( IGameApp& game )
     {
-        int argc = 0;
-        LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
-        CommandLineArgs::Initialize(argc, argv);
-
         Graphics::Initialize();
         SystemTime::Initialize();
         GameInput::Initialize();
@@ -60,10 +58,14 @@ namespace GameCore
         game.Cleanup();
 
         GameInput::Shutdown();
+
+        FrameAllocator::PrintStatistics();
+        FrameAllocator::Shutdown();
     }
 
     bool UpdateApplication( IGameApp& game )
     {
+        FrameAllocator::BeginFrame();
         EngineProfiling::Update();
 
         float DeltaTime = Graphics::GetFrameTime();
@@ -144,6 +146,18 @@ namespace GameCore
         if (!XMVerifyCPUSupport())
             return 1;
 
+        int argc = 0;
+        LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+        CommandLineArgs::Initialize(argc, argv);
+
+        // VRS batch experiments run on the CPU, so they need neither a window nor a device
+        std::wstring vrsBatchScript;
+        if (CommandLineArgs::GetString(L"vrs_batch", vrsBatchScript))
+        {
+            SystemTime::Initialize();
+            return VRSBatch::Run(vrsBatchScript) ? 0 : 1;
+        }
+
         Microsoft::WRL::Wrappers::RoInitializeWrapper InitializeWinRT(RO_INIT_MULTITHREADED);
         ASSERT_SUCCEEDED(InitializeWinRT);
 
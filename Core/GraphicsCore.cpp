@@ -26,6 +26,8 @@
 #include "CommandContext.h"
 #include "CommandListManager.h"
 #include "RootSignature.h"
+#include "PipelineCache.h"
+#include "RetirementQueue.h"
 #include "CommandSignature.h"
 #include "ParticleEffectManager.h"
 #include "GraphRenderer.h"
@@ -371,6 +373,9 @@ void Graphics::Initialize(void)
 
     g_CommandManager.Create(g_Device);
 
+    // Start reading cached pipelines while the rest of the engine initializes
+    PipelineCache::Initialize(g_Device);
+
     // Common state was moved to GraphicsCommon.*
     InitializeCommonState();
 
@@ -388,12 +393,15 @@ void Graphics::Initialize(void)
 void Graphics::Shutdown( void )
 {
     g_CommandManager.IdleGPU();
+    RetirementQueueBase::PrintAllStatistics();
 
     CommandContext::DestroyAllContexts();
     g_CommandManager.Shutdown();
     GpuTimeManager::Shutdown();
     PSO::DestroyAll();
     RootSignature::DestroyAll();
+    PipelineCache::PrintStatistics();
+    PipelineCache::Shutdown();
     DescriptorAllocator::DestroyAll();
 
     DestroyCommonState();
@@ -13,6 +13,7 @@
 #pragma once
 
 #include "Math/Common.h"
+#include <cstring>
 
 // This requires SSE4.2 which is present on Intel Nehalem (Nov. 2008)
 // and AMD Bulldozer (Oct. 2011) processors.  I could put a runtime
@@ -63,4 +64,80 @@ namespace Utility
         return HashRange((uint32_t*)StateDesc, (uint32_t*)(StateDesc + Count), Hash);
     }
 
+    // A 64-bit content hash (XXH64) for arbitrary byte ranges such as whole files.  Unlike
+    // HashRange, this has no alignment requirements and is stable across CPUs and builds,
+    // so it is suitable for keys that are persisted to disk.
+    inline uint64_t HashBytes64( const void* Data, size_t Size, uint64_t Seed = 0 )
+    {
+        const uint64_t P1 = 11400714785074694791ULL;
+        const uint64_t P2 = 14029467366897019727ULL;
+        const uint64_t P3 = 1609587929392839161ULL;
+        const uint64_t P4 = 9650029242287828579ULL;
+        const uint64_t P5 = 2870177450012600261ULL;
+
+        auto Round = [=](uint64_t Acc, uint64_t Input)
+        {
+            return _rotl64(Acc + Input * P2, 31) * P1;
+        };
+
+        auto Read64 = [](const uint8_t* Ptr) { uint64_t Val; memcpy(&Val, Ptr, 8); return Val; };
+        auto Read32 = [](const uint8_t* Ptr) { uint32_t Val; memcpy(&Val, Ptr, 4); return Val; };
+
+        const uint8_t* Iter = (const uint8_t*)Data;
+        const uint8_t* const End = Iter + Size;
+        uint64_t Hash;
+
+        if (Size >= 32)
+        {
+            // Four independent lanes keep the multiplier pipelines busy
+            uint64_t V1 = Seed + P1 + P2;
+            uint64_t V2 = Seed + P2;
+            uint64_t V3 = Seed;
+            uint64_t V4 = Seed - P1;
+
+            const uint8_t* const Limit = End - 32;
+            do
+            {
+                V1 = Round(V1, Read64(Iter));
+                V2 = Round(V2, Read64(Iter + 8));
+                V3 = Round(V3, Read64(Iter + 16));
+                V4 = Round(V4, Read64(Iter + 24));
+                Iter += 32;
+            }
+            while (Iter <= Limit);
+
+            Hash = _rotl64(V1, 1) + _rotl64(V2, 7) + _rotl64(V3, 12) + _rotl64(V4, 18);
+            Hash = (Hash ^ Round(0, V1)) * P1 + P4;
+            Hash = (Hash ^ Round(0, V2)) * P1 + P4;
+            Hash = (Hash ^ Round(0, V3)) * P1 + P4;
+            Hash = (Hash ^ Round(0, V4)) * P1 + P4;
+        }
+        else
+        {
+            Hash = Seed + P5;
+        }
+
+        Hash += (uint64_t)Size;
+
+        for (; Iter + 8 <= End; Iter += 8)
+            Hash = _rotl64(Hash ^ Round(0, Read64(Iter)), 27) * P1 + P4;
+
+        if (Iter + 4 <= End)
+        {
+            Hash = _rotl64(Hash ^ (Read32(Iter) * P1), 23) * P2 + P3;
+            Iter += 4;
+        }
+
+        for (; Iter < End; ++Iter)
+            Hash = _rotl64(Hash ^ (*Iter * P5), 11) * P1;
+
+        Hash ^= Hash >> 33;
+        Hash *= P2;
+        Hash ^= Hash >> 29;
+        Hash *= P3;
+        Hash ^= Hash >> 32;
+
+        return Hash;
+    }
+
 } // namespace Utility
@@ -0,0 +1,867 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pch.h"
+#include "ImageMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <emmintrin.h>
+
+#ifdef _WIN32
+#include <ppl.h>
+#else
+#include <atomic>
+#include <thread>
+#endif
+
+using namespace ImageMetrics;
+
+namespace
+{
+    const double kPi = 3.14159265358979323846;
+    const double kLn2 = 0.69314718055994530942;
+    const double kLn10 = 2.30258509299404568402;
+
+    // Every task reads and writes its own rows, so the split does not affect the results
+    template <typename Body>
+    void ParallelForRows( uint32_t numRows, const Body& body )
+    {
+#ifdef _WIN32
+        concurrency::parallel_for(0u, numRows, [&]( uint32_t y ) { body(y); });
+#else
+        std::atomic<uint32_t> nextRow(0);
+        std::vector<std::thread> workers(std::max(1u, std::thread::hardware_concurrency()));
+        for (std::thread& worker : workers)
+        {
+            worker = std::thread([&]()
+            {
+                for (uint32_t y = nextRow++; y < numRows; y = nextRow++)
+                    body(y);
+            });
+        }
+        for (std::thread& worker : workers)
+            worker.join();
+#endif
+    }
+
+    // exp, log, pow, and cbrt from basic arithmetic so that they do not depend on the C runtime
+
+    double PortableExp( double x )
+    {
+        if (x < -745.0)
+            return 0.0;
+        if (x > 709.0)
+            return std::numeric_limits<double>::infinity();
+
+        // x = k * ln(2) + r with |r| <= ln(2) / 2
+        const double kd = x / kLn2;
+        const int k = (int)(kd < 0.0 ? kd - 0.5 : kd + 0.5);
+        const double r = x - k * kLn2;
+
+        double p = 1.0;
+        for (int i = 20; i > 0; --i)
+            p = 1.0 + r * p / i;
+        return std::ldexp(p, k);
+    }
+
+    double PortableLog( double x )
+    {
+        if (x <= 0.0)
+            return -std::numeric_limits<double>::infinity();
+
+        // x = m * 2^e with m in [sqrt(1/2), sqrt(2)), then log(m) = 2 atanh((m - 1) / (m + 1))
+        int e;
+        double m = std::frexp(x, &e);
+        if (m < 0.70710678118654752440)
+        {
+            m *= 2.0;
+            --e;
+        }
+        const double s = (m - 1.0) / (m + 1.0);
+        const double s2 = s * s;
+
+        double series = 0.0;
+        for (int i = 31; i >= 1; i -= 2)
+            series = 1.0 / i + s2 * series;
+        return e * kLn2 + 2.0 * s * series;
+    }
+
+    double PortablePow( double x, double y )
+    {
+        return x <= 0.0 ? 0.0 : PortableExp(y * PortableLog(x));
+    }
+
+    double PortableCbrt( double x )
+    {
+        if (x <= 0.0)
+            return 0.0;
+
+        // Bit trick estimate refined by Newton's method
+        float estimate = (float)x;
+        uint32_t bits;
+        memcpy(&bits, &estimate, sizeof(bits));
+        bits = bits / 3 + 709921077;
+        memcpy(&estimate, &bits, sizeof(bits));
+
+        double y = estimate;
+        for (int i = 0; i < 5; ++i)
+            y = y - (y * y * y - x) / (3.0 * y * y);
+        return y;
+    }
+
+    // 8-bit values as [0, 1] and as linear light
+    struct ChannelTable
+    {
+        ChannelTable()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                const double c = i / 255.0;
+                Unit[i] = (float)c;
+                Linear[i] = (float)(c <= 0.04045 ? c / 12.92 : PortablePow((c + 0.055) / 1.055, 2.4));
+            }
+        }
+
+        float Unit[256];
+        float Linear[256];
+    };
+
+    const ChannelTable& GetChannelTable( void )
+    {
+        static const ChannelTable table;
+        return table;
+    }
+
+    // A single channel float image.  Rows are padded to a multiple of four floats.
+    struct Plane
+    {
+        Plane( uint32_t width, uint32_t height ) :
+            Width(width), Height(height), Stride((width + 3) & ~3u), Data((size_t)Stride * height)
+        {
+        }
+
+        float* Row( uint32_t y ) { return &Data[(size_t)y * Stride]; }
+        const float* Row( uint32_t y ) const { return &Data[(size_t)y * Stride]; }
+
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t Stride;
+        std::vector<float> Data;
+    };
+
+    typedef std::vector<float> Kernel;
+
+    Kernel NormalizedGaussian( double sigma, int radius )
+    {
+        Kernel kernel(2 * radius + 1);
+        double sum = 0.0;
+        for (int x = -radius; x <= radius; ++x)
+            sum += PortableExp(-(x * x) / (2.0 * sigma * sigma));
+        for (int x = -radius; x <= radius; ++x)
+            kernel[x + radius] = (float)(PortableExp(-(x * x) / (2.0 * sigma * sigma)) / sum);
+        return kernel;
+    }
+
+    // Convolves with kernelX along rows, then kernelY along columns, clamping at the edges.  temp
+    // holds the intermediate result.
+    void ConvolveSeparable( const Plane& src, Plane& dst, Plane& temp, const Kernel& kernelX, const Kernel& kernelY )
+    {
+        const uint32_t width = src.Width;
+        const uint32_t height = src.Height;
+        const uint32_t stride = src.Stride;
+        const int radiusX = (int)kernelX.size() / 2;
+        const int radiusY = (int)kernelY.size() / 2;
+
+        ParallelForRows(height, [&]( uint32_t y )
+        {
+            // Replicate the edge pixels so that every tap is a plain unaligned load
+            std::vector<float> padded(stride + 2 * radiusX + 4);
+            const float* in = src.Row(y);
+            for (int i = 0; i < (int)padded.size(); ++i)
+                padded[i] = in[std::min(std::max(i - radiusX, 0), (int)width - 1)];
+
+            float* out = temp.Row(y);
+            for (uint32_t x = 0; x < stride; x += 4)
+            {
+                __m128 sum = _mm_setzero_ps();
+                for (int k = 0; k <= 2 * radiusX; ++k)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kernelX[k]), _mm_loadu_ps(&padded[x + k])));
+                _mm_storeu_ps(out + x, sum);
+            }
+        });
+
+        ParallelForRows(height, [&]( uint32_t y )
+        {
+            float* out = dst.Row(y);
+            for (uint32_t x = 0; x < stride; x += 4)
+                _mm_storeu_ps(out + x, _mm_setzero_ps());
+
+            for (int k = 0; k <= 2 * radiusY; ++k)
+            {
+                const uint32_t sourceY = (uint32_t)std::min(std::max((int)y + k - radiusY, 0), (int)height - 1);
+                const float* in = temp.Row(sourceY);
+                const __m128 weight = _mm_set1_ps(kernelY[k]);
+                for (uint32_t x = 0; x < stride; x += 4)
+                    _mm_storeu_ps(out + x, _mm_add_ps(_mm_loadu_ps(out + x), _mm_mul_ps(weight, _mm_loadu_ps(in + x))));
+            }
+        });
+    }
+
+    // Sums the per row partial results in row order
+    double SumRows( const std::vector<double>& rowSums )
+    {
+        double sum = 0.0;
+        for (double rowSum : rowSums)
+            sum += rowSum;
+        return sum;
+    }
+
+    //
+    // Pixel differences and correlation
+    //
+
+    struct RowStats
+    {
+        uint64_t Differing;
+        uint64_t AbsSum;
+        uint64_t SquareSum;
+        uint32_t Peak;
+        uint64_t SumA[3];
+        uint64_t SumB[3];
+        uint64_t SumAA[3];
+        uint64_t SumBB[3];
+        uint64_t SumAB[3];
+    };
+
+    void AddLanes( __m128i v, uint64_t sums[3] )
+    {
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, v);
+        for (int c = 0; c < 3; ++c)
+            sums[c] += lanes[c];
+    }
+
+    void ComputeRowStats( const uint8_t* a, const uint8_t* b, uint32_t width, RowStats& stats )
+    {
+        memset(&stats, 0, sizeof(stats));
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+
+        // The 32-bit lane sums can take 8192 groups of four pixels before they could overflow
+        const uint32_t kFlushInterval = 8192;
+
+        __m128i absSum = zero;
+        __m128i peak = zero;
+        uint32_t x = 0;
+
+        while (x + 4 <= width)
+        {
+            __m128i squareSum = zero;
+            __m128i sumA = zero, sumB = zero, sumAA = zero, sumBB = zero, sumAB = zero;
+
+            for (uint32_t group = 0; group < kFlushInterval && x + 4 <= width; ++group, x += 4)
+            {
+                const __m128i pixelsA = _mm_and_si128(_mm_loadu_si128((const __m128i*)(a + x * 4)), colorMask);
+                const __m128i pixelsB = _mm_and_si128(_mm_loadu_si128((const __m128i*)(b + x * 4)), colorMask);
+
+                const __m128i diff = _mm_or_si128(_mm_subs_epu8(pixelsA, pixelsB), _mm_subs_epu8(pixelsB, pixelsA));
+                peak = _mm_max_epu8(peak, diff);
+                absSum = _mm_add_epi64(absSum, _mm_sad_epu8(diff, zero));
+
+                const int samePixels = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(diff, zero)));
+                stats.Differing += 4 - ((samePixels & 1) + (samePixels >> 1 & 1) + (samePixels >> 2 & 1) + (samePixels >> 3 & 1));
+
+                const __m128i diffLo = _mm_unpacklo_epi8(diff, zero);
+                const __m128i diffHi = _mm_unpackhi_epi8(diff, zero);
+                squareSum = _mm_add_epi32(squareSum, _mm_add_epi32(_mm_madd_epi16(diffLo, diffLo), _mm_madd_epi16(diffHi, diffHi)));
+
+                // Widen each pixel to one channel per 32-bit lane.  Viewed as 16-bit pairs of
+                // (value, 0), madd then gives per channel products.
+                const __m128i wordsA[2] = { _mm_unpacklo_epi8(pixelsA, zero), _mm_unpackhi_epi8(pixelsA, zero) };
+                const __m128i wordsB[2] = { _mm_unpacklo_epi8(pixelsB, zero), _mm_unpackhi_epi8(pixelsB, zero) };
+                for (int half = 0; half < 2; ++half)
+                {
+                    const __m128i channelsA[2] = { _mm_unpacklo_epi16(wordsA[half], zero), _mm_unpackhi_epi16(wordsA[half], zero) };
+                    const __m128i channelsB[2] = { _mm_unpacklo_epi16(wordsB[half], zero), _mm_unpackhi_epi16(wordsB[half], zero) };
+                    for (int p = 0; p < 2; ++p)
+                    {
+                        sumA = _mm_add_epi32(sumA, channelsA[p]);
+                        sumB = _mm_add_epi32(sumB, channelsB[p]);
+                        sumAA = _mm_add_epi32(sumAA, _mm_madd_epi16(channelsA[p], channelsA[p]));
+                        sumBB = _mm_add_epi32(sumBB, _mm_madd_epi16(channelsB[p], channelsB[p]));
+                        sumAB = _mm_add_epi32(sumAB, _mm_madd_epi16(channelsA[p], channelsB[p]));
+                    }
+                }
+            }
+
+            uint32_t squareLanes[4];
+            _mm_storeu_si128((__m128i*)squareLanes, squareSum);
+            stats.SquareSum += (uint64_t)squareLanes[0] + squareLanes[1] + squareLanes[2] + squareLanes[3];
+
+            AddLanes(sumA, stats.SumA);
+            AddLanes(sumB, stats.SumB);
+            AddLanes(sumAA, stats.SumAA);
+            AddLanes(sumBB, stats.SumBB);
+            AddLanes(sumAB, stats.SumAB);
+        }
+
+        uint64_t absLanes[2];
+        _mm_storeu_si128((__m128i*)absLanes, absSum);
+        stats.AbsSum = absLanes[0] + absLanes[1];
+
+        uint8_t peakBytes[16];
+        _mm_storeu_si128((__m128i*)peakBytes, peak);
+        for (int i = 0; i < 16; ++i)
+            stats.Peak = std::max<uint32_t>(stats.Peak, peakBytes[i]);
+
+        for (; x < width; ++x)
+        {
+            bool differs = false;
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint32_t va = a[x * 4 + c];
+                const uint32_t vb = b[x * 4 + c];
+                const uint32_t d = va > vb ? va - vb : vb - va;
+                differs |= d != 0;
+                stats.AbsSum += d;
+                stats.SquareSum += d * d;
+                stats.Peak = std::max(stats.Peak, d);
+                stats.SumA[c] += va;
+                stats.SumB[c] += vb;
+                stats.SumAA[c] += va * va;
+                stats.SumBB[c] += vb * vb;
+                stats.SumAB[c] += va * vb;
+            }
+            stats.Differing += differs ? 1 : 0;
+        }
+    }
+
+    void ComputePixelStats( const Image& reference, const Image& test, Report& report )
+    {
+        const uint32_t width = reference.Width;
+        const uint32_t height = reference.Height;
+
+        std::vector<RowStats> rows(height);
+        ParallelForRows(height, [&]( uint32_t y )
+        {
+            ComputeRowStats(reference.Pixels + (size_t)y * reference.RowPitch, test.Pixels + (size_t)y * test.RowPitch, width, rows[y]);
+        });
+
+        RowStats total;
+        memset(&total, 0, sizeof(total));
+        for (const RowStats& row : rows)
+        {
+            total.Differing += row.Differing;
+            total.AbsSum += row.AbsSum;
+            total.SquareSum += row.SquareSum;
+            total.Peak = std::max(total.Peak, row.Peak);
+            for (int c = 0; c < 3; ++c)
+            {
+                total.SumA[c] += row.SumA[c];
+                total.SumB[c] += row.SumB[c];
+                total.SumAA[c] += row.SumAA[c];
+                total.SumBB[c] += row.SumBB[c];
+                total.SumAB[c] += row.SumAB[c];
+            }
+        }
+
+        const double numPixels = (double)width * height;
+        const double numSamples = numPixels * 3.0;
+
+        report.AE = total.Differing;
+        report.MAE = (double)total.AbsSum / (numSamples * 255.0);
+        report.MSE = (double)total.SquareSum / (numSamples * 255.0 * 255.0);
+        report.RMSE = sqrt(report.MSE);
+        report.PSNR = report.MSE > 0.0 ? -10.0 * PortableLog(report.MSE) / kLn10 : std::numeric_limits<double>::infinity();
+        report.PAE = total.Peak / 255.0;
+
+        double ncc = 0.0;
+        for (int c = 0; c < 3; ++c)
+        {
+            const double meanA = total.SumA[c] / numPixels;
+            const double meanB = total.SumB[c] / numPixels;
+            const double varianceA = total.SumAA[c] / numPixels - meanA * meanA;
+            const double varianceB = total.SumBB[c] / numPixels - meanB * meanB;
+            const double covariance = total.SumAB[c] / numPixels - meanA * meanB;
+            const double denominator = sqrt(varianceA * varianceB);
+
+            // Flat channels only correlate if they are identical
+            if (denominator > 0.0)
+                ncc += covariance / denominator;
+            else
+                ncc += meanA == meanB ? 1.0 : 0.0;
+        }
+        report.NCC = ncc / 3.0;
+    }
+
+    //
+    // Structural similarity (Wang et al. 2004)
+    //
+
+    void ComputeSSIM( const Image& reference, const Image& test, Report& report )
+    {
+        const uint32_t width = reference.Width;
+        const uint32_t height = reference.Height;
+        const ChannelTable& table = GetChannelTable();
+        const Kernel window = NormalizedGaussian(1.5, 5);
+        const float C1 = 0.01f * 0.01f;
+        const float C2 = 0.03f * 0.03f;
+
+        Plane a(width, height), b(width, height), aa(width, height), bb(width, height), ab(width, height);
+        Plane meanA(width, height), meanB(width, height), meanAA(width, height), meanBB(width, height), meanAB(width, height);
+        Plane temp(width, height);
+        std::vector<double> rowSums(height);
+
+        double ssim = 0.0;
+        for (int c = 0; c < 3; ++c)
+        {
+            ParallelForRows(height, [&]( uint32_t y )
+            {
+                const uint8_t* pixelsA = reference.Pixels + (size_t)y * reference.RowPitch;
+                const uint8_t* pixelsB = test.Pixels + (size_t)y * test.RowPitch;
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    // Values are centered on mid gray, so the variances below are not small
+                    // differences of large moments, which float would round badly next to C2
+                    const float va = table.Unit[pixelsA[x * 4 + c]] - 0.5f;
+                    const float vb = table.Unit[pixelsB[x * 4 + c]] - 0.5f;
+                    a.Row(y)[x] = va;
+                    b.Row(y)[x] = vb;
+                    aa.Row(y)[x] = va * va;
+                    bb.Row(y)[x] = vb * vb;
+                    ab.Row(y)[x] = va * vb;
+                }
+            });
+
+            ConvolveSeparable(a, meanA, temp, window, window);
+            ConvolveSeparable(b, meanB, temp, window, window);
+            ConvolveSeparable(aa, meanAA, temp, window, window);
+            ConvolveSeparable(bb, meanBB, temp, window, window);
+            ConvolveSeparable(ab, meanAB, temp, window, window);
+
+            ParallelForRows(height, [&]( uint32_t y )
+            {
+                double rowSum = 0.0;
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    const float centeredA = meanA.Row(y)[x];
+                    const float centeredB = meanB.Row(y)[x];
+                    const float sigmaAA = meanAA.Row(y)[x] - centeredA * centeredA;
+                    const float sigmaBB = meanBB.Row(y)[x] - centeredB * centeredB;
+                    const float sigmaAB = meanAB.Row(y)[x] - centeredA * centeredB;
+                    const float muA = centeredA + 0.5f;
+                    const float muB = centeredB + 0.5f;
+                    rowSum += ((2.0f * muA * muB + C1) * (2.0f * sigmaAB + C2)) /
+                        ((muA * muA + muB * muB + C1) * (sigmaAA + sigmaBB + C2));
+                }
+                rowSums[y] = rowSum;
+            });
+
+            ssim += SumRows(rowSums) / ((double)width * height);
+        }
+
+        report.SSIM = ssim / 3.0;
+        report.DSSIM = (1.0 - report.SSIM) / 2.0;
+    }
+
+    //
+    // LDR-FLIP (Andersson et al. 2020)
+    //
+
+    const double kWhiteX = 0.950428545;
+    const double kWhiteY = 1.0;
+    const double kWhiteZ = 1.088900371;
+
+    struct Color { double x, y, z; };
+
+    Color LinearRGBToXYZ( const Color& c )
+    {
+        return Color{
+            0.4124564 * c.x + 0.3575761 * c.y + 0.1804375 * c.z,
+            0.2126729 * c.x + 0.7151522 * c.y + 0.0721750 * c.z,
+            0.0193339 * c.x + 0.1191920 * c.y + 0.9503041 * c.z };
+    }
+
+    Color XYZToLinearRGB( const Color& c )
+    {
+        return Color{
+             3.2404542 * c.x - 1.5371385 * c.y - 0.4985314 * c.z,
+            -0.9692660 * c.x + 1.8760108 * c.y + 0.0415560 * c.z,
+             0.0556434 * c.x - 0.2040259 * c.y + 1.0572252 * c.z };
+    }
+
+    // CIELAB with the Hunt adjustment of a and b
+    Color XYZToHuntLab( const Color& c )
+    {
+        const double delta = 6.0 / 29.0;
+        auto f = [&]( double t ) { return t > delta * delta * delta ? PortableCbrt(t) : t / (3.0 * delta * delta) + 4.0 / 29.0; };
+
+        const double fx = f(c.x / kWhiteX);
+        const double fy = f(c.y / kWhiteY);
+        const double fz = f(c.z / kWhiteZ);
+        const double L = 116.0 * fy - 16.0;
+        return Color{ L, 0.01 * L * 500.0 * (fx - fy), 0.01 * L * 200.0 * (fy - fz) };
+    }
+
+    double HyAB( const Color& a, const Color& b )
+    {
+        const double da = a.y - b.y;
+        const double db = a.z - b.z;
+        return fabs(a.x - b.x) + sqrt(da * da + db * db);
+    }
+
+    // The opponent space FLIP filters in: a linearized CIELAB
+    void ComputeYCxCz( const Image& image, Plane& Y, Plane& Cx, Plane& Cz )
+    {
+        const ChannelTable& table = GetChannelTable();
+        ParallelForRows(image.Height, [&]( uint32_t y )
+        {
+            const uint8_t* pixels = image.Pixels + (size_t)y * image.RowPitch;
+            for (uint32_t x = 0; x < image.Width; ++x)
+            {
+                const Color rgb = { table.Linear[pixels[x * 4]], table.Linear[pixels[x * 4 + 1]], table.Linear[pixels[x * 4 + 2]] };
+                const Color xyz = LinearRGBToXYZ(rgb);
+                const double nx = xyz.x / kWhiteX, ny = xyz.y / kWhiteY, nz = xyz.z / kWhiteZ;
+                Y.Row(y)[x] = (float)(116.0 * ny - 16.0);
+                Cx.Row(y)[x] = (float)(500.0 * (nx - ny));
+                Cz.Row(y)[x] = (float)(200.0 * (ny - nz));
+            }
+        });
+    }
+
+    // One channel's contrast sensitivity filter: a weighted sum of up to two Gaussians
+    struct CSFilter
+    {
+        Kernel Kernels[2];
+        float Weights[2];
+        uint32_t NumTerms;
+    };
+
+    CSFilter MakeCSFilter( double a1, double b1, double a2, double b2, double pixelsPerDegree )
+    {
+        const double a[2] = { a1, a2 };
+        const double b[2] = { b1, b2 };
+
+        CSFilter filter;
+        filter.NumTerms = a2 > 0.0 ? 2 : 1;
+
+        double termSums[2] = {};
+        for (uint32_t t = 0; t < filter.NumTerms; ++t)
+        {
+            // exp(-pi^2 r^2 / b) with r in degrees is a Gaussian with this many pixels of deviation
+            const double sigma = sqrt(b[t] / (2.0 * kPi * kPi)) * pixelsPerDegree;
+            const int radius = (int)ceil(3.0 * sigma);
+            filter.Kernels[t] = NormalizedGaussian(sigma, radius);
+
+            double sum = 0.0;
+            for (int x = -radius; x <= radius; ++x)
+                sum += PortableExp(-(x * x) / (2.0 * sigma * sigma));
+            termSums[t] = a[t] * (kPi / b[t]) * sum * sum;
+        }
+
+        const double total = termSums[0] + termSums[1];
+        for (uint32_t t = 0; t < 2; ++t)
+            filter.Weights[t] = (float)(termSums[t] / total);
+        return filter;
+    }
+
+    void ApplyCSFilter( const CSFilter& filter, Plane& plane, Plane& temp, Plane& scratch )
+    {
+        if (filter.NumTerms == 1)
+        {
+            ConvolveSeparable(plane, scratch, temp, filter.Kernels[0], filter.Kernels[0]);
+            plane.Data.swap(scratch.Data);
+            return;
+        }
+
+        Plane second(plane.Width, plane.Height);
+        ConvolveSeparable(plane, scratch, temp, filter.Kernels[0], filter.Kernels[0]);
+        ConvolveSeparable(plane, second, temp, filter.Kernels[1], filter.Kernels[1]);
+        for (size_t i = 0; i < plane.Data.size(); ++i)
+            plane.Data[i] = filter.Weights[0] * scratch.Data[i] + filter.Weights[1] * second.Data[i];
+    }
+
+    // Edge and point detector responses of the normalized luminance
+    void ComputeFeatures( const Plane& Y, const Kernel& gaussian, const Kernel& edge, const Kernel& point,
+        Plane& edgeMagnitude, Plane& pointMagnitude )
+    {
+        const uint32_t width = Y.Width;
+        const uint32_t height = Y.Height;
+
+        Plane luminance(width, height), temp(width, height), responseX(width, height), responseY(width, height);
+        for (size_t i = 0; i < Y.Data.size(); ++i)
+            luminance.Data[i] = (Y.Data[i] + 16.0f) / 116.0f;
+
+        ConvolveSeparable(luminance, responseX, temp, edge, gaussian);
+        ConvolveSeparable(luminance, responseY, temp, gaussian, edge);
+        for (size_t i = 0; i < Y.Data.size(); ++i)
+            edgeMagnitude.Data[i] = sqrtf(responseX.Data[i] * responseX.Data[i] + responseY.Data[i] * responseY.Data[i]);
+
+        ConvolveSeparable(luminance, responseX, temp, point, gaussian);
+        ConvolveSeparable(luminance, responseY, temp, gaussian, point);
+        for (size_t i = 0; i < Y.Data.size(); ++i)
+            pointMagnitude.Data[i] = sqrtf(responseX.Data[i] * responseX.Data[i] + responseY.Data[i] * responseY.Data[i]);
+    }
+
+    void ComputeFLIP( const Image& reference, const Image& test, const Settings& settings, Report& report, float* errorMap )
+    {
+        const uint32_t width = reference.Width;
+        const uint32_t height = reference.Height;
+        const double ppd = settings.PixelsPerDegree;
+
+        // Constants from the paper
+        const double qc = 0.7;
+        const double pc = 0.4;
+        const double pt = 0.95;
+        const double featureWidth = 0.082;
+
+        Plane refY(width, height), refCx(width, height), refCz(width, height);
+        Plane testY(width, height), testCx(width, height), testCz(width, height);
+        ComputeYCxCz(reference, refY, refCx, refCz);
+        ComputeYCxCz(test, testY, testCx, testCz);
+
+        // Feature detection works on the unfiltered luminance
+        const double sd = 0.5 * featureWidth * ppd;
+        const int featureRadius = (int)ceil(3.0 * sd);
+        const Kernel gaussian = NormalizedGaussian(sd, featureRadius);
+        Kernel edge(2 * featureRadius + 1), point(2 * featureRadius + 1);
+        {
+            double edgePositive = 0.0, pointPositive = 0.0, pointNegative = 0.0;
+            for (int x = -featureRadius; x <= featureRadius; ++x)
+            {
+                const double g = PortableExp(-(x * x) / (2.0 * sd * sd));
+                const double e = -x * g;
+                const double p = (x * x / (sd * sd) - 1.0) * g;
+                edgePositive += e > 0.0 ? e : 0.0;
+                (p > 0.0 ? pointPositive : pointNegative) += p;
+            }
+
+            // Positive weights sum to 1 and negative weights to -1
+            for (int x = -featureRadius; x <= featureRadius; ++x)
+            {
+                const double g = PortableExp(-(x * x) / (2.0 * sd * sd));
+                const double p = (x * x / (sd * sd) - 1.0) * g;
+                edge[x + featureRadius] = (float)(-x * g / edgePositive);
+                point[x + featureRadius] = (float)(p > 0.0 ? p / pointPositive : p / -pointNegative);
+            }
+        }
+
+        Plane refEdge(width, height), refPoint(width, height), testEdge(width, height), testPoint(width, height);
+        ComputeFeatures(refY, gaussian, edge, point, refEdge, refPoint);
+        ComputeFeatures(testY, gaussian, edge, point, testEdge, testPoint);
+
+        // Contrast sensitivity filtering of the achromatic, red-green, and blue-yellow channels
+        const CSFilter achromatic = MakeCSFilter(1.0, 0.0047, 0.0, 1e-5, ppd);
+        const CSFilter redGreen = MakeCSFilter(1.0, 0.0053, 0.0, 1e-5, ppd);
+        const CSFilter blueYellow = MakeCSFilter(34.1, 0.04, 13.5, 0.025, ppd);
+        {
+            Plane temp(width, height), scratch(width, height);
+            ApplyCSFilter(achromatic, refY, temp, scratch);
+            ApplyCSFilter(redGreen, refCx, temp, scratch);
+            ApplyCSFilter(blueYellow, refCz, temp, scratch);
+            ApplyCSFilter(achromatic, testY, temp, scratch);
+            ApplyCSFilter(redGreen, testCx, temp, scratch);
+            ApplyCSFilter(blueYellow, testCz, temp, scratch);
+        }
+
+        const double cmax = PortablePow(HyAB(XYZToHuntLab(LinearRGBToXYZ(Color{ 0.0, 1.0, 0.0 })),
+            XYZToHuntLab(LinearRGBToXYZ(Color{ 0.0, 0.0, 1.0 }))), qc);
+        const double pccmax = pc * cmax;
+
+        std::vector<float> localErrorMap;
+        if (errorMap == nullptr)
+        {
+            localErrorMap.resize((size_t)width * height);
+            errorMap = localErrorMap.data();
+        }
+
+        std::vector<double> rowSums(height);
+        ParallelForRows(height, [&]( uint32_t y )
+        {
+            // Back from the filtered opponent space to linear RGB, clamped to the displayable range
+            auto FilteredHuntLab = [&]( const Plane& Y, const Plane& Cx, const Plane& Cz, uint32_t x )
+            {
+                const double ny = (Y.Row(y)[x] + 16.0) / 116.0;
+                const Color xyz = { (Cx.Row(y)[x] / 500.0 + ny) * kWhiteX, ny * kWhiteY, (ny - Cz.Row(y)[x] / 200.0) * kWhiteZ };
+                Color rgb = XYZToLinearRGB(xyz);
+                rgb.x = std::min(std::max(rgb.x, 0.0), 1.0);
+                rgb.y = std::min(std::max(rgb.y, 0.0), 1.0);
+                rgb.z = std::min(std::max(rgb.z, 0.0), 1.0);
+                return XYZToHuntLab(LinearRGBToXYZ(rgb));
+            };
+
+            double rowSum = 0.0;
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                double colorError = PortablePow(HyAB(FilteredHuntLab(refY, refCx, refCz, x), FilteredHuntLab(testY, testCx, testCz, x)), qc);
+                if (colorError < pccmax)
+                    colorError = (pt / pccmax) * colorError;
+                else
+                    colorError = pt + ((colorError - pccmax) / (cmax - pccmax)) * (1.0 - pt);
+
+                const double edgeDifference = fabs(refEdge.Row(y)[x] - testEdge.Row(y)[x]);
+                const double pointDifference = fabs(refPoint.Row(y)[x] - testPoint.Row(y)[x]);
+                const double featureError = sqrt(std::max(edgeDifference, pointDifference) / sqrt(2.0));
+
+                const double error = PortablePow(colorError, 1.0 - featureError);
+                errorMap[(size_t)y * width + x] = (float)error;
+                rowSum += error;
+            }
+            rowSums[y] = rowSum;
+        });
+
+        const size_t numPixels = (size_t)width * height;
+
+        std::vector<float> sorted(errorMap, errorMap + numPixels);
+        std::nth_element(sorted.begin(), sorted.begin() + numPixels / 2, sorted.end());
+        const float medianError = sorted[numPixels / 2];
+        const float maxError = *std::max_element(sorted.begin() + numPixels / 2, sorted.end());
+
+        report.FLIPMean = SumRows(rowSums) / (double)numPixels;
+        report.FLIPMedian = medianError;
+        report.FLIPMax = maxError;
+    }
+}
+
+void ImageMetrics::Compare( const Image& reference, const Image& test, const Settings& settings, Report& report, float* flipErrorMap )
+{
+    ASSERT(reference.Width == test.Width && reference.Height == test.Height, "Compared images must be the same size");
+
+    report = Report();
+    if (reference.Width == 0 || reference.Height == 0)
+        return;
+
+    ComputePixelStats(reference, test, report);
+    ComputeSSIM(reference, test, report);
+    ComputeFLIP(reference, test, settings, report, flipErrorMap);
+}
+
+namespace
+{
+    // Color channels are color(x, y, c).  Alpha varies too, which must not matter.
+    template <typename ColorFunction>
+    std::vector<uint8_t> MakeTestImage( uint32_t width, uint32_t height, uint8_t alphaSeed, const ColorFunction& color )
+    {
+        std::vector<uint8_t> pixels((size_t)width * height * 4);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint8_t* pixel = &pixels[((size_t)y * width + x) * 4];
+                for (uint32_t c = 0; c < 3; ++c)
+                    pixel[c] = (uint8_t)color(x, y, c);
+                pixel[3] = (uint8_t)(x * y + alphaSeed);
+            }
+        }
+        return pixels;
+    }
+
+    Report CompareTestImages( const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, uint32_t width, uint32_t height )
+    {
+        const Image reference = { a.data(), width, height, width * 4 };
+        const Image test = { b.data(), width, height, width * 4 };
+        Report report;
+        Compare(reference, test, Settings(), report);
+        return report;
+    }
+
+    bool IsNear( double value, double expected, double tolerance )
+    {
+        return fabs(value - expected) <= tolerance;
+    }
+}
+
+void ImageMetrics::Test( void )
+{
+    // ImageMagick's normalized metrics have closed forms for these cases.  An offset of d in
+    // every channel gives MAE = PAE = d / 255, MSE = (d / 255)^2 and PSNR = 20 log10(255 / d).
+    // Flat images a and b give SSIM = (2ab + C1) / (a^2 + b^2 + C1).  The fixture's values come
+    // from a double precision evaluation of the same definitions, with clamped window edges.
+    const double kOffsetPSNR = 34.1514035220;       // 20 log10(255 / 5)
+    const double kFlatPSNR = 20.1720034352;         // 20 log10(255 / 25)
+    const double kFlatSSIM = 0.9842962861;          // a = 128 / 255, b = 153 / 255
+    const uint64_t kFixtureAE = 219;
+    const double kFixtureMSE = 49200.0 / (256.0 * 3.0 * 255.0 * 255.0);
+    const double kFixtureSSIM = 0.9546009261;
+    const double kFixtureNCC = 0.9904360652;
+
+    // SSIM filters in float, so it only matches double precision values closely
+    const double kFloatTolerance = 1e-5;
+    const double kDoubleTolerance = 1e-9;
+
+    // A width that is not a multiple of four also covers the scalar tail of each row
+    const uint32_t width = 37;
+    const uint32_t height = 23;
+    const uint32_t fixtureSize = 16;
+
+    auto Pattern = []( uint32_t x, uint32_t y, uint32_t c ) { return (x * 7 + y * 13 + c * 50) % 200 + 20; };
+    const std::vector<uint8_t> pattern = MakeTestImage(width, height, 0, Pattern);
+    const std::vector<uint8_t> offset = MakeTestImage(width, height, 99,
+        [&]( uint32_t x, uint32_t y, uint32_t c ) { return Pattern(x, y, c) + 5; });
+    const std::vector<uint8_t> inverted = MakeTestImage(width, height, 0,
+        [&]( uint32_t x, uint32_t y, uint32_t c ) { return 255 - Pattern(x, y, c); });
+    const std::vector<uint8_t> flatA = MakeTestImage(fixtureSize, fixtureSize, 0, []( uint32_t, uint32_t, uint32_t ) { return 128; });
+    const std::vector<uint8_t> flatB = MakeTestImage(fixtureSize, fixtureSize, 0, []( uint32_t, uint32_t, uint32_t ) { return 153; });
+
+    // Pixels move by -12 to 12 in steps of 4, the same in every channel, so one in seven is unchanged
+    const std::vector<uint8_t> fixtureA = MakeTestImage(fixtureSize, fixtureSize, 0, Pattern);
+    const std::vector<uint8_t> fixtureB = MakeTestImage(fixtureSize, fixtureSize, 0,
+        [&]( uint32_t x, uint32_t y, uint32_t c ) { return Pattern(x, y, c) + (x * 3 + y * 5) % 7 * 4 - 12; });
+
+    Utility::Printf("Image metrics test\n");
+    bool allPassed = true;
+
+    auto Print = [&]( const char* name, const Report& report, bool passed )
+    {
+        Utility::Printf("  %-10s AE %4llu  MAE %.6f  MSE %.9f  PSNR %8.4f  PAE %.6f  NCC %+.8f  SSIM %.8f  FLIP %.6f:  %s\n",
+            name, (unsigned long long)report.AE, report.MAE, report.MSE, report.PSNR, report.PAE, report.NCC, report.SSIM,
+            report.FLIPMean, passed ? "passed" : "FAILED");
+        allPassed = allPassed && passed;
+    };
+
+    Report report = CompareTestImages(pattern, pattern, width, height);
+    Print("Identical", report, report.AE == 0 && report.MAE == 0.0 && report.MSE == 0.0 && report.RMSE == 0.0 &&
+        report.PAE == 0.0 && std::isinf(report.PSNR) && IsNear(report.NCC, 1.0, kDoubleTolerance) &&
+        report.SSIM == 1.0 && report.DSSIM == 0.0 && report.FLIPMean == 0.0 && report.FLIPMax == 0.0);
+
+    report = CompareTestImages(pattern, offset, width, height);
+    Print("Offset 5", report, report.AE == width * height && IsNear(report.MAE, 5.0 / 255.0, kDoubleTolerance) &&
+        IsNear(report.MSE, 25.0 / (255.0 * 255.0), kDoubleTolerance) && IsNear(report.RMSE, 5.0 / 255.0, kDoubleTolerance) &&
+        IsNear(report.PSNR, kOffsetPSNR, kDoubleTolerance) && IsNear(report.PAE, 5.0 / 255.0, kDoubleTolerance) &&
+        IsNear(report.NCC, 1.0, kDoubleTolerance));
+
+    report = CompareTestImages(pattern, inverted, width, height);
+    Print("Inverted", report, IsNear(report.NCC, -1.0, kDoubleTolerance));
+
+    report = CompareTestImages(flatA, flatB, fixtureSize, fixtureSize);
+    Print("Flat", report, report.AE == fixtureSize * fixtureSize && IsNear(report.PSNR, kFlatPSNR, kDoubleTolerance) &&
+        report.NCC == 0.0 && IsNear(report.SSIM, kFlatSSIM, kFloatTolerance));
+
+    report = CompareTestImages(fixtureA, fixtureB, fixtureSize, fixtureSize);
+    Print("Fixture", report, report.AE == kFixtureAE && IsNear(report.MSE, kFixtureMSE, kDoubleTolerance) &&
+        IsNear(report.NCC, kFixtureNCC, kDoubleTolerance) && IsNear(report.SSIM, kFixtureSSIM, kFloatTolerance));
+
+    Utility::Printf("Image metrics test %s\n", allPassed ? "passed" : "FAILED");
+}
@@ -0,0 +1,74 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+
+// Full-reference image quality metrics computed in process on two 8-bit images, replacing the
+// ImageMagick compare and FLIP command line tools.  Work is spread across rows, partial sums are
+// combined in a fixed order, and the only math used is IEEE basic arithmetic and sqrt, so results
+// are bit-identical whatever the thread count or platform (compile with FP contraction disabled).
+
+namespace ImageMetrics
+{
+    // 8-bit RGBA pixels; alpha is ignored
+    struct Image
+    {
+        const uint8_t* Pixels;
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t RowPitch;  // In bytes
+    };
+
+    // Errors are normalized to [0, 1] and averaged over the three color channels, as with
+    // ImageMagick's normalized output.
+    struct Report
+    {
+        uint64_t AE = 0;        // Pixels that differ in any channel
+        double MAE = 0.0;       // Mean absolute error
+        double MSE = 0.0;       // Mean squared error
+        double RMSE = 0.0;      // Root mean squared error
+        double PSNR = 0.0;      // Peak signal to noise ratio in dB, infinite for identical images
+        double PAE = 0.0;       // Peak absolute error
+        double NCC = 0.0;       // Normalized cross correlation
+        double SSIM = 0.0;      // Mean structural similarity, 11x11 Gaussian window with sigma 1.5
+        double DSSIM = 0.0;     // (1 - SSIM) / 2
+        double FLIPMean = 0.0;  // LDR-FLIP perceptual error statistics
+        double FLIPMedian = 0.0;
+        double FLIPMax = 0.0;
+    };
+
+    struct Settings
+    {
+        // FLIP's default viewing conditions: a 0.7 m wide 4K monitor seen from 0.7 m
+        float PixelsPerDegree = 67.0206f;
+    };
+
+    // Compares test against reference, which must be the same size.  If flipErrorMap is given it
+    // receives the per pixel FLIP error, Width * Height floats in [0, 1].
+    void Compare( const Image& reference, const Image& test, const Settings& settings, Report& report,
+        float* flipErrorMap = nullptr );
+
+    // Checks Compare against known values:  identical images, a constant offset, an inverted
+    // image, two flat images, and a small fixture whose SSIM and NCC were evaluated separately in
+    // double precision.  Prints each case and whether it passed.
+    void Test( void );
+}
@@ -23,7 +23,9 @@ using namespace std;
 
 LinearAllocatorType LinearAllocatorPageManager::sm_AutoType = kGpuExclusive;
 
-LinearAllocatorPageManager::LinearAllocatorPageManager()
+LinearAllocatorPageManager::LinearAllocatorPageManager() :
+    m_RetiredPages(sm_AutoType == kGpuExclusive ? "GPU linear allocator pages" : "CPU linear allocator pages"),
+    m_DeletionQueue(sm_AutoType == kGpuExclusive ? "GPU linear allocator large pages" : "CPU linear allocator large pages")
 {
     m_AllocationType = sm_AutoType;
     sm_AutoType = (LinearAllocatorType)(sm_AutoType + 1);
@@ -34,24 +36,13 @@ LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
 
 LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-
-    while (!m_RetiredPages.empty() && g_CommandManager.IsFenceComplete(m_RetiredPages.front().first))
-    {
-        m_AvailablePages.push(m_RetiredPages.front().second);
-        m_RetiredPages.pop();
-    }
-
     LinearAllocationPage* PagePtr = nullptr;
 
-    if (!m_AvailablePages.empty())
-    {
-        PagePtr = m_AvailablePages.front();
-        m_AvailablePages.pop();
-    }
-    else
+    if (!m_RetiredPages.Reclaim(PagePtr, [](uint64_t FenceValue) { return g_CommandManager.IsFenceComplete(FenceValue); }))
     {
         PagePtr = CreateNewPage();
+
+        lock_guard<mutex> LockGuard(m_Mutex);
         m_PagePool.emplace_back(PagePtr);
     }
 
@@ -60,26 +51,27 @@ LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
 
 void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages )
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-    for (auto iter = UsedPages.begin(); iter != UsedPages.end(); ++iter)
-        m_RetiredPages.push(make_pair(FenceValue, *iter));
+    m_RetiredPages.Retire(FenceValue, UsedPages.data(), UsedPages.size());
 }
 
 void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vector<LinearAllocationPage*>& LargePages )
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-
-    while (!m_DeletionQueue.empty() && g_CommandManager.IsFenceComplete(m_DeletionQueue.front().first))
-    {
-        delete m_DeletionQueue.front().second;
-        m_DeletionQueue.pop();
-    }
+    m_DeletionQueue.ReclaimAll([](uint64_t FenceValue) { return g_CommandManager.IsFenceComplete(FenceValue); },
+        [](LinearAllocationPage* Page) { delete Page; });
 
     for (auto iter = LargePages.begin(); iter != LargePages.end(); ++iter)
-    {
         (*iter)->Unmap();
-        m_DeletionQueue.push(make_pair(FenceValue, *iter));
-    }
+
+    m_DeletionQueue.Retire(FenceValue, LargePages.data(), LargePages.size());
+}
+
+void LinearAllocatorPageManager::Destroy( void )
+{
+    // The GPU is idle, so pages still waiting on a fence can go too
+    m_RetiredPages.Flush([](LinearAllocationPage*) {});
+    m_DeletionQueue.Flush([](LinearAllocationPage* Page) { delete Page; });
+
+    m_PagePool.clear();
 }
 
 LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage( size_t PageSize  )
@@ -23,8 +23,8 @@
 #pragma once
 
 #include "GpuResource.h"
+#include "RetirementQueue.h"
 #include <vector>
-#include <queue>
 #include <mutex>
 
 // Constant blocks must be multiples of 16 constants @ 16 bytes each
@@ -111,7 +111,7 @@ public:
     // "large" pages.
     void FreeLargePages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
 
-    void Destroy( void ) { m_PagePool.clear(); }
+    void Destroy( void );
 
 private:
 
@@ -119,10 +119,9 @@ private:
 
     LinearAllocatorType m_AllocationType;
     std::vector<std::unique_ptr<LinearAllocationPage> > m_PagePool;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_RetiredPages;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_DeletionQueue;
-    std::queue<LinearAllocationPage*> m_AvailablePages;
-    std::mutex m_Mutex;
+    RetirementQueue<LinearAllocationPage*> m_RetiredPages;
+    RetirementQueue<LinearAllocationPage*> m_DeletionQueue;
+    std::mutex m_Mutex;     // Guards m_PagePool
 };
 
 class LinearAllocator
@@ -0,0 +1,915 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "PipelineCache.h"
+#include "Hash.h"
+#include "SystemTime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+using Microsoft::WRL::ComPtr;
+
+namespace PipelineCache
+{
+    // Bump this whenever the file layout or the way keys are computed changes
+    const uint32_t kFormatVersion = 1;
+    const char kMagic[4] = { 'M', 'E', 'P', 'C' };
+
+    struct FileHeader
+    {
+        char Magic[4];
+        uint32_t Version;
+        uint64_t DeviceKey;
+        uint64_t NumEntries;
+    };
+
+    struct EntryHeader
+    {
+        uint64_t Key;
+        uint64_t Size;
+        uint64_t Checksum;
+    };
+
+    // Where a loaded entry's blob lives in s_FileData
+    struct LoadedEntry
+    {
+        uint64_t Key;
+        size_t Offset;
+        size_t Size;
+    };
+
+    // Keys are hashes, so the low bits spread entries evenly between shards
+    const uint32_t kNumShards = 16;
+
+    struct Shard
+    {
+        std::mutex Mutex;
+        std::unordered_map<uint64_t, std::vector<uint8_t>> Entries;
+    };
+
+    // Folds each field into the hash as it is added.  Fields are added one at a time rather than
+    // hashing whole structs so that padding bytes never reach the key.
+    class KeyBuilder
+    {
+    public:
+        explicit KeyBuilder( uint64_t Seed ) : m_Hash(Seed) {}
+
+        void AddBytes( const void* Data, size_t Size )
+        {
+            if (Size > 0)
+                m_Hash = Utility::HashBytes64(Data, Size, m_Hash);
+        }
+
+        template <typename T>
+        void Add( const T& Value )
+        {
+            AddBytes(&Value, sizeof(T));
+        }
+
+        void AddString( const char* String )
+        {
+            const uint64_t Length = String != nullptr ? strlen(String) : 0;
+            Add(Length);
+            AddBytes(String, (size_t)Length);
+        }
+
+        void AddShader( const D3D12_SHADER_BYTECODE& Shader )
+        {
+            const uint64_t Length = Shader.pShaderBytecode != nullptr ? Shader.BytecodeLength : 0;
+            Add(Length);
+            AddBytes(Shader.pShaderBytecode, (size_t)Length);
+        }
+
+        void AddStencilOp( const D3D12_DEPTH_STENCILOP_DESC& Op )
+        {
+            Add(Op.StencilFailOp);
+            Add(Op.StencilDepthFailOp);
+            Add(Op.StencilPassOp);
+            Add(Op.StencilFunc);
+        }
+
+        uint64_t GetKey( void ) const { return m_Hash; }
+
+    private:
+        uint64_t m_Hash;
+    };
+
+    // Distinguishes the three kinds of entries sharing the file
+    const uint64_t kRootSignatureSeed = 0x52;
+    const uint64_t kGraphicsPSOSeed = 0x47;
+    const uint64_t kComputePSOSeed = 0x43;
+
+    // Cached blobs are only valid on the adapter and driver that produced them
+    uint64_t ComputeDeviceKey( ID3D12Device* Device )
+    {
+        struct DeviceIdentity
+        {
+            uint32_t FormatVersion;
+            uint32_t VendorId;
+            uint32_t DeviceId;
+            uint32_t SubSysId;
+            uint32_t Revision;
+            uint32_t Reserved;
+            int64_t DriverVersion;
+        } Identity = {};
+        Identity.FormatVersion = kFormatVersion;
+
+        ComPtr<IDXGIFactory4> dxgiFactory;
+        ComPtr<IDXGIAdapter1> pAdapter;
+        if (SUCCEEDED(CreateDXGIFactory2(0, MY_IID_PPV_ARGS(&dxgiFactory))) &&
+            SUCCEEDED(dxgiFactory->EnumAdapterByLuid(Device->GetAdapterLuid(), MY_IID_PPV_ARGS(&pAdapter))))
+        {
+            DXGI_ADAPTER_DESC1 desc;
+            if (SUCCEEDED(pAdapter->GetDesc1(&desc)))
+            {
+                Identity.VendorId = desc.VendorId;
+                Identity.DeviceId = desc.DeviceId;
+                Identity.SubSysId = desc.SubSysId;
+                Identity.Revision = desc.Revision;
+            }
+
+            LARGE_INTEGER DriverVersion;
+            if (SUCCEEDED(pAdapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &DriverVersion)))
+                Identity.DriverVersion = DriverVersion.QuadPart;
+        }
+
+        return Utility::HashBytes64(&Identity, sizeof(Identity));
+    }
+
+    bool WriteBytes( HANDLE File, const void* Data, size_t Size )
+    {
+        DWORD written = 0;
+        return WriteFile(File, Data, (DWORD)Size, &written, nullptr) && written == Size;
+    }
+
+    bool WriteEntry( HANDLE File, uint64_t Key, const void* Data, size_t Size )
+    {
+        EntryHeader entry = { Key, Size, Utility::HashBytes64(Data, Size) };
+        return WriteBytes(File, &entry, sizeof(entry)) && WriteBytes(File, Data, Size);
+    }
+
+    // The file and everything found in it or stored for it.  The engine opens one for its device,
+    // and the test opens its own.
+    class CacheFile
+    {
+    public:
+        CacheFile() : m_DeviceKey(0), m_TicksLoading(0), m_Loaded(false), m_Hits(0), m_Misses(0),
+            m_Rejects(0), m_Stores(0) {}
+
+        // Starts reading the file on a worker thread
+        void Open( const std::wstring& FilePath, uint64_t DeviceKey );
+
+        // Writes the file if anything was stored or rejected, then releases every entry
+        void Close( void );
+
+        bool IsOpen( void ) const { return !m_FilePath.empty(); }
+
+        bool Find( uint64_t Key, const void*& Data, size_t& Size );
+        void Store( uint64_t Key, const void* Data, size_t Size );
+        void Reject( uint64_t Key );
+
+        Statistics GetStatistics( void ) const;
+
+    private:
+        void Load( void );
+        void WaitForLoad( void );
+        void Save( void );
+
+        std::wstring m_FilePath;
+        uint64_t m_DeviceKey;
+
+        // Filled by the loading thread and never modified after m_Loaded is set
+        std::vector<uint8_t> m_FileData;
+        std::vector<LoadedEntry> m_LoadedEntries;
+        int64_t m_TicksLoading;
+
+        std::atomic<bool> m_Loaded;
+        std::future<void> m_LoadTask;
+        std::mutex m_LoadMutex;
+
+        Shard m_Shards[kNumShards];
+
+        // Loaded keys the driver would not accept, which are left out of the next file
+        std::mutex m_RejectedMutex;
+        std::vector<uint64_t> m_RejectedKeys;
+
+        std::atomic<uint32_t> m_Hits;
+        std::atomic<uint32_t> m_Misses;
+        std::atomic<uint32_t> m_Rejects;
+        std::atomic<uint32_t> m_Stores;
+    };
+
+    CacheFile s_Cache;
+
+    void CacheFile::Open( const std::wstring& FilePath, uint64_t DeviceKey )
+    {
+        ASSERT(!IsOpen());
+
+        m_FilePath = FilePath;
+        m_DeviceKey = DeviceKey;
+        m_TicksLoading = 0;
+        m_Loaded = false;
+        m_Hits = 0;
+        m_Misses = 0;
+        m_Rejects = 0;
+        m_Stores = 0;
+        m_LoadTask = std::async(std::launch::async, [this] { Load(); });
+    }
+
+    void CacheFile::Close( void )
+    {
+        if (!IsOpen())
+            return;
+
+        WaitForLoad();
+
+        if (m_Stores > 0 || !m_RejectedKeys.empty())
+            Save();
+
+        for (Shard& shard : m_Shards)
+            shard.Entries.clear();
+        m_RejectedKeys.clear();
+        m_LoadedEntries.clear();
+        m_FileData.clear();
+        m_FilePath.clear();
+        m_LoadTask = std::future<void>();
+    }
+
+    // Runs on a worker thread.  Entries are checked one at a time, and everything from the first
+    // damaged entry onward is ignored.
+    void CacheFile::Load( void )
+    {
+        int64_t startTick = SystemTime::GetCurrentTick();
+
+        std::ifstream file(m_FilePath, std::ios::in | std::ios::binary);
+        if (file)
+        {
+            file.seekg(0, std::ios::end);
+            const std::streamoff fileSize = file.tellg();
+            file.seekg(0, std::ios::beg);
+
+            if (fileSize >= (std::streamoff)sizeof(FileHeader))
+            {
+                m_FileData.resize((size_t)fileSize);
+                if (!file.read((char*)m_FileData.data(), fileSize))
+                    m_FileData.clear();
+            }
+        }
+
+        FileHeader header = {};
+        if (!m_FileData.empty())
+            memcpy(&header, m_FileData.data(), sizeof(header));
+
+        if (memcmp(header.Magic, kMagic, sizeof(kMagic)) == 0 && header.Version == kFormatVersion &&
+            header.DeviceKey == m_DeviceKey)
+        {
+            size_t Offset = sizeof(FileHeader);
+            for (uint64_t i = 0; i < header.NumEntries; ++i)
+            {
+                EntryHeader entry;
+                if (m_FileData.size() - Offset < sizeof(entry))
+                    break;
+                memcpy(&entry, &m_FileData[Offset], sizeof(entry));
+                Offset += sizeof(entry);
+
+                if (entry.Size == 0 || entry.Size > m_FileData.size() - Offset ||
+                    Utility::HashBytes64(&m_FileData[Offset], (size_t)entry.Size) != entry.Checksum)
+                {
+                    break;
+                }
+
+                m_LoadedEntries.push_back({ entry.Key, Offset, (size_t)entry.Size });
+                Offset += (size_t)entry.Size;
+            }
+
+            std::sort(m_LoadedEntries.begin(), m_LoadedEntries.end(),
+                []( const LoadedEntry& a, const LoadedEntry& b ) { return a.Key < b.Key; });
+            m_LoadedEntries.erase(std::unique(m_LoadedEntries.begin(), m_LoadedEntries.end(),
+                []( const LoadedEntry& a, const LoadedEntry& b ) { return a.Key == b.Key; }), m_LoadedEntries.end());
+        }
+
+        if (m_LoadedEntries.empty())
+            m_FileData.clear();
+
+        m_TicksLoading = SystemTime::GetCurrentTick() - startTick;
+        m_Loaded.store(true, std::memory_order_release);
+    }
+
+    void CacheFile::WaitForLoad( void )
+    {
+        if (m_Loaded.load(std::memory_order_acquire))
+            return;
+
+        std::lock_guard<std::mutex> lock(m_LoadMutex);
+        if (m_LoadTask.valid())
+            m_LoadTask.wait();
+    }
+
+    // Replaces the file with the loaded entries that are still good plus everything stored this run.  The new file is
+    // written beside the old one and moved over it, so a crash never leaves a partial cache.
+    void CacheFile::Save( void )
+    {
+        std::vector<std::pair<uint64_t, const std::vector<uint8_t>*>> newEntries;
+        for (Shard& shard : m_Shards)
+        {
+            for (auto& iter : shard.Entries)
+                newEntries.emplace_back(iter.first, &iter.second);
+        }
+        std::sort(newEntries.begin(), newEntries.end());
+
+        std::sort(m_RejectedKeys.begin(), m_RejectedKeys.end());
+
+        // Loaded entries are kept unless they were stored again or rejected
+        auto IsDropped = [&]( uint64_t Key )
+        {
+            return std::binary_search(m_RejectedKeys.begin(), m_RejectedKeys.end(), Key) ||
+                std::binary_search(newEntries.begin(), newEntries.end(), std::make_pair(Key, (const std::vector<uint8_t>*)nullptr),
+                []( const std::pair<uint64_t, const std::vector<uint8_t>*>& a, const std::pair<uint64_t, const std::vector<uint8_t>*>& b )
+                { return a.first < b.first; });
+        };
+
+        uint64_t numEntries = newEntries.size();
+        for (const LoadedEntry& entry : m_LoadedEntries)
+            numEntries += IsDropped(entry.Key) ? 0 : 1;
+
+        wchar_t uniqueSuffix[32];
+        swprintf_s(uniqueSuffix, L".%u.tmp", GetCurrentProcessId());
+        const std::wstring tempFile = m_FilePath + uniqueSuffix;
+
+        HANDLE file = CreateFileW(tempFile.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            Utility::Printf(L"Unable to write pipeline cache %ws\n", tempFile.c_str());
+            return;
+        }
+
+        FileHeader header = {};
+        memcpy(header.Magic, kMagic, sizeof(kMagic));
+        header.Version = kFormatVersion;
+        header.DeviceKey = m_DeviceKey;
+        header.NumEntries = numEntries;
+
+        bool succeeded = WriteBytes(file, &header, sizeof(header));
+        for (const LoadedEntry& entry : m_LoadedEntries)
+        {
+            if (succeeded && !IsDropped(entry.Key))
+                succeeded = WriteEntry(file, entry.Key, &m_FileData[entry.Offset], entry.Size);
+        }
+        for (auto& entry : newEntries)
+        {
+            if (succeeded)
+                succeeded = WriteEntry(file, entry.first, entry.second->data(), entry.second->size());
+        }
+        CloseHandle(file);
+
+        if (!succeeded || !MoveFileExW(tempFile.c_str(), m_FilePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            Utility::Printf(L"Unable to write pipeline cache %ws\n", m_FilePath.c_str());
+            DeleteFileW(tempFile.c_str());
+        }
+    }
+
+    bool CacheFile::Find( uint64_t Key, const void*& Data, size_t& Size )
+    {
+        WaitForLoad();
+
+        auto iter = std::lower_bound(m_LoadedEntries.begin(), m_LoadedEntries.end(), Key,
+            []( const LoadedEntry& Entry, uint64_t Key ) { return Entry.Key < Key; });
+
+        if (iter == m_LoadedEntries.end() || iter->Key != Key)
+        {
+            ++m_Misses;
+            return false;
+        }
+
+        ++m_Hits;
+        Data = &m_FileData[iter->Offset];
+        Size = iter->Size;
+        return true;
+    }
+
+    void CacheFile::Store( uint64_t Key, const void* Data, size_t Size )
+    {
+        Shard& shard = m_Shards[Key % kNumShards];
+        {
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            shard.Entries[Key].assign((const uint8_t*)Data, (const uint8_t*)Data + Size);
+        }
+        ++m_Stores;
+    }
+
+    void CacheFile::Reject( uint64_t Key )
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_RejectedMutex);
+            m_RejectedKeys.push_back(Key);
+        }
+        ++m_Rejects;
+    }
+
+    Statistics CacheFile::GetStatistics( void ) const
+    {
+        const bool loaded = m_Loaded.load(std::memory_order_acquire);
+
+        Statistics stats;
+        stats.entriesLoaded = loaded ? (uint32_t)m_LoadedEntries.size() : 0;
+        stats.hits = m_Hits;
+        stats.misses = m_Misses;
+        stats.rejects = m_Rejects;
+        stats.stores = m_Stores;
+        stats.secondsLoading = loaded ? SystemTime::TicksToSeconds(m_TicksLoading) : 0.0;
+        return stats;
+    }
+}
+
+void PipelineCache::Initialize( ID3D12Device* Device )
+{
+    std::wstring filePath;
+    if (!CommandLineArgs::GetString(L"pso_cache", filePath) || filePath == L"none")
+        return;
+
+    if (filePath == L"default")
+    {
+        filePath.clear();
+
+        wchar_t* localAppData = nullptr;
+        size_t length = 0;
+        if (_wdupenv_s(&localAppData, &length, L"LOCALAPPDATA") == 0 && localAppData != nullptr)
+        {
+            const std::wstring cacheDir = std::wstring(localAppData) + L"\\MiniEngine";
+            free(localAppData);
+
+            if (CreateDirectoryW(cacheDir.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS)
+                filePath = cacheDir + L"\\PipelineCache.bin";
+        }
+
+        if (filePath.empty())
+            return;
+    }
+
+    s_Cache.Open(filePath, ComputeDeviceKey(Device));
+}
+
+void PipelineCache::Shutdown( void )
+{
+    s_Cache.Close();
+}
+
+bool PipelineCache::IsEnabled( void )
+{
+    return s_Cache.IsOpen();
+}
+
+uint64_t PipelineCache::ComputeRootSignatureKey( const D3D12_ROOT_SIGNATURE_DESC& Desc )
+{
+    KeyBuilder Key(kRootSignatureSeed);
+    Key.Add(Desc.Flags);
+    Key.Add(Desc.NumParameters);
+
+    for (UINT Param = 0; Param < Desc.NumParameters; ++Param)
+    {
+        const D3D12_ROOT_PARAMETER& RootParam = Desc.pParameters[Param];
+        Key.Add(RootParam.ParameterType);
+        Key.Add(RootParam.ShaderVisibility);
+
+        switch (RootParam.ParameterType)
+        {
+        case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+            Key.Add(RootParam.DescriptorTable.NumDescriptorRanges);
+            Key.AddBytes(RootParam.DescriptorTable.pDescriptorRanges,
+                RootParam.DescriptorTable.NumDescriptorRanges * sizeof(D3D12_DESCRIPTOR_RANGE));
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            Key.Add(RootParam.Constants);
+            break;
+        default:
+            Key.Add(RootParam.Descriptor);
+            break;
+        }
+    }
+
+    // Both structures are made entirely of 32-bit fields, so there is no padding to skip
+    Key.Add(Desc.NumStaticSamplers);
+    Key.AddBytes(Desc.pStaticSamplers, Desc.NumStaticSamplers * sizeof(D3D12_STATIC_SAMPLER_DESC));
+
+    return Key.GetKey();
+}
+
+uint64_t PipelineCache::ComputeGraphicsPSOKey( const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureKey )
+{
+    KeyBuilder Key(kGraphicsPSOSeed);
+    Key.Add(RootSignatureKey);
+    Key.AddShader(Desc.VS);
+    Key.AddShader(Desc.PS);
+    Key.AddShader(Desc.DS);
+    Key.AddShader(Desc.HS);
+    Key.AddShader(Desc.GS);
+
+    const D3D12_STREAM_OUTPUT_DESC& StreamOutput = Desc.StreamOutput;
+    Key.Add(StreamOutput.NumEntries);
+    for (UINT i = 0; i < StreamOutput.NumEntries; ++i)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& Entry = StreamOutput.pSODeclaration[i];
+        Key.Add(Entry.Stream);
+        Key.AddString(Entry.SemanticName);
+        Key.Add(Entry.SemanticIndex);
+        Key.Add(Entry.StartComponent);
+        Key.Add(Entry.ComponentCount);
+        Key.Add(Entry.OutputSlot);
+    }
+    Key.Add(StreamOutput.NumStrides);
+    Key.AddBytes(StreamOutput.pBufferStrides, StreamOutput.NumStrides * sizeof(UINT));
+    Key.Add(StreamOutput.RasterizedStream);
+
+    // Render target blend descs end in a byte-sized write mask
+    Key.Add(Desc.BlendState.AlphaToCoverageEnable);
+    Key.Add(Desc.BlendState.IndependentBlendEnable);
+    for (const D3D12_RENDER_TARGET_BLEND_DESC& Blend : Desc.BlendState.RenderTarget)
+    {
+        Key.Add(Blend.BlendEnable);
+        Key.Add(Blend.LogicOpEnable);
+        Key.Add(Blend.SrcBlend);
+        Key.Add(Blend.DestBlend);
+        Key.Add(Blend.BlendOp);
+        Key.Add(Blend.SrcBlendAlpha);
+        Key.Add(Blend.DestBlendAlpha);
+        Key.Add(Blend.BlendOpAlpha);
+        Key.Add(Blend.LogicOp);
+        Key.Add(Blend.RenderTargetWriteMask);
+    }
+
+    Key.Add(Desc.SampleMask);
+    Key.Add(Desc.RasterizerState);
+
+    const D3D12_DEPTH_STENCIL_DESC& DepthStencil = Desc.DepthStencilState;
+    Key.Add(DepthStencil.DepthEnable);
+    Key.Add(DepthStencil.DepthWriteMask);
+    Key.Add(DepthStencil.DepthFunc);
+    Key.Add(DepthStencil.StencilEnable);
+    Key.Add(DepthStencil.StencilReadMask);
+    Key.Add(DepthStencil.StencilWriteMask);
+    Key.AddStencilOp(DepthStencil.FrontFace);
+    Key.AddStencilOp(DepthStencil.BackFace);
+
+    Key.Add(Desc.InputLayout.NumElements);
+    for (UINT i = 0; i < Desc.InputLayout.NumElements; ++i)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& Element = Desc.InputLayout.pInputElementDescs[i];
+        Key.AddString(Element.SemanticName);
+        Key.Add(Element.SemanticIndex);
+        Key.Add(Element.Format);
+        Key.Add(Element.InputSlot);
+        Key.Add(Element.AlignedByteOffset);
+        Key.Add(Element.InputSlotClass);
+        Key.Add(Element.InstanceDataStepRate);
+    }
+
+    Key.Add(Desc.IBStripCutValue);
+    Key.Add(Desc.PrimitiveTopologyType);
+    Key.Add(Desc.NumRenderTargets);
+    Key.AddBytes(Desc.RTVFormats, Desc.NumRenderTargets * sizeof(DXGI_FORMAT));
+    Key.Add(Desc.DSVFormat);
+    Key.Add(Desc.SampleDesc);
+    Key.Add(Desc.NodeMask);
+    Key.Add(Desc.Flags);
+
+    return Key.GetKey();
+}
+
+uint64_t PipelineCache::ComputeComputePSOKey( const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureKey )
+{
+    KeyBuilder Key(kComputePSOSeed);
+    Key.Add(RootSignatureKey);
+    Key.AddShader(Desc.CS);
+    Key.Add(Desc.NodeMask);
+    Key.Add(Desc.Flags);
+    return Key.GetKey();
+}
+
+bool PipelineCache::Find( uint64_t Key, const void*& Data, size_t& Size )
+{
+    return IsEnabled() && s_Cache.Find(Key, Data, Size);
+}
+
+void PipelineCache::Store( uint64_t Key, const void* Data, size_t Size )
+{
+    if (IsEnabled() && Data != nullptr && Size > 0)
+        s_Cache.Store(Key, Data, Size);
+}
+
+void PipelineCache::Reject( uint64_t Key )
+{
+    if (IsEnabled())
+        s_Cache.Reject(Key);
+}
+
+PipelineCache::Statistics PipelineCache::GetStatistics( void )
+{
+    return s_Cache.GetStatistics();
+}
+
+void PipelineCache::PrintStatistics( void )
+{
+    if (!IsEnabled())
+        return;
+
+    Statistics stats = GetStatistics();
+    Utility::Printf("Pipeline cache:  %u loaded in %.3f s, %u hits, %u misses, %u rejected, %u stored\n",
+        stats.entriesLoaded, stats.secondsLoading, stats.hits, stats.misses, stats.rejects, stats.stores);
+}
+
+namespace PipelineCache
+{
+    // Keys of the test descriptors below.  These only change when kFormatVersion does.
+    const uint64_t kExpectedRootSignatureKey = 0x951D0894A0EB5DF5ull;
+    const uint64_t kExpectedGraphicsPSOKey = 0x7A74FB04D1C361DBull;
+    const uint64_t kExpectedComputePSOKey = 0x2390C1D73D5EC272ull;
+
+    // Stand-ins for shader bytecode, copied into the test's own buffers
+    void FillBytecode( std::vector<uint8_t>& Bytecode, size_t Size, uint8_t Seed )
+    {
+        Bytecode.resize(Size);
+        for (size_t i = 0; i < Size; ++i)
+            Bytecode[i] = (uint8_t)(Seed + i * 7);
+    }
+
+    struct TestRootSignature
+    {
+        D3D12_DESCRIPTOR_RANGE Ranges[2];
+        D3D12_ROOT_PARAMETER Params[2];
+        D3D12_STATIC_SAMPLER_DESC Sampler;
+        D3D12_ROOT_SIGNATURE_DESC Desc;
+
+        TestRootSignature()
+        {
+            memset(this, 0, sizeof(*this));
+            Ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+            Ranges[0].NumDescriptors = 4;
+            Ranges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+            Ranges[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+            Ranges[1].NumDescriptors = 2;
+            Ranges[1].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+            Params[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+            Params[0].DescriptorTable.NumDescriptorRanges = 2;
+            Params[0].DescriptorTable.pDescriptorRanges = Ranges;
+            Params[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+            Params[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+            Params[1].Constants.Num32BitValues = 4;
+            Params[1].Constants.ShaderRegister = 1;
+            Params[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+            Sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+            Sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+            Sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+            Sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+            Sampler.MaxAnisotropy = 16;
+            Sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+            Sampler.MaxLOD = D3D12_FLOAT32_MAX;
+            Sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+            Desc.NumParameters = 2;
+            Desc.pParameters = Params;
+            Desc.NumStaticSamplers = 1;
+            Desc.pStaticSamplers = &Sampler;
+            Desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+        }
+    };
+
+    struct TestGraphicsPSO
+    {
+        std::vector<uint8_t> VS, PS;
+        char PositionName[16], TexcoordName[16];
+        D3D12_INPUT_ELEMENT_DESC Elements[2];
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc;
+
+        TestGraphicsPSO()
+        {
+            FillBytecode(VS, 96, 1);
+            FillBytecode(PS, 72, 2);
+            strcpy_s(PositionName, "POSITION");
+            strcpy_s(TexcoordName, "TEXCOORD");
+
+            memset(Elements, 0, sizeof(Elements));
+            Elements[0].SemanticName = PositionName;
+            Elements[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+            Elements[0].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+            Elements[1].SemanticName = TexcoordName;
+            Elements[1].Format = DXGI_FORMAT_R16G16_FLOAT;
+            Elements[1].AlignedByteOffset = 12;
+            Elements[1].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+
+            memset(&Desc, 0, sizeof(Desc));
+            Desc.VS = { VS.data(), VS.size() };
+            Desc.PS = { PS.data(), PS.size() };
+            Desc.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_ONE;
+            Desc.BlendState.RenderTarget[0].DestBlend = D3D12_BLEND_ZERO;
+            Desc.BlendState.RenderTarget[0].BlendOp = D3D12_BLEND_OP_ADD;
+            Desc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+            Desc.SampleMask = 0xFFFFFFFF;
+            Desc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+            Desc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+            Desc.RasterizerState.DepthClipEnable = TRUE;
+            Desc.DepthStencilState.DepthEnable = TRUE;
+            Desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+            Desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_GREATER_EQUAL;
+            Desc.InputLayout = { Elements, 2 };
+            Desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+            Desc.NumRenderTargets = 1;
+            Desc.RTVFormats[0] = DXGI_FORMAT_R11G11B10_FLOAT;
+            Desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+            Desc.SampleDesc.Count = 1;
+        }
+    };
+
+    bool TestKeys( void )
+    {
+        bool passed = true;
+        auto Check = [&]( bool Condition, const char* What )
+        {
+            if (!Condition)
+                Utility::Printf("  %s\n", What);
+            passed = passed && Condition;
+        };
+
+        TestRootSignature rootSig, rootSigCopy;
+        const uint64_t rootSigKey = ComputeRootSignatureKey(rootSig.Desc);
+        Check(rootSigKey == kExpectedRootSignatureKey, "Root signature key changed");
+        Check(ComputeRootSignatureKey(rootSigCopy.Desc) == rootSigKey, "Root signature key depends on pointers");
+        rootSigCopy.Ranges[1].NumDescriptors = 3;
+        Check(ComputeRootSignatureKey(rootSigCopy.Desc) != rootSigKey, "Root signature key ignores descriptor ranges");
+
+        TestGraphicsPSO graphics, graphicsCopy;
+        const uint64_t graphicsKey = ComputeGraphicsPSOKey(graphics.Desc, rootSigKey);
+        Check(graphicsKey == kExpectedGraphicsPSOKey, "Graphics PSO key changed");
+        Check(ComputeGraphicsPSOKey(graphicsCopy.Desc, rootSigKey) == graphicsKey, "Graphics PSO key depends on pointers");
+        Check(ComputeGraphicsPSOKey(graphics.Desc, rootSigKey + 1) != graphicsKey, "Graphics PSO key ignores the root signature");
+        graphicsCopy.VS[50] ^= 1;
+        Check(ComputeGraphicsPSOKey(graphicsCopy.Desc, rootSigKey) != graphicsKey, "Graphics PSO key ignores bytecode");
+        graphicsCopy.VS[50] ^= 1;
+        graphicsCopy.TexcoordName[0] = 'N';
+        Check(ComputeGraphicsPSOKey(graphicsCopy.Desc, rootSigKey) != graphicsKey, "Graphics PSO key ignores semantic names");
+
+        std::vector<uint8_t> CS, CSCopy;
+        FillBytecode(CS, 120, 3);
+        FillBytecode(CSCopy, 120, 3);
+        D3D12_COMPUTE_PIPELINE_STATE_DESC compute = {};
+        compute.CS = { CS.data(), CS.size() };
+        const uint64_t computeKey = ComputeComputePSOKey(compute, rootSigKey);
+        Check(computeKey == kExpectedComputePSOKey, "Compute PSO key changed");
+        compute.CS.pShaderBytecode = CSCopy.data();
+        Check(ComputeComputePSOKey(compute, rootSigKey) == computeKey, "Compute PSO key depends on pointers");
+        CSCopy.back() ^= 0x80;
+        Check(ComputeComputePSOKey(compute, rootSigKey) != computeKey, "Compute PSO key ignores bytecode");
+
+        return passed;
+    }
+
+    // Blob i is i-dependent bytes of an i-dependent size
+    uint64_t TestBlobKey( uint32_t i ) { return Utility::HashBytes64(&i, sizeof(i), 0x7E57); }
+    void FillTestBlob( std::vector<uint8_t>& Blob, uint32_t i ) { FillBytecode(Blob, 1 + (i * 37) % 4096, (uint8_t)i); }
+
+    // Counts the blobs a cache file finds with the right contents
+    uint32_t CountTestBlobs( CacheFile& Cache, uint32_t NumBlobs )
+    {
+        uint32_t numFound = 0;
+        std::vector<uint8_t> expected;
+        for (uint32_t i = 0; i < NumBlobs; ++i)
+        {
+            const void* data = nullptr;
+            size_t size = 0;
+            if (!Cache.Find(TestBlobKey(i), data, size))
+                continue;
+
+            FillTestBlob(expected, i);
+            if (size == expected.size() && memcmp(data, expected.data(), size) == 0)
+                ++numFound;
+        }
+        return numFound;
+    }
+}
+
+void PipelineCache::Test( void )
+{
+    Utility::Printf("Pipeline cache test\n");
+
+    const bool keysPassed = TestKeys();
+    Utility::Printf("  Content keys:  %s\n", keysPassed ? "passed" : "FAILED");
+
+    wchar_t tempDir[MAX_PATH];
+    GetTempPathW(MAX_PATH, tempDir);
+    const std::wstring filePath = std::wstring(tempDir) + L"MiniEnginePipelineCacheTest.bin";
+    DeleteFileW(filePath.c_str());
+
+    const uint64_t kDeviceKey = 0x0123456789ABCDEFull;
+    const uint32_t kNumThreads = 8;
+    const uint32_t kBlobsPerThread = 256;
+    const uint32_t kNumBlobs = kNumThreads * kBlobsPerThread;
+
+    // Stores from many threads at once, each blob twice to replace an entry while others store
+    bool storePassed = true;
+    {
+        CacheFile cache;
+        cache.Open(filePath, kDeviceKey);
+        storePassed = cache.GetStatistics().entriesLoaded == 0 && CountTestBlobs(cache, kNumBlobs) == 0;
+
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < kNumThreads; ++t)
+        {
+            threads.emplace_back([&cache, t]
+            {
+                std::vector<uint8_t> blob;
+                for (uint32_t pass = 0; pass < 2; ++pass)
+                {
+                    for (uint32_t i = t; i < kNumBlobs; i += kNumThreads)
+                    {
+                        FillTestBlob(blob, i);
+                        if (pass == 0)
+                            blob[0] ^= 0xFF;
+                        cache.Store(TestBlobKey(i), blob.data(), blob.size());
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        storePassed = storePassed && cache.GetStatistics().stores == kNumBlobs * 2;
+        cache.Close();
+    }
+
+    // Reloads every blob, then rejects one, which the next file leaves out
+    uint32_t numReloaded = 0;
+    uint32_t numAfterReject = 0;
+    {
+        CacheFile cache;
+        cache.Open(filePath, kDeviceKey);
+        numReloaded = CountTestBlobs(cache, kNumBlobs);
+        cache.Reject(TestBlobKey(5));
+        cache.Close();
+
+        cache.Open(filePath, kDeviceKey);
+        numAfterReject = CountTestBlobs(cache, kNumBlobs);
+        const void* data = nullptr;
+        size_t size = 0;
+        numAfterReject = cache.Find(TestBlobKey(5), data, size) ? 0 : numAfterReject;
+        cache.Close();
+    }
+
+    // Another adapter or driver finds nothing
+    uint32_t numOtherDevice = 0;
+    {
+        CacheFile cache;
+        cache.Open(filePath, kDeviceKey + 1);
+        numOtherDevice = cache.GetStatistics().entriesLoaded + CountTestBlobs(cache, kNumBlobs);
+        cache.Close();
+    }
+
+    // Everything before the cut of a truncated file still loads
+    uint32_t numTruncated = 0;
+    {
+        std::vector<char> fileData;
+        {
+            std::ifstream file(filePath, std::ios::in | std::ios::binary);
+            fileData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        {
+            std::ofstream file(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+            file.write(fileData.data(), fileData.size() / 2);
+        }
+
+        CacheFile cache;
+        cache.Open(filePath, kDeviceKey);
+        numTruncated = CountTestBlobs(cache, kNumBlobs);
+        storePassed = storePassed && numTruncated == cache.GetStatistics().entriesLoaded;
+        cache.Close();
+    }
+
+    DeleteFileW(filePath.c_str());
+
+    const bool filePassed = storePassed && numReloaded == kNumBlobs && numAfterReject == kNumBlobs - 1 &&
+        numOtherDevice == 0 && numTruncated > 0 && numTruncated < kNumBlobs;
+
+    Utility::Printf("  %u blobs from %u threads:  %u reloaded, %u after a reject, %u for another device, "
+        "%u from half the file:  %s\n", kNumBlobs, kNumThreads, numReloaded, numAfterReject, numOtherDevice,
+        numTruncated, filePassed ? "passed" : "FAILED");
+}
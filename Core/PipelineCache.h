@@ -0,0 +1,75 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "pch.h"
+
+//
+// A persistent cache of driver-compiled pipeline state objects and serialized root signatures.
+// Entries are keyed by a hash of their content (shader bytecode, fixed function state, input
+// layout, and the root signature's own key) rather than by pointers, so keys are the same from
+// one launch to the next.  The file is tagged with the adapter and driver version and ignored
+// when either changes.
+//
+// The file is read on a worker thread as soon as the device exists, and the first lookup waits
+// for it.  Once loaded, the table is never modified, so lookups take no lock.  Pipelines compiled
+// during the run go to a sharded table and are merged into the file at shutdown.
+//
+namespace PipelineCache
+{
+    // The cache is off unless the command line names a file with "-pso_cache <file>".
+    // "-pso_cache default" uses %LOCALAPPDATA%\MiniEngine\PipelineCache.bin.
+    void Initialize( ID3D12Device* Device );
+
+    // Writes the file if anything new was stored, then releases every entry
+    void Shutdown( void );
+
+    bool IsEnabled( void );
+
+    // Content keys.  Pointers are replaced by what they point to.
+    uint64_t ComputeRootSignatureKey( const D3D12_ROOT_SIGNATURE_DESC& Desc );
+    uint64_t ComputeGraphicsPSOKey( const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureKey );
+    uint64_t ComputeComputePSOKey( const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureKey );
+
+    // Returns the blob stored under this key by an earlier run.  The memory stays valid until
+    // Shutdown.
+    bool Find( uint64_t Key, const void*& Data, size_t& Size );
+
+    // Records a blob for the next run.  Also call it when the driver rejects a found blob, so that
+    // the stale entry is replaced.
+    void Store( uint64_t Key, const void* Data, size_t Size );
+
+    // Drops a found blob the driver would not accept, so that it is not written to the next file
+    // unless a new blob is stored under the same key
+    void Reject( uint64_t Key );
+
+    struct Statistics
+    {
+        uint32_t entriesLoaded;
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t rejects;
+        uint32_t stores;
+        double secondsLoading;
+    };
+
+    Statistics GetStatistics( void );
+    void PrintStatistics( void );
+
+    // Checks the content keys of fixed descriptors against known values and against copies that
+    // differ only in pointers or in one byte of bytecode.  Then stores blobs from many threads into
+    // a temporary file, reloads it, and checks every blob, a rejected entry, another device's key,
+    // and a truncated file.  Uses no device.
+    void Test( void );
+}
@@ -14,23 +14,54 @@
 #include "GraphicsCore.h"
 #include "PipelineState.h"
 #include "RootSignature.h"
-#include "Hash.h"
-#include <map>
-#include <thread>
-#include <mutex>
+#include "PipelineCache.h"
+#include "ConcurrentHashMap.h"
 
 using Math::IsAligned;
 using namespace Graphics;
 using Microsoft::WRL::ComPtr;
 using namespace std;
 
-static map< size_t, ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
-static map< size_t, ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
+static ConcurrentHashMap< ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
+static ConcurrentHashMap< ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
 
 void PSO::DestroyAll(void)
 {
-    s_GraphicsPSOHashMap.clear();
-    s_ComputePSOHashMap.clear();
+    s_GraphicsPSOHashMap.Clear();
+    s_ComputePSOHashMap.Clear();
+}
+
+// Creates the pipeline from the driver's blob of an earlier run when there is one it accepts.
+// Otherwise the pipeline is compiled and its blob is kept for the next run.
+template <typename DescType, typename CreateFunc>
+static ID3D12PipelineState* CreateCachedPipelineState( uint64_t Key, DescType& Desc, CreateFunc Create )
+{
+    ID3D12PipelineState* pPSO = nullptr;
+
+    const void* CachedBlob = nullptr;
+    size_t CachedBlobSize = 0;
+    if (PipelineCache::Find(Key, CachedBlob, CachedBlobSize))
+    {
+        Desc.CachedPSO.pCachedBlob = CachedBlob;
+        Desc.CachedPSO.CachedBlobSizeInBytes = CachedBlobSize;
+        HRESULT hr = Create(Desc, &pPSO);
+        Desc.CachedPSO.pCachedBlob = nullptr;
+        Desc.CachedPSO.CachedBlobSizeInBytes = 0;
+
+        if (SUCCEEDED(hr))
+            return pPSO;
+
+        PipelineCache::Reject(Key);
+        pPSO = nullptr;
+    }
+
+    ASSERT_SUCCEEDED( Create(Desc, &pPSO) );
+
+    ComPtr<ID3DBlob> Blob;
+    if (PipelineCache::IsEnabled() && SUCCEEDED(pPSO->GetCachedBlob(Blob.GetAddressOf())))
+        PipelineCache::Store(Key, Blob->GetBufferPointer(), Blob->GetBufferSize());
+
+    return pPSO;
 }
 
 
@@ -121,41 +152,20 @@ void GraphicsPSO::Finalize()
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     ASSERT(m_PSODesc.pRootSignature != nullptr);
 
-    m_PSODesc.InputLayout.pInputElementDescs = nullptr;
-    size_t HashCode = Utility::HashState(&m_PSODesc);
-    HashCode = Utility::HashState(m_InputLayouts.get(), m_PSODesc.InputLayout.NumElements, HashCode);
     m_PSODesc.InputLayout.pInputElementDescs = m_InputLayouts.get();
+    const uint64_t HashCode = PipelineCache::ComputeGraphicsPSOKey(m_PSODesc, m_RootSignature->GetContentKey());
 
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
-    {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_GraphicsPSOHashMap.find(HashCode);
-
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_GraphicsPSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_GraphicsPSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
-
-    if (firstCompile)
+    // The first thread to ask compiles it, and any others asking meanwhile wait for that
+    m_PSO = s_GraphicsPSOHashMap.GetOrCreate(HashCode, [&]( void )
     {
         ASSERT(m_PSODesc.DepthStencilState.DepthEnable != (m_PSODesc.DSVFormat == DXGI_FORMAT_UNKNOWN));
-        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_GraphicsPSOHashMap[HashCode].Attach(m_PSO);
-        m_PSO->SetName(m_Name);
-    }
-    else
-    {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        ComPtr<ID3D12PipelineState> pPSO;
+        pPSO.Attach(CreateCachedPipelineState(HashCode, m_PSODesc,
+            []( const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** ppPSO )
+            { return g_Device->CreateGraphicsPipelineState(&Desc, MY_IID_PPV_ARGS(ppPSO)); }));
+        pPSO->SetName(m_Name);
+        return pPSO;
+    }).Get();
 }
 
 void ComputePSO::Finalize()
@@ -164,37 +174,17 @@ void ComputePSO::Finalize()
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     ASSERT(m_PSODesc.pRootSignature != nullptr);
 
-    size_t HashCode = Utility::HashState(&m_PSODesc);
-
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
-    {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_ComputePSOHashMap.find(HashCode);
-
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_ComputePSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_ComputePSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
+    const uint64_t HashCode = PipelineCache::ComputeComputePSOKey(m_PSODesc, m_RootSignature->GetContentKey());
 
-    if (firstCompile)
-    {
-        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_ComputePSOHashMap[HashCode].Attach(m_PSO);
-        m_PSO->SetName(m_Name);
-    }
-    else
+    m_PSO = s_ComputePSOHashMap.GetOrCreate(HashCode, [&]( void )
     {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        ComPtr<ID3D12PipelineState> pPSO;
+        pPSO.Attach(CreateCachedPipelineState(HashCode, m_PSODesc,
+            []( const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** ppPSO )
+            { return g_Device->CreateComputePipelineState(&Desc, MY_IID_PPV_ARGS(ppPSO)); }));
+        pPSO->SetName(m_Name);
+        return pPSO;
+    }).Get();
 }
 
 ComputePSO::ComputePSO(const wchar_t* Name)
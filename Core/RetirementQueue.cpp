@@ -0,0 +1,277 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "RetirementQueue.h"
+#include "SystemTime.h"
+
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace
+{
+    // Queues only register and unregister when they are created and destroyed.  The mutex is
+    // created by the first queue, so it outlives every queue, including static ones.
+    std::mutex& GetRegistryMutex( void )
+    {
+        static std::mutex s_Mutex;
+        return s_Mutex;
+    }
+
+    RetirementQueueBase* s_FirstQueue = nullptr;
+}
+
+RetirementQueueBase::RetirementQueueBase( const char* Name ) :
+    m_Name(Name), m_Retired(0), m_Reclaimed(0), m_PeakRetained(0), m_TotalLatency(0), m_MaxLatency(0)
+{
+    std::lock_guard<std::mutex> lock(GetRegistryMutex());
+    m_NextQueue = s_FirstQueue;
+    s_FirstQueue = this;
+}
+
+RetirementQueueBase::~RetirementQueueBase()
+{
+    std::lock_guard<std::mutex> lock(GetRegistryMutex());
+    for (RetirementQueueBase** Link = &s_FirstQueue; *Link != nullptr; Link = &(*Link)->m_NextQueue)
+    {
+        if (*Link == this)
+        {
+            *Link = m_NextQueue;
+            break;
+        }
+    }
+}
+
+int64_t RetirementQueueBase::GetTick( void )
+{
+    return SystemTime::GetCurrentTick();
+}
+
+void RetirementQueueBase::RecordRetire( uint64_t Count )
+{
+    const uint64_t Retained = m_Retired.fetch_add(Count, std::memory_order_relaxed) + Count -
+        m_Reclaimed.load(std::memory_order_relaxed);
+
+    uint64_t Peak = m_PeakRetained.load(std::memory_order_relaxed);
+    while (Retained > Peak && !m_PeakRetained.compare_exchange_weak(Peak, Retained, std::memory_order_relaxed))
+    {
+    }
+}
+
+void RetirementQueueBase::RecordReclaim( uint64_t Count, int64_t TotalLatency, int64_t MaxLatency )
+{
+    m_Reclaimed.fetch_add(Count, std::memory_order_relaxed);
+    m_TotalLatency.fetch_add(TotalLatency, std::memory_order_relaxed);
+
+    int64_t Max = m_MaxLatency.load(std::memory_order_relaxed);
+    while (MaxLatency > Max && !m_MaxLatency.compare_exchange_weak(Max, MaxLatency, std::memory_order_relaxed))
+    {
+    }
+}
+
+RetirementQueueBase::Statistics RetirementQueueBase::GetStatistics( void ) const
+{
+    Statistics stats;
+    stats.reclaimed = m_Reclaimed.load(std::memory_order_relaxed);
+    stats.retired = m_Retired.load(std::memory_order_relaxed);
+    stats.retained = stats.retired > stats.reclaimed ? stats.retired - stats.reclaimed : 0;
+    stats.peakRetained = m_PeakRetained.load(std::memory_order_relaxed);
+    stats.averageReuseLatency = stats.reclaimed > 0 ?
+        SystemTime::TicksToSeconds(m_TotalLatency.load(std::memory_order_relaxed)) / stats.reclaimed : 0.0;
+    stats.maxReuseLatency = SystemTime::TicksToSeconds(m_MaxLatency.load(std::memory_order_relaxed));
+    return stats;
+}
+
+void RetirementQueueBase::PrintAllStatistics( void )
+{
+    std::lock_guard<std::mutex> lock(GetRegistryMutex());
+    for (const RetirementQueueBase* Queue = s_FirstQueue; Queue != nullptr; Queue = Queue->m_NextQueue)
+    {
+        Statistics stats = Queue->GetStatistics();
+        if (stats.retired == 0)
+            continue;
+
+        Utility::Printf("%s:  %llu retired, %llu waiting, peak %llu, reuse latency %.2f ms average, %.2f ms max\n",
+            Queue->GetName(), stats.retired, stats.retained, stats.peakRetained,
+            stats.averageReuseLatency * 1000.0, stats.maxReuseLatency * 1000.0);
+    }
+}
+
+namespace
+{
+    // The pattern RetirementQueue replaces
+    class LockedRetirementQueue
+    {
+    public:
+        void Retire( uint64_t FenceValue, uint32_t Item )
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Retired.push(std::make_pair(FenceValue, Item));
+        }
+
+        template <typename IsCompleteFunc>
+        bool Reclaim( uint32_t& Item, IsCompleteFunc IsComplete )
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Retired.empty() || !IsComplete(m_Retired.front().first))
+                return false;
+            Item = m_Retired.front().second;
+            m_Retired.pop();
+            return true;
+        }
+
+        template <typename IsCompleteFunc, typename ReleaseFunc>
+        size_t ReclaimAll( IsCompleteFunc IsComplete, ReleaseFunc Release )
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            size_t Count = 0;
+            while (!m_Retired.empty() && IsComplete(m_Retired.front().first))
+            {
+                Release(m_Retired.front().second);
+                m_Retired.pop();
+                ++Count;
+            }
+            return Count;
+        }
+
+    private:
+        std::mutex m_Mutex;
+        std::queue<std::pair<uint64_t, uint32_t>> m_Retired;
+    };
+
+    // Stands in for a GPU queue that always has FenceLag fences in flight: issuing a fence
+    // completes the one FenceLag before it
+    class SimulatedFence
+    {
+    public:
+        explicit SimulatedFence( uint64_t FenceLag ) : m_FenceLag(FenceLag), m_NextValue(1), m_CompletedValue(0) {}
+
+        uint64_t Signal( void )
+        {
+            const uint64_t Value = m_NextValue.fetch_add(1, std::memory_order_relaxed);
+            if (Value > m_FenceLag)
+            {
+                uint64_t Completed = m_CompletedValue.load(std::memory_order_relaxed);
+                while (Completed < Value - m_FenceLag &&
+                    !m_CompletedValue.compare_exchange_weak(Completed, Value - m_FenceLag, std::memory_order_release))
+                {
+                }
+            }
+            return Value;
+        }
+
+        bool IsComplete( uint64_t Value ) const { return Value <= m_CompletedValue.load(std::memory_order_acquire); }
+
+        void WaitForIdle( void ) { m_CompletedValue.store(m_NextValue.load() - 1, std::memory_order_release); }
+
+    private:
+        const uint64_t m_FenceLag;
+        std::atomic<uint64_t> m_NextValue;
+        std::atomic<uint64_t> m_CompletedValue;
+    };
+
+    struct RunResult
+    {
+        double Seconds;
+        uint32_t ItemsCreated;
+        uint32_t Errors;
+    };
+
+    // Every thread repeatedly takes an item, reusing one if any is ready, "records commands" into
+    // it, and retires it at a new fence.  Items are checked to be idle and past their fences when
+    // reused, and all of them must come back once the last fence completes.
+    template <typename QueueType>
+    RunResult Run( QueueType& Queue, uint32_t NumThreads, uint32_t ItemsPerThread, uint32_t FenceLag )
+    {
+        SimulatedFence fence(FenceLag);
+        const uint32_t kMaxItems = NumThreads * ItemsPerThread;
+        std::unique_ptr<std::atomic<uint64_t>[]> itemFence(new std::atomic<uint64_t>[kMaxItems]);
+        std::unique_ptr<std::atomic<uint32_t>[]> itemInUse(new std::atomic<uint32_t>[kMaxItems]);
+        std::atomic<uint32_t> itemsCreated(0), errors(0);
+
+        auto IsComplete = [&]( uint64_t FenceValue ) { return fence.IsComplete(FenceValue); };
+
+        const int64_t startTick = SystemTime::GetCurrentTick();
+
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < NumThreads; ++t)
+        {
+            threads.push_back(std::thread([&]( void )
+            {
+                for (uint32_t i = 0; i < ItemsPerThread; ++i)
+                {
+                    uint32_t Item;
+                    if (Queue.Reclaim(Item, IsComplete))
+                    {
+                        if (!IsComplete(itemFence[Item].load(std::memory_order_relaxed)))
+                            ++errors;
+                    }
+                    else
+                    {
+                        Item = itemsCreated++;
+                        itemInUse[Item].store(0, std::memory_order_relaxed);
+                    }
+
+                    // No other thread may hold the item while this one does
+                    if (itemInUse[Item].exchange(1, std::memory_order_relaxed) != 0)
+                        ++errors;
+
+                    const uint64_t FenceValue = fence.Signal();
+                    itemFence[Item].store(FenceValue, std::memory_order_relaxed);
+                    itemInUse[Item].store(0, std::memory_order_relaxed);
+                    Queue.Retire(FenceValue, Item);
+                }
+            }));
+        }
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        const double seconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        // Once the GPU is idle every item must come back exactly once
+        fence.WaitForIdle();
+        std::vector<uint8_t> returned(itemsCreated, 0);
+        Queue.ReclaimAll(IsComplete, [&]( uint32_t Item ) { errors += Item >= returned.size() || returned[Item]++ != 0; });
+        for (uint8_t count : returned)
+            errors += count != 1;
+
+        RunResult result = { seconds, itemsCreated, errors };
+        return result;
+    }
+}
+
+void BenchmarkRetirementQueue( void )
+{
+    const uint32_t kItemsPerThread = 200000;
+    const uint32_t kFenceLag = 64;
+    const uint32_t threadCounts[] = { 1, 2, 4, 8, 16 };
+
+    Utility::Printf("Retirement queue benchmark (%u items per thread, %u fences in flight)\n", kItemsPerThread, kFenceLag);
+
+    for (uint32_t numThreads : threadCounts)
+    {
+        LockedRetirementQueue lockedQueue;
+        RetirementQueue<uint32_t> retirementQueue("Benchmark");
+
+        const RunResult locked = Run(lockedQueue, numThreads, kItemsPerThread, kFenceLag);
+        const RunResult lockFree = Run(retirementQueue, numThreads, kItemsPerThread, kFenceLag);
+
+        const double items = (double)numThreads * kItemsPerThread;
+        Utility::Printf("  %2u threads:  mutex + queue %7.2f Mitems/s (%u created)   lock-free %7.2f Mitems/s (%u created)   %s\n",
+            numThreads, items / locked.Seconds * 1e-6, locked.ItemsCreated, items / lockFree.Seconds * 1e-6,
+            lockFree.ItemsCreated, locked.Errors == 0 && lockFree.Errors == 0 ? "passed" : "FAILED");
+    }
+}
@@ -0,0 +1,387 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+//
+// Holds objects the GPU may still be using until the fence they were retired with completes, then
+// hands them back for reuse or destruction.  Command allocators, linear allocator pages and
+// descriptor heaps are all recycled this way.
+//
+// Retiring never locks or waits.  Retired items are pushed onto a stack with one compare-exchange
+// per batch, and ready items are popped from another.  A
+// thread that wants an item and finds none ready sweeps: it takes everything retired since the
+// last sweep, appends it to the waiting lists in retirement order, and moves every item at the
+// front of a list whose fence has completed to a ready stack in one batch.  Fences are only
+// tested when something is needed, and a sweep stops at the first fence that has not completed,
+// as a FIFO would.  Fences are only ordered within a command queue, and the queue type is kept in
+// the top byte of a fence value, so each type waits in its own list.  Sweeps take turns through
+// an atomic flag.  A thread that finds nothing ready while another sweeps waits for that sweep,
+// which is short, rather than growing the pool with a new object.
+//
+// Stacks link nodes by index with a tag in the upper half of the head, so a node popped and
+// pushed back between another thread's read and compare-exchange cannot be mistaken for the old
+// head.  Nodes live in chunks that are never freed until the queue is destroyed.
+//
+class RetirementQueueBase
+{
+public:
+    struct Statistics
+    {
+        uint64_t retired;               // Items ever retired
+        uint64_t reclaimed;             // Items handed back for reuse or destruction
+        uint64_t retained;              // Items waiting now
+        uint64_t peakRetained;          // The most ever waiting at once
+        double averageReuseLatency;     // Seconds from retirement to reclamation
+        double maxReuseLatency;
+    };
+
+    const char* GetName( void ) const { return m_Name; }
+    Statistics GetStatistics( void ) const;
+
+    // Prints the statistics of every queue that has retired something
+    static void PrintAllStatistics( void );
+
+protected:
+    explicit RetirementQueueBase( const char* Name );
+    ~RetirementQueueBase();
+
+    RetirementQueueBase( const RetirementQueueBase& ) = delete;
+    RetirementQueueBase& operator=( const RetirementQueueBase& ) = delete;
+
+    static int64_t GetTick( void );
+    void RecordRetire( uint64_t Count );
+    void RecordReclaim( uint64_t Count, int64_t TotalLatency, int64_t MaxLatency );
+
+private:
+    const char* m_Name;
+    RetirementQueueBase* m_NextQueue;   // Every live queue, for PrintAllStatistics()
+
+    std::atomic<uint64_t> m_Retired;
+    std::atomic<uint64_t> m_Reclaimed;
+    std::atomic<uint64_t> m_PeakRetained;
+    std::atomic<int64_t> m_TotalLatency;
+    std::atomic<int64_t> m_MaxLatency;
+};
+
+template <typename T>
+class RetirementQueue : public RetirementQueueBase
+{
+public:
+    RetirementQueue( const char* Name ) : RetirementQueueBase(Name), m_Sweeping(false), m_NodeCount(0)
+    {
+        for (uint32_t Lane = 0; Lane < kNumLanes; ++Lane)
+            m_WaitingFirst[Lane] = m_WaitingLast[Lane] = kNil;
+        for (std::atomic<Node*>& chunk : m_Chunks)
+            chunk.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~RetirementQueue()
+    {
+        for (std::atomic<Node*>& chunk : m_Chunks)
+            delete[] chunk.load(std::memory_order_relaxed);
+    }
+
+    // Item may be reused once FenceValue completes
+    void Retire( uint64_t FenceValue, const T& Item )
+    {
+        Retire(FenceValue, &Item, 1);
+    }
+
+    void Retire( uint64_t FenceValue, const T* Items, size_t Count )
+    {
+        if (Count == 0)
+            return;
+
+        const int64_t Tick = GetTick();
+
+        // Link the batch privately, then publish it all at once
+        uint32_t First = kNil, Last = kNil;
+        for (size_t i = 0; i < Count; ++i)
+        {
+            const uint32_t Index = AllocateNode();
+            Node& node = GetNode(Index);
+            node.FenceValue = FenceValue;
+            node.RetireTick = Tick;
+            node.Item = Items[i];
+            Link(Index, First, Last);
+        }
+
+        m_Retired.Push(*this, First, Last);
+        RecordRetire(Count);
+    }
+
+    // Returns false if no retired item has passed its fence.  IsComplete( FenceValue ) tests a
+    // fence.
+    template <typename IsCompleteFunc>
+    bool Reclaim( T& Item, IsCompleteFunc IsComplete )
+    {
+        uint32_t Index = m_Ready.Pop(*this);
+        while (Index == kNil && !Sweep(IsComplete, &Index))
+        {
+            std::this_thread::yield();
+            Index = m_Ready.Pop(*this);
+        }
+        if (Index == kNil)
+            return false;
+
+        Node& node = GetNode(Index);
+        Item = node.Item;
+        const int64_t Latency = GetTick() - node.RetireTick;
+        m_FreeNodes.Push(*this, Index, Index);
+        RecordReclaim(1, Latency, Latency);
+        return true;
+    }
+
+    // Calls Release( Item ) for every item whose fence has completed and returns how many
+    template <typename IsCompleteFunc, typename ReleaseFunc>
+    size_t ReclaimAll( IsCompleteFunc IsComplete, ReleaseFunc Release )
+    {
+        while (!Sweep(IsComplete, nullptr))
+            std::this_thread::yield();
+        return ReleaseChain(m_Ready.TakeAll(), Release);
+    }
+
+    // Calls Release( Item ) for every item regardless of its fence.  Only for when the GPU is idle.
+    template <typename ReleaseFunc>
+    size_t Flush( ReleaseFunc Release )
+    {
+        ASSERT(!m_Sweeping.load(std::memory_order_relaxed));
+
+        size_t Count = ReleaseChain(m_Ready.TakeAll(), Release) + ReleaseChain(m_Retired.TakeAll(), Release);
+        for (uint32_t Lane = 0; Lane < kNumLanes; ++Lane)
+        {
+            Count += ReleaseChain(m_WaitingFirst[Lane], Release);
+            m_WaitingFirst[Lane] = m_WaitingLast[Lane] = kNil;
+        }
+        return Count;
+    }
+
+private:
+    static const uint32_t kNil = 0xFFFFFFFF;
+    static const uint32_t kChunkSize = 1024;
+    static const uint32_t kMaxChunks = 1024;
+    static const uint32_t kNumLanes = 8;
+
+    struct Node
+    {
+        std::atomic<uint32_t> Next;
+        uint64_t FenceValue;
+        int64_t RetireTick;
+        T Item;
+    };
+
+    // A stack of node indices.  The head holds the top index in its low 32 bits and a count of
+    // changes in its high 32 bits.
+    class Stack
+    {
+    public:
+        Stack() : m_Head(kNil) {}
+
+        // Pushes a chain of nodes already linked from First to Last
+        void Push( RetirementQueue& Queue, uint32_t First, uint32_t Last )
+        {
+            uint64_t Head = m_Head.load(std::memory_order_relaxed);
+            do
+            {
+                Queue.GetNode(Last).Next.store((uint32_t)Head, std::memory_order_relaxed);
+            }
+            while (!m_Head.compare_exchange_weak(Head, Tagged(First, Head), std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        uint32_t Pop( RetirementQueue& Queue )
+        {
+            uint64_t Head = m_Head.load(std::memory_order_acquire);
+            for (;;)
+            {
+                const uint32_t Top = (uint32_t)Head;
+                if (Top == kNil)
+                    return kNil;
+
+                // Another thread may pop this node first, so this read can be stale, but then the
+                // tag will have changed and the exchange fails
+                const uint32_t Next = Queue.GetNode(Top).Next.load(std::memory_order_relaxed);
+                if (m_Head.compare_exchange_weak(Head, Tagged(Next, Head), std::memory_order_acquire, std::memory_order_acquire))
+                    return Top;
+            }
+        }
+
+        // Returns the top of the whole chain, which is now private to the caller
+        uint32_t TakeAll( void )
+        {
+            uint64_t Head = m_Head.load(std::memory_order_acquire);
+            while ((uint32_t)Head != kNil &&
+                !m_Head.compare_exchange_weak(Head, Tagged(kNil, Head), std::memory_order_acquire, std::memory_order_acquire))
+            {
+            }
+            return (uint32_t)Head;
+        }
+
+    private:
+        static uint64_t Tagged( uint32_t Index, uint64_t OldHead )
+        {
+            return ((OldHead >> 32) + 1) << 32 | Index;
+        }
+
+        std::atomic<uint64_t> m_Head;
+    };
+
+    Node& GetNode( uint32_t Index )
+    {
+        return m_Chunks[Index / kChunkSize].load(std::memory_order_acquire)[Index % kChunkSize];
+    }
+
+    uint32_t AllocateNode( void )
+    {
+        uint32_t Index = m_FreeNodes.Pop(*this);
+        if (Index != kNil)
+            return Index;
+
+        Index = m_NodeCount.fetch_add(1, std::memory_order_relaxed);
+        std::atomic<Node*>& Chunk = m_Chunks[Index / kChunkSize];
+        ASSERT(Index / kChunkSize < kMaxChunks, "Too many items retired at once");
+
+        // The first thread to need a chunk allocates it.  A thread that loses the race frees its own.
+        if (Chunk.load(std::memory_order_acquire) == nullptr)
+        {
+            Node* NewChunk = new Node[kChunkSize];
+            Node* Expected = nullptr;
+            if (!Chunk.compare_exchange_strong(Expected, NewChunk, std::memory_order_acq_rel))
+                delete[] NewChunk;
+        }
+        return Index;
+    }
+
+    // Adds a node to the front of a private chain
+    void Link( uint32_t Index, uint32_t& First, uint32_t& Last )
+    {
+        GetNode(Index).Next.store(First, std::memory_order_relaxed);
+        First = Index;
+        if (Last == kNil)
+            Last = Index;
+    }
+
+    // Moves every item at the front of a waiting list whose fence has completed to the ready
+    // stack, except that the first is given to the caller if it asks with Claimed.  Returns false
+    // without doing anything if another thread is sweeping.
+    template <typename IsCompleteFunc>
+    bool Sweep( IsCompleteFunc IsComplete, uint32_t* Claimed )
+    {
+        if (m_Sweeping.exchange(true, std::memory_order_acquire))
+            return false;
+
+        // The newest retirements are on top, so reverse them into retirement order
+        uint32_t Oldest = kNil;
+        for (uint32_t Index = m_Retired.TakeAll(); Index != kNil; )
+        {
+            Node& node = GetNode(Index);
+            const uint32_t Next = node.Next.load(std::memory_order_relaxed);
+            node.Next.store(Oldest, std::memory_order_relaxed);
+            Oldest = Index;
+            Index = Next;
+        }
+
+        for (uint32_t Index = Oldest; Index != kNil; )
+        {
+            Node& node = GetNode(Index);
+            const uint32_t Next = node.Next.load(std::memory_order_relaxed);
+            const uint32_t Lane = (uint32_t)(node.FenceValue >> 56) % kNumLanes;
+
+            node.Next.store(kNil, std::memory_order_relaxed);
+            if (m_WaitingLast[Lane] == kNil)
+                m_WaitingFirst[Lane] = Index;
+            else
+                GetNode(m_WaitingLast[Lane]).Next.store(Index, std::memory_order_relaxed);
+            m_WaitingLast[Lane] = Index;
+
+            Index = Next;
+        }
+
+        uint32_t ReadyFirst = kNil, ReadyLast = kNil;
+        for (uint32_t Lane = 0; Lane < kNumLanes; ++Lane)
+        {
+            uint32_t& First = m_WaitingFirst[Lane];
+            while (First != kNil && IsComplete(GetNode(First).FenceValue))
+            {
+                const uint32_t Index = First;
+                First = GetNode(Index).Next.load(std::memory_order_relaxed);
+                Link(Index, ReadyFirst, ReadyLast);
+            }
+            if (First == kNil)
+                m_WaitingLast[Lane] = kNil;
+        }
+
+        m_Sweeping.store(false, std::memory_order_release);
+
+        if (Claimed != nullptr)
+        {
+            *Claimed = ReadyFirst;
+            if (ReadyFirst != kNil)
+                ReadyFirst = ReadyFirst == ReadyLast ? kNil : GetNode(ReadyFirst).Next.load(std::memory_order_relaxed);
+        }
+
+        if (ReadyFirst != kNil)
+            m_Ready.Push(*this, ReadyFirst, ReadyLast);
+        return true;
+    }
+
+    // Releases a private chain and recycles its nodes
+    template <typename ReleaseFunc>
+    size_t ReleaseChain( uint32_t First, ReleaseFunc Release )
+    {
+        if (First == kNil)
+            return 0;
+
+        const int64_t Tick = GetTick();
+        int64_t TotalLatency = 0, MaxLatency = 0;
+        size_t Count = 0;
+        uint32_t Last = First;
+
+        for (uint32_t Index = First; Index != kNil; )
+        {
+            Node& node = GetNode(Index);
+            Release(node.Item);
+            const int64_t Latency = Tick - node.RetireTick;
+            TotalLatency += Latency;
+            MaxLatency = Latency > MaxLatency ? Latency : MaxLatency;
+            ++Count;
+            Last = Index;
+            Index = node.Next.load(std::memory_order_relaxed);
+        }
+
+        m_FreeNodes.Push(*this, First, Last);
+        RecordReclaim(Count, TotalLatency, MaxLatency);
+        return Count;
+    }
+
+    Stack m_Retired;        // Retired since the last sweep
+    Stack m_Ready;          // Fences known to be complete
+    Stack m_FreeNodes;
+
+    // Only the sweeping thread touches the waiting lists
+    std::atomic<bool> m_Sweeping;
+    uint32_t m_WaitingFirst[kNumLanes];
+    uint32_t m_WaitingLast[kNumLanes];
+
+    std::atomic<uint32_t> m_NodeCount;
+    std::atomic<Node*> m_Chunks[kMaxChunks];
+};
+
+// Checks that items are never reused before their fences and none are lost, with producers,
+// consumers and a simulated GPU fence on separate threads, then compares throughput against a
+// mutex and std::queue
+void BenchmarkRetirementQueue( void );
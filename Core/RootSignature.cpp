@@ -14,20 +14,18 @@
 #include "pch.h"
 #include "RootSignature.h"
 #include "GraphicsCore.h"
-#include "Hash.h"
-#include <map>
-#include <thread>
-#include <mutex>
+#include "PipelineCache.h"
+#include "ConcurrentHashMap.h"
 
 using namespace Graphics;
 using namespace std;
 using Microsoft::WRL::ComPtr;
 
-static std::map< size_t, ComPtr<ID3D12RootSignature> > s_RootSignatureHashMap;
+static ConcurrentHashMap< ComPtr<ID3D12RootSignature> > s_RootSignatureHashMap;
 
 void RootSignature::DestroyAll(void)
 {
-    s_RootSignatureHashMap.clear();
+    s_RootSignatureHashMap.Clear();
 }
 
 void RootSignature::InitStaticSampler(
@@ -103,8 +101,8 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
     m_DescriptorTableBitMap = 0;
     m_SamplerTableBitMap = 0;
 
-    size_t HashCode = Utility::HashState(&RootDesc.Flags);
-    HashCode = Utility::HashState( RootDesc.pStaticSamplers, m_NumSamplers, HashCode );
+    m_ContentKey = PipelineCache::ComputeRootSignatureKey(RootDesc);
+    const uint64_t HashCode = m_ContentKey;
 
     for (UINT Param = 0; Param < m_NumParameters; ++Param)
     {
@@ -115,9 +113,6 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
         {
             ASSERT(RootParam.DescriptorTable.pDescriptorRanges != nullptr);
 
-            HashCode = Utility::HashState( RootParam.DescriptorTable.pDescriptorRanges,
-                RootParam.DescriptorTable.NumDescriptorRanges, HashCode );
-
             // We keep track of sampler descriptor tables separately from CBV_SRV_UAV descriptor tables
             if (RootParam.DescriptorTable.pDescriptorRanges->RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
                 m_SamplerTableBitMap |= (1 << Param);
@@ -127,48 +122,38 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
             for (UINT TableRange = 0; TableRange < RootParam.DescriptorTable.NumDescriptorRanges; ++TableRange)
                 m_DescriptorTableSize[Param] += RootParam.DescriptorTable.pDescriptorRanges[TableRange].NumDescriptors;
         }
-        else
-            HashCode = Utility::HashState( &RootParam, 1, HashCode );
     }
 
-    ID3D12RootSignature** RSRef = nullptr;
-    bool firstCompile = false;
+    m_Signature = s_RootSignatureHashMap.GetOrCreate(HashCode, [&]( void )
     {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_RootSignatureHashMap.find(HashCode);
+        ComPtr<ID3D12RootSignature> Signature;
 
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_RootSignatureHashMap.end())
+        // A previous run may already have serialized this signature
+        const void* CachedBlob = nullptr;
+        size_t CachedBlobSize = 0;
+        if (PipelineCache::Find(HashCode, CachedBlob, CachedBlobSize) &&
+            FAILED(g_Device->CreateRootSignature(1, CachedBlob, CachedBlobSize, MY_IID_PPV_ARGS(Signature.ReleaseAndGetAddressOf()))))
         {
-            RSRef = s_RootSignatureHashMap[HashCode].GetAddressOf();
-            firstCompile = true;
+            PipelineCache::Reject(HashCode);
+            Signature = nullptr;
         }
-        else
-            RSRef = iter->second.GetAddressOf();
-    }
 
-    if (firstCompile)
-    {
-        ComPtr<ID3DBlob> pOutBlob, pErrorBlob;
+        if (Signature == nullptr)
+        {
+            ComPtr<ID3DBlob> pOutBlob, pErrorBlob;
 
-        ASSERT_SUCCEEDED( D3D12SerializeRootSignature(&RootDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-            pOutBlob.GetAddressOf(), pErrorBlob.GetAddressOf()));
+            ASSERT_SUCCEEDED( D3D12SerializeRootSignature(&RootDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+                pOutBlob.GetAddressOf(), pErrorBlob.GetAddressOf()));
 
-        ASSERT_SUCCEEDED( g_Device->CreateRootSignature(1, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(),
-            MY_IID_PPV_ARGS(&m_Signature)) );
+            ASSERT_SUCCEEDED( g_Device->CreateRootSignature(1, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(),
+                MY_IID_PPV_ARGS(Signature.ReleaseAndGetAddressOf())) );
 
-        m_Signature->SetName(name.c_str());
+            PipelineCache::Store(HashCode, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize());
+        }
 
-        s_RootSignatureHashMap[HashCode].Attach(m_Signature);
-        ASSERT(*RSRef == m_Signature);
-    }
-    else
-    {
-        while (*RSRef == nullptr)
-            this_thread::yield();
-        m_Signature = *RSRef;
-    }
+        Signature->SetName(name.c_str());
+        return Signature;
+    }).Get();
 
     m_Finalized = TRUE;
 }
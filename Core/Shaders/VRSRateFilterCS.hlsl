@@ -0,0 +1,131 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Temporal hysteresis and dilation of the shading rate image.  VRSRateFilter.cpp holds the CPU
+// reference, which must stay in step with this file.
+//
+// The history texture keeps, per tile, the held rate in bits 0-7, the rate being waited on in
+// bits 8-15, and the number of frames it has been requested above that.  Pass 0 advances the
+// history by one frame.  Pass 1 dilates the held rates into the shading rate image; without
+// dilation pass 0 writes the held rates itself and pass 1 is skipped.
+
+#include "VRSCommon.hlsli"
+
+#define VRS_RootSig \
+    "RootFlags(0), " \
+    "RootConstants(b0, num32BitConstants=7), " \
+    "DescriptorTable(UAV(u0, numDescriptors = 2))"
+
+RWTexture2D<uint> FilterHistory : register(u1);
+
+cbuffer CB0 : register(b0)
+{
+    uint2 TileCount;
+    uint RefineFrames;
+    uint CoarsenFrames;
+    uint DilationRadius;
+    uint DilationPass;
+    uint ResetHistory;
+}
+
+uint FinestRate(uint a, uint b)
+{
+    return D3D12_MAKE_COARSE_SHADING_RATE(
+        min(D3D12_GET_COARSE_SHADING_RATE_X_AXIS(a), D3D12_GET_COARSE_SHADING_RATE_X_AXIS(b)),
+        min(D3D12_GET_COARSE_SHADING_RATE_Y_AXIS(a), D3D12_GET_COARSE_SHADING_RATE_Y_AXIS(b)));
+}
+
+bool IsFinerRate(uint a, uint b)
+{
+    return D3D12_GET_COARSE_SHADING_RATE_X_AXIS(a) < D3D12_GET_COARSE_SHADING_RATE_X_AXIS(b) ||
+           D3D12_GET_COARSE_SHADING_RATE_Y_AXIS(a) < D3D12_GET_COARSE_SHADING_RATE_Y_AXIS(b);
+}
+
+uint ResetState(uint rate)
+{
+    return rate | rate << 8;
+}
+
+// Requests that keep pointing the same way from the held rate count towards one switch, to the
+// finest rate requested along the way
+uint StepRateFilter(uint state, uint rate)
+{
+    uint held = state & 0xFF;
+    uint pending = (state >> 8) & 0xFF;
+    uint count = state >> 16;
+
+    if (rate == held)
+        return ResetState(held);
+
+    bool refine = IsFinerRate(rate, held);
+    if (count > 0 && refine == IsFinerRate(pending, held))
+    {
+        pending = FinestRate(pending, rate);
+    }
+    else
+    {
+        pending = refine ? FinestRate(held, rate) : rate;
+        count = 0;
+    }
+
+    count++;
+    if (count >= (refine ? RefineFrames : CoarsenFrames))
+        return ResetState(pending);
+
+    return held | pending << 8 | count << 16;
+}
+
+[RootSignature(VRS_RootSig)]
+[numthreads(8, 8, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    if (any(DTid.xy >= TileCount))
+        return;
+
+    int2 C = DTid.xy;
+
+    if (DilationPass)
+    {
+        int2 Lo = max(C - (int)DilationRadius, 0);
+        int2 Hi = min(C + (int)DilationRadius, (int2)TileCount - 1);
+
+        uint rate = FilterHistory[C] & 0xFF;
+        for (int y = Lo.y; y <= Hi.y; ++y)
+        {
+            for (int x = Lo.x; x <= Hi.x; ++x)
+            {
+                rate = FinestRate(rate, FilterHistory[int2(x, y)] & 0xFF);
+            }
+        }
+        SetShadingRate(C, rate);
+    }
+    else
+    {
+        uint rate = GetShadingRate(C);
+        uint state = ResetHistory ? ResetState(rate) : StepRateFilter(FilterHistory[C], rate);
+        FilterHistory[C] = state;
+
+        if (DilationRadius == 0)
+        {
+            SetShadingRate(C, state & 0xFF);
+        }
+    }
+}
@@ -21,6 +21,7 @@
 #include "PipelineState.h"
 #include "RootSignature.h"
 #include "BufferManager.h"
+#include "FrameAllocator.h"
 #include "CompiledShaders/TextVS.h"
 #include "CompiledShaders/TextAntialiasPS.h"
 #include "CompiledShaders/TextShadowPS.h"
@@ -29,7 +30,6 @@
 #include <string>
 #include <cstdio>
 #include <memory>
-#include <malloc.h>
 
 using namespace Graphics;
 using namespace Math;
@@ -488,38 +488,30 @@ UINT TextContext::FillVertexBuffer( TextVert volatile* verts, const char* str, s
     return charsDrawn;
 }
 
-void TextContext::DrawString( const std::wstring& str )
+// The vertices are staged in frame memory rather than with _malloca, which goes to the heap for
+// any string longer than 63 characters.
+void TextContext::DrawCharacters( const char* str, size_t stride, size_t slen )
 {
     SetRenderState();
 
-    void* stackMem = _malloca((str.size() + 1) * 16);
-    TextVert* vbPtr = Math::AlignUp((TextVert*)stackMem, 16);
-    UINT primCount = FillVertexBuffer(vbPtr, (char*)str.c_str(), 2, str.size());
+    TextVert* vbPtr = FrameAllocator::Allocate<TextVert>(slen + 1);
+    UINT primCount = FillVertexBuffer(vbPtr, str, stride, slen);
 
     if (primCount > 0)
     {
         m_Context.SetDynamicVB(0, primCount, sizeof(TextVert), vbPtr);
         m_Context.DrawInstanced( 4, primCount );
     }
+}
 
-    _freea(stackMem);
+void TextContext::DrawString( const std::wstring& str )
+{
+    DrawCharacters((const char*)str.c_str(), 2, str.size());
 }
 
 void TextContext::DrawString( const std::string& str )
 {
-    SetRenderState();
-
-    void* stackMem = _malloca((str.size() + 1) * 16);
-    TextVert* vbPtr = Math::AlignUp((TextVert*)stackMem, 16);
-    UINT primCount = FillVertexBuffer(vbPtr, (char*)str.c_str(), 1, str.size());
-
-    if (primCount > 0)
-    {
-        m_Context.SetDynamicVB(0, primCount, sizeof(TextVert), vbPtr);
-        m_Context.DrawInstanced( 4, primCount );
-    }
-
-    _freea(stackMem);
+    DrawCharacters(str.c_str(), 1, str.size());
 }
 
 void TextContext::DrawFormattedString( const wchar_t* format, ... )
@@ -527,9 +519,9 @@ void TextContext::DrawFormattedString( const wchar_t* format, ... )
     wchar_t buffer[256];
     va_list ap;
     va_start(ap, format);
-    vswprintf( buffer, 256, format, ap );
+    int length = vswprintf( buffer, 256, format, ap );
     va_end(ap);
-    DrawString( wstring(buffer) );
+    DrawCharacters((const char*)buffer, 2, length < 0 ? wcslen(buffer) : (size_t)length);
 }
 
 void TextContext::DrawFormattedString( const char* format, ... )
@@ -537,7 +529,7 @@ void TextContext::DrawFormattedString( const char* format, ... )
     char buffer[256];
     va_list ap;
     va_start(ap, format);
-    vsprintf_s( buffer, 256, format, ap );
+    int length = vsprintf_s( buffer, 256, format, ap );
     va_end(ap);
-    DrawString( string(buffer) );
+    DrawCharacters(buffer, 1, length < 0 ? strlen(buffer) : (size_t)length);
 }
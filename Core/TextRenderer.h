@@ -128,6 +128,7 @@ private:
     };
 
     UINT FillVertexBuffer( TextVert volatile* verts, const char* str, size_t stride, size_t slen );
+    void DrawCharacters( const char* str, size_t stride, size_t slen );
     void DrawStringInternal( const std::string& str );
     void DrawStringInternal( const std::wstring& str );
 
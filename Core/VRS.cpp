@@ -20,6 +20,9 @@
 
 #include "pch.h"
 #include "VRS.h"
+#include "VRSContrastAdaptiveCPU.h"
+#include "VRSShadingRateStats.h"
+#include "VRSRateFilter.h"
 #include "Display.h"
 #include "Camera.h"
 #include "GraphicsCore.h"
@@ -32,6 +35,8 @@
 #include "DepthOfField.h"
 #include "GpuResource.h"
 
+#include <fstream>
+
 #include "CompiledShaders/VRSScreenSpace_RGB_CS.h"
 #include "CompiledShaders/VRSScreenSpace_RGB2_CS.h"
 
@@ -51,6 +56,7 @@
 #include "CompiledShaders/VRSContrastAdaptive16x16_RGB2_CS.h"
 
 #include "CompiledShaders/VRSPostSingleEliminationCS.h"
+#include "CompiledShaders/VRSRateFilterCS.h"
 
 using namespace Graphics;
 
@@ -58,9 +64,34 @@ namespace VRS
 {
     D3D12_QUERY_DATA_PIPELINE_STATISTICS PipelineStatistics;
     ShadingRatePercents Percents;
-    ReadbackBuffer VRSReadbackBuffer;
     BoolVar CalculatePercents("VRS/VRS Debug/Calculate %s", true);
 
+    ShadingRateStats RateStats;
+    ShadingRateHistory RateHistory;
+    IntVar RateStatsGridX("VRS/VRS Debug/Stats Grid X", 2, 1, 16);
+    IntVar RateStatsGridY("VRS/VRS Debug/Stats Grid Y", 2, 1, 16);
+    BoolVar ExportRateStats("VRS/VRS Debug/Export Stats CSV", false);
+
+    // Shading rate image copies in flight.  Statistics trail the screen by a frame or two instead
+    // of stalling on the copy.
+    struct RateReadback
+    {
+        ReadbackBuffer Buffer;
+        uint64_t Fence = 0;
+        uint32_t RowPitch = 0;
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        bool Pending = false;
+    };
+    const uint32_t kNumRateReadbacks = 3;
+    RateReadback RateReadbacks[kNumRateReadbacks];
+    uint32_t NextRateReadback = 0;
+    uint64_t RateStatsFrame = 0;
+    std::ofstream RateStatsFile;
+
+    void ProcessRateReadback(RateReadback& readback);
+    void ExportShadingRateStats(void);
+
     const char* VRSLabels[] = { "1X1", "1X2", "2X1", "2X2", "2X4", "4X2", "4X4" };
     const char* combiners[] = { "Passthrough", "Override", "Min", "Max", "Sum" };
     const char* modes[] = { "Quadrant (CPU)", "Checkerboard (CPU)", "Foveated (GPU)", "Depth LOD (GPU)", "Depth DoF (GPU)", "Compute Test (GPU)", "Contrast Adaptive (GPU)" };
@@ -73,6 +104,7 @@ namespace VRS
     RootSignature PostProcess_RootSig;
     RootSignature ComputeTest_RootSig;
     RootSignature ContrastAdaptive_RootSig;
+    RootSignature RateFilter_RootSig;
 
     ComputePSO VRSDepthCS(L"VRS: Depth");
     ComputePSO VRSDebugScreenSpaceCS(L"VRS: Debug Screen Space");
@@ -80,6 +112,7 @@ namespace VRS
     ComputePSO VRSPostSingleEliminationCS(L"VRS: Post Process (Single Elim.)");
     ComputePSO VRSComputeTestCS(L"VRS: Compute Test");
     ComputePSO VRSContrastAdaptiveCS(L"VRS: Contrast Adaptive");
+    ComputePSO VRSRateFilterCS(L"VRS: Rate Filter");
 
     D3D12_VARIABLE_SHADING_RATE_TIER ShadingRateTier = {};
     UINT ShadingRateTileSize = 16;
@@ -126,6 +159,20 @@ namespace VRS
     NumVar ContrastAdaptiveWeberFechnerConstant("VRS/VRS Contrast Adaptive/Weber-Fechner Constant", 1.0f, 0.0f, 10.0f, 0.01f);
     BoolVar ContrastAdaptiveUseWeberFechner("VRS/VRS Contrast Adaptive/Use Weber-Fechner", false);
     BoolVar ContrastAdaptiveUseMotionVectors("VRS/VRS Contrast Adaptive/Use Motion Vectors", false);
+    BoolVar ContrastAdaptiveValidateCPU("VRS/VRS Contrast Adaptive/Validate Against CPU", false);
+    BoolVar ContrastAdaptiveSweepCPU("VRS/VRS Contrast Adaptive/CPU Parameter Sweep", false);
+
+    BoolVar RateFilterEnable("VRS/VRS Rate Filter/Enable", false);
+    IntVar RateFilterRefineFrames("VRS/VRS Rate Filter/Refine Frames", 1, 1, 60);
+    IntVar RateFilterCoarsenFrames("VRS/VRS Rate Filter/Coarsen Frames", 4, 1, 60);
+    IntVar RateFilterDilationRadius("VRS/VRS Rate Filter/Dilation Radius", 0, 0, 4);
+    BoolVar RateFilterValidateCPU("VRS/VRS Rate Filter/Validate Against CPU", false);
+
+    // Per tile filter state, and the frame it was last advanced so that a gap restarts it
+    ColorBuffer RateFilterStateBuffer;
+    uint64_t RateFilterLastFrame = 0;
+
+    void ApplyRateFilter(ComputeContext& Context);
 }
 
 void VRS::ParseCommandLine()
@@ -232,6 +279,11 @@ void VRS::Initialize()
     ContrastAdaptive_RootSig[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 3);
     ContrastAdaptive_RootSig.Finalize(L"ContrastAdaptive_VRS");
 
+    RateFilter_RootSig.Reset(2, 0);
+    RateFilter_RootSig[0].InitAsConstants(0, 7);
+    RateFilter_RootSig[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 2);
+    RateFilter_RootSig.Finalize(L"RateFilter_VRS");
+
 #define CreatePSO( ObjName, ShaderByteCode ) \
     ObjName.SetRootSignature(Debug_RootSig); \
     ObjName.SetComputeShader(ShaderByteCode, sizeof(ShaderByteCode) ); \
@@ -333,8 +385,15 @@ void VRS::Initialize()
     CreatePSO(VRSPostSingleEliminationCS, g_pVRSPostSingleEliminationCS);
 #undef CreatePSO
 
+#define CreatePSO( ObjName, ShaderByteCode ) \
+    ObjName.SetRootSignature(RateFilter_RootSig); \
+    ObjName.SetComputeShader(ShaderByteCode, sizeof(ShaderByteCode) ); \
+    ObjName.Finalize();
+
+    CreatePSO(VRSRateFilterCS, g_pVRSRateFilterCS);
+#undef CreatePSO
+
     g_VRSTier2Buffer.SetClearColor(Color(D3D12_SHADING_RATE_1X1));
-    VRSReadbackBuffer.Create(L"VRS Readback", g_VRSTier2Buffer.GetWidth() * g_VRSTier2Buffer.GetHeight(), sizeof(uint8_t));
 }
 
 void VRS::CheckHardwareSupport()
@@ -567,7 +626,13 @@ D3D12_SHADING_RATE VRS::GetCurrentTier1ShadingRate(EnumVar shadingRate)
 }
 
 void VRS::Shutdown(void) {
-    VRSReadbackBuffer.Destroy();
+    for (RateReadback& readback : RateReadbacks)
+    {
+        readback.Buffer.Destroy();
+        readback.Pending = false;
+    }
+    RateStatsFile.close();
+    RateFilterStateBuffer.Destroy();
 }
 
 bool VRS::IsVRSSupported() {
@@ -702,6 +767,10 @@ void VRS::Update()
     static float prevCenterY = 0.0f;
     static bool wasTrackMouse = false;
 
+    // Compare or sweep a frame captured by the contrast adaptive pass
+    ProcessContrastAdaptiveFrame();
+    ProcessRateFilterFrame();
+
     if (IsVRSTierSupported(D3D12_VARIABLE_SHADING_RATE_TIER_2))
     {
         VRS::ShadingMode mode = (VRS::ShadingMode)((int32_t)VRS::ShadingModes);
@@ -886,6 +955,18 @@ void VRS::Render(ComputeContext& Context)
             Context.SetPipelineState(VRSContrastAdaptiveCS);
             Context.Dispatch((UINT)ceil((float)Target.GetWidth() / (float)ShadingRateTileSize),
                              (UINT)ceil((float)Target.GetHeight() / (float)ShadingRateTileSize));
+
+            // Grab this frame's inputs and rates before anything else touches them
+            if ((bool)ContrastAdaptiveValidateCPU || (bool)ContrastAdaptiveSweepCPU || IsContrastAdaptiveFrameSavePending())
+            {
+                CaptureContrastAdaptiveFrame(Context, Target, g_VelocityBuffer, g_VRSTier2Buffer,
+                    ContrastAdaptiveValidateCPU, ContrastAdaptiveSweepCPU);
+                ContrastAdaptiveValidateCPU = false;
+                ContrastAdaptiveSweepCPU = false;
+            }
+
+            if ((bool)RateFilterEnable)
+                ApplyRateFilter(Context);
         }
 
         if ((bool)MaskPostProcessSingleVN || (bool)MaskPostProcessSingleM)
@@ -934,69 +1015,151 @@ void VRS::Render(ComputeContext& Context)
 
 void VRS::CalculateShadingRatePercentages(CommandContext& Context)
 {
-    uint8_t* vrsreadbackptr = nullptr;
-    uint32_t vrsRowPitchInBytes = 0;
+    if (!(bool)VRS::Enable)
+    {
+        Context.Finish();
+        Percents = ShadingRatePercents();
+        Percents.num1x1 = 100;
+        return;
+    }
 
-    int vrsHeight = g_VRSTier2Buffer.GetHeight();
-    int vrsWidth = g_VRSTier2Buffer.GetWidth();
+    // Only reuse a readback once its copy has landed
+    RateReadback& readback = RateReadbacks[NextRateReadback];
+    if (readback.Pending)
+    {
+        g_CommandManager.WaitForFence(readback.Fence);
+        ProcessRateReadback(readback);
+    }
 
-    vrsRowPitchInBytes = Context.ReadbackTexture(VRSReadbackBuffer, g_VRSTier2Buffer);
+    readback.RowPitch = Context.ReadbackTexture(readback.Buffer, g_VRSTier2Buffer);
     Context.TransitionResource(g_VRSTier2Buffer, D3D12_RESOURCE_STATE_SHADING_RATE_SOURCE, true);
-    Context.Finish(true);
-    
-    Percents.num1x1 = 0;
-    Percents.num1x2 = 0;
-    Percents.num2x1 = 0;
-    Percents.num2x2 = 0;
-    Percents.num2x4 = 0;
-    Percents.num4x2 = 0;
-    Percents.num4x4 = 0;
+    readback.Width = g_VRSTier2Buffer.GetWidth();
+    readback.Height = g_VRSTier2Buffer.GetHeight();
+    readback.Fence = Context.Finish();
+    readback.Pending = true;
+    NextRateReadback = (NextRateReadback + 1) % kNumRateReadbacks;
+
+    // Oldest first so that the history stays in frame order
+    for (uint32_t i = 0; i < kNumRateReadbacks; ++i)
+    {
+        RateReadback& completed = RateReadbacks[(NextRateReadback + i) % kNumRateReadbacks];
+        if (!completed.Pending)
+            continue;
+        if (!g_CommandManager.IsFenceComplete(completed.Fence))
+            break;
+        ProcessRateReadback(completed);
+    }
 
-    if (!(bool)VRS::Enable)
+    if (!ExportRateStats && RateStatsFile.is_open())
+        RateStatsFile.close();
+}
+
+void VRS::ProcessRateReadback(RateReadback& readback)
+{
+    const uint8_t* rates = (const uint8_t*)readback.Buffer.Map();
+    ComputeShadingRateStats(rates, readback.Width, readback.Height, readback.RowPitch,
+        (uint32_t)(int32_t)RateStatsGridX, (uint32_t)(int32_t)RateStatsGridY, RateStats);
+    readback.Buffer.Unmap();
+    readback.Pending = false;
+
+    const float scale = RateStats.NumTiles > 0 ? 100.0f / RateStats.NumTiles : 0.0f;
+    const uint32_t* counts = RateStats.Total.Counts;
+    Percents.num1x1 = counts[OneXOne] * scale;
+    Percents.num1x2 = counts[OneXTwo] * scale;
+    Percents.num2x1 = counts[TwoXOne] * scale;
+    Percents.num2x2 = counts[TwoXTwo] * scale;
+    Percents.num2x4 = counts[TwoXFour] * scale;
+    Percents.num4x2 = counts[FourXTwo] * scale;
+    Percents.num4x4 = counts[FourXFour] * scale;
+
+    RateHistory.Push(RateStats.Total);
+
+    if (ExportRateStats)
+        ExportShadingRateStats();
+    ++RateStatsFrame;
+}
+
+void VRS::ExportShadingRateStats(void)
+{
+    if (!RateStatsFile.is_open())
     {
-        Percents.num1x1 = 100;
-        return;
+        RateStatsFile.open("VRSShadingRateStats.csv");
+        RateStatsFile << "Frame,Region,Tiles,1x1,1x2,2x1,2x2,2x4,4x2,4x4,Work" << std::endl;
     }
 
-    vrsreadbackptr = (uint8_t*)VRSReadbackBuffer.Map();
+    // The whole screen, then each grid cell by column and row
+    for (uint32_t cell = 0; cell <= RateStats.Cells.size(); ++cell)
+    {
+        const ShadingRateCounts& counts = cell == 0 ? RateStats.Total : RateStats.Cells[cell - 1];
+
+        uint32_t numTiles = 0;
+        for (uint32_t r = 0; r < 7; ++r)
+            numTiles += counts.Counts[r];
+        const float scale = numTiles > 0 ? 100.0f / numTiles : 0.0f;
 
-    int totalPixels = vrsHeight * vrsWidth;
-    for (int yy = 0; yy < vrsHeight; yy++)
+        RateStatsFile << RateStatsFrame << ",";
+        if (cell == 0)
+            RateStatsFile << "All";
+        else
+            RateStatsFile << "Cell " << (cell - 1) % RateStats.GridX << " " << (cell - 1) / RateStats.GridX;
+        RateStatsFile << "," << numTiles;
+        for (uint32_t r = 0; r < 7; ++r)
+            RateStatsFile << "," << counts.Counts[r] * scale;
+        RateStatsFile << "," << GetShadingWork(counts) * 100.0f << "\n";
+    }
+}
+
+void VRS::ApplyRateFilter(ComputeContext& Context)
+{
+    ScopedTimer _prof(L"VRS Rate Filter", Context);
+
+    const uint32_t tilesX = g_VRSTier2Buffer.GetWidth();
+    const uint32_t tilesY = g_VRSTier2Buffer.GetHeight();
+
+    // Start over from this frame's rates after a resize or any frame the filter skipped
+    bool reset = RateFilterLastFrame + 1 != Graphics::GetFrameCount();
+    if (RateFilterStateBuffer.GetResource() == nullptr || RateFilterStateBuffer.GetWidth() != tilesX || RateFilterStateBuffer.GetHeight() != tilesY)
     {
-        for (int xx = 0; xx < vrsWidth; xx++)
-        {
-            uint8_t currentPixel = vrsreadbackptr[yy * vrsRowPitchInBytes + xx];
-            switch (currentPixel)
-            {
-            case D3D12_SHADING_RATE_1X1:
-                Percents.num1x1++;
-                break;
-            case D3D12_SHADING_RATE_1X2:
-                Percents.num1x2++;
-                break;
-            case D3D12_SHADING_RATE_2X1:
-                Percents.num2x1++;
-                break;
-            case D3D12_SHADING_RATE_2X2:
-                Percents.num2x2++;
-                break;
-            case D3D12_SHADING_RATE_2X4:
-                Percents.num2x4++;
-                break;
-            case D3D12_SHADING_RATE_4X2:
-                Percents.num4x2++;
-                break;
-            case D3D12_SHADING_RATE_4X4:
-                Percents.num4x4++;
-            }
-        }
+        RateFilterStateBuffer.Create(L"VRS Rate Filter History", tilesX, tilesY, 1, DXGI_FORMAT_R32_UINT);
+        reset = true;
     }
-    Percents.num1x1 = ((float)Percents.num1x1 / (float)totalPixels) * 100.0f;
-    Percents.num1x2 = ((float)Percents.num1x2 / (float)totalPixels) * 100.0f;
-    Percents.num2x1 = ((float)Percents.num2x1 / (float)totalPixels) * 100.0f;
-    Percents.num2x2 = ((float)Percents.num2x2 / (float)totalPixels) * 100.0f;
-    Percents.num2x4 = ((float)Percents.num2x4 / (float)totalPixels) * 100.0f;
-    Percents.num4x2 = ((float)Percents.num4x2 / (float)totalPixels) * 100.0f;
-    Percents.num4x4 = ((float)Percents.num4x4 / (float)totalPixels) * 100.0f;
-    VRSReadbackBuffer.Unmap();
-}
\ No newline at end of file
+    RateFilterLastFrame = Graphics::GetFrameCount();
+
+    const bool validate = (bool)RateFilterValidateCPU;
+    RateFilterValidateCPU = false;
+    if (validate)
+        CaptureRateFilterInput(Context, g_VRSTier2Buffer, RateFilterStateBuffer, reset);
+
+    const RateFilterSettings settings = GetRateFilterSettings();
+
+    D3D12_CPU_DESCRIPTOR_HANDLE Pass1UAVs[] =
+    {
+        g_VRSTier2Buffer.GetUAV(),
+        RateFilterStateBuffer.GetUAV(),
+    };
+
+    Context.SetRootSignature(RateFilter_RootSig);
+    Context.SetConstant(0, 0, tilesX);
+    Context.SetConstant(0, 1, tilesY);
+    Context.SetConstant(0, 2, std::max(settings.RefineFrames, 1u));
+    Context.SetConstant(0, 3, std::max(settings.CoarsenFrames, 1u));
+    Context.SetConstant(0, 4, settings.DilationRadius);
+    Context.SetConstant(0, 5, 0u);
+    Context.SetConstant(0, 6, (UINT)reset);
+    Context.SetDynamicDescriptors(1, 0, _countof(Pass1UAVs), Pass1UAVs);
+    Context.TransitionResource(g_VRSTier2Buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    Context.TransitionResource(RateFilterStateBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+    Context.SetPipelineState(VRSRateFilterCS);
+    Context.Dispatch2D(tilesX, tilesY);
+
+    // Dilation reads the neighbours' held rates, so it waits for the whole history
+    if (settings.DilationRadius > 0)
+    {
+        Context.InsertUAVBarrier(RateFilterStateBuffer);
+        Context.SetConstant(0, 5, 1u);
+        Context.Dispatch2D(tilesX, tilesY);
+    }
+
+    if (validate)
+        CaptureRateFilterOutput(Context, g_VRSTier2Buffer, RateFilterStateBuffer);
+}
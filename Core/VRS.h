@@ -20,8 +20,11 @@
 
 #pragma once
 
+#include "VRSShadingRateStats.h"
+
 class ColorBuffer;
 class BoolVar;
+class IntVar;
 class NumVar;
 class NumVar;
 class ComputeContext;
@@ -50,6 +53,11 @@ namespace VRS
     extern BoolVar ContrastAdaptiveUseWeberFechner;
     extern BoolVar ContrastAdaptiveUseMotionVectors;
 
+    extern BoolVar RateFilterEnable;
+    extern IntVar RateFilterRefineFrames;
+    extern IntVar RateFilterCoarsenFrames;
+    extern IntVar RateFilterDilationRadius;
+
     extern D3D12_VARIABLE_SHADING_RATE_TIER ShadingRateTier;
     extern UINT ShadingRateTileSize;
     extern BOOL ShadingRateAdditionalShadingRatesSupported;
@@ -67,6 +75,13 @@ namespace VRS
     };
     extern ShadingRatePercents Percents;
 
+    // Rebuilt from each shading rate readback once it lands, a frame or two behind the screen
+    extern ShadingRateStats RateStats;
+    extern ShadingRateHistory RateHistory;
+    extern IntVar RateStatsGridX;
+    extern IntVar RateStatsGridY;
+    extern BoolVar ExportRateStats;
+
     enum ShadingRates
     {
         OneXOne, 
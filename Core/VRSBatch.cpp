@@ -0,0 +1,677 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pch.h"
+#include "VRSBatch.h"
+#include "ImageMetrics.h"
+#include "SystemTime.h"
+
+#include <DirectXPackedVector.h>
+#include <ppl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+using namespace VRSBatch;
+
+namespace
+{
+    const char kSettingPrefix[] = "VRS/VRS Contrast Adaptive/";
+    const char kFilterSettingPrefix[] = "VRS/VRS Rate Filter/";
+
+    struct FrameHeader
+    {
+        char Magic[4];
+        uint32_t Version;
+        uint32_t Width;
+        uint32_t Height;
+    };
+
+    const char kFrameMagic[4] = { 'V', 'R', 'S', 'F' };
+    const uint32_t kFrameVersion = 1;
+
+    std::string Trim( const std::string& s )
+    {
+        const size_t first = s.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return std::string();
+        return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+    }
+
+    std::vector<std::string> SplitFields( const std::string& line )
+    {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        while (true)
+        {
+            const size_t end = line.find(',', start);
+            fields.push_back(Trim(line.substr(start, end == std::string::npos ? std::string::npos : end - start)));
+            if (end == std::string::npos)
+                break;
+            start = end + 1;
+        }
+        return fields;
+    }
+
+    bool ParseFloat( const std::string& s, float& value )
+    {
+        char* end = nullptr;
+        value = strtof(s.c_str(), &end);
+        return !s.empty() && *end == '\0';
+    }
+
+    bool ParseUint( const std::string& s, uint32_t minValue, uint32_t maxValue, uint32_t& value )
+    {
+        char* end = nullptr;
+        const long parsed = strtol(s.c_str(), &end, 10);
+        if (s.empty() || *end != '\0' || parsed < (long)minValue || parsed > (long)maxValue)
+            return false;
+        value = (uint32_t)parsed;
+        return true;
+    }
+
+    // Accepts the same affirmations as BoolVar
+    bool ParseBool( const std::string& s, bool& value )
+    {
+        if (_stricmp(s.c_str(), "1") == 0 || _stricmp(s.c_str(), "on") == 0 || _stricmp(s.c_str(), "yes") == 0 || _stricmp(s.c_str(), "true") == 0)
+            value = true;
+        else if (_stricmp(s.c_str(), "0") == 0 || _stricmp(s.c_str(), "off") == 0 || _stricmp(s.c_str(), "no") == 0 || _stricmp(s.c_str(), "false") == 0)
+            value = false;
+        else
+            return false;
+        return true;
+    }
+
+    // The ranges match the EngineTuning variables
+    bool ApplyFilterSetting( VRS::RateFilterSettings& filter, const std::string& leaf, const std::string& value )
+    {
+        if (leaf == "Enable")
+            return ParseBool(value, filter.Enable);
+        if (leaf == "Refine Frames")
+            return ParseUint(value, 1, 60, filter.RefineFrames);
+        if (leaf == "Coarsen Frames")
+            return ParseUint(value, 1, 60, filter.CoarsenFrames);
+        if (leaf == "Dilation Radius")
+            return ParseUint(value, 0, 4, filter.DilationRadius);
+        return false;
+    }
+
+    bool ApplySetting( VRS::ContrastAdaptiveSettings& settings, VRS::RateFilterSettings& filter, const std::string& name, const std::string& value )
+    {
+        if (name == "Tile Size")
+        {
+            float tileSize;
+            if (!ParseFloat(value, tileSize) || (tileSize != 8.0f && tileSize != 16.0f))
+                return false;
+            settings.TileSize = (uint32_t)tileSize;
+            return true;
+        }
+
+        if (name.compare(0, sizeof(kFilterSettingPrefix) - 1, kFilterSettingPrefix) == 0)
+            return ApplyFilterSetting(filter, name.substr(sizeof(kFilterSettingPrefix) - 1), value);
+
+        if (name.compare(0, sizeof(kSettingPrefix) - 1, kSettingPrefix) != 0)
+            return false;
+
+        const std::string leaf = name.substr(sizeof(kSettingPrefix) - 1);
+        if (leaf == "Sensitivity Threshold")
+            return ParseFloat(value, settings.SensitivityThreshold);
+        if (leaf == "Quarter Rate Sensitivity")
+            return ParseFloat(value, settings.K);
+        if (leaf == "Env. Luma")
+            return ParseFloat(value, settings.EnvLuma);
+        if (leaf == "Weber-Fechner Constant")
+            return ParseFloat(value, settings.WeberFechnerConstant);
+        if (leaf == "Use Weber-Fechner")
+            return ParseBool(value, settings.UseWeberFechner);
+        if (leaf == "Use Motion Vectors")
+            return ParseBool(value, settings.UseMotionVectors);
+        return false;
+    }
+
+    // Linear color and velocity length as the CPU pass takes them
+    struct UnpackedFrame
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        std::vector<float> RGB;
+        std::vector<float> Velocity;
+    };
+
+    void UnpackFrame( const CapturedFrame& frame, UnpackedFrame& unpacked )
+    {
+        const uint32_t width = frame.Width;
+        unpacked.Width = width;
+        unpacked.Height = frame.Height;
+        unpacked.RGB.resize((size_t)width * frame.Height * 3);
+        unpacked.Velocity.resize((size_t)width * frame.Height);
+
+        concurrency::parallel_for(0u, frame.Height, [&]( uint32_t y )
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const size_t i = (size_t)y * width + x;
+                DirectX::PackedVector::XMFLOAT3PK packed(frame.Color[i]);
+                DirectX::XMStoreFloat3((DirectX::XMFLOAT3*)&unpacked.RGB[i * 3], DirectX::PackedVector::XMLoadFloat3PK(&packed));
+                unpacked.Velocity[i] = VRS::UnpackVelocityLength(frame.Velocity[i]);
+            }
+        });
+    }
+
+    // The pass runs after tone mapping, so color is linear and displayable.  Encodes to the
+    // nearest 8-bit sRGB value by searching the midpoints between codes.
+    struct SRGBEncoder
+    {
+        SRGBEncoder()
+        {
+            for (int i = 0; i < 255; ++i)
+            {
+                const float c = (i + 0.5f) / 255.0f;
+                Midpoints[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            }
+        }
+
+        uint8_t Encode( float linear ) const
+        {
+            return (uint8_t)(std::upper_bound(Midpoints, Midpoints + 255, linear) - Midpoints);
+        }
+
+        float Midpoints[255];
+    };
+
+    void EncodeImage( const float* rgb, uint32_t width, uint32_t height, const SRGBEncoder& encoder, uint8_t* rgba )
+    {
+        concurrency::parallel_for(0u, height, [&]( uint32_t y )
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const size_t i = (size_t)y * width + x;
+                rgba[i * 4 + 0] = encoder.Encode(rgb[i * 3 + 0]);
+                rgba[i * 4 + 1] = encoder.Encode(rgb[i * 3 + 1]);
+                rgba[i * 4 + 2] = encoder.Encode(rgb[i * 3 + 2]);
+                rgba[i * 4 + 3] = 255;
+            }
+        });
+    }
+
+    // Shades each coarse pixel once, as the average of the pixels it covers, and encodes the result.
+    // Returns the number of coarse pixels, which is the pixel shader invocations the rates cost.
+    uint64_t ShadeCoarse( const UnpackedFrame& frame, const uint8_t* rates, uint32_t tileSize, const SRGBEncoder& encoder, uint8_t* rgba )
+    {
+        const uint32_t width = frame.Width;
+        const uint32_t height = frame.Height;
+        const uint32_t tilesX = (width + tileSize - 1) / tileSize;
+        const uint32_t tilesY = (height + tileSize - 1) / tileSize;
+        const float* rgb = frame.RGB.data();
+
+        std::vector<uint64_t> rowInvocations(tilesY);
+        concurrency::parallel_for(0u, tilesY, [&]( uint32_t ty )
+        {
+            uint64_t invocations = 0;
+            for (uint32_t tx = 0; tx < tilesX; ++tx)
+            {
+                // D3D12_SHADING_RATE packs log2 of the coarse pixel width above log2 of its height
+                const uint8_t rate = rates[ty * tilesX + tx];
+                const uint32_t rateX = 1u << (rate >> 2);
+                const uint32_t rateY = 1u << (rate & 3);
+
+                const uint32_t x0 = tx * tileSize, x1 = std::min(x0 + tileSize, width);
+                const uint32_t y0 = ty * tileSize, y1 = std::min(y0 + tileSize, height);
+
+                for (uint32_t by = y0; by < y1; by += rateY)
+                {
+                    for (uint32_t bx = x0; bx < x1; bx += rateX)
+                    {
+                        const uint32_t ex = std::min(bx + rateX, x1);
+                        const uint32_t ey = std::min(by + rateY, y1);
+
+                        float sum[3] = {};
+                        for (uint32_t y = by; y < ey; ++y)
+                        {
+                            for (uint32_t x = bx; x < ex; ++x)
+                            {
+                                const float* pixel = &rgb[((size_t)y * width + x) * 3];
+                                sum[0] += pixel[0];
+                                sum[1] += pixel[1];
+                                sum[2] += pixel[2];
+                            }
+                        }
+
+                        const float scale = 1.0f / ((ex - bx) * (ey - by));
+                        const uint8_t shaded[4] = { encoder.Encode(sum[0] * scale), encoder.Encode(sum[1] * scale), encoder.Encode(sum[2] * scale), 255 };
+                        for (uint32_t y = by; y < ey; ++y)
+                        {
+                            for (uint32_t x = bx; x < ex; ++x)
+                                memcpy(&rgba[((size_t)y * width + x) * 4], shaded, 4);
+                        }
+                        ++invocations;
+                    }
+                }
+            }
+            rowInvocations[ty] = invocations;
+        });
+
+        uint64_t invocations = 0;
+        for (uint64_t rowCount : rowInvocations)
+            invocations += rowCount;
+        return invocations;
+    }
+
+    bool ParsePose( const std::vector<std::string>& fields, size_t first, Pose& pose )
+    {
+        return ParseFloat(fields[first], pose.Heading) && ParseFloat(fields[first + 1], pose.Pitch) &&
+            ParseFloat(fields[first + 2], pose.Position[0]) && ParseFloat(fields[first + 3], pose.Position[1]) &&
+            ParseFloat(fields[first + 4], pose.Position[2]);
+    }
+
+    struct ExperimentResult
+    {
+        uint32_t NumTiles;
+        VRS::ShadingRateCounts Histogram;
+        uint64_t PSInvocations;
+        uint32_t RateChanges;       // Tiles whose rate differs from the previous frame of the sequence
+        uint32_t RawRateChanges;    // The same before the rate filter
+        ImageMetrics::Report Metrics;
+    };
+
+    // Rate changes are summed over the frames that follow another, and work is a fraction of
+    // full rate shading summed over every frame
+    struct SequenceResult
+    {
+        uint64_t ComparedTiles = 0;
+        uint64_t RateChanges = 0;
+        uint64_t RawRateChanges = 0;
+        double Work = 0.0;
+        double RawWork = 0.0;
+    };
+}
+
+bool VRSBatch::LoadScript(const std::wstring& path, Script& script)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        printf("Unable to open VRS batch script %ws\n", path.c_str());
+        return false;
+    }
+
+    const size_t slash = path.find_last_of(L"\\/");
+    const size_t nameStart = slash == std::wstring::npos ? 0 : slash + 1;
+    script.Directory = path.substr(0, nameStart);
+    const size_t dot = path.find_last_of(L'.');
+    script.BaseName = path.substr(nameStart, dot != std::wstring::npos && dot > nameStart ? dot - nameStart : std::wstring::npos);
+    script.Poses.clear();
+    script.Sequences.clear();
+    script.Experiments.clear();
+
+    VRS::ContrastAdaptiveSettings settings = VRS::GetContrastAdaptiveSettings();
+    VRS::RateFilterSettings filter = VRS::GetRateFilterSettings();
+
+    std::string line;
+    for (uint32_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.resize(comment);
+        if (Trim(line).empty())
+            continue;
+
+        const std::vector<std::string> fields = SplitFields(line);
+        bool valid = false;
+
+        if (fields[0] == "pose" && fields.size() == 7)
+        {
+            Pose pose;
+            pose.Name = fields[1];
+            valid = !pose.Name.empty() && ParsePose(fields, 2, pose);
+            if (valid)
+            {
+                Sequence sequence = { pose.Name, (uint32_t)script.Poses.size(), 1 };
+                script.Sequences.push_back(sequence);
+                script.Poses.push_back(pose);
+            }
+        }
+        else if (fields[0] == "path" && fields.size() == 13)
+        {
+            uint32_t numFrames;
+            Pose start, end;
+            valid = !fields[1].empty() && ParseUint(fields[2], 2, 9999, numFrames) && ParsePose(fields, 3, start) && ParsePose(fields, 8, end);
+            if (valid)
+            {
+                Sequence sequence = { fields[1], (uint32_t)script.Poses.size(), numFrames };
+                script.Sequences.push_back(sequence);
+
+                for (uint32_t f = 0; f < numFrames; ++f)
+                {
+                    const float t = (float)f / (numFrames - 1);
+                    char name[16];
+                    sprintf_s(name, "-%03u", f);
+
+                    Pose pose;
+                    pose.Name = fields[1] + name;
+                    pose.Heading = start.Heading + (end.Heading - start.Heading) * t;
+                    pose.Pitch = start.Pitch + (end.Pitch - start.Pitch) * t;
+                    for (int i = 0; i < 3; ++i)
+                        pose.Position[i] = start.Position[i] + (end.Position[i] - start.Position[i]) * t;
+                    script.Poses.push_back(pose);
+                }
+            }
+        }
+        else if (fields[0] == "set" && fields.size() == 3)
+        {
+            valid = ApplySetting(settings, filter, fields[1], fields[2]);
+        }
+        else if (fields[0] == "experiment" && fields.size() >= 2 && !fields[1].empty())
+        {
+            ExperimentConfig experiment;
+            experiment.Name = fields[1];
+            experiment.Settings = settings;
+            experiment.Filter = filter;
+
+            valid = true;
+            for (size_t i = 2; i < fields.size() && valid; ++i)
+            {
+                const size_t equals = fields[i].find('=');
+                valid = equals != std::string::npos &&
+                    ApplySetting(experiment.Settings, experiment.Filter, Trim(fields[i].substr(0, equals)), Trim(fields[i].substr(equals + 1)));
+            }
+            if (valid)
+                script.Experiments.push_back(experiment);
+        }
+
+        if (!valid)
+        {
+            printf("%ws(%u): unable to parse \"%s\"\n", path.c_str(), lineNumber, line.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::wstring VRSBatch::GetFramePath(const Script& script, const Pose& pose)
+{
+    return script.Directory + script.BaseName + L"-" + Utility::UTF8ToWideString(pose.Name) + L".vrsframe";
+}
+
+bool VRSBatch::SaveFrame(const std::wstring& path, const CapturedFrame& frame)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file)
+        return false;
+
+    FrameHeader header;
+    memcpy(header.Magic, kFrameMagic, sizeof(kFrameMagic));
+    header.Version = kFrameVersion;
+    header.Width = frame.Width;
+    header.Height = frame.Height;
+
+    const std::streamsize imageBytes = (std::streamsize)frame.Width * frame.Height * sizeof(uint32_t);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)frame.Color.data(), imageBytes);
+    file.write((const char*)frame.Velocity.data(), imageBytes);
+    return file.good();
+}
+
+bool VRSBatch::LoadFrame(const std::wstring& path, CapturedFrame& frame)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+        return false;
+
+    FrameHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || memcmp(header.Magic, kFrameMagic, sizeof(kFrameMagic)) != 0 ||
+        header.Version != kFrameVersion)
+    {
+        return false;
+    }
+
+    const size_t numPixels = (size_t)header.Width * header.Height;
+    frame.Width = header.Width;
+    frame.Height = header.Height;
+    frame.Color.resize(numPixels);
+    frame.Velocity.resize(numPixels);
+    file.read((char*)frame.Color.data(), numPixels * sizeof(uint32_t));
+    file.read((char*)frame.Velocity.data(), numPixels * sizeof(uint32_t));
+    return file.good();
+}
+
+bool VRSBatch::Run(const std::wstring& scriptPath)
+{
+    Script script;
+    if (!LoadScript(scriptPath, script))
+        return false;
+
+    const uint32_t numPoses = (uint32_t)script.Poses.size();
+    const uint32_t numSequences = (uint32_t)script.Sequences.size();
+    const uint32_t numExperiments = (uint32_t)script.Experiments.size();
+    printf("VRS batch: %u poses in %u sequences, %u experiments\n", numPoses, numSequences, numExperiments);
+
+    int64_t startTick = SystemTime::GetCurrentTick();
+
+    std::vector<UnpackedFrame> frames(numPoses);
+    for (uint32_t p = 0; p < numPoses; ++p)
+    {
+        CapturedFrame captured;
+        const std::wstring framePath = GetFramePath(script, script.Poses[p]);
+        if (!LoadFrame(framePath, captured))
+        {
+            printf("Unable to load %ws.  Capture it first with -vrs_capture.\n", framePath.c_str());
+            return false;
+        }
+        UnpackFrame(captured, frames[p]);
+    }
+
+    const SRGBEncoder encoder;
+    std::vector<std::vector<uint8_t>> references(numPoses);
+    for (uint32_t p = 0; p < numPoses; ++p)
+    {
+        references[p].resize((size_t)frames[p].Width * frames[p].Height * 4);
+        EncodeImage(frames[p].RGB.data(), frames[p].Width, frames[p].Height, encoder, references[p].data());
+    }
+
+    // Every sequence and experiment pair is independent.  Within one, frames are evaluated in
+    // order so that the rate filter carries its history from frame to frame.
+    std::vector<ExperimentResult> results((size_t)numPoses * numExperiments);
+    std::vector<SequenceResult> sequenceResults((size_t)numSequences * numExperiments);
+    concurrency::parallel_for(0u, (uint32_t)sequenceResults.size(), [&]( uint32_t job )
+    {
+        const Sequence& sequence = script.Sequences[job / numExperiments];
+        const uint32_t e = job % numExperiments;
+        const ExperimentConfig& experiment = script.Experiments[e];
+        const VRS::ContrastAdaptiveSettings& settings = experiment.Settings;
+        SequenceResult& sequenceResult = sequenceResults[job];
+
+        VRS::RateFilterHistory history;
+        std::vector<uint8_t> rawRates, rates, previousRawRates, previousRates;
+        uint32_t previousWidth = 0, previousHeight = 0;
+
+        for (uint32_t p = sequence.FirstPose; p < sequence.FirstPose + sequence.NumPoses; ++p)
+        {
+            const UnpackedFrame& frame = frames[p];
+            ExperimentResult& result = results[(size_t)p * numExperiments + e];
+
+            const uint32_t T = settings.TileSize;
+            const uint32_t tilesX = (frame.Width + T - 1) / T;
+            const uint32_t tilesY = (frame.Height + T - 1) / T;
+            result.NumTiles = tilesX * tilesY;
+            rawRates.resize(result.NumTiles);
+            VRS::ComputeContrastAdaptiveRates(frame.RGB.data(), frame.Velocity.data(), frame.Width, frame.Height, settings, rawRates.data());
+
+            if (experiment.Filter.Enable)
+            {
+                rates.resize(result.NumTiles);
+                VRS::FilterShadingRates(rawRates.data(), tilesX, tilesY, experiment.Filter, history, rates.data());
+            }
+            else
+            {
+                rates = rawRates;
+            }
+
+            VRS::ShadingRateCounts rawHistogram;
+            VRS::CountShadingRates(rawRates.data(), result.NumTiles, rawHistogram.Counts);
+            VRS::CountShadingRates(rates.data(), result.NumTiles, result.Histogram.Counts);
+            sequenceResult.RawWork += VRS::GetShadingWork(rawHistogram);
+            sequenceResult.Work += VRS::GetShadingWork(result.Histogram);
+
+            // A frame of another size starts the sequence over, as it does the filter
+            result.RateChanges = 0;
+            result.RawRateChanges = 0;
+            if (frame.Width == previousWidth && frame.Height == previousHeight)
+            {
+                result.RateChanges = VRS::CountRateChanges(previousRates.data(), rates.data(), result.NumTiles);
+                result.RawRateChanges = VRS::CountRateChanges(previousRawRates.data(), rawRates.data(), result.NumTiles);
+                sequenceResult.RateChanges += result.RateChanges;
+                sequenceResult.RawRateChanges += result.RawRateChanges;
+                sequenceResult.ComparedTiles += result.NumTiles;
+            }
+
+            std::vector<uint8_t> coarse((size_t)frame.Width * frame.Height * 4);
+            result.PSInvocations = ShadeCoarse(frame, rates.data(), T, encoder, coarse.data());
+
+            const std::vector<uint8_t>& reference = references[p];
+            ImageMetrics::Image referenceImage = { reference.data(), frame.Width, frame.Height, frame.Width * 4 };
+            ImageMetrics::Image testImage = { coarse.data(), frame.Width, frame.Height, frame.Width * 4 };
+            ImageMetrics::Compare(referenceImage, testImage, ImageMetrics::Settings(), result.Metrics);
+
+            std::swap(previousRawRates, rawRates);
+            std::swap(previousRates, rates);
+            previousWidth = frame.Width;
+            previousHeight = frame.Height;
+        }
+    });
+
+    const double seconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+    const std::wstring resultsPath = script.Directory + script.BaseName + L"-Results.csv";
+    std::ofstream outfile(resultsPath);
+    if (!outfile)
+    {
+        printf("Unable to write %ws\n", resultsPath.c_str());
+        return false;
+    }
+
+    outfile.precision(9);
+    outfile << "Pose,Experiment,Threshold,K,Env. Luma,Weber-Fechner Constant,Use Weber-Fechner,Use Motion Vectors,Tile Size,"
+            << "Rate Filter,Refine Frames,Coarsen Frames,Dilation Radius,"
+            << "1x1,1x2,2x1,2x2,2x4,4x2,4x4,PSInvocations,PS Savings,Rate Changes,Raw Rate Changes,"
+            << "AE,MAE,MSE,RMSE,PSNR,PAE,NCC,SSIM,DSSIM,FLIP Mean,FLIP Median,FLIP Max" << std::endl;
+
+    printf("  %-16s %-32s %8s %8s %10s\n", "pose", "experiment", "savings", "PSNR", "FLIP mean");
+
+    for (uint32_t job = 0; job < (uint32_t)results.size(); ++job)
+    {
+        const Pose& pose = script.Poses[job / numExperiments];
+        const UnpackedFrame& frame = frames[job / numExperiments];
+        const ExperimentConfig& experiment = script.Experiments[job % numExperiments];
+        const VRS::ContrastAdaptiveSettings& settings = experiment.Settings;
+        const ExperimentResult& result = results[job];
+        const ImageMetrics::Report& metrics = result.Metrics;
+        const double savings = 1.0 - (double)result.PSInvocations / ((double)frame.Width * frame.Height);
+
+        outfile << pose.Name << ","
+            << experiment.Name << ","
+            << settings.SensitivityThreshold << ","
+            << settings.K << ","
+            << settings.EnvLuma << ","
+            << settings.WeberFechnerConstant << ","
+            << settings.UseWeberFechner << ","
+            << settings.UseMotionVectors << ","
+            << settings.TileSize << ","
+            << experiment.Filter.Enable << ","
+            << experiment.Filter.RefineFrames << ","
+            << experiment.Filter.CoarsenFrames << ","
+            << experiment.Filter.DilationRadius;
+        for (uint32_t i = 0; i < 7; ++i)
+            outfile << "," << 100.0 * result.Histogram.Counts[i] / result.NumTiles;
+        outfile << "," << result.PSInvocations << ","
+            << savings << ","
+            << 100.0 * result.RateChanges / result.NumTiles << ","
+            << 100.0 * result.RawRateChanges / result.NumTiles << ","
+            << metrics.AE << ","
+            << metrics.MAE << ","
+            << metrics.MSE << ","
+            << metrics.RMSE << ","
+            << metrics.PSNR << ","
+            << metrics.PAE << ","
+            << metrics.NCC << ","
+            << metrics.SSIM << ","
+            << metrics.DSSIM << ","
+            << metrics.FLIPMean << ","
+            << metrics.FLIPMedian << ","
+            << metrics.FLIPMax << std::endl;
+
+        printf("  %-16s %-32s %7.1f%% %8.2f %10.4f\n", pose.Name.c_str(), experiment.Name.c_str(), savings * 100.0,
+            metrics.PSNR, metrics.FLIPMean);
+    }
+
+    // Stability of each sequence long enough to have any
+    const std::wstring stabilityPath = script.Directory + script.BaseName + L"-Stability.csv";
+    std::ofstream stabilityFile;
+    for (uint32_t job = 0; job < (uint32_t)sequenceResults.size(); ++job)
+    {
+        const Sequence& sequence = script.Sequences[job / numExperiments];
+        const ExperimentConfig& experiment = script.Experiments[job % numExperiments];
+        const SequenceResult& result = sequenceResults[job];
+        if (result.ComparedTiles == 0)
+            continue;
+
+        if (!stabilityFile.is_open())
+        {
+            stabilityFile.open(stabilityPath);
+            if (!stabilityFile)
+            {
+                printf("Unable to write %ws\n", stabilityPath.c_str());
+                return false;
+            }
+
+            stabilityFile.precision(9);
+            stabilityFile << "Sequence,Experiment,Frames,Rate Filter,Refine Frames,Coarsen Frames,Dilation Radius,"
+                << "Changes Per Tile Per Frame,Raw Changes Per Tile Per Frame,Shading Savings,Raw Shading Savings" << std::endl;
+
+            printf("  %-16s %-32s %21s %17s\n", "sequence", "experiment", "changes/tile/frame", "savings");
+        }
+
+        const double changes = (double)result.RateChanges / result.ComparedTiles;
+        const double rawChanges = (double)result.RawRateChanges / result.ComparedTiles;
+        const double savings = 1.0 - result.Work / sequence.NumPoses;
+        const double rawSavings = 1.0 - result.RawWork / sequence.NumPoses;
+
+        stabilityFile << sequence.Name << ","
+            << experiment.Name << ","
+            << sequence.NumPoses << ","
+            << experiment.Filter.Enable << ","
+            << experiment.Filter.RefineFrames << ","
+            << experiment.Filter.CoarsenFrames << ","
+            << experiment.Filter.DilationRadius << ","
+            << changes << ","
+            << rawChanges << ","
+            << savings << ","
+            << rawSavings << std::endl;
+
+        printf("  %-16s %-32s %.4f (raw %.4f) %6.1f%% (raw %5.1f%%)\n", sequence.Name.c_str(), experiment.Name.c_str(),
+            changes, rawChanges, savings * 100.0, rawSavings * 100.0);
+    }
+
+    printf("VRS batch finished in %.2f s, results in %ws\n", seconds, resultsPath.c_str());
+    return true;
+}
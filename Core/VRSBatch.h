@@ -0,0 +1,109 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "VRSContrastAdaptiveCPU.h"
+#include "VRSRateFilter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Offline contrast adaptive experiments.  A script lists camera poses and shading rate settings.
+// An interactive session (-vrs_capture <script>) flies to every pose and saves the contrast
+// adaptive pass's inputs next to the script.  A batch run (-vrs_batch <script>) then evaluates every
+// experiment on every captured frame with the CPU pass, without creating a window or device.
+//
+// Scripts are comma separated, one record per line; '#' starts a comment:
+//
+//   pose, <name>, <heading>, <pitch>, <x>, <y>, <z>
+//   path, <name>, <frames>, <heading>, <pitch>, <x>, <y>, <z>, <heading>, <pitch>, <x>, <y>, <z>
+//   set, <setting>, <value>
+//   experiment, <name>[, <setting>=<value>...]
+//
+// A path is a camera move captured as a sequence of poses, <name>-000 onwards, interpolated
+// from the first pose to the second.  Sequences are evaluated in frame order, so that the rate
+// filter carries its history from frame to frame and rate changes can be counted.
+//
+// Settings are named by their EngineTuning path, e.g. "VRS/VRS Contrast Adaptive/Sensitivity
+// Threshold" or "VRS/VRS Rate Filter/Coarsen Frames", plus "Tile Size".  set applies to every
+// later experiment; overrides on an experiment line apply to that experiment only.
+
+namespace VRSBatch
+{
+    struct Pose
+    {
+        std::string Name;
+        float Heading;
+        float Pitch;
+        float Position[3];
+    };
+
+    // Consecutive poses evaluated in order.  A lone pose is a sequence of one.
+    struct Sequence
+    {
+        std::string Name;
+        uint32_t FirstPose;
+        uint32_t NumPoses;
+    };
+
+    struct ExperimentConfig
+    {
+        std::string Name;
+        VRS::ContrastAdaptiveSettings Settings;
+        VRS::RateFilterSettings Filter;
+    };
+
+    struct Script
+    {
+        std::wstring Directory;     // Where frames and results are written, with a trailing slash
+        std::wstring BaseName;      // The script's file name without extension
+        std::vector<Pose> Poses;
+        std::vector<Sequence> Sequences;
+        std::vector<ExperimentConfig> Experiments;
+    };
+
+    // Prints the offending line and returns false on a syntax error or unknown setting
+    bool LoadScript(const std::wstring& path, Script& script);
+
+    std::wstring GetFramePath(const Script& script, const Pose& pose);
+
+    // The contrast adaptive pass's inputs as the GPU stores them: R11G11B10_FLOAT color and
+    // PixelPacking_Velocity velocity, tightly packed
+    struct CapturedFrame
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        std::vector<uint32_t> Color;
+        std::vector<uint32_t> Velocity;
+    };
+
+    bool SaveFrame(const std::wstring& path, const CapturedFrame& frame);
+    bool LoadFrame(const std::wstring& path, CapturedFrame& frame);
+
+    // Runs every experiment on every pose's frame, spread across cores, and writes shading rate
+    // percentages, estimated pixel shader invocations, rate changes since the previous frame of
+    // the sequence, and image metrics to <Directory><BaseName>-Results.csv.  Image metrics compare
+    // the frame against a copy shaded once per coarse pixel at the chosen rates.  Sequences of
+    // more than one frame also get rate changes per tile per frame and shading savings, with and
+    // without the rate filter, in <Directory><BaseName>-Stability.csv.
+    bool Run(const std::wstring& scriptPath);
+}
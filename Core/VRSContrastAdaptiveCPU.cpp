@@ -0,0 +1,936 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pch.h"
+#include "VRSContrastAdaptiveCPU.h"
+#include "VRS.h"
+#include "VRSBatch.h"
+#include "ColorBuffer.h"
+#include "CommandContext.h"
+#include "CommandListManager.h"
+#include "GraphicsCore.h"
+#include "ReadbackBuffer.h"
+#include "SystemTime.h"
+
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ppl.h>
+#include <random>
+
+using namespace Graphics;
+using namespace VRS;
+
+namespace
+{
+    // D3D12_AXIS_SHADING_RATE values, as the shaders use them
+    const uint32_t kAxis1X = 0;
+    const uint32_t kAxis2X = 1;
+    const uint32_t kAxis4X = 2;
+
+    // RGBToLuminance in ShaderUtility.hlsli
+    const float kLumaR = 0.212671f;
+    const float kLumaG = 0.715160f;
+    const float kLumaB = 0.072169f;
+
+    // Floats ahead of x = 0 in each row of a band, so that x = -1 reads zero like an out of bounds
+    // UAV load while x = 0 stays 16-byte aligned
+    const uint32_t kRowHalo = 4;
+
+    // Same results as _mm_min_ps and _mm_max_ps
+    inline float MinF( float a, float b ) { return a < b ? a : b; }
+    inline float MaxF( float a, float b ) { return a > b ? a : b; }
+
+    inline float Luma( const float* rgb, bool squared )
+    {
+        float r = rgb[0], g = rgb[1], b = rgb[2];
+        if (squared)
+        {
+            r *= r;
+            g *= g;
+            b *= b;
+        }
+        return (r * kLumaR + g * kLumaG) + b * kLumaB;
+    }
+
+    // Luma of four consecutive RGB pixels
+    inline __m128 Luma4( const float* rgb, bool squared )
+    {
+        const __m128 v0 = _mm_loadu_ps(rgb);        // r0 g0 b0 r1
+        const __m128 v1 = _mm_loadu_ps(rgb + 4);    // g1 b1 r2 g2
+        const __m128 v2 = _mm_loadu_ps(rgb + 8);    // b2 r3 g3 b3
+
+        __m128 r = _mm_shuffle_ps(v0, _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 g = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0, 0, 1, 1)),
+            _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 1, 2, 2)),
+            _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+        if (squared)
+        {
+            r = _mm_mul_ps(r, r);
+            g = _mm_mul_ps(g, g);
+            b = _mm_mul_ps(b, b);
+        }
+
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(kLumaR)), _mm_mul_ps(g, _mm_set1_ps(kLumaG))),
+            _mm_mul_ps(b, _mm_set1_ps(kLumaB)));
+    }
+
+    // Luma of one image row, zero past the right edge or for rows outside the image (rgbRow null)
+    void ComputeLumaRow( const float* rgbRow, uint32_t width, bool squared, float* dest, uint32_t count )
+    {
+        uint32_t x = 0;
+        if (rgbRow != nullptr)
+        {
+            for (; x + 4 <= width; x += 4)
+                _mm_storeu_ps(dest + x, Luma4(rgbRow + x * 3, squared));
+            for (; x < width; ++x)
+                dest[x] = Luma(rgbRow + x * 3, squared);
+        }
+        for (; x < count; ++x)
+            dest[x] = 0.0f;
+    }
+
+    // Adds the lanes in a fixed order so that the scalar reference can match it exactly
+    inline float SumLanes( __m128 v )
+    {
+        float lanes[4];
+        _mm_storeu_ps(lanes, v);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    inline __m128 Saturate( __m128 v )
+    {
+        return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    }
+
+    inline __m128 Abs( __m128 v )
+    {
+        return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+    }
+
+    struct TileSums
+    {
+        float Luma;
+        float DerivX;
+        float DerivY;
+        float MinVelocity;
+    };
+
+    // The per tile decision made by thread 0 of each group
+    uint8_t ChooseShadingRate( const TileSums& sums, const ContrastAdaptiveSettings& settings )
+    {
+        const uint32_t numThreads = settings.TileSize * settings.TileSize;
+
+        // The unoptimized shader leaves out the derivatives across the tile's first column and row
+        const float derivCount = settings.Variant == ContrastAdaptiveSLM ?
+            (float)numThreads : (float)(numThreads - settings.TileSize);
+
+        const float avgTileLuma = sums.Luma / (float)numThreads;
+        const float avgTileLumaX = sums.DerivX / derivCount;
+        const float avgTileLumaY = sums.DerivY / derivCount;
+
+        const float jndThreshold = settings.SensitivityThreshold * (avgTileLuma + settings.EnvLuma);
+
+        const float avgErrorX = sqrtf(avgTileLumaX);
+        const float avgErrorY = sqrtf(avgTileLumaY);
+
+        float velocityHError = 1.0f;
+        float velocityQError = settings.K;
+
+        if (settings.UseMotionVectors)
+        {
+            if (settings.Variant == ContrastAdaptiveSLM)
+            {
+                // Linear fits of equations 20 and 21 over velocities of 0 to 16
+                velocityHError = ((0.0468f - 1.0f) / 16.0f) * sums.MinVelocity + 1.0f;
+                velocityQError = ((0.1629f - settings.K) / 16.0f) * sums.MinVelocity + settings.K;
+            }
+            else
+            {
+                velocityHError = powf(1.0f / (1.0f + powf(1.05f * sums.MinVelocity, 3.10f)), 0.35f);
+                velocityQError = settings.K * powf(1.0f / (1.0f + powf(0.55f * sums.MinVelocity, 2.41f)), 0.49f);
+            }
+        }
+
+        uint32_t xRate = kAxis2X;
+        uint32_t yRate = kAxis2X;
+
+        if (velocityHError * avgErrorX >= jndThreshold)
+            xRate = kAxis1X;
+        else if (velocityQError * avgErrorX < jndThreshold)
+            xRate = kAxis4X;
+
+        // 4X1 and 1X4 are not valid rates
+        if (velocityHError * avgErrorY >= jndThreshold)
+            yRate = xRate == kAxis4X ? kAxis2X : kAxis1X;
+        else if (velocityQError * avgErrorY < jndThreshold)
+            yRate = xRate == kAxis1X ? kAxis2X : kAxis4X;
+
+        return (uint8_t)(xRate << 2 | yRate);
+    }
+
+    // Velocity reads outside the image return 0, so partial tiles always have zero velocity
+    float MinTileVelocity( const float* velocity, uint32_t width, uint32_t height,
+        uint32_t x0, uint32_t y0, uint32_t tileSize, float initialMin )
+    {
+        if (x0 + tileSize > width || y0 + tileSize > height)
+            return MinF(initialMin, 0.0f);
+
+        __m128 minVelocity = _mm_set1_ps(initialMin);
+        for (uint32_t y = 0; y < tileSize; ++y)
+        {
+            const float* row = velocity + (size_t)(y0 + y) * width + x0;
+            for (uint32_t x = 0; x < tileSize; x += 4)
+                minVelocity = _mm_min_ps(minVelocity, _mm_loadu_ps(row + x));
+        }
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, minVelocity);
+        return MinF(MinF(lanes[0], lanes[1]), MinF(lanes[2], lanes[3]));
+    }
+
+    // Per thread scratch for the SLM variant.  Luma is held column by column, the same layout as
+    // the shader's groupshared neighborhood[x][y], so that its flattened neighbor reads become
+    // fixed offsets.
+    struct SLMScratch
+    {
+        explicit SLMScratch( uint32_t tileSize ) :
+            Columns((tileSize + 1) * (tileSize + 1)),
+            Neighborhood(tileSize * tileSize + 2 * (tileSize + 1), 0.0f),
+            Sensitivity(tileSize * tileSize)
+        {
+        }
+
+        std::vector<float> Columns;         // Tile plus the column to its left and the row above
+        std::vector<float> Neighborhood;    // Tile with tileSize + 1 zeros at each end
+        std::vector<float> Sensitivity;     // Weber-Fechner divisor term per pixel
+    };
+
+    // lumaRows holds the squared luma of the row above the tile and the tile's rows
+    void SumTileSLM( const float* lumaRows, size_t stride, uint32_t x0, const ContrastAdaptiveSettings& settings,
+        SLMScratch& scratch, TileSums& sums )
+    {
+        const uint32_t T = settings.TileSize;
+        const uint32_t columnStride = T + 1;
+
+        float* columns = scratch.Columns.data();
+        for (uint32_t r = 0; r <= T; ++r)
+        {
+            const float* row = lumaRows + r * stride + kRowHalo + x0 - 1;
+            for (uint32_t c = 0; c <= T; ++c)
+                columns[c * columnStride + r] = row[c];
+        }
+
+        if (settings.UseWeberFechner)
+        {
+            // Neighbors outside the tile are read through the flattened groupshared index, so they
+            // wrap into the adjacent column.  Reads past either end of the array are undefined on
+            // the GPU and taken as 0 here.  The shader's W neighbor is (x, y + 1), the same as S.
+            float* neighborhood = scratch.Neighborhood.data() + T + 1;
+            for (uint32_t x = 0; x < T; ++x)
+                memcpy(neighborhood + x * T, columns + (x + 1) * columnStride + 1, T * sizeof(float));
+
+            const __m128 wfConstant = _mm_set1_ps(settings.WeberFechnerConstant);
+            for (uint32_t f = 0; f < T * T; f += 4)
+            {
+                const float* p = neighborhood + f;
+                __m128 minLuma = _mm_set1_ps(10000.0f);
+                minLuma = _mm_min_ps(minLuma, _mm_loadu_ps(p - 1));            // N
+                minLuma = _mm_min_ps(minLuma, _mm_loadu_ps(p + T - 1));        // NE
+                minLuma = _mm_min_ps(minLuma, _mm_loadu_ps(p + T));            // E
+                minLuma = _mm_min_ps(minLuma, _mm_loadu_ps(p + T + 1));        // SE
+                minLuma = _mm_min_ps(minLuma, _mm_loadu_ps(p + 1));            // S
+                minLuma = _mm_min_ps(minLuma, _mm_loadu_ps(p - (T - 1)));      // SW
+                minLuma = _mm_min_ps(minLuma, _mm_loadu_ps(p + 1));            // W
+                minLuma = _mm_min_ps(minLuma, _mm_loadu_ps(p - (T + 1)));      // NW
+
+                __m128 sensitivity = Saturate(_mm_sub_ps(_mm_mul_ps(minLuma, _mm_set1_ps(50.0f)), _mm_set1_ps(2.5f)));
+                sensitivity = _mm_mul_ps(wfConstant, _mm_sub_ps(_mm_set1_ps(1.0f), sensitivity));
+                _mm_storeu_ps(&scratch.Sensitivity[f], sensitivity);
+            }
+        }
+
+        __m128 lumaSum = _mm_setzero_ps();
+        __m128 derivXSum = _mm_setzero_ps();
+        __m128 derivYSum = _mm_setzero_ps();
+
+        for (uint32_t x = 0; x < T; ++x)
+        {
+            const float* column = columns + (x + 1) * columnStride + 1;
+            for (uint32_t y = 0; y < T; y += 4)
+            {
+                const __m128 luma = _mm_loadu_ps(column + y);
+                const __m128 lumaXMinusOne = _mm_loadu_ps(column + y - columnStride);
+                const __m128 lumaYMinusOne = _mm_loadu_ps(column + y - 1);
+
+                __m128 derivX = Abs(_mm_sub_ps(luma, lumaXMinusOne));
+                __m128 derivY = Abs(_mm_sub_ps(luma, lumaYMinusOne));
+
+                if (settings.UseWeberFechner)
+                {
+                    const __m128 sensitivity = _mm_loadu_ps(&scratch.Sensitivity[x * T + y]);
+                    derivX = _mm_div_ps(derivX, _mm_add_ps(_mm_min_ps(luma, lumaXMinusOne), sensitivity));
+                    derivY = _mm_div_ps(derivY, _mm_add_ps(_mm_min_ps(luma, lumaYMinusOne), sensitivity));
+                }
+                else
+                {
+                    derivX = _mm_mul_ps(derivX, _mm_set1_ps(0.5f));
+                    derivY = _mm_mul_ps(derivY, _mm_set1_ps(0.5f));
+                }
+
+                lumaSum = _mm_add_ps(lumaSum, luma);
+                derivXSum = _mm_add_ps(derivXSum, derivX);
+                derivYSum = _mm_add_ps(derivYSum, derivY);
+            }
+        }
+
+        sums.Luma = SumLanes(lumaSum);
+        sums.DerivX = SumLanes(derivXSum);
+        sums.DerivY = SumLanes(derivYSum);
+    }
+
+    // lumaRows is as for SumTileSLM.  rawRows holds the luma of the unsquared color for the tile's
+    // rows and the three below them.
+    void SumTileUnoptimized( const float* lumaRows, const float* rawRows, size_t stride, uint32_t x0, uint32_t y0,
+        uint32_t height, const ContrastAdaptiveSettings& settings, TileSums& sums )
+    {
+        const uint32_t T = settings.TileSize;
+        const __m128 wfConstant = _mm_set1_ps(settings.WeberFechnerConstant);
+        const __m128 allLanes = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        const __m128 firstColumnMask = _mm_castsi128_ps(_mm_set_epi32(-1, -1, -1, 0));
+
+        __m128 lumaSum = _mm_setzero_ps();
+        __m128 derivXSum = _mm_setzero_ps();
+        __m128 derivYSum = _mm_setzero_ps();
+
+        for (uint32_t y = 0; y < T; ++y)
+        {
+            const uint32_t pixelY = y0 + y;
+            const float* row = lumaRows + (y + 1) * stride + kRowHalo + x0;
+            const float* rowAbove = row - stride;
+
+            // Weber-Fechner averages over this row and the next three, skipping those past the
+            // bottom of the image.  Beyond the bottom that leaves 0 / 0, as on the GPU.
+            uint32_t neighborCount = 0;
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                if (pixelY + j < height)
+                    neighborCount += 2;
+            }
+            const __m128 neighborCountVec = _mm_set1_ps((float)neighborCount);
+
+            // Derivatives across the top and left edges of the image are not summed
+            const __m128 yMask = pixelY > 0 ? allLanes : _mm_setzero_ps();
+
+            for (uint32_t x = 0; x < T; x += 4)
+            {
+                const __m128 luma = _mm_loadu_ps(row + x);
+                const __m128 lumaXMinusOne = _mm_loadu_ps(row + x - 1);
+                const __m128 lumaYMinusOne = _mm_loadu_ps(rowAbove + x);
+
+                __m128 derivX = Abs(_mm_sub_ps(luma, lumaXMinusOne));
+                __m128 derivY = Abs(_mm_sub_ps(luma, lumaYMinusOne));
+
+                if (settings.UseWeberFechner)
+                {
+                    __m128 totalLuma = _mm_setzero_ps();
+                    for (uint32_t j = 0; j < 4; ++j)
+                    {
+                        if (pixelY + j < height)
+                        {
+                            const float* raw = rawRows + (y + j) * stride + kRowHalo + x0 + x;
+                            totalLuma = _mm_add_ps(totalLuma, _mm_loadu_ps(raw));
+                            totalLuma = _mm_add_ps(totalLuma, _mm_loadu_ps(raw - 1));
+                        }
+                    }
+                    const __m128 avgNeighborLuma = _mm_div_ps(totalLuma, neighborCountVec);
+
+                    __m128 sensitivity = Saturate(_mm_sub_ps(_mm_mul_ps(avgNeighborLuma, _mm_set1_ps(50.0f)), _mm_set1_ps(2.5f)));
+                    sensitivity = _mm_mul_ps(wfConstant, _mm_sub_ps(_mm_set1_ps(1.0f), sensitivity));
+
+                    derivX = _mm_div_ps(derivX, _mm_add_ps(_mm_min_ps(luma, lumaXMinusOne), sensitivity));
+                    derivY = _mm_div_ps(derivY, _mm_add_ps(_mm_min_ps(luma, lumaYMinusOne), sensitivity));
+                }
+                else
+                {
+                    derivX = _mm_mul_ps(derivX, _mm_set1_ps(0.5f));
+                    derivY = _mm_mul_ps(derivY, _mm_set1_ps(0.5f));
+                }
+
+                if (x0 + x == 0)
+                    derivX = _mm_and_ps(derivX, firstColumnMask);
+                derivY = _mm_and_ps(derivY, yMask);
+
+                lumaSum = _mm_add_ps(lumaSum, luma);
+                derivXSum = _mm_add_ps(derivXSum, derivX);
+                derivYSum = _mm_add_ps(derivYSum, derivY);
+            }
+        }
+
+        sums.Luma = SumLanes(lumaSum);
+        sums.DerivX = SumLanes(derivXSum);
+        sums.DerivY = SumLanes(derivYSum);
+    }
+
+    // A direct transcription of the shaders, one pixel at a time.  Partial sums are kept per lane
+    // in the order the SSE path visits pixels so that both produce identical results.
+    void ComputeContrastAdaptiveRatesScalar( const float* rgb, const float* velocity, uint32_t width, uint32_t height,
+        const ContrastAdaptiveSettings& settings, uint8_t* rates )
+    {
+        const int T = (int)settings.TileSize;
+        const uint32_t tilesX = (width + T - 1) / T;
+        const uint32_t tilesY = (height + T - 1) / T;
+        const bool slm = settings.Variant == ContrastAdaptiveSLM;
+
+        auto LumaAt = [&]( int x, int y, bool squared ) -> float
+        {
+            if (x < 0 || y < 0 || x >= (int)width || y >= (int)height)
+                return 0.0f;
+            return Luma(rgb + ((size_t)y * width + x) * 3, squared);
+        };
+
+        auto VelocityAt = [&]( int x, int y ) -> float
+        {
+            if (x >= (int)width || y >= (int)height)
+                return 0.0f;
+            return velocity[(size_t)y * width + x];
+        };
+
+        auto Sensitivity = [&]( float neighborLuma ) -> float
+        {
+            return settings.WeberFechnerConstant * (1.0f - MinF(MaxF(neighborLuma * 50.0f - 2.5f, 0.0f), 1.0f));
+        };
+
+        for (uint32_t ty = 0; ty < tilesY; ++ty)
+        {
+            for (uint32_t tx = 0; tx < tilesX; ++tx)
+            {
+                const int x0 = (int)tx * T;
+                const int y0 = (int)ty * T;
+
+                // groupshared neighborhood[x][y] read through its flattened index
+                auto Neighborhood = [&]( int nx, int ny ) -> float
+                {
+                    const int flat = nx * T + ny;
+                    if (flat < 0 || flat >= T * T)
+                        return 0.0f;
+                    return LumaAt(x0 + flat / T, y0 + flat % T, true);
+                };
+
+                float lumaSum[4] = {};
+                float derivXSum[4] = {};
+                float derivYSum[4] = {};
+                float minVelocity = slm ? 10000.0f : 1000.0f;
+
+                for (int i = 0; i < T * T; ++i)
+                {
+                    // The SSE path walks SLM tiles by column and unoptimized tiles by row
+                    const int x = slm ? i / T : i % T;
+                    const int y = slm ? i % T : i / T;
+                    const int lane = i & 3;
+                    const int px = x0 + x;
+                    const int py = y0 + y;
+
+                    const float luma = LumaAt(px, py, true);
+                    const float lumaXMinusOne = LumaAt(px - 1, py, true);
+                    const float lumaYMinusOne = LumaAt(px, py - 1, true);
+
+                    float derivX, derivY;
+                    if (settings.UseWeberFechner)
+                    {
+                        float sensitivity;
+                        if (slm)
+                        {
+                            float minLuma = 10000.0f;
+                            minLuma = MinF(minLuma, Neighborhood(x, y - 1));
+                            minLuma = MinF(minLuma, Neighborhood(x + 1, y - 1));
+                            minLuma = MinF(minLuma, Neighborhood(x + 1, y));
+                            minLuma = MinF(minLuma, Neighborhood(x + 1, y + 1));
+                            minLuma = MinF(minLuma, Neighborhood(x, y + 1));
+                            minLuma = MinF(minLuma, Neighborhood(x - 1, y + 1));
+                            minLuma = MinF(minLuma, Neighborhood(x, y + 1));
+                            minLuma = MinF(minLuma, Neighborhood(x - 1, y - 1));
+                            sensitivity = Sensitivity(minLuma);
+                        }
+                        else
+                        {
+                            float totalLuma = 0.0f;
+                            uint32_t neighborCount = 0;
+                            for (int j = 0; j < 4; ++j)
+                            {
+                                if ((uint32_t)(py + j) < height)
+                                {
+                                    totalLuma = totalLuma + LumaAt(px, py + j, false);
+                                    totalLuma = totalLuma + LumaAt(px - 1, py + j, false);
+                                    neighborCount += 2;
+                                }
+                            }
+                            sensitivity = Sensitivity(totalLuma / (float)neighborCount);
+                        }
+                        derivX = fabsf(luma - lumaXMinusOne) / (MinF(luma, lumaXMinusOne) + sensitivity);
+                        derivY = fabsf(luma - lumaYMinusOne) / (MinF(luma, lumaYMinusOne) + sensitivity);
+                    }
+                    else
+                    {
+                        derivX = fabsf(luma - lumaXMinusOne) * 0.5f;
+                        derivY = fabsf(luma - lumaYMinusOne) * 0.5f;
+                    }
+
+                    lumaSum[lane] += luma;
+                    if (slm || px > 0)
+                        derivXSum[lane] += derivX;
+                    if (slm || py > 0)
+                        derivYSum[lane] += derivY;
+                    if (settings.UseMotionVectors)
+                        minVelocity = MinF(minVelocity, VelocityAt(px, py));
+                }
+
+                TileSums sums;
+                sums.Luma = (lumaSum[0] + lumaSum[1]) + (lumaSum[2] + lumaSum[3]);
+                sums.DerivX = (derivXSum[0] + derivXSum[1]) + (derivXSum[2] + derivXSum[3]);
+                sums.DerivY = (derivYSum[0] + derivYSum[1]) + (derivYSum[2] + derivYSum[3]);
+                sums.MinVelocity = minVelocity;
+                rates[ty * tilesX + tx] = ChooseShadingRate(sums, settings);
+            }
+        }
+    }
+
+    // Percent of tiles at each rate, followed by the pixel shader work relative to full rate
+    void PrintShadingRateHistogram( const uint32_t histogram[7] )
+    {
+        static const float kPixelsPerInvocation[7] = { 1.0f, 2.0f, 2.0f, 4.0f, 8.0f, 8.0f, 16.0f };
+
+        uint32_t numTiles = 0;
+        float work = 0.0f;
+        for (uint32_t i = 0; i < 7; ++i)
+        {
+            numTiles += histogram[i];
+            work += histogram[i] / kPixelsPerInvocation[i];
+        }
+        const float scale = numTiles > 0 ? 100.0f / numTiles : 0.0f;
+
+        for (uint32_t i = 0; i < 7; ++i)
+            Utility::Printf("  %5.1f", histogram[i] * scale);
+        Utility::Printf("  %5.1f\n", work * scale);
+    }
+
+    const char* kHistogramHeader = "    1X1    1X2    2X1    2X2    2X4    4X2    4X4   work\n";
+
+    // Written by CaptureContrastAdaptiveFrame and consumed by ProcessContrastAdaptiveFrame
+    ReadbackBuffer s_ColorReadback;
+    ReadbackBuffer s_VelocityReadback;
+    ReadbackBuffer s_RateReadback;
+    uint32_t s_ColorRowPitch = 0;
+    uint32_t s_VelocityRowPitch = 0;
+    uint32_t s_RateRowPitch = 0;
+    uint32_t s_CaptureWidth = 0;
+    uint32_t s_CaptureHeight = 0;
+    uint32_t s_RateWidth = 0;
+    uint32_t s_RateHeight = 0;
+    ContrastAdaptiveSettings s_CaptureSettings;
+    bool s_CaptureValidate = false;
+    bool s_CaptureSweep = false;
+    std::wstring s_CaptureSavePath;
+
+    // Where the next capture should be saved for the batch runner
+    std::wstring s_SaveRequestPath;
+
+    void ReleaseCapture( void )
+    {
+        s_ColorReadback.Destroy();
+        s_VelocityReadback.Destroy();
+        s_RateReadback.Destroy();
+        s_CaptureValidate = false;
+        s_CaptureSweep = false;
+        s_CaptureSavePath.clear();
+    }
+
+    // Copies the packed color and velocity out of the readback buffers
+    void SaveCapture( const std::wstring& path )
+    {
+        VRSBatch::CapturedFrame frame;
+        frame.Width = s_CaptureWidth;
+        frame.Height = s_CaptureHeight;
+        frame.Color.resize((size_t)frame.Width * frame.Height);
+        frame.Velocity.resize((size_t)frame.Width * frame.Height);
+
+        const uint8_t* colorData = (const uint8_t*)s_ColorReadback.Map();
+        const uint8_t* velocityData = (const uint8_t*)s_VelocityReadback.Map();
+        for (uint32_t y = 0; y < frame.Height; ++y)
+        {
+            memcpy(&frame.Color[(size_t)y * frame.Width], colorData + (size_t)y * s_ColorRowPitch, frame.Width * sizeof(uint32_t));
+            memcpy(&frame.Velocity[(size_t)y * frame.Width], velocityData + (size_t)y * s_VelocityRowPitch, frame.Width * sizeof(uint32_t));
+        }
+        s_ColorReadback.Unmap();
+        s_VelocityReadback.Unmap();
+
+        if (VRSBatch::SaveFrame(path, frame))
+            Utility::Printf(L"Saved contrast adaptive frame %ws\n", path.c_str());
+        else
+            Utility::Printf(L"Unable to write contrast adaptive frame %ws\n", path.c_str());
+    }
+}
+
+ContrastAdaptiveSettings VRS::GetContrastAdaptiveSettings(void)
+{
+    ContrastAdaptiveSettings settings;
+    settings.TileSize = ShadingRateTileSize;
+    settings.SensitivityThreshold = (float)ContrastAdaptiveSensitivityThreshold;
+    settings.EnvLuma = (float)ContrastAdaptiveEnvLuma;
+    settings.K = (float)ContrastAdaptiveK;
+    settings.WeberFechnerConstant = (float)ContrastAdaptiveWeberFechnerConstant;
+    settings.UseWeberFechner = (bool)ContrastAdaptiveUseWeberFechner;
+    settings.UseMotionVectors = (bool)ContrastAdaptiveUseMotionVectors;
+    settings.Variant = ContrastAdaptiveSLM;
+    return settings;
+}
+
+float VRS::UnpackVelocityLength(uint32_t packedVelocity)
+{
+    using DirectX::PackedVector::HALF;
+    using DirectX::PackedVector::XMConvertHalfToFloat;
+
+    // UnpackXY and UnpackZ
+    auto UnpackXY = []( uint32_t v ) { return XMConvertHalfToFloat((HALF)((v & 0x1FF) << 4 | (v >> 9) << 15)) * 32768.0f; };
+    auto UnpackZ = []( uint32_t v ) { return XMConvertHalfToFloat((HALF)((v & 0x7FF) << 2 | (v >> 11) << 15)) * 128.0f; };
+
+    const float x = UnpackXY(packedVelocity & 0x3FF);
+    const float y = UnpackXY((packedVelocity >> 10) & 0x3FF);
+    const float z = UnpackZ(packedVelocity >> 20);
+    return sqrtf(x * x + y * y + z * z);
+}
+
+void VRS::ComputeContrastAdaptiveRates(const float* rgb, const float* velocity, uint32_t width, uint32_t height,
+    const ContrastAdaptiveSettings& settings, uint8_t* rates)
+{
+    const uint32_t T = settings.TileSize;
+    ASSERT(T == 8 || T == 16, "Contrast adaptive shading rates use 8x8 or 16x16 tiles");
+    ASSERT(velocity != nullptr || !settings.UseMotionVectors, "Motion vectors need a velocity image");
+
+    const uint32_t tilesX = (width + T - 1) / T;
+    const uint32_t tilesY = (height + T - 1) / T;
+    const size_t stride = kRowHalo + (size_t)tilesX * T;
+    const bool slm = settings.Variant == ContrastAdaptiveSLM;
+    const bool needRawLuma = !slm && settings.UseWeberFechner;
+
+    auto RowOrNull = [&]( int32_t y ) -> const float*
+    {
+        return y >= 0 && y < (int32_t)height ? rgb + (size_t)y * width * 3 : nullptr;
+    };
+
+    // Each task handles one row of tiles
+    concurrency::parallel_for(0u, tilesY, [&]( uint32_t ty )
+    {
+        const uint32_t y0 = ty * T;
+
+        // Squared luma of the row above the tiles and the tiles' rows.  The halo stays zero.
+        std::vector<float> lumaRows((T + 1) * stride, 0.0f);
+        for (uint32_t r = 0; r <= T; ++r)
+            ComputeLumaRow(RowOrNull((int32_t)(y0 + r) - 1), width, true, &lumaRows[r * stride + kRowHalo], tilesX * T);
+
+        std::vector<float> rawRows;
+        if (needRawLuma)
+        {
+            rawRows.resize((T + 3) * stride, 0.0f);
+            for (uint32_t r = 0; r < T + 3; ++r)
+                ComputeLumaRow(RowOrNull((int32_t)(y0 + r)), width, false, &rawRows[r * stride + kRowHalo], tilesX * T);
+        }
+
+        SLMScratch scratch(slm ? T : 0);
+
+        for (uint32_t tx = 0; tx < tilesX; ++tx)
+        {
+            const uint32_t x0 = tx * T;
+
+            TileSums sums;
+            if (slm)
+                SumTileSLM(lumaRows.data(), stride, x0, settings, scratch, sums);
+            else
+                SumTileUnoptimized(lumaRows.data(), rawRows.data(), stride, x0, y0, height, settings, sums);
+
+            sums.MinVelocity = settings.UseMotionVectors ?
+                MinTileVelocity(velocity, width, height, x0, y0, T, slm ? 10000.0f : 1000.0f) : 0.0f;
+
+            rates[ty * tilesX + tx] = ChooseShadingRate(sums, settings);
+        }
+    });
+}
+
+void VRS::SweepContrastAdaptiveSettings(const float* rgb, const float* velocity, uint32_t width, uint32_t height,
+    const ContrastAdaptiveSettings& baseSettings, const float* thresholds, uint32_t numThresholds,
+    const float* quarterRateK, uint32_t numK)
+{
+    const uint32_t T = baseSettings.TileSize;
+    const uint32_t numTiles = ((width + T - 1) / T) * ((height + T - 1) / T);
+    std::vector<uint8_t> rates(numTiles);
+
+    Utility::Printf("Contrast adaptive sweep, %ux%u, %ux%u tiles (%% of tiles)\n", width, height, T, T);
+    Utility::Printf("  threshold      K%s", kHistogramHeader);
+
+    ContrastAdaptiveSettings settings = baseSettings;
+    for (uint32_t t = 0; t < numThresholds; ++t)
+    {
+        for (uint32_t k = 0; k < numK; ++k)
+        {
+            settings.SensitivityThreshold = thresholds[t];
+            settings.K = quarterRateK[k];
+            ComputeContrastAdaptiveRates(rgb, velocity, width, height, settings, rates.data());
+
+            uint32_t histogram[7];
+            CountShadingRates(rates.data(), numTiles, histogram);
+            Utility::Printf("  %9.3f  %5.2f", settings.SensitivityThreshold, settings.K);
+            PrintShadingRateHistogram(histogram);
+        }
+    }
+}
+
+void VRS::CaptureContrastAdaptiveFrame(ComputeContext& Context, ColorBuffer& Color, ColorBuffer& Velocity,
+    ColorBuffer& ShadingRateImage, bool validate, bool sweep)
+{
+    // The color buffer is either R11G11B10_FLOAT or the same bits in R32_UINT
+    ASSERT(Color.GetFormat() == DXGI_FORMAT_R11G11B10_FLOAT || Color.GetFormat() == DXGI_FORMAT_R32_UINT);
+    ASSERT(Velocity.GetFormat() == DXGI_FORMAT_R32_UINT);
+    ASSERT(ShadingRateImage.GetFormat() == DXGI_FORMAT_R8_UINT);
+
+    s_ColorRowPitch = Context.ReadbackTexture(s_ColorReadback, Color);
+    s_VelocityRowPitch = Context.ReadbackTexture(s_VelocityReadback, Velocity);
+    s_RateRowPitch = Context.ReadbackTexture(s_RateReadback, ShadingRateImage);
+
+    s_CaptureWidth = Color.GetWidth();
+    s_CaptureHeight = Color.GetHeight();
+    s_RateWidth = ShadingRateImage.GetWidth();
+    s_RateHeight = ShadingRateImage.GetHeight();
+    s_CaptureSettings = GetContrastAdaptiveSettings();
+    s_CaptureValidate = validate;
+    s_CaptureSweep = sweep;
+    s_CaptureSavePath = s_SaveRequestPath;
+    s_SaveRequestPath.clear();
+}
+
+void VRS::RequestContrastAdaptiveFrameSave(const std::wstring& path)
+{
+    s_SaveRequestPath = path;
+}
+
+bool VRS::IsContrastAdaptiveFrameSavePending(void)
+{
+    return !s_SaveRequestPath.empty() || !s_CaptureSavePath.empty();
+}
+
+void VRS::CancelContrastAdaptiveFrameSave(void)
+{
+    s_SaveRequestPath.clear();
+}
+
+void VRS::ProcessContrastAdaptiveFrame(void)
+{
+    if (!s_CaptureValidate && !s_CaptureSweep && s_CaptureSavePath.empty())
+        return;
+
+    g_CommandManager.IdleGPU();
+
+    if (!s_CaptureSavePath.empty())
+        SaveCapture(s_CaptureSavePath);
+
+    if (!s_CaptureValidate && !s_CaptureSweep)
+    {
+        ReleaseCapture();
+        return;
+    }
+
+    const uint32_t width = s_CaptureWidth;
+    const uint32_t height = s_CaptureHeight;
+    const ContrastAdaptiveSettings& settings = s_CaptureSettings;
+
+    std::vector<float> rgb((size_t)width * height * 3);
+    std::vector<float> velocity((size_t)width * height);
+
+    const uint8_t* colorData = (const uint8_t*)s_ColorReadback.Map();
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint32_t* row = (const uint32_t*)(colorData + (size_t)y * s_ColorRowPitch);
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            DirectX::PackedVector::XMFLOAT3PK packed(row[x]);
+            DirectX::XMStoreFloat3((DirectX::XMFLOAT3*)&rgb[((size_t)y * width + x) * 3], DirectX::PackedVector::XMLoadFloat3PK(&packed));
+        }
+    }
+    s_ColorReadback.Unmap();
+
+    const uint8_t* velocityData = (const uint8_t*)s_VelocityReadback.Map();
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint32_t* row = (const uint32_t*)(velocityData + (size_t)y * s_VelocityRowPitch);
+        for (uint32_t x = 0; x < width; ++x)
+            velocity[(size_t)y * width + x] = UnpackVelocityLength(row[x]);
+    }
+    s_VelocityReadback.Unmap();
+
+    if (settings.TileSize != 8 && settings.TileSize != 16)
+    {
+        Utility::Printf("Contrast adaptive capture skipped: %u pixel tiles are not supported\n", settings.TileSize);
+    }
+    else
+    {
+        if (s_CaptureValidate)
+        {
+            const uint32_t tilesX = (width + settings.TileSize - 1) / settings.TileSize;
+            const uint32_t tilesY = (height + settings.TileSize - 1) / settings.TileSize;
+            std::vector<uint8_t> cpuRates(tilesX * tilesY);
+            ComputeContrastAdaptiveRates(rgb.data(), velocity.data(), width, height, settings, cpuRates.data());
+
+            // The shading rate image may be a tile narrower or shorter than the dispatch
+            const uint32_t compareX = std::min(tilesX, s_RateWidth);
+            const uint32_t compareY = std::min(tilesY, s_RateHeight);
+            std::vector<uint8_t> gpuRates(compareX * compareY);
+            std::vector<uint8_t> comparedCpuRates(compareX * compareY);
+
+            const uint8_t* rateData = (const uint8_t*)s_RateReadback.Map();
+            uint32_t mismatches = 0;
+            for (uint32_t y = 0; y < compareY; ++y)
+            {
+                for (uint32_t x = 0; x < compareX; ++x)
+                {
+                    const uint8_t gpu = rateData[(size_t)y * s_RateRowPitch + x];
+                    const uint8_t cpu = cpuRates[y * tilesX + x];
+                    gpuRates[y * compareX + x] = gpu;
+                    comparedCpuRates[y * compareX + x] = cpu;
+                    if (gpu != cpu)
+                        ++mismatches;
+                }
+            }
+            s_RateReadback.Unmap();
+
+            // Wave and float ordering differ between the GPU and CPU, so tiles right at a
+            // threshold can legitimately land on different sides of it.
+            Utility::Printf("Contrast adaptive validation, %ux%u, %ux%u tiles: %u of %u tiles differ (%.3f%%)\n",
+                width, height, settings.TileSize, settings.TileSize, mismatches, compareX * compareY,
+                100.0f * mismatches / std::max(compareX * compareY, 1u));
+
+            uint32_t histogram[7];
+            Utility::Printf("      %s", kHistogramHeader);
+            CountShadingRates(gpuRates.data(), compareX * compareY, histogram);
+            Utility::Print("  GPU ");
+            PrintShadingRateHistogram(histogram);
+            CountShadingRates(comparedCpuRates.data(), compareX * compareY, histogram);
+            Utility::Print("  CPU ");
+            PrintShadingRateHistogram(histogram);
+        }
+
+        if (s_CaptureSweep)
+        {
+            const float thresholds[] = { 0.05f, 0.10f, 0.15f, 0.20f, 0.30f, 0.40f };
+            const float quarterRateK[] = { 1.0f, 1.5f, 2.13f, 3.0f, 4.0f };
+            SweepContrastAdaptiveSettings(rgb.data(), velocity.data(), width, height, settings,
+                thresholds, _countof(thresholds), quarterRateK, _countof(quarterRateK));
+        }
+    }
+
+    ReleaseCapture();
+}
+
+void VRS::BenchmarkContrastAdaptiveCPU(void)
+{
+    struct FrameSize { uint32_t width, height; };
+    const FrameSize frameSizes[] = { { 1920, 1080 }, { 3840, 2160 } };
+    const char* variantNames[] = { "SLM", "unoptimized" };
+
+    Utility::Printf("Contrast adaptive CPU benchmark (%% of tiles)\n");
+    Utility::Printf("%79s%s", "", kHistogramHeader);
+
+    for (const FrameSize& size : frameSizes)
+    {
+        const uint32_t width = size.width;
+        const uint32_t height = size.height;
+
+        // Blocks of smooth gradient, bright noise, dark noise, and horizontal and vertical stripes
+        // so that every rate shows up, with velocity increasing from left to right
+        std::mt19937 rng(12345);
+        std::uniform_real_distribution<float> noise(0.0f, 1.0f);
+        std::vector<float> rgb((size_t)width * height * 3);
+        std::vector<float> velocity((size_t)width * height);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                float* c = &rgb[((size_t)y * width + x) * 3];
+                switch ((x / 96 + y / 96) % 5)
+                {
+                case 0:
+                    c[0] = c[1] = c[2] = 0.3f + 0.2f * sinf(x * 0.01f) * cosf(y * 0.013f);
+                    break;
+                case 1:
+                    c[0] = noise(rng);
+                    c[1] = noise(rng);
+                    c[2] = noise(rng);
+                    break;
+                case 2:
+                    c[0] = c[1] = c[2] = 0.02f + 0.05f * noise(rng);
+                    break;
+                case 3:
+                    c[0] = c[1] = c[2] = (y / 2) & 1 ? 0.8f : 0.3f;
+                    break;
+                default:
+                    c[0] = c[1] = c[2] = (x / 2) & 1 ? 0.8f : 0.3f;
+                    break;
+                }
+                velocity[(size_t)y * width + x] = 16.0f * x / width + noise(rng);
+            }
+        }
+
+        for (uint32_t tileSize = 8; tileSize <= 16; tileSize *= 2)
+        {
+            const uint32_t numTiles = ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+            std::vector<uint8_t> rates(numTiles);
+            std::vector<uint8_t> referenceRates(numTiles);
+
+            for (uint32_t variant = 0; variant < 2; ++variant)
+            {
+                for (uint32_t weberFechner = 0; weberFechner < 2; ++weberFechner)
+                {
+                    ContrastAdaptiveSettings settings;
+                    settings.TileSize = tileSize;
+                    settings.Variant = (ContrastAdaptiveVariant)variant;
+                    settings.UseWeberFechner = weberFechner != 0;
+                    settings.UseMotionVectors = true;
+
+                    int64_t startTick = SystemTime::GetCurrentTick();
+                    ComputeContrastAdaptiveRates(rgb.data(), velocity.data(), width, height, settings, rates.data());
+                    double seconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+                    startTick = SystemTime::GetCurrentTick();
+                    ComputeContrastAdaptiveRatesScalar(rgb.data(), velocity.data(), width, height, settings, referenceRates.data());
+                    double referenceSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+                    Utility::Printf("  %4ux%-4u %2ux%-2u %-11s WF %-3s %7.3f ms (scalar %8.3f ms, %-9s)", width, height,
+                        tileSize, tileSize, variantNames[variant], weberFechner ? "on" : "off", seconds * 1000.0,
+                        referenceSeconds * 1000.0, rates == referenceRates ? "identical" : "MISMATCH");
+
+                    uint32_t histogram[7];
+                    CountShadingRates(rates.data(), numTiles, histogram);
+                    PrintShadingRateHistogram(histogram);
+                }
+            }
+        }
+    }
+}
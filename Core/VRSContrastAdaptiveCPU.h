@@ -0,0 +1,97 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "VRSShadingRateStats.h"
+
+#include <cstdint>
+#include <string>
+
+class ColorBuffer;
+class ComputeContext;
+
+// A CPU implementation of the contrast adaptive shading rate pass (VRSContrastAdaptiveCS*.hlsli).
+// It reproduces the shaders' arithmetic, including their edge handling, so that it can stand in
+// for the GPU when tuning the sensitivity threshold and K offline and serve as the reference the
+// GPU variants are checked against.
+
+namespace VRS
+{
+    // Which shader to reproduce.  The contrast adaptive PSOs are built from the SLM variant.
+    enum ContrastAdaptiveVariant
+    {
+        ContrastAdaptiveSLM,
+        ContrastAdaptiveUnoptimized,
+    };
+
+    struct ContrastAdaptiveSettings
+    {
+        uint32_t TileSize = 16;                 // 8 or 16, the shader's thread group size
+        float SensitivityThreshold = 0.15f;
+        float EnvLuma = 0.05f;
+        float K = 2.13f;
+        float WeberFechnerConstant = 1.0f;
+        bool UseWeberFechner = false;
+        bool UseMotionVectors = false;
+        ContrastAdaptiveVariant Variant = ContrastAdaptiveSLM;
+    };
+
+    // The settings the GPU pass will use this frame
+    ContrastAdaptiveSettings GetContrastAdaptiveSettings(void);
+
+    // Length of a velocity stored by PixelPacking_Velocity.hlsli, as the shaders compute it
+    float UnpackVelocityLength(uint32_t packedVelocity);
+
+    // Computes one D3D12_SHADING_RATE per tile, the same value the shader writes to the shading
+    // rate image.  rgb holds three floats per pixel, velocity holds one velocity length per pixel
+    // and may be null when motion vectors are not used.  rates receives ceil(width / TileSize) by
+    // ceil(height / TileSize) bytes.  Rows of tiles are spread across worker threads and each tile
+    // is processed four pixels at a time with SSE.
+    void ComputeContrastAdaptiveRates(const float* rgb, const float* velocity, uint32_t width, uint32_t height,
+        const ContrastAdaptiveSettings& settings, uint8_t* rates);
+
+    // Prints the share of tiles at each shading rate for every combination of sensitivity threshold
+    // and K, with the remaining settings taken from baseSettings.
+    void SweepContrastAdaptiveSettings(const float* rgb, const float* velocity, uint32_t width, uint32_t height,
+        const ContrastAdaptiveSettings& baseSettings, const float* thresholds, uint32_t numThresholds,
+        const float* quarterRateK, uint32_t numK);
+
+    // Copies the contrast adaptive pass's inputs and output to readback memory.  Call right after
+    // the dispatch, before anything else modifies the shading rate image.
+    void CaptureContrastAdaptiveFrame(ComputeContext& Context, ColorBuffer& Color, ColorBuffer& Velocity,
+        ColorBuffer& ShadingRateImage, bool validate, bool sweep);
+
+    // Makes the next capture also write the pass's inputs to path in VRSBatch's frame format.  The
+    // contrast adaptive pass must be running for the request to complete.
+    void RequestContrastAdaptiveFrameSave(const std::wstring& path);
+    bool IsContrastAdaptiveFrameSavePending(void);
+
+    // Drops a request that no capture has picked up yet.  A frame already captured is still saved.
+    void CancelContrastAdaptiveFrameSave(void);
+
+    // Once a captured frame has been executed, compares its shading rate image with the CPU result
+    // and/or runs the parameter sweep on it.  Waits for the GPU if a capture is pending.
+    void ProcessContrastAdaptiveFrame(void);
+
+    // Times the CPU pass on synthetic 1080p and 4K frames and checks it against a scalar
+    // transcription of the shaders.
+    void BenchmarkContrastAdaptiveCPU(void);
+}
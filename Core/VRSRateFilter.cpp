@@ -0,0 +1,399 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "VRSRateFilter.h"
+#include "VRS.h"
+#include "ColorBuffer.h"
+#include "CommandContext.h"
+#include "CommandListManager.h"
+#include "GraphicsCore.h"
+#include "ReadbackBuffer.h"
+#include "SystemTime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ppl.h>
+#include <random>
+
+using namespace Graphics;
+using namespace VRS;
+
+namespace
+{
+    // D3D12_SHADING_RATE packs log2 of the coarse pixel width above log2 of its height
+    inline uint32_t RateX( uint32_t rate ) { return (rate >> 2) & 3; }
+    inline uint32_t RateY( uint32_t rate ) { return rate & 3; }
+
+    // The finest of two rates along each axis.  Valid rates give a valid rate, because a rate
+    // four pixels along one axis is two along the other.
+    inline uint32_t FinestRate( uint32_t a, uint32_t b )
+    {
+        return std::min(RateX(a), RateX(b)) << 2 | std::min(RateY(a), RateY(b));
+    }
+
+    // Whether a is finer than b along either axis
+    inline bool IsFinerRate( uint32_t a, uint32_t b )
+    {
+        return RateX(a) < RateX(b) || RateY(a) < RateY(b);
+    }
+
+    inline uint32_t HeldRate( uint32_t state ) { return state & 0xFF; }
+    inline uint32_t ResetState( uint32_t rate ) { return rate | rate << 8; }
+
+    // StepRateFilter in VRSRateFilterCS.hlsl.  Requests that keep pointing the same way from the
+    // held rate count towards one switch, to the finest rate requested along the way.
+    uint32_t StepRateFilter( uint32_t state, uint32_t rate, uint32_t refineFrames, uint32_t coarsenFrames )
+    {
+        uint32_t held = state & 0xFF;
+        uint32_t pending = (state >> 8) & 0xFF;
+        uint32_t count = state >> 16;
+
+        if (rate == held)
+            return ResetState(held);
+
+        const bool refine = IsFinerRate(rate, held);
+        if (count > 0 && refine == IsFinerRate(pending, held))
+        {
+            pending = FinestRate(pending, rate);
+        }
+        else
+        {
+            pending = refine ? FinestRate(held, rate) : rate;
+            count = 0;
+        }
+
+        if (++count >= (refine ? refineFrames : coarsenFrames))
+            return ResetState(pending);
+
+        return held | pending << 8 | count << 16;
+    }
+
+    // The filter as the shader runs it, one tile at a time with the whole neighbourhood read for
+    // each tile.  The benchmark's reference.
+    void FilterShadingRatesScalar( const uint8_t* rates, uint32_t width, uint32_t height,
+        const RateFilterSettings& settings, RateFilterHistory& history, uint8_t* filtered )
+    {
+        const size_t numTiles = (size_t)width * height;
+        const bool reset = history.Width != width || history.Height != height || history.State.size() != numTiles;
+        history.Width = width;
+        history.Height = height;
+        history.State.resize(numTiles);
+
+        for (size_t i = 0; i < numTiles; ++i)
+        {
+            history.State[i] = reset ? ResetState(rates[i]) :
+                StepRateFilter(history.State[i], rates[i], std::max(settings.RefineFrames, 1u), std::max(settings.CoarsenFrames, 1u));
+        }
+
+        const int32_t radius = (int32_t)settings.DilationRadius;
+        for (int32_t y = 0; y < (int32_t)height; ++y)
+        {
+            for (int32_t x = 0; x < (int32_t)width; ++x)
+            {
+                uint32_t rate = HeldRate(history.State[(size_t)y * width + x]);
+                for (int32_t ny = std::max(y - radius, 0); ny <= std::min(y + radius, (int32_t)height - 1); ++ny)
+                {
+                    for (int32_t nx = std::max(x - radius, 0); nx <= std::min(x + radius, (int32_t)width - 1); ++nx)
+                        rate = FinestRate(rate, HeldRate(history.State[(size_t)ny * width + nx]));
+                }
+                filtered[(size_t)y * width + x] = (uint8_t)rate;
+            }
+        }
+    }
+
+    // Written by CaptureRateFilterInput/Output and consumed by ProcessRateFilterFrame
+    ReadbackBuffer s_InputRateReadback;
+    ReadbackBuffer s_InputStateReadback;
+    ReadbackBuffer s_OutputRateReadback;
+    ReadbackBuffer s_OutputStateReadback;
+    uint32_t s_InputRateRowPitch = 0;
+    uint32_t s_InputStateRowPitch = 0;
+    uint32_t s_OutputRateRowPitch = 0;
+    uint32_t s_OutputStateRowPitch = 0;
+    uint32_t s_CaptureWidth = 0;
+    uint32_t s_CaptureHeight = 0;
+    RateFilterSettings s_CaptureSettings;
+    bool s_CaptureReset = false;
+    bool s_CapturePending = false;
+
+    void ReleaseCapture( void )
+    {
+        s_InputRateReadback.Destroy();
+        s_InputStateReadback.Destroy();
+        s_OutputRateReadback.Destroy();
+        s_OutputStateReadback.Destroy();
+        s_CapturePending = false;
+    }
+
+    // Copies a readback of width by height elements into a tightly packed array
+    template <typename T>
+    void UnpackReadback( ReadbackBuffer& readback, uint32_t rowPitch, uint32_t width, uint32_t height, std::vector<T>& values )
+    {
+        values.resize((size_t)width * height);
+        const uint8_t* data = (const uint8_t*)readback.Map();
+        for (uint32_t y = 0; y < height; ++y)
+            memcpy(&values[(size_t)y * width], data + (size_t)y * rowPitch, width * sizeof(T));
+        readback.Unmap();
+    }
+
+    float GetRatesWork( const uint8_t* rates, uint32_t numTiles )
+    {
+        ShadingRateCounts counts;
+        CountShadingRates(rates, numTiles, counts.Counts);
+        return GetShadingWork(counts);
+    }
+}
+
+RateFilterSettings VRS::GetRateFilterSettings(void)
+{
+    RateFilterSettings settings;
+    settings.Enable = (bool)RateFilterEnable;
+    settings.RefineFrames = (uint32_t)(int32_t)RateFilterRefineFrames;
+    settings.CoarsenFrames = (uint32_t)(int32_t)RateFilterCoarsenFrames;
+    settings.DilationRadius = (uint32_t)(int32_t)RateFilterDilationRadius;
+    return settings;
+}
+
+void VRS::ResetRateFilter(RateFilterHistory& history)
+{
+    history.Width = 0;
+    history.Height = 0;
+    history.State.clear();
+}
+
+void VRS::FilterShadingRates(const uint8_t* rates, uint32_t width, uint32_t height,
+    const RateFilterSettings& settings, RateFilterHistory& history, uint8_t* filtered)
+{
+    const size_t numTiles = (size_t)width * height;
+    const bool reset = history.Width != width || history.Height != height || history.State.size() != numTiles;
+    history.Width = width;
+    history.Height = height;
+    history.State.resize(numTiles);
+
+    const uint32_t refineFrames = std::max(settings.RefineFrames, 1u);
+    const uint32_t coarsenFrames = std::max(settings.CoarsenFrames, 1u);
+    const uint32_t radius = settings.DilationRadius;
+    uint32_t* state = history.State.data();
+
+    // Without dilation the held rates are the result
+    uint8_t* held = radius == 0 ? filtered : nullptr;
+    std::vector<uint8_t> heldRates;
+    if (held == nullptr)
+    {
+        heldRates.resize(numTiles);
+        held = heldRates.data();
+    }
+
+    concurrency::parallel_for(0u, height, [&]( uint32_t y )
+    {
+        for (size_t i = (size_t)y * width, end = i + width; i < end; ++i)
+        {
+            state[i] = reset ? ResetState(rates[i]) : StepRateFilter(state[i], rates[i], refineFrames, coarsenFrames);
+            held[i] = (uint8_t)HeldRate(state[i]);
+        }
+    });
+
+    if (radius == 0)
+        return;
+
+    // The finest rate along each axis is separable, so dilate along rows and then along columns
+    std::vector<uint8_t> rowFinest(numTiles);
+    concurrency::parallel_for(0u, height, [&]( uint32_t y )
+    {
+        const uint8_t* row = held + (size_t)y * width;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t rate = row[x];
+            for (uint32_t nx = x > radius ? x - radius : 0; nx <= std::min(x + radius, width - 1); ++nx)
+                rate = FinestRate(rate, row[nx]);
+            rowFinest[(size_t)y * width + x] = (uint8_t)rate;
+        }
+    });
+
+    concurrency::parallel_for(0u, height, [&]( uint32_t y )
+    {
+        const uint32_t y0 = y > radius ? y - radius : 0;
+        const uint32_t y1 = std::min(y + radius, height - 1);
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t rate = rowFinest[(size_t)y * width + x];
+            for (uint32_t ny = y0; ny <= y1; ++ny)
+                rate = FinestRate(rate, rowFinest[(size_t)ny * width + x]);
+            filtered[(size_t)y * width + x] = (uint8_t)rate;
+        }
+    });
+}
+
+uint32_t VRS::CountRateChanges(const uint8_t* previous, const uint8_t* current, uint32_t numTiles)
+{
+    uint32_t changes = 0;
+    for (uint32_t i = 0; i < numTiles; ++i)
+        changes += previous[i] != current[i] ? 1 : 0;
+    return changes;
+}
+
+void VRS::CaptureRateFilterInput(ComputeContext& Context, ColorBuffer& ShadingRateImage, ColorBuffer& History, bool reset)
+{
+    ASSERT(ShadingRateImage.GetFormat() == DXGI_FORMAT_R8_UINT);
+    ASSERT(History.GetFormat() == DXGI_FORMAT_R32_UINT);
+
+    s_InputRateRowPitch = Context.ReadbackTexture(s_InputRateReadback, ShadingRateImage);
+    s_InputStateRowPitch = Context.ReadbackTexture(s_InputStateReadback, History);
+
+    s_CaptureWidth = ShadingRateImage.GetWidth();
+    s_CaptureHeight = ShadingRateImage.GetHeight();
+    s_CaptureSettings = GetRateFilterSettings();
+    s_CaptureReset = reset;
+}
+
+void VRS::CaptureRateFilterOutput(ComputeContext& Context, ColorBuffer& ShadingRateImage, ColorBuffer& History)
+{
+    s_OutputRateRowPitch = Context.ReadbackTexture(s_OutputRateReadback, ShadingRateImage);
+    s_OutputStateRowPitch = Context.ReadbackTexture(s_OutputStateReadback, History);
+    s_CapturePending = true;
+}
+
+void VRS::ProcessRateFilterFrame(void)
+{
+    if (!s_CapturePending)
+        return;
+
+    g_CommandManager.IdleGPU();
+
+    const uint32_t width = s_CaptureWidth;
+    const uint32_t height = s_CaptureHeight;
+    const uint32_t numTiles = width * height;
+
+    std::vector<uint8_t> inputRates, gpuRates;
+    std::vector<uint32_t> inputState, gpuState;
+    UnpackReadback(s_InputRateReadback, s_InputRateRowPitch, width, height, inputRates);
+    UnpackReadback(s_InputStateReadback, s_InputStateRowPitch, width, height, inputState);
+    UnpackReadback(s_OutputRateReadback, s_OutputRateRowPitch, width, height, gpuRates);
+    UnpackReadback(s_OutputStateReadback, s_OutputStateRowPitch, width, height, gpuState);
+    ReleaseCapture();
+
+    RateFilterHistory history;
+    if (!s_CaptureReset)
+    {
+        history.Width = width;
+        history.Height = height;
+        history.State = inputState;
+    }
+
+    std::vector<uint8_t> cpuRates(numTiles);
+    FilterShadingRates(inputRates.data(), width, height, s_CaptureSettings, history, cpuRates.data());
+
+    uint32_t stateMismatches = 0;
+    for (uint32_t i = 0; i < numTiles; ++i)
+        stateMismatches += history.State[i] != gpuState[i] ? 1 : 0;
+
+    // Unlike the rate pass, the filter is integer arithmetic and should match exactly
+    Utility::Printf("Rate filter validation, %ux%u tiles: %u rates and %u states differ\n", width, height,
+        CountRateChanges(cpuRates.data(), gpuRates.data(), numTiles), stateMismatches);
+    Utility::Printf("  %u tiles filtered to a different rate, work %.1f%% before and %.1f%% after\n",
+        CountRateChanges(inputRates.data(), gpuRates.data(), numTiles),
+        GetRatesWork(inputRates.data(), numTiles) * 100.0f, GetRatesWork(gpuRates.data(), numTiles) * 100.0f);
+}
+
+void VRS::BenchmarkRateFilter(void)
+{
+    // 8x8 tiles of a 4K frame
+    const uint32_t width = 480;
+    const uint32_t height = 270;
+    const uint32_t numTiles = width * height;
+    const uint32_t numFrames = 120;
+
+    // Each axis's rate comes from a slowly drifting field plus per frame noise, so that tiles near
+    // a rate boundary flip back and forth the way contrast measurements do under camera motion
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> noise(-0.08f, 0.08f);
+    std::vector<std::vector<uint8_t>> sequence(numFrames, std::vector<uint8_t>(numTiles));
+    for (uint32_t f = 0; f < numFrames; ++f)
+    {
+        const float drift = f * 0.05f;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const float fieldX = 1.0f + 1.1f * sinf(x * 0.031f + drift) * cosf(y * 0.017f) + noise(rng);
+                const float fieldY = 1.0f + 1.1f * cosf(x * 0.013f - drift) * sinf(y * 0.029f) + noise(rng);
+                uint32_t rateX = (uint32_t)std::min(std::max(fieldX + 0.5f, 0.0f), 2.0f);
+                uint32_t rateY = (uint32_t)std::min(std::max(fieldY + 0.5f, 0.0f), 2.0f);
+                if (rateX + rateY == 2 && rateX != rateY)
+                    rateX = rateY = 1;
+                sequence[f][y * width + x] = (uint8_t)(rateX << 2 | rateY);
+            }
+        }
+    }
+
+    uint32_t rawChanges = 0;
+    float rawWork = 0.0f;
+    for (uint32_t f = 0; f < numFrames; ++f)
+    {
+        if (f > 0)
+            rawChanges += CountRateChanges(sequence[f - 1].data(), sequence[f].data(), numTiles);
+        rawWork += GetRatesWork(sequence[f].data(), numTiles);
+    }
+
+    Utility::Printf("Rate filter benchmark, %ux%u tiles, %u frames\n", width, height, numFrames);
+    Utility::Printf("  unfiltered                    changes/tile/frame %.4f, work %5.1f%%\n",
+        (double)rawChanges / ((double)numTiles * (numFrames - 1)), rawWork * 100.0f / numFrames);
+
+    struct Config { uint32_t refine, coarsen, radius; };
+    const Config configs[] = { { 1, 2, 0 }, { 1, 4, 0 }, { 1, 8, 0 }, { 2, 8, 0 }, { 1, 4, 1 }, { 1, 8, 2 } };
+
+    std::vector<uint8_t> filtered(numTiles), previous(numTiles), reference(numTiles);
+    for (const Config& config : configs)
+    {
+        RateFilterSettings settings;
+        settings.Enable = true;
+        settings.RefineFrames = config.refine;
+        settings.CoarsenFrames = config.coarsen;
+        settings.DilationRadius = config.radius;
+
+        RateFilterHistory history, referenceHistory;
+        uint32_t changes = 0;
+        float work = 0.0f;
+        double seconds = 0.0;
+        bool identical = true;
+
+        for (uint32_t f = 0; f < numFrames; ++f)
+        {
+            int64_t startTick = SystemTime::GetCurrentTick();
+            FilterShadingRates(sequence[f].data(), width, height, settings, history, filtered.data());
+            seconds += SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            FilterShadingRatesScalar(sequence[f].data(), width, height, settings, referenceHistory, reference.data());
+            identical = identical && filtered == reference && history.State == referenceHistory.State;
+
+            if (f > 0)
+                changes += CountRateChanges(previous.data(), filtered.data(), numTiles);
+            work += GetRatesWork(filtered.data(), numTiles);
+            std::swap(previous, filtered);
+        }
+
+        Utility::Printf("  refine %u coarsen %-2u dilate %u  changes/tile/frame %.4f, work %5.1f%%  %6.3f ms/frame (%s)\n",
+            config.refine, config.coarsen, config.radius, (double)changes / ((double)numTiles * (numFrames - 1)),
+            work * 100.0f / numFrames, seconds * 1000.0 / numFrames, identical ? "identical" : "MISMATCH");
+    }
+}
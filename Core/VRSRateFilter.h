@@ -0,0 +1,82 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class ColorBuffer;
+class ComputeContext;
+
+// Temporal and spatial filtering of a shading rate image (VRSRateFilterCS.hlsl).  Per tile
+// decisions made fresh every frame flicker between neighbouring rates as the camera moves.  The
+// filter holds each tile's rate until a different one has been requested for several frames in
+// a row, refining sooner than it coarsens, and can then dilate fine rates into their neighbours.
+// The CPU functions here mirror the shader exactly and serve as its reference.
+
+namespace VRS
+{
+    struct RateFilterSettings
+    {
+        bool Enable = false;
+        uint32_t RefineFrames = 1;      // Consecutive frames a finer rate must be requested to switch to it
+        uint32_t CoarsenFrames = 4;     // Likewise for a coarser rate
+        uint32_t DilationRadius = 0;    // Each tile takes the finest held rate within this many tiles
+    };
+
+    // The settings the GPU pass will use this frame
+    RateFilterSettings GetRateFilterSettings(void);
+
+    // Per tile state carried from frame to frame, packed as the shader stores it: the held rate in
+    // bits 0-7, the rate being waited on in bits 8-15, and the frames it has been requested above.
+    struct RateFilterHistory
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        std::vector<uint32_t> State;
+    };
+
+    // Makes the next FilterShadingRates start over from the rates it is given
+    void ResetRateFilter(RateFilterHistory& history);
+
+    // Advances history by one frame of width by height tightly packed D3D12_SHADING_RATE values
+    // and writes the rates to use to filtered.  A history of another size is reset first.
+    void FilterShadingRates(const uint8_t* rates, uint32_t width, uint32_t height,
+        const RateFilterSettings& settings, RateFilterHistory& history, uint8_t* filtered);
+
+    // Tiles whose rate differs between two frames
+    uint32_t CountRateChanges(const uint8_t* previous, const uint8_t* current, uint32_t numTiles);
+
+    // Copies the shading rate image and filter state to readback memory around the GPU pass.
+    // Call the first right before the dispatch and the second right after it.
+    void CaptureRateFilterInput(ComputeContext& Context, ColorBuffer& ShadingRateImage, ColorBuffer& History, bool reset);
+    void CaptureRateFilterOutput(ComputeContext& Context, ColorBuffer& ShadingRateImage, ColorBuffer& History);
+
+    // Once a captured frame has been executed, runs the CPU filter on its input and compares the
+    // results with the GPU's.  Waits for the GPU if a capture is pending.
+    void ProcessRateFilterFrame(void);
+
+    // Filters a synthetic sequence of 4K shading rate images whose tiles sit near a rate
+    // boundary, and reports the time per frame, the rate changes per tile per frame, and the
+    // shading work with and without the filter.
+    void BenchmarkRateFilter(void);
+}
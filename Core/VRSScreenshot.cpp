@@ -118,7 +118,8 @@ void Screenshot::Shutdown()
     tempBuffer.Destroy();
 }
 
-void Screenshot::TakeScreenshotAndExportVRSBuffer(const char* filename, ColorBuffer& source, const char* vrsfilename, ColorBuffer& vrsBuffer, CommandContext& context, bool exportBuffer)
+void Screenshot::TakeScreenshotAndExportVRSBuffer(const char* filename, ColorBuffer& source, const char* vrsfilename, ColorBuffer& vrsBuffer, CommandContext& context, bool exportBuffer,
+    std::vector<uint8_t>* pixels)
 {
     Initialize(source, vrsBuffer);
     ConvertData(source, context);
@@ -128,7 +129,18 @@ void Screenshot::TakeScreenshotAndExportVRSBuffer(const char* filename, ColorBuf
     context.Finish(true);
     uint8_t* vrsreadbackptr = (uint8_t*)vrsreadback.Map();
 
-    WriteToFile(filename, sourceWidth, sourceHeight, 4, readback.Map(), sourceRowPitchInBytes);
+    uint8_t* readbackptr = (uint8_t*)readback.Map();
+    WriteToFile(filename, sourceWidth, sourceHeight, 4, readbackptr, sourceRowPitchInBytes);
+
+    if (pixels)
+    {
+        const size_t rowBytes = (size_t)sourceWidth * 4;
+        pixels->resize(rowBytes * sourceHeight);
+        for (int y = 0; y < sourceHeight; ++y)
+        {
+            memcpy(pixels->data() + rowBytes * y, readbackptr + (size_t)sourceRowPitchInBytes * y, rowBytes);
+        }
+    }
 
     if (exportBuffer)
     {
@@ -136,3 +148,13 @@ void Screenshot::TakeScreenshotAndExportVRSBuffer(const char* filename, ColorBuf
     }
     Shutdown();
 }
+
+void Screenshot::WriteErrorMap(const char* filename, int width, int height, const float* error)
+{
+    std::vector<uint8_t> gray((size_t)width * height);
+    for (size_t i = 0; i < gray.size(); ++i)
+    {
+        gray[i] = (uint8_t)(std::min(std::max(error[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+    WriteToFile(filename, width, height, 1, gray.data(), width);
+}
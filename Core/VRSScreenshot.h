@@ -25,5 +25,10 @@ class CommandContext;
 
 namespace Screenshot
 {
-    void TakeScreenshotAndExportVRSBuffer(const char* filename, ColorBuffer& source, const char* vrsfilename, ColorBuffer& vrsBuffer, CommandContext& context, bool exportBuffer);
+    // If pixels is given it also receives the screenshot as tightly packed RGBA8
+    void TakeScreenshotAndExportVRSBuffer(const char* filename, ColorBuffer& source, const char* vrsfilename, ColorBuffer& vrsBuffer, CommandContext& context, bool exportBuffer,
+        std::vector<uint8_t>* pixels = nullptr);
+
+    // Writes a per pixel error in [0, 1] as a grayscale PNG
+    void WriteErrorMap(const char* filename, int width, int height, const float* error);
 }
\ No newline at end of file
@@ -0,0 +1,282 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pch.h"
+#include "VRSShadingRateStats.h"
+#include "VRS.h"
+#include "SystemTime.h"
+
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+#include <ppl.h>
+#include <random>
+
+using namespace VRS;
+
+namespace
+{
+    // D3D12_SHADING_RATE of each ShadingRates entry
+    const uint8_t kRateValues[7] =
+    {
+        D3D12_SHADING_RATE_1X1, D3D12_SHADING_RATE_1X2, D3D12_SHADING_RATE_2X1, D3D12_SHADING_RATE_2X2,
+        D3D12_SHADING_RATE_2X4, D3D12_SHADING_RATE_4X2, D3D12_SHADING_RATE_4X4
+    };
+
+    const float kPixelsPerInvocation[7] = { 1.0f, 2.0f, 2.0f, 4.0f, 8.0f, 8.0f, 16.0f };
+
+    // Adds the rates of count consecutive tiles to counts
+    void CountSpan( const uint8_t* rates, uint32_t count, uint32_t counts[7] )
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i values[7];
+        for (int r = 0; r < 7; ++r)
+            values[r] = _mm_set1_epi8((char)kRateValues[r]);
+
+        uint32_t i = 0;
+        while (i + 16 <= count)
+        {
+            // Each byte lane counts matches, so flush before it can wrap
+            __m128i matches[7] = { zero, zero, zero, zero, zero, zero, zero };
+            for (uint32_t chunk = 0; chunk < 255 && i + 16 <= count; ++chunk, i += 16)
+            {
+                const __m128i v = _mm_loadu_si128((const __m128i*)(rates + i));
+                for (int r = 0; r < 7; ++r)
+                    matches[r] = _mm_sub_epi8(matches[r], _mm_cmpeq_epi8(v, values[r]));
+            }
+
+            for (int r = 0; r < 7; ++r)
+            {
+                const __m128i sums = _mm_sad_epu8(matches[r], zero);
+                counts[r] += (uint32_t)_mm_cvtsi128_si32(sums) + (uint32_t)_mm_extract_epi16(sums, 4);
+            }
+        }
+
+        for (; i < count; ++i)
+        {
+            for (int r = 0; r < 7; ++r)
+            {
+                if (rates[i] == kRateValues[r])
+                {
+                    ++counts[r];
+                    break;
+                }
+            }
+        }
+    }
+
+    // The original byte at a time count, kept as the reference for the benchmark
+    void CountShadingRatesScalar( const uint8_t* rates, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t counts[7] )
+    {
+        for (int r = 0; r < 7; ++r)
+            counts[r] = 0;
+
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                switch (rates[(size_t)y * rowPitch + x])
+                {
+                case D3D12_SHADING_RATE_1X1: ++counts[OneXOne]; break;
+                case D3D12_SHADING_RATE_1X2: ++counts[OneXTwo]; break;
+                case D3D12_SHADING_RATE_2X1: ++counts[TwoXOne]; break;
+                case D3D12_SHADING_RATE_2X2: ++counts[TwoXTwo]; break;
+                case D3D12_SHADING_RATE_2X4: ++counts[TwoXFour]; break;
+                case D3D12_SHADING_RATE_4X2: ++counts[FourXTwo]; break;
+                case D3D12_SHADING_RATE_4X4: ++counts[FourXFour]; break;
+                }
+            }
+        }
+    }
+}
+
+void VRS::ComputeShadingRateStats(const uint8_t* rates, uint32_t width, uint32_t height, uint32_t rowPitch,
+    uint32_t gridX, uint32_t gridY, ShadingRateStats& stats)
+{
+    gridX = std::max(1u, std::min(gridX, std::max(width, 1u)));
+    gridY = std::max(1u, std::min(gridY, std::max(height, 1u)));
+
+    stats.NumTiles = width * height;
+    stats.GridX = gridX;
+    stats.GridY = gridY;
+    stats.Total = ShadingRateCounts();
+    stats.Cells.assign(gridX * gridY, ShadingRateCounts());
+
+    // Each row counts its span of every cell column, then the rows are summed in order
+    std::vector<ShadingRateCounts> rowCounts((size_t)height * gridX, ShadingRateCounts());
+    concurrency::parallel_for(0u, height, [&]( uint32_t y )
+    {
+        const uint8_t* row = rates + (size_t)y * rowPitch;
+        for (uint32_t cx = 0; cx < gridX; ++cx)
+        {
+            const uint32_t x0 = (uint32_t)((uint64_t)cx * width / gridX);
+            const uint32_t x1 = (uint32_t)((uint64_t)(cx + 1) * width / gridX);
+            CountSpan(row + x0, x1 - x0, rowCounts[(size_t)y * gridX + cx].Counts);
+        }
+    });
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint32_t cy = (uint32_t)((uint64_t)y * gridY / height);
+        for (uint32_t cx = 0; cx < gridX; ++cx)
+        {
+            const ShadingRateCounts& row = rowCounts[(size_t)y * gridX + cx];
+            ShadingRateCounts& cell = stats.Cells[cy * gridX + cx];
+            for (int r = 0; r < 7; ++r)
+            {
+                cell.Counts[r] += row.Counts[r];
+                stats.Total.Counts[r] += row.Counts[r];
+            }
+        }
+    }
+}
+
+void VRS::CountShadingRates(const uint8_t* rates, uint32_t numTiles, uint32_t histogram[7])
+{
+    for (int r = 0; r < 7; ++r)
+        histogram[r] = 0;
+    CountSpan(rates, numTiles, histogram);
+}
+
+float VRS::GetShadingWork(const ShadingRateCounts& counts)
+{
+    uint32_t numTiles = 0;
+    float work = 0.0f;
+    for (int r = 0; r < 7; ++r)
+    {
+        numTiles += counts.Counts[r];
+        work += counts.Counts[r] / kPixelsPerInvocation[r];
+    }
+    return numTiles > 0 ? work / numTiles : 1.0f;
+}
+
+ShadingRateHistory::ShadingRateHistory(uint32_t length) :
+    m_Values(std::max(length, 1u) * kValuesPerFrame), m_Length(std::max(length, 1u)), m_Next(0), m_NumFrames(0)
+{
+}
+
+void ShadingRateHistory::Push(const ShadingRateCounts& counts)
+{
+    uint32_t numTiles = 0;
+    for (int r = 0; r < 7; ++r)
+        numTiles += counts.Counts[r];
+    const float scale = numTiles > 0 ? 100.0f / numTiles : 0.0f;
+
+    float* values = &m_Values[m_Next * kValuesPerFrame];
+    for (int r = 0; r < 7; ++r)
+        values[r] = counts.Counts[r] * scale;
+    values[7] = GetShadingWork(counts) * 100.0f;
+
+    m_Next = (m_Next + 1) % m_Length;
+    m_NumFrames = std::min(m_NumFrames + 1, m_Length);
+}
+
+void ShadingRateHistory::Clear(void)
+{
+    m_Next = 0;
+    m_NumFrames = 0;
+}
+
+void ShadingRateHistory::GetAverage(float percents[7], float& work) const
+{
+    float sums[kValuesPerFrame] = {};
+    for (uint32_t f = 0; f < m_NumFrames; ++f)
+    {
+        for (uint32_t v = 0; v < kValuesPerFrame; ++v)
+            sums[v] += m_Values[f * kValuesPerFrame + v];
+    }
+
+    const float scale = m_NumFrames > 0 ? 1.0f / m_NumFrames : 0.0f;
+    for (int r = 0; r < 7; ++r)
+        percents[r] = sums[r] * scale;
+    work = sums[7] * scale;
+}
+
+void ShadingRateHistory::GetWorkRange(float& minWork, float& maxWork) const
+{
+    minWork = maxWork = 0.0f;
+    for (uint32_t f = 0; f < m_NumFrames; ++f)
+    {
+        const float work = m_Values[f * kValuesPerFrame + 7];
+        minWork = f == 0 ? work : std::min(minWork, work);
+        maxWork = f == 0 ? work : std::max(maxWork, work);
+    }
+}
+
+void VRS::BenchmarkShadingRateStats(void)
+{
+    struct FrameSize { const char* name; uint32_t width, height; };
+    const FrameSize frameSizes[] = { { "4K", 3840, 2160 }, { "8K", 7680, 4320 } };
+    const uint32_t tileSizes[] = { 16, 8 };
+    const uint32_t kRepeats = 20;
+
+    Utility::Printf("Shading rate statistics benchmark (4x4 grid, %u runs each)\n", kRepeats);
+
+    std::mt19937 rng(7);
+    for (const FrameSize& size : frameSizes)
+    {
+        for (uint32_t tileSize : tileSizes)
+        {
+            const uint32_t width = (size.width + tileSize - 1) / tileSize;
+            const uint32_t height = (size.height + tileSize - 1) / tileSize;
+
+            // Readbacks pad rows to 256 bytes.  Coarse rates come in blobs, so fill runs of tiles,
+            // with the odd invalid value that must not be counted.
+            const uint32_t rowPitch = (width + 255) & ~255u;
+            std::vector<uint8_t> rates((size_t)rowPitch * height, 0xFF);
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width; )
+                {
+                    const uint32_t run = std::min(width - x, 1 + (uint32_t)rng() % 24);
+                    const uint32_t pick = (uint32_t)rng() % 64;
+                    const uint8_t value = pick == 0 ? (uint8_t)3 : kRateValues[pick % 7];
+                    memset(&rates[(size_t)y * rowPitch + x], value, run);
+                    x += run;
+                }
+            }
+
+            ShadingRateStats stats;
+            int64_t startTick = SystemTime::GetCurrentTick();
+            for (uint32_t i = 0; i < kRepeats; ++i)
+                ComputeShadingRateStats(rates.data(), width, height, rowPitch, 4, 4, stats);
+            double seconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / kRepeats;
+
+            uint32_t reference[7];
+            startTick = SystemTime::GetCurrentTick();
+            for (uint32_t i = 0; i < kRepeats; ++i)
+                CountShadingRatesScalar(rates.data(), width, height, rowPitch, reference);
+            double referenceSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / kRepeats;
+
+            // The cells must partition the image
+            bool identical = true;
+            for (int r = 0; r < 7; ++r)
+            {
+                uint32_t cellSum = 0;
+                for (const ShadingRateCounts& cell : stats.Cells)
+                    cellSum += cell.Counts[r];
+                identical &= stats.Total.Counts[r] == reference[r] && cellSum == reference[r];
+            }
+
+            Utility::Printf("  %s %2ux%-2u tiles %4ux%-4u:  %7.3f ms  (switch %7.3f ms, %s)\n", size.name, tileSize, tileSize,
+                width, height, seconds * 1000.0, referenceSeconds * 1000.0, identical ? "identical" : "MISMATCH");
+        }
+    }
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2022 Intel Corporation
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+// OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Shading rate statistics over a readback of the shading rate image: tile counts for the whole
+// screen and for each cell of a grid, plus a rolling history of the whole screen breakdown.
+
+namespace VRS
+{
+    // Tile counts indexed by ShadingRates.  Tiles holding any other value are not counted.
+    struct ShadingRateCounts
+    {
+        uint32_t Counts[7];
+    };
+
+    struct ShadingRateStats
+    {
+        uint32_t NumTiles = 0;
+        uint32_t GridX = 0;
+        uint32_t GridY = 0;
+        ShadingRateCounts Total = {};
+
+        // Row major.  Cell column i starts at tile column i * width / GridX, and likewise for rows.
+        std::vector<ShadingRateCounts> Cells;
+    };
+
+    // Counts the D3D12_SHADING_RATE tiles of a width by height image with rowPitch bytes per row.
+    // Rows are spread across worker threads and counted 16 tiles at a time with SSE.  A 2x2 grid
+    // gives screen quadrants.
+    void ComputeShadingRateStats(const uint8_t* rates, uint32_t width, uint32_t height, uint32_t rowPitch,
+        uint32_t gridX, uint32_t gridY, ShadingRateStats& stats);
+
+    // Tile counts of a tightly packed shading rate image, indexed by ShadingRates
+    void CountShadingRates(const uint8_t* rates, uint32_t numTiles, uint32_t histogram[7]);
+
+    // Pixel shader invocations relative to full rate shading, assuming equal sized tiles
+    float GetShadingWork(const ShadingRateCounts& counts);
+
+    // The whole screen percentages of the last few frames
+    class ShadingRateHistory
+    {
+    public:
+        explicit ShadingRateHistory(uint32_t length = 120);
+
+        void Push(const ShadingRateCounts& counts);
+        void Clear(void);
+
+        uint32_t GetLength(void) const { return m_Length; }
+        uint32_t GetNumFrames(void) const { return m_NumFrames; }
+
+        // Means over the recorded frames of the percent of tiles at each rate and of the shading
+        // work, and the work's range
+        void GetAverage(float percents[7], float& work) const;
+        void GetWorkRange(float& minWork, float& maxWork) const;
+
+    private:
+        static const uint32_t kValuesPerFrame = 8;  // Seven rates, then work
+
+        std::vector<float> m_Values;
+        uint32_t m_Length;
+        uint32_t m_Next;
+        uint32_t m_NumFrames;
+    };
+
+    // Times the SSE kernel against a byte at a time switch on synthetic shading rate images for 4K
+    // and 8K frames with 8x8 and 16x16 tiles, and checks that they agree.
+    void BenchmarkShadingRateStats(void);
+}
@@ -24,6 +24,10 @@
 #include "CameraController.h"
 #include "GameInput.h"
 #include "VRSScreenshot.h"
+#include "ImageMetrics.h"
+#include "VRSBatch.h"
+#include "VRSContrastAdaptiveCPU.h"
+#include "SystemTime.h"
 
 #include <conio.h>
 #include <sys/types.h>
@@ -54,24 +58,6 @@ using namespace std;
 
 #define ACCUMULATE_FRAMES 1000
 
-std::string exec(const char* command) {
-    char tmpname[L_tmpnam];
-    std::tmpnam(tmpname);
-    std::string scommand = command;
-    std::string cmd = scommand + " > " + tmpname + " 2>&1";
-    std::system(cmd.c_str());
-    std::ifstream file(tmpname, std::ios::in | std::ios::binary);
-    std::string result;
-    if (file) {
-        while (!file.eof()) result.push_back(file.get())
-            ;
-        file.close();
-    }
-    remove(tmpname);
-    result.pop_back();
-    return result;
-}
-
 namespace VRSTest
 {
     bool RunningTest = false;
@@ -92,6 +78,19 @@ namespace VRSTest
     UnitTestMode TestMode = UnitTestMode::TestModeNone;
     UnitTestState TestState = UnitTestState::TestStateNone;
 
+    // The control screenshot that every later experiment of the test is compared against
+    std::vector<uint8_t> controlPixels;
+
+    // Poses being captured for the VRS batch runner
+    VRSBatch::Script captureScript;
+    uint32_t capturePoseIndex = 0;
+    uint32_t captureWaitFrames = 0;
+    uint32_t skippedPoses = 0;
+
+    // A capture normally completes a frame or two after it is requested.  If the contrast
+    // adaptive pass stops running, the pose is skipped after this many frames.
+    const uint32_t kCaptureTimeoutFrames = 120;
+
     const Location locales[3] = { Location(1.55f, 0.0f, Math::Vector3(-850.0f, 150.0f, -40.0f)), //lion head
                               Location(4.70f, 0.0f, Math::Vector3(-900.0f, 200.0f, -40.0f)), //first floor view
                               Location(0.0f, 0.0f, Math::Vector3(-430.0f, 160.0f, 150.0f)), //cloth
@@ -499,28 +498,104 @@ void VRSTest::Update(CameraController* camera, float deltaT)
             }
         }
         break;
+        case UnitTestState::CaptureScriptPose:
+        {
+            if (capturePoseIndex >= captureScript.Poses.size())
+            {
+                printf("Captured %u poses for the VRS batch runner, skipped %u\n",
+                    (uint32_t)captureScript.Poses.size() - skippedPoses, skippedPoses);
+                RunningTest = false;
+                TestState = UnitTestState::TestStateNone;
+                break;
+            }
+
+            FlyingFPSCamera* const fpsCamera = dynamic_cast<FlyingFPSCamera*> (camera);
+            if (fpsCamera == nullptr)
+            {
+                printf("Unable to move camera, not FPSCamera.\n");
+                RunningTest = false;
+                TestState = UnitTestState::TestStateNone;
+                break;
+            }
+
+            const VRSBatch::Pose& pose = captureScript.Poses[capturePoseIndex];
+            fpsCamera->SetHeadingPitchAndPosition(pose.Heading, pose.Pitch, Math::Vector3(pose.Position[0], pose.Position[1], pose.Position[2]));
+            TestState = UnitTestState::WaitScriptPose;
+        }
+        break;
+        case UnitTestState::WaitScriptPose:
+        {
+            // Let temporal effects and auto exposure settle before capturing
+            countdownTimer -= deltaT;
+            if (countdownTimer <= 0.0f)
+            {
+                countdownTimer = 5.0f;
+                VRS::RequestContrastAdaptiveFrameSave(VRSBatch::GetFramePath(captureScript, captureScript.Poses[capturePoseIndex]));
+                captureWaitFrames = 0;
+                TestState = UnitTestState::WaitScriptCapture;
+            }
+        }
+        break;
+        case UnitTestState::WaitScriptCapture:
+        {
+            if (!VRS::IsContrastAdaptiveFrameSavePending())
+            {
+                capturePoseIndex++;
+                TestState = UnitTestState::CaptureScriptPose;
+            }
+            else if (++captureWaitFrames >= kCaptureTimeoutFrames)
+            {
+                printf("Skipped pose %u:  the contrast adaptive pass did not capture it within %u frames\n",
+                    capturePoseIndex, kCaptureTimeoutFrames);
+                VRS::CancelContrastAdaptiveFrameSave();
+                skippedPoses++;
+                capturePoseIndex++;
+                TestState = UnitTestState::CaptureScriptPose;
+            }
+        }
+        break;
+    }
+}
+
+bool VRSTest::StartScriptCapture(const std::wstring& scriptPath)
+{
+    if (RunningTest || !VRSBatch::LoadScript(scriptPath, captureScript))
+    {
+        return false;
+    }
+
+    if (!VRS::IsVRSTierSupported(D3D12_VARIABLE_SHADING_RATE_TIER_2))
+    {
+        printf("Script capture needs the contrast adaptive pass, which requires Tier 2 VRS\n");
+        return false;
     }
+
+    // The frames are grabbed from the contrast adaptive pass, so it has to run
+    VRS::Enable = true;
+    VRS::DebugDraw = false;
+    VRS::ShadingModes = VRS::ShadingMode::ContrastAdaptiveGPU;
+
+    capturePoseIndex = 0;
+    skippedPoses = 0;
+    countdownTimer = 5.0f;
+    RunningTest = true;
+    TestState = UnitTestState::CaptureScriptPose;
+    return true;
 }
 
 void VRSTest::ResetExperimentData()
 {
+    controlPixels.clear();
+
     std::ofstream outfile;
     std::string filename = std::string("c:\\VRSExperiments\\").append(Test->GetName()).append("\\").append(Test->GetName()).append("-Results.csv");
     outfile.open(filename.c_str());
     outfile << "UnitTest,Experiment,Threshold,K,Env. Luma,Weber-Fechner Constant,PSInvocations,CPUTime,GPUTime,FrameRate,1x1,1x2,2x1,2x2,2x4,4x2,4x4,"
-            << "AE,DSSIM,FUZZ,MAE,MEPP,MSE,NCC,PAE,PHASH,RMSE,SSIM,PSNR,Path" << std::endl;
+            << "AE,MAE,MSE,RMSE,PSNR,PAE,NCC,SSIM,DSSIM,FLIP Mean,FLIP Median,FLIP Max,Path" << std::endl;
     outfile.close();
-
-    filename = std::string("c:\\VRSExperiments\\").append(Test->GetName()).append("\\").append(Test->GetName()).append("-FLIP.txt");
-    outfile.open(filename.c_str());
-    outfile << "";
-    outfile.close();
-
-    filename = std::string("c:\\VRSExperiments\\").append(Test->GetName()).append("\\").append("FLIP.csv");
-    remove(filename.c_str());
 }
 
-void VRSTest::WriteExperimentData(std::string& AE, std::string& DSSIM, std::string& FUZZ, std::string& MAE, std::string& MEPP, std::string& MSE, std::string& NCC, std::string& PAE, std::string& PHASH, std::string& RMSE, std::string& SSIM, std::string& PSNR, std::string& FLIP)
+void VRSTest::WriteExperimentData(const ImageMetrics::Report& metrics)
 {
     float frameRate = 1.0f / EngineProfiling::GetFrameRate();
 
@@ -528,6 +603,7 @@ void VRSTest::WriteExperimentData(std::string& AE, std::string& DSSIM, std::stri
     std::string filename = std::string("c:\\VRSExperiments\\").append(Test->GetName()).append("\\").append(Test->GetName()).append("-Results.csv");
     std::string imagePath = std::string("c:\\VRSExperiments\\").append(Test->GetName()).append("\\").append((*NextExperiment)->GetName()).append(".png");
     outfile.open(filename.c_str(), std::ios_base::app);
+    outfile.precision(9);
     outfile << Test->GetName() << ","
         << (*NextExperiment)->GetName() << ","
         << (float)VRS::ContrastAdaptiveSensitivityThreshold << ","
@@ -545,26 +621,20 @@ void VRSTest::WriteExperimentData(std::string& AE, std::string& DSSIM, std::stri
         << VRS::Percents.num2x4 << ","
         << VRS::Percents.num4x2 << ","
         << VRS::Percents.num4x4 << ","
-        << AE << ","
-        << DSSIM << ","
-        << FUZZ << ","
-        << MAE << ","
-        << MEPP << ","
-        << MSE << ","
-        << NCC << ","
-        << PAE << ","
-        << PHASH << ","
-        << RMSE << ","
-        << SSIM << ","
-        << PSNR << ","
+        << metrics.AE << ","
+        << metrics.MAE << ","
+        << metrics.MSE << ","
+        << metrics.RMSE << ","
+        << metrics.PSNR << ","
+        << metrics.PAE << ","
+        << metrics.NCC << ","
+        << metrics.SSIM << ","
+        << metrics.DSSIM << ","
+        << metrics.FLIPMean << ","
+        << metrics.FLIPMedian << ","
+        << metrics.FLIPMax << ","
         << imagePath << std::endl;
     outfile.close();
-
-    filename = std::string("c:\\VRSExperiments\\").append(Test->GetName()).append("\\").append(Test->GetName()).append("-FLIP.txt");
-    outfile.open(filename.c_str(), std::ios_base::app);
-    outfile << "[Unit Test: " << Test->GetName() << " Experiment: " << (*NextExperiment)->GetName() << "]\n";
-    outfile << FLIP;
-    outfile.close();
 }
 
 bool VRSTest::Render(CommandContext& context, ColorBuffer& source, ColorBuffer& vrsBuffer)
@@ -577,131 +647,54 @@ bool VRSTest::Render(CommandContext& context, ColorBuffer& source, ColorBuffer&
 
             std::string filename = std::string("c:\\VRSExperiments\\").append(Test->GetName()).append("\\").append(exp->GetName()).append(".png");
             std::string vrsfilename = std::string("c:\\VRSExperiments\\").append(Test->GetName()).append("\\").append(exp->GetName()).append("-VRSBuffer.png");
-            
-            Screenshot::TakeScreenshotAndExportVRSBuffer(filename.c_str(), source, vrsfilename.c_str(), vrsBuffer, context, exp->CaptureVRSBuffer());
 
-            std::string AE, DSSIM, FUZZ, MAE, MEPP, MSE, NCC, PAE, PHASH, RMSE, SSIM, PSNR, FLIP;
+            std::vector<uint8_t> pixels;
+            Screenshot::TakeScreenshotAndExportVRSBuffer(filename.c_str(), source, vrsfilename.c_str(), vrsBuffer, context, exp->CaptureVRSBuffer(), &pixels);
+
+            const uint32_t width = source.GetWidth();
+            const uint32_t height = source.GetHeight();
+
+            if (exp->IsControl())
+            {
+                controlPixels = pixels;
+            }
 
             if (exp->CaptureStats())
             {
                 printf("[Unit Test: %s Experiment: %s]\n", Test->GetName().c_str(), exp->GetName().c_str());
 
-                std::string controlPath("\"C:\\VRSExperiments\\");
-                controlPath.append(Test->GetName()).append("\\Control.png\"");
-
-                std::string experimentPath("\"C:\\VRSExperiments\\");
-                experimentPath.append(Test->GetName()).append("\\").append(exp->GetName()).append(".png\"");
-
-                std::string differencePath("\"C:\\VRSExperiments\\");
-                differencePath.append(Test->GetName()).append("\\").append(exp->GetName()).append("-diff.png\"");
-
-                std::string cmd("magick compare -metric AE");
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                AE = exec(cmd.c_str());
-                printf("AE: %s\n", AE.c_str());
-
-                cmd = "magick compare -metric DSSIM";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                DSSIM = exec(cmd.c_str());
-                printf("DSSIM: %s\n", DSSIM.c_str());
-
-                cmd = "magick compare -metric FUZZ";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                FUZZ = exec(cmd.c_str());
-                printf("FUZZ: %s\n", FUZZ.c_str());
-
-                cmd = "magick compare -metric MAE";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                MAE = exec(cmd.c_str());
-                printf("MAE: %s\n", MAE.c_str());
-
-                cmd = "magick compare -metric MEPP";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                MEPP = exec(cmd.c_str());
-                std::replace(MEPP.begin(), MEPP.end(), ',', ';');
-                printf("MEPP: %s\n", MEPP.c_str());
-
-                cmd = "magick compare -metric MSE";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                MSE = exec(cmd.c_str());
-                printf("MSE: %s\n", MSE.c_str());
-
-                cmd = "magick compare -metric NCC";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                NCC = exec(cmd.c_str());
-                printf("NCC: %s\n", NCC.c_str());
-
-                cmd = "magick compare -metric PAE";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                PAE = exec(cmd.c_str());
-                printf("PAE: %s\n", PAE.c_str());
-
-                cmd = "magick compare -metric PHASH";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                PHASH = exec(cmd.c_str());
-                printf("PHASH: %s\n", PHASH.c_str());
-
-                cmd = "magick compare -metric RMSE";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                RMSE = exec(cmd.c_str());
-                printf("RMSE: %s\n", RMSE.c_str());
-
-                cmd = "magick compare -metric SSIM";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                SSIM = exec(cmd.c_str());
-                printf("SSIM: %s\n", SSIM.c_str());
-
-                cmd = "magick compare -metric PSNR";
-                cmd.append(" ").append(controlPath);
-                cmd.append(" ").append(experimentPath);
-                cmd.append(" ").append(differencePath);
-                PSNR = exec(cmd.c_str());
-                printf("PSNR: %s\n", PSNR.c_str());
-
-                std::string flipCSV("C:\\VRSExperiments\\");
-                flipCSV.append(Test->GetName()).append("\\FLIP.csv");
-
-                cmd = "cd C:\\VRSExperiments\\";
-                cmd.append(Test->GetName());
-                cmd.append(" & C:\\VRSExperiments\\FLIP\\flip.exe --reference ");
-                cmd.append(controlPath);
-                cmd.append(" --test ").append(experimentPath);
-                cmd.append(" --save-ldrflip --save-ldr-images -hist --basename ").append(exp->GetName()).append("-FLIP");
-                cmd.append(" --csv ").append(flipCSV);
-                FLIP = exec(cmd.c_str());
-                printf("FLIP: %s\n\n", FLIP.c_str());
-                
-                std::string createFlipPDF("cd C:\\VRSExperiments\\");
-                createFlipPDF.append(Test->GetName());
-                createFlipPDF.append(" & \"C:\\Program Files (x86)\\Microsoft Visual Studio\\Shared\\Python37_64\\python.exe\" ");
-                createFlipPDF.append(exp->GetName()).append("-FLIP.py");
-                printf("FLIP PDF CMD: %s\n", createFlipPDF.c_str());
-                std::string result = exec(createFlipPDF.c_str());
-                printf("%s\n", result.c_str());
-
-                WriteExperimentData(AE, DSSIM, FUZZ, MAE, MEPP, MSE, NCC, PAE, PHASH, RMSE, SSIM, PSNR, FLIP);
+                if (controlPixels.size() != pixels.size())
+                {
+                    printf("No control image to compare against\n\n");
+                }
+                else
+                {
+                    ImageMetrics::Image reference = { controlPixels.data(), width, height, width * 4 };
+                    ImageMetrics::Image test = { pixels.data(), width, height, width * 4 };
+                    ImageMetrics::Report metrics;
+                    std::vector<float> flipErrorMap((size_t)width * height);
+
+                    int64_t startTick = SystemTime::GetCurrentTick();
+                    ImageMetrics::Compare(reference, test, ImageMetrics::Settings(), metrics, flipErrorMap.data());
+                    double seconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+                    printf("AE: %llu\n", (unsigned long long)metrics.AE);
+                    printf("MAE: %g\n", metrics.MAE);
+                    printf("MSE: %g\n", metrics.MSE);
+                    printf("RMSE: %g\n", metrics.RMSE);
+                    printf("PSNR: %g\n", metrics.PSNR);
+                    printf("PAE: %g\n", metrics.PAE);
+                    printf("NCC: %g\n", metrics.NCC);
+                    printf("SSIM: %g\n", metrics.SSIM);
+                    printf("DSSIM: %g\n", metrics.DSSIM);
+                    printf("FLIP: mean %g, median %g, max %g\n", metrics.FLIPMean, metrics.FLIPMedian, metrics.FLIPMax);
+                    printf("Metrics took %.1f ms\n\n", seconds * 1000.0);
+
+                    std::string flipfilename = std::string("c:\\VRSExperiments\\").append(Test->GetName()).append("\\").append(exp->GetName()).append("-FLIP.png");
+                    Screenshot::WriteErrorMap(flipfilename.c_str(), (int)width, (int)height, flipErrorMap.data());
+
+                    WriteExperimentData(metrics);
+                }
             }
 
             VRSTest::takeScreenshot = false;
@@ -24,6 +24,8 @@
 class CameraController;
 class ColorBuffer;
 
+namespace ImageMetrics { struct Report; }
+
 enum UnitTestState
 {
     TestStateNone,
@@ -36,6 +38,9 @@ enum UnitTestState
     Teardown,
     FlyCamera,
     WaitFlyCamera,
+    CaptureScriptPose,
+    WaitScriptPose,
+    WaitScriptCapture,
 };
 
 enum UnitTestMode
@@ -104,12 +109,10 @@ namespace VRSTest
     void MoveCamera(CameraController* camera, UnitTestMode testMode);
     UnitTestMode CheckIfChangeLocationKeyPressed();
     void ResetExperimentData();
-    void WriteExperimentData(
-        std::string& AE, std::string& DSSIM, std::string& FUZZ, 
-        std::string& MAE, std::string& MEPP, std::string& MSE, 
-        std::string& NCC, std::string& PAE, std::string& PHASH, 
-        std::string& RMSE, std::string& SSIM, std::string& PSNR, 
-        std::string& FLIP);
+    void WriteExperimentData(const ImageMetrics::Report& metrics);
+
+    // Flies to each pose of a VRSBatch script and saves the contrast adaptive pass's inputs there
+    bool StartScriptCapture(const std::wstring& scriptPath);
 
 }
 
@@ -20,11 +20,6 @@
 using Math::Quaternion;
 using Math::Vector4;
 
-static inline float ToFloat(const int8_t x) { return Math::Max(x / 127.0f, -1.0f); }
-static inline float ToFloat(const uint8_t x) { return x / 255.0f; }
-static inline float ToFloat(const int16_t x) { return Math::Max(x / 32767.0f, -1.0f); }
-static inline float ToFloat(const uint16_t x) { return x / 65535.0f; }
-
 static inline void Lerp3(float* Dest, const float* Key1, const float* Key2, float T)
 {
     Dest[0] = Math::Lerp(Key1[0], Key2[0], T);
@@ -32,10 +27,49 @@ static inline void Lerp3(float* Dest, const float* Key1, const float* Key2, floa
     Dest[2] = Math::Lerp(Key1[2], Key2[2], T);
 }
 
-template <typename T>
-static inline Quaternion ToQuat(const T* rot)
+static inline void ToFloat3(float* Dest, const uint16_t* Key, const AnimationKeyRange& Range)
 {
-    return (Quaternion)Vector4(ToFloat(rot[0]), ToFloat(rot[1]), ToFloat(rot[2]), ToFloat(rot[3]));
+    Dest[0] = Range.bias[0] + Range.scale[0] * Key[0];
+    Dest[1] = Range.bias[1] + Range.scale[1] * Key[1];
+    Dest[2] = Range.bias[2] + Range.scale[2] * Key[2];
+}
+
+static inline void Lerp3(float* Dest, const byte* Key1, const byte* Key2, float T, uint32_t Format, const byte* Range)
+{
+    switch (Format)
+    {
+    case AnimationCurve::kUNorm16:
+    {
+        const AnimationKeyRange& range = *(const AnimationKeyRange*)Range;
+        float key1[3], key2[3];
+        ToFloat3(key1, (const uint16_t*)Key1, range);
+        ToFloat3(key2, (const uint16_t*)Key2, range);
+        Lerp3(Dest, key1, key2, T);
+        break;
+    }
+    case AnimationCurve::kFloat:
+        Lerp3(Dest, (const float*)Key1, (const float*)Key2, T);
+        break;
+    default:
+        ASSERT(0, "Unexpected animation key frame data format");
+        break;
+    }
+}
+
+// Rebuilds the largest component from the other three, which are stored in order
+static inline Quaternion ToQuat(const int16_t* rot)
+{
+    const float kScale = 0.70710678f / 32767.0f;
+    const float a = rot[0] * kScale, b = rot[1] * kScale, c = rot[2] * kScale;
+    const float largest = sqrtf(Math::Max(1.0f - a * a - b * b - c * c, 0.0f));
+
+    switch (rot[3] & 3)
+    {
+    case 0:  return (Quaternion)Vector4(largest, a, b, c);
+    case 1:  return (Quaternion)Vector4(a, largest, b, c);
+    case 2:  return (Quaternion)Vector4(a, b, largest, c);
+    default: return (Quaternion)Vector4(a, b, c, largest);
+    }
 }
 
 static inline Quaternion ToQuat(const float* rot)
@@ -47,20 +81,6 @@ static inline void Slerp(float* Dest, const void* Key1, const void* Key2, float
 {
     switch (Format)
     {
-    case AnimationCurve::kSNorm8:
-    {
-        const int8_t* key1 = (const int8_t*)Key1;
-        const int8_t* key2 = (const int8_t*)Key2;
-        XMStoreFloat4((XMFLOAT4*)Dest, (FXMVECTOR)Math::Slerp(ToQuat(key1), ToQuat(key2), T));
-        break;
-    }
-    case AnimationCurve::kUNorm8:
-    {
-        const uint8_t* key1 = (const uint8_t*)Key1;
-        const uint8_t* key2 = (const uint8_t*)Key2;
-        XMStoreFloat4((XMFLOAT4*)Dest, (FXMVECTOR)Math::Slerp(ToQuat(key1), ToQuat(key2), T));
-        break;
-    }
     case AnimationCurve::kSNorm16:
     {
         const int16_t* key1 = (const int16_t*)Key1;
@@ -68,13 +88,6 @@ static inline void Slerp(float* Dest, const void* Key1, const void* Key2, float
         XMStoreFloat4((XMFLOAT4*)Dest, (FXMVECTOR)Math::Slerp(ToQuat(key1), ToQuat(key2), T));
         break;
     }
-    case AnimationCurve::kUNorm16:
-    {
-        const uint16_t* key1 = (const uint16_t*)Key1;
-        const uint16_t* key2 = (const uint16_t*)Key2;
-        XMStoreFloat4((XMFLOAT4*)Dest, (FXMVECTOR)Math::Slerp(ToQuat(key1), ToQuat(key2), T));
-        break;
-    }
     case AnimationCurve::kFloat:
     {
         const float* key1 = (const float*)Key1;
@@ -87,20 +100,62 @@ static inline void Slerp(float* Dest, const void* Key1, const void* Key2, float
         break;
     }
 }
-void ModelInstance::UpdateAnimations(float deltaTime)
+
+void SampleAnimationCurve(const AnimationCurve& curve, const uint8_t* keyFrameData, float time, GraphNode& node)
 {
-    uint32_t NumAnimations = m_Model->m_NumAnimations;
-    GraphNode* animGraph = m_AnimGraph.get();
+    ASSERT(curve.numSegments > 0);
+
+    const float progress = Math::Clamp((time - curve.startTime) * curve.rangeScale, 0.0f, curve.numSegments);
+    uint32_t segment = (uint32_t)progress;
+    float lerpT = progress - (float)segment;
 
-    for (uint32_t i = 0; i < NumAnimations; ++i)
+    // The last key frame ends the last segment rather than starting another
+    if ((float)segment >= curve.numSegments)
     {
-        AnimationState& anim = m_AnimState[i];
+        segment = (uint32_t)curve.numSegments - 1;
+        lerpT = 1.0f;
+    }
+
+    if (curve.interpolation == AnimationCurve::kStep)
+        lerpT = lerpT < 1.0f ? 0.0f : 1.0f;
+
+    const size_t stride = curve.keyFrameStride * 4;
+    const byte* keys = keyFrameData + curve.keyFrameOffset;
+    const byte* key1 = keys + stride * segment;
+    const byte* key2 = key1 + stride;
+    const byte* range = keys - sizeof(AnimationKeyRange);
+
+    switch (curve.targetPath)
+    {
+    case AnimationCurve::kTranslation:
+        Lerp3((float*)&node.xform + 12, key1, key2, lerpT, curve.keyFrameFormat, range);
+        break;
+    case AnimationCurve::kRotation:
+        node.staleMatrix = true;
+        Slerp((float*)&node.rotation, key1, key2, lerpT, curve.keyFrameFormat);
+        break;
+    case AnimationCurve::kScale:
+        node.staleMatrix = true;
+        Lerp3((float*)&node.scale, key1, key2, lerpT, curve.keyFrameFormat, range);
+        break;
+    default:
+    case AnimationCurve::kWeights:
+        ASSERT(0, "Unhandled blend shape weights in animation");
+        break;
+    }
+}
+
+void AdvanceAnimations(AnimationState* states, const AnimationSet* animations, uint32_t numAnimations, float deltaTime)
+{
+    for (uint32_t i = 0; i < numAnimations; ++i)
+    {
+        AnimationState& anim = states[i];
         if (anim.state == AnimationState::kStopped)
             continue;
 
         anim.time += deltaTime;
 
-        const AnimationSet& animation = m_Model->m_Animations[i];
+        const AnimationSet& animation = animations[i];
 
         if (anim.state == AnimationState::kLooping)
         {
@@ -111,46 +166,15 @@ void ModelInstance::UpdateAnimations(float deltaTime)
             anim.time = 0.0f;
             anim.state = AnimationState::kStopped;
         }
+    }
+}
 
-        const AnimationCurve* firstCurve = m_Model->m_CurveData.get() + animation.firstCurve;
+void ModelInstance::UpdateAnimations(float deltaTime)
+{
+    AdvanceAnimations(m_AnimState.data(), m_Model->m_Animations, m_Model->m_NumAnimations, deltaTime);
 
-        // Update animation nodes
-        for (uint32_t j = 0; j < animation.numCurves; ++j)
-        {
-            const AnimationCurve& curve = firstCurve[j];
-            ASSERT(curve.numSegments > 0);
-
-            const float progress = Math::Clamp((anim.time - curve.startTime) * curve.rangeScale, 0.0f, curve.numSegments);
-            const uint32_t segment = (uint32_t)progress;
-            const float lerpT = progress - (float)segment;
-
-            const size_t stride = curve.keyFrameStride * 4;
-            const byte* key1 = m_Model->m_KeyFrameData.get() + curve.keyFrameOffset + stride * segment;
-            const byte* key2 = key1 + stride;
-            GraphNode& node = animGraph[curve.targetNode];
-
-            switch (curve.targetPath)
-            {
-            case AnimationCurve::kTranslation:
-                ASSERT(curve.keyFrameFormat == AnimationCurve::kFloat);
-                Lerp3((float*)&node.xform + 12, (const float*)key1, (const float*)key2, lerpT);
-                break;
-            case AnimationCurve::kRotation:
-                node.staleMatrix = true;
-                Slerp((float*)&node.rotation, key1, key2, lerpT, curve.keyFrameFormat);
-                break;
-            case AnimationCurve::kScale:
-                ASSERT(curve.keyFrameFormat == AnimationCurve::kFloat);
-                node.staleMatrix = true;
-                Lerp3((float*)&node.scale, (const float*)key1, (const float*)key2, lerpT);
-                break;
-            default:
-            case AnimationCurve::kWeights:
-                ASSERT(0, "Unhandled blend shape weights in animation");
-                break;
-            }
-        }
-    }
+    // Update animation nodes
+    m_Model->m_AnimationBlender.Evaluate(m_AnimState.data(), m_AnimGraph.get(), m_AnimWorkspace);
 }
 
 void ModelInstance::PlayAnimation(uint32_t animIdx, bool loop)
@@ -165,6 +189,15 @@ void ModelInstance::PauseAnimation(uint32_t animIdx)
         m_AnimState[animIdx].state = AnimationState::kStopped;
 }
 
+void ModelInstance::SetAnimationWeight(uint32_t animIdx, float weight, bool additive)
+{
+    if (animIdx < m_AnimState.size())
+    {
+        m_AnimState[animIdx].weight = Math::Max(weight, 0.0f);
+        m_AnimState[animIdx].additive = additive;
+    }
+}
+
 void ModelInstance::ResetAnimation(uint32_t animIdx)
 {
     if (animIdx >= m_AnimState.size())
@@ -39,6 +39,24 @@ struct AnimationCurve
     float rangeScale;                   // numSegments / (endTime - startTime)
 };
 
+//
+// Translation, rotation, and scale curves are resampled when cooked, so their key frames are
+// always evenly spaced and use one of these encodings:
+//
+//   kFloat      Three or four floats
+//   kUNorm16    Translation and scale:  three uint16 and one of padding.  The value is
+//               bias + scale * key, with the ranges stored just before the first key frame.
+//   kSNorm16    Rotation:  the "smallest three" quaternion components in [-1/sqrt(2), 1/sqrt(2)]
+//               followed by the index of the largest, which is positive and left out.
+//
+// Blend shape weights are stored as authored.
+//
+struct AnimationKeyRange
+{
+    float bias[3];
+    float scale[3];
+};
+
 //
 // An animation is composed of multiple animation curves.
 //
@@ -51,12 +69,25 @@ struct AnimationSet
 
 //
 // Animation state indicates whether an animation is playing and keeps track of current
-// position within the animation's playback.
+// position within the animation's playback.  Animations that play at the same time are blended
+// by weight, and additive ones are then layered on top as differences from the rest pose.
 //
 struct AnimationState
 {
     enum eMode { kStopped, kPlaying, kLooping };
     eMode state;
     float time;
-    AnimationState() : state(kStopped), time(0.0f) {}
+    float weight;       // Relative to other animations, or the strength of an additive one
+    bool additive;
+    AnimationState() : state(kStopped), time(0.0f), weight(1.0f), additive(false) {}
 };
+
+// Moves the playing animations forward in time.  Looping animations wrap around, and the others
+// stop when they reach the end.
+void AdvanceAnimations( AnimationState* states, const AnimationSet* animations, uint32_t numAnimations, float deltaTime );
+
+struct GraphNode;
+
+// Writes the value of one translation, rotation, or scale curve at the given time to its node.
+// Times outside of the curve hold the first or last key frame.
+void SampleAnimationCurve( const AnimationCurve& curve, const uint8_t* keyFrameData, float time, GraphNode& node );
@@ -0,0 +1,312 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "AnimationBlender.h"
+#include "AnimationSampler.h"
+#include "Model.h"
+#include "../Core/Utility.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    inline bool IsContributing( const AnimationState& state )
+    {
+        return state.state != AnimationState::kStopped && state.weight > 0.0f;
+    }
+
+    inline float Dot4( const float* a, const float* b )
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    }
+
+    inline void Normalize4( float* q )
+    {
+        const float lengthSq = Dot4(q, q);
+        const float invLength = lengthSq > 0.0f ? 1.0f / std::sqrt(lengthSq) : 0.0f;
+        for (int i = 0; i < 4; ++i)
+            q[i] *= invLength;
+        if (invLength == 0.0f)
+            q[3] = 1.0f;
+    }
+
+    // a * b, which rotates by b and then by a
+    inline void Multiply( float* result, const float* a, const float* b )
+    {
+        const float x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+        const float y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+        const float z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+        const float w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+        result[0] = x;
+        result[1] = y;
+        result[2] = z;
+        result[3] = w;
+    }
+
+    // Adds the difference between an additive sample and the rest pose to one channel of the pose
+    void ApplyAdditive( float* pose, const float* sample, const float* rest, uint32_t targetPath, float weight )
+    {
+        switch (targetPath)
+        {
+        case AnimationCurve::kTranslation:
+            for (int i = 0; i < 3; ++i)
+                pose[i] += weight * (sample[i] - rest[i]);
+            break;
+
+        case AnimationCurve::kRotation:
+        {
+            // delta = sample * inverse(rest), scaled toward identity and applied on top of the pose
+            const float inverseRest[4] = { -rest[0], -rest[1], -rest[2], rest[3] };
+            float delta[4];
+            Multiply(delta, sample, inverseRest);
+            const float sign = delta[3] < 0.0f ? -weight : weight;
+            for (int i = 0; i < 3; ++i)
+                delta[i] *= sign;
+            delta[3] = 1.0f - weight + delta[3] * sign;
+            Normalize4(delta);
+            Multiply(pose, delta, pose);
+            Normalize4(pose);
+            break;
+        }
+
+        default:
+            for (int i = 0; i < 3; ++i)
+            {
+                const float ratio = rest[i] != 0.0f ? sample[i] / rest[i] : 1.0f;
+                pose[i] *= 1.0f + weight * (ratio - 1.0f);
+            }
+            break;
+        }
+    }
+}
+
+float* AnimationBlender::GetChannel( GraphNode& node, uint32_t targetPath )
+{
+    switch (targetPath)
+    {
+    case AnimationCurve::kTranslation: return (float*)&node.xform + 12;
+    case AnimationCurve::kRotation: return (float*)&node.rotation;
+    default: return (float*)&node.scale;
+    }
+}
+
+void AnimationBlender::Create( const AnimationSampler& sampler, const AnimationSet* animations, uint32_t numAnimations,
+    const AnimationCurve* curves, const GraphNode* restPose, uint32_t numNodes )
+{
+    Destroy();
+
+    m_Sampler = &sampler;
+    m_Animations = animations;
+    m_RestPose = restPose;
+    m_NumNodes = numNodes;
+
+    // Bit i of node n is set when the channel with target path i is animated
+    std::vector<uint8_t> animated(numNodes, 0);
+    std::vector<uint8_t> inAnimation(numNodes, 0);
+
+    for (uint32_t animIdx = 0; animIdx < numAnimations; ++animIdx)
+    {
+        m_FirstChannel.push_back((uint32_t)m_Channels.size());
+
+        const AnimationSet& animation = animations[animIdx];
+        for (uint32_t c = 0; c < animation.numCurves; ++c)
+        {
+            const AnimationCurve& curve = curves[animation.firstCurve + c];
+            if (curve.targetPath == AnimationCurve::kWeights)
+                continue;
+
+            ASSERT(curve.targetNode < numNodes);
+            inAnimation[curve.targetNode] |= 1 << curve.targetPath;
+        }
+
+        for (uint32_t node = 0; node < numNodes; ++node)
+        {
+            for (uint32_t path = 0; path < AnimationCurve::kWeights; ++path)
+            {
+                if (inAnimation[node] & (1 << path))
+                    m_Channels.push_back({ node, path });
+            }
+            animated[node] |= inAnimation[node];
+            inAnimation[node] = 0;
+        }
+    }
+    m_FirstChannel.push_back((uint32_t)m_Channels.size());
+
+    for (uint32_t node = 0; node < numNodes; ++node)
+    {
+        for (uint32_t path = 0; path < AnimationCurve::kWeights; ++path)
+        {
+            if (animated[node] & (1 << path))
+                m_AnimatedChannels.push_back({ node, path });
+        }
+    }
+}
+
+void AnimationBlender::Destroy( void )
+{
+    m_Sampler = nullptr;
+    m_Animations = nullptr;
+    m_RestPose = nullptr;
+    m_NumNodes = 0;
+    m_Channels.clear();
+    m_FirstChannel.clear();
+    m_AnimatedChannels.clear();
+}
+
+uint32_t AnimationBlender::GetEvaluationCost( const AnimationState* states ) const
+{
+    uint32_t numCurves = 0;
+    for (uint32_t animIdx = 0; animIdx < GetNumAnimations(); ++animIdx)
+    {
+        if (IsContributing(states[animIdx]))
+            numCurves += m_Animations[animIdx].numCurves;
+    }
+    return numCurves;
+}
+
+uint32_t AnimationBlender::Evaluate( const AnimationState* states, GraphNode* pose, Workspace& workspace ) const
+{
+    const uint32_t numAnimations = GetNumAnimations();
+
+    uint32_t numBlended = 0, numAdditive = 0, lastBlended = 0;
+    for (uint32_t animIdx = 0; animIdx < numAnimations; ++animIdx)
+    {
+        if (!IsContributing(states[animIdx]))
+            continue;
+
+        if (states[animIdx].additive)
+        {
+            ++numAdditive;
+        }
+        else
+        {
+            ++numBlended;
+            lastBlended = animIdx;
+        }
+    }
+
+    if (numBlended + numAdditive == 0)
+        return 0;
+
+    // One animation at full weight is sampled in place
+    if (numBlended == 1 && numAdditive == 0 && states[lastBlended].weight >= 1.0f)
+    {
+        m_Sampler->Sample(lastBlended, states[lastBlended].time, pose);
+        return m_Animations[lastBlended].numCurves;
+    }
+
+    if (workspace.m_NumNodes != m_NumNodes)
+    {
+        workspace.m_NumNodes = m_NumNodes;
+        workspace.m_Scratch.reset(new GraphNode[m_NumNodes]);
+        workspace.m_Channels.resize(m_NumNodes * 3);
+    }
+    GraphNode* scratch = workspace.m_Scratch.get();
+    Workspace::Accumulator* accumulators = workspace.m_Channels.data();
+
+    uint32_t numCurves = 0;
+
+    if (numBlended > 0)
+    {
+        for (const Channel& channel : m_AnimatedChannels)
+        {
+            Workspace::Accumulator& accumulator = accumulators[channel.targetNode * 3 + channel.targetPath];
+            accumulator.value[0] = accumulator.value[1] = accumulator.value[2] = accumulator.value[3] = 0.0f;
+            accumulator.weight = 0.0f;
+        }
+
+        for (uint32_t animIdx = 0; animIdx < numAnimations; ++animIdx)
+        {
+            const AnimationState& state = states[animIdx];
+            if (!IsContributing(state) || state.additive)
+                continue;
+
+            m_Sampler->Sample(animIdx, state.time, scratch);
+            numCurves += m_Animations[animIdx].numCurves;
+
+            for (uint32_t c = m_FirstChannel[animIdx]; c < m_FirstChannel[animIdx + 1]; ++c)
+            {
+                const Channel& channel = m_Channels[c];
+                Workspace::Accumulator& accumulator = accumulators[channel.targetNode * 3 + channel.targetPath];
+                const float* value = GetChannel(scratch[channel.targetNode], channel.targetPath);
+
+                if (channel.targetPath == AnimationCurve::kRotation)
+                {
+                    // Keep every rotation in the same hemisphere as the running sum
+                    const float weight = Dot4(accumulator.value, value) < 0.0f ? -state.weight : state.weight;
+                    for (int i = 0; i < 4; ++i)
+                        accumulator.value[i] += weight * value[i];
+                }
+                else
+                {
+                    for (int i = 0; i < 3; ++i)
+                        accumulator.value[i] += state.weight * value[i];
+                }
+                accumulator.weight += state.weight;
+            }
+        }
+
+        for (const Channel& channel : m_AnimatedChannels)
+        {
+            const Workspace::Accumulator& accumulator = accumulators[channel.targetNode * 3 + channel.targetPath];
+            if (accumulator.weight == 0.0f)
+                continue;
+
+            GraphNode& node = pose[channel.targetNode];
+            float* result = GetChannel(node, channel.targetPath);
+            const float* rest = GetChannel(m_RestPose[channel.targetNode], channel.targetPath);
+            const float restWeight = std::max(1.0f - accumulator.weight, 0.0f);
+
+            if (channel.targetPath == AnimationCurve::kRotation)
+            {
+                const float weight = Dot4(accumulator.value, rest) < 0.0f ? -restWeight : restWeight;
+                for (int i = 0; i < 4; ++i)
+                    result[i] = accumulator.value[i] + weight * rest[i];
+                Normalize4(result);
+            }
+            else
+            {
+                const float invWeight = 1.0f / (accumulator.weight + restWeight);
+                for (int i = 0; i < 3; ++i)
+                    result[i] = (accumulator.value[i] + restWeight * rest[i]) * invWeight;
+            }
+
+            if (channel.targetPath != AnimationCurve::kTranslation)
+                node.staleMatrix = true;
+        }
+    }
+
+    for (uint32_t animIdx = 0; animIdx < numAnimations; ++animIdx)
+    {
+        const AnimationState& state = states[animIdx];
+        if (!IsContributing(state) || !state.additive)
+            continue;
+
+        m_Sampler->Sample(animIdx, state.time, scratch);
+        numCurves += m_Animations[animIdx].numCurves;
+
+        for (uint32_t c = m_FirstChannel[animIdx]; c < m_FirstChannel[animIdx + 1]; ++c)
+        {
+            const Channel& channel = m_Channels[c];
+            GraphNode& node = pose[channel.targetNode];
+            ApplyAdditive(GetChannel(node, channel.targetPath), GetChannel(scratch[channel.targetNode], channel.targetPath),
+                GetChannel(m_RestPose[channel.targetNode], channel.targetPath), channel.targetPath, state.weight);
+
+            if (channel.targetPath != AnimationCurve::kTranslation)
+                node.staleMatrix = true;
+        }
+    }
+
+    return numCurves;
+}
@@ -0,0 +1,98 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "Animation.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct GraphNode;
+class AnimationSampler;
+
+// Poses a model from every animation that is playing.  A single animation at full weight is
+// sampled straight into the pose.  Otherwise each animation is sampled into a scratch copy of
+// the scene graph, and the translation, rotation, and scale channels are blended by weight.
+// When the weights of the animations that move a channel add up to less than one, the rest pose
+// makes up the difference; when they add up to more, they are normalized.  Additive animations
+// are applied afterwards, in order, as their difference from the rest pose scaled by weight.
+//
+// Nodes that no playing animation moves keep whatever the pose held before.
+class AnimationBlender
+{
+public:
+    // Scratch memory for blending.  Keep one per instance or per thread.
+    class Workspace
+    {
+    public:
+        Workspace() : m_NumNodes(0) {}
+
+    private:
+        friend class AnimationBlender;
+
+        struct Accumulator
+        {
+            float value[4];
+            float weight;
+        };
+
+        uint32_t m_NumNodes;
+        std::unique_ptr<GraphNode[]> m_Scratch;
+        std::vector<Accumulator> m_Channels;    // Three for each node
+    };
+
+    // Which node and which of its transform components an animation moves
+    struct Channel
+    {
+        uint32_t targetNode : 30;
+        uint32_t targetPath : 2;
+    };
+
+    AnimationBlender() : m_Sampler(nullptr), m_Animations(nullptr), m_RestPose(nullptr), m_NumNodes(0) {}
+
+    void Create( const AnimationSampler& sampler, const AnimationSet* animations, uint32_t numAnimations,
+        const AnimationCurve* curves, const GraphNode* restPose, uint32_t numNodes );
+    void Destroy( void );
+
+    uint32_t GetNumNodes( void ) const { return m_NumNodes; }
+    const AnimationSet* GetAnimations( void ) const { return m_Animations; }
+    uint32_t GetNumAnimations( void ) const { return m_FirstChannel.empty() ? 0 : (uint32_t)m_FirstChannel.size() - 1; }
+
+    // Every channel moved by any animation, sorted by node
+    const std::vector<Channel>& GetAnimatedChannels( void ) const { return m_AnimatedChannels; }
+
+    // The translation, rotation, or scale of a node as three or four floats
+    static float* GetChannel( GraphNode& node, uint32_t targetPath );
+    static const float* GetChannel( const GraphNode& node, uint32_t targetPath )
+    {
+        return GetChannel(const_cast<GraphNode&>(node), targetPath);
+    }
+
+    // The number of curves that Evaluate() samples for these states
+    uint32_t GetEvaluationCost( const AnimationState* states ) const;
+
+    // Writes the blended pose of one animation state per animation and returns the number of
+    // curves sampled.
+    uint32_t Evaluate( const AnimationState* states, GraphNode* pose, Workspace& workspace ) const;
+
+private:
+    const AnimationSampler* m_Sampler;
+    const AnimationSet* m_Animations;
+    const GraphNode* m_RestPose;
+    uint32_t m_NumNodes;
+    std::vector<Channel> m_Channels;            // Of each animation, without duplicates
+    std::vector<uint32_t> m_FirstChannel;       // First channel of each animation, plus the end
+    std::vector<Channel> m_AnimatedChannels;
+};
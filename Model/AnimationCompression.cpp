@@ -0,0 +1,626 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "AnimationCompression.h"
+#include "glTF.h"
+#include "../Core/Utility.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const float kInvSqrt2 = 0.70710678f;
+
+    // Resampling may use this much of the tolerance, leaving the rest for quantization
+    const float kResampleShare = 0.8f;
+
+    // Uneven or spline curves are never resampled more finely than this
+    const uint32_t kMaxSegments = 65536;
+
+    // An authored curve decoded to floats
+    struct SourceCurve
+    {
+        uint32_t numComponents;     // 4 for rotations, otherwise 3
+        uint32_t numKeys;
+        uint32_t interpolation;
+        bool isRotation;
+        std::vector<float> times;
+        std::vector<float> values;  // Cubic splines have an in tangent, value, and out tangent per key
+
+        const float* GetKey( uint32_t key ) const
+        {
+            return interpolation == AnimationCurve::kCubicSpline ?
+                &values[(key * 3 + 1) * numComponents] : &values[key * numComponents];
+        }
+    };
+
+    // Evenly spaced float keys located the way the runtime locates them
+    struct UniformCurve
+    {
+        uint32_t numSegments;
+        float startTime;
+        float rangeScale;
+        std::vector<float> keys;
+    };
+
+    float ReadComponent( const uint8_t* data, uint32_t componentType )
+    {
+        switch (componentType)
+        {
+        case glTF::Accessor::kByte:          return std::max(*(const int8_t*)data / 127.0f, -1.0f);
+        case glTF::Accessor::kUnsignedByte:  return *data / 255.0f;
+        case glTF::Accessor::kShort:         return std::max(*(const int16_t*)data / 32767.0f, -1.0f);
+        case glTF::Accessor::kUnsignedShort: return *(const uint16_t*)data / 65535.0f;
+        default:
+        {
+            float value;
+            std::memcpy(&value, data, sizeof(float));
+            return value;
+        }
+        }
+    }
+
+    uint32_t GetBytesPerComponent( uint32_t componentType )
+    {
+        return componentType == glTF::Accessor::kFloat ? 4 : componentType / 2 + 1;
+    }
+
+    uint32_t GetElementStride( const glTF::Accessor& accessor )
+    {
+        // In glTF, stride==0 means "packed tightly"
+        return accessor.stride != 0 ? accessor.stride : (accessor.type + 1) * GetBytesPerComponent(accessor.componentType);
+    }
+
+    void Normalize4( float* q )
+    {
+        const float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int i = 0; i < 4; ++i)
+            q[i] *= scale;
+    }
+
+    // Matches XMQuaternionSlerp, which takes the shorter arc
+    void Slerp( float* dest, const float* a, const float* b, float t )
+    {
+        float cosOmega = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        const float sign = cosOmega < 0.0f ? -1.0f : 1.0f;
+        cosOmega *= sign;
+
+        float scale0 = 1.0f - t, scale1 = t;
+        if (cosOmega < 1.0f - 0.00001f)
+        {
+            const float omega = acosf(cosOmega);
+            const float sinOmega = sinf(omega);
+            scale0 = sinf((1.0f - t) * omega) / sinOmega;
+            scale1 = sinf(t * omega) / sinOmega;
+        }
+        scale1 *= sign;
+
+        for (int i = 0; i < 4; ++i)
+            dest[i] = scale0 * a[i] + scale1 * b[i];
+        Normalize4(dest);
+    }
+
+    void Interpolate( float* dest, const float* a, const float* b, float t, uint32_t numComponents )
+    {
+        if (numComponents == 4)
+        {
+            Slerp(dest, a, b, t);
+            return;
+        }
+
+        for (uint32_t i = 0; i < numComponents; ++i)
+            dest[i] = a[i] + (b[i] - a[i]) * t;
+    }
+
+    // The authored value at a time, using the authored interpolation
+    void EvaluateSource( const SourceCurve& source, float time, float* value )
+    {
+        const uint32_t C = source.numComponents;
+        const uint32_t lastKey = source.numKeys - 1;
+
+        if (lastKey == 0 || time <= source.times[0])
+        {
+            std::memcpy(value, source.GetKey(0), C * sizeof(float));
+            return;
+        }
+        if (time >= source.times[lastKey])
+        {
+            std::memcpy(value, source.GetKey(lastKey), C * sizeof(float));
+            return;
+        }
+
+        const uint32_t key = (uint32_t)(std::upper_bound(source.times.begin(), source.times.end(), time) - source.times.begin()) - 1;
+        const float dt = source.times[key + 1] - source.times[key];
+        const float s = (time - source.times[key]) / dt;
+
+        switch (source.interpolation)
+        {
+        case AnimationCurve::kStep:
+            std::memcpy(value, source.GetKey(key), C * sizeof(float));
+            break;
+
+        case AnimationCurve::kCubicSpline:
+        {
+            // Hermite spline with the out tangent of this key and the in tangent of the next
+            const float* p0 = source.GetKey(key);
+            const float* p1 = source.GetKey(key + 1);
+            const float* m0 = p0 + C;
+            const float* m1 = p1 - C;
+            const float s2 = s * s, s3 = s2 * s;
+            for (uint32_t i = 0; i < C; ++i)
+            {
+                value[i] = (2.0f * s3 - 3.0f * s2 + 1.0f) * p0[i] + (s3 - 2.0f * s2 + s) * dt * m0[i] +
+                    (-2.0f * s3 + 3.0f * s2) * p1[i] + (s3 - s2) * dt * m1[i];
+            }
+            if (source.isRotation)
+                Normalize4(value);
+            break;
+        }
+
+        default:
+            Interpolate(value, source.GetKey(key), source.GetKey(key + 1), s, C);
+            break;
+        }
+    }
+
+    // Mirrors SampleAnimationCurve
+    void EvaluateUniform( const UniformCurve& curve, const float* keys, uint32_t numComponents, uint32_t interpolation,
+        float time, float* value )
+    {
+        const float numSegments = (float)curve.numSegments;
+        const float progress = std::min(std::max((time - curve.startTime) * curve.rangeScale, 0.0f), numSegments);
+        uint32_t segment = (uint32_t)progress;
+        float lerpT = progress - (float)segment;
+        if ((float)segment >= numSegments)
+        {
+            segment = curve.numSegments - 1;
+            lerpT = 1.0f;
+        }
+        if (interpolation == AnimationCurve::kStep)
+            lerpT = lerpT < 1.0f ? 0.0f : 1.0f;
+
+        const float* key1 = keys + segment * numComponents;
+        Interpolate(value, key1, key1 + numComponents, lerpT, numComponents);
+    }
+
+    // Rotations are compared by the angle between them, anything else by its largest component
+    double Difference( const float* a, const float* b, bool isRotation )
+    {
+        if (!isRotation)
+        {
+            double largest = 0.0;
+            for (int i = 0; i < 3; ++i)
+                largest = std::max(largest, std::fabs((double)a[i] - b[i]));
+            return largest;
+        }
+
+        // The chord between unit quaternions is accurate where the dot product's arc cosine is not
+        double difference = 0.0, sum = 0.0;
+        for (int i = 0; i < 4; ++i)
+        {
+            difference += ((double)a[i] - b[i]) * ((double)a[i] - b[i]);
+            sum += ((double)a[i] + b[i]) * ((double)a[i] + b[i]);
+        }
+        const double chord = std::sqrt(std::min(difference, sum));
+        return 4.0 * std::asin(std::min(chord * 0.5, 1.0));
+    }
+
+    // Compares cooked keys against the authored curve at every authored key and between them
+    class ErrorMeasure
+    {
+    public:
+        explicit ErrorMeasure( const SourceCurve& source ) : m_Source(source)
+        {
+            // Step curves jump at their keys, so only the middle of each segment is meaningful
+            const bool isStep = source.interpolation == AnimationCurve::kStep;
+            const uint32_t divisions = source.interpolation == AnimationCurve::kCubicSpline ? 4 : 2;
+
+            for (uint32_t key = 0; key < source.numKeys; ++key)
+            {
+                const float time = source.times[key];
+                if (!isStep || source.numKeys == 1)
+                    m_Times.push_back(time);
+                if (key + 1 < source.numKeys)
+                {
+                    const float dt = source.times[key + 1] - time;
+                    for (uint32_t i = 1; i < divisions; ++i)
+                        m_Times.push_back(time + dt * i / divisions);
+                }
+            }
+
+            m_Values.resize(m_Times.size() * source.numComponents);
+            for (size_t i = 0; i < m_Times.size(); ++i)
+                EvaluateSource(source, m_Times[i], &m_Values[i * source.numComponents]);
+        }
+
+        double Measure( const UniformCurve& curve, const float* keys ) const
+        {
+            const uint32_t C = m_Source.numComponents;
+            double largest = 0.0;
+            float value[4];
+            for (size_t i = 0; i < m_Times.size(); ++i)
+            {
+                EvaluateUniform(curve, keys, C, m_Source.interpolation, m_Times[i], value);
+                largest = std::max(largest, Difference(value, &m_Values[i * C], m_Source.isRotation));
+            }
+            return largest;
+        }
+
+    private:
+        const SourceCurve& m_Source;
+        std::vector<float> m_Times;
+        std::vector<float> m_Values;
+    };
+
+    void Decode( SourceCurve& source, const glTF::AnimSampler& sampler, uint32_t targetPath )
+    {
+        const glTF::Accessor& input = *sampler.m_input;
+        const glTF::Accessor& output = *sampler.m_output;
+
+        source.isRotation = targetPath == AnimationCurve::kRotation;
+        source.numComponents = source.isRotation ? 4 : 3;
+        source.interpolation = sampler.m_interpolation == glTF::AnimSampler::kCatmullRomSpline ?
+            (uint32_t)AnimationCurve::kLinear : (uint32_t)sampler.m_interpolation;
+
+        const uint32_t valuesPerKey = source.interpolation == AnimationCurve::kCubicSpline ? 3 : 1;
+        source.numKeys = std::min(input.count, output.count / valuesPerKey);
+        ASSERT(source.numKeys > 0, "Animation sampler has no key frames");
+
+        const float* timeStamps = (const float*)input.dataPtr;
+        source.times.assign(timeStamps, timeStamps + source.numKeys);
+
+        const uint32_t numValues = source.numKeys * valuesPerKey;
+        const uint32_t numComponents = std::min<uint32_t>(output.type + 1, source.numComponents);
+        const uint32_t elementStride = GetElementStride(output);
+        const uint32_t componentSize = GetBytesPerComponent(output.componentType);
+
+        source.values.assign(numValues * source.numComponents, 0.0f);
+        for (uint32_t i = 0; i < numValues; ++i)
+        {
+            const uint8_t* element = output.dataPtr + (size_t)i * elementStride;
+            for (uint32_t c = 0; c < numComponents; ++c)
+                source.values[i * source.numComponents + c] = ReadComponent(element + c * componentSize, output.componentType);
+        }
+
+        if (source.isRotation)
+        {
+            for (uint32_t key = 0; key < source.numKeys; ++key)
+                Normalize4(&source.values[(key * valuesPerKey + valuesPerKey / 2) * 4]);
+        }
+    }
+
+    // Evaluates the authored curve at numSegments + 1 evenly spaced times
+    void Resample( UniformCurve& curve, const SourceCurve& source, uint32_t numSegments )
+    {
+        const uint32_t C = source.numComponents;
+        const float startTime = source.times[0];
+        const float duration = source.times[source.numKeys - 1] - startTime;
+
+        curve.numSegments = numSegments;
+        curve.startTime = startTime;
+        curve.rangeScale = duration > 0.0f ? numSegments / duration : 0.0f;
+        curve.keys.resize((numSegments + 1) * C);
+
+        // Step keys are taken just after each sample time so that keys on the grid are not lost
+        // to rounding
+        const float bias = source.interpolation == AnimationCurve::kStep ? duration / numSegments * 1e-3f : 0.0f;
+
+        for (uint32_t i = 0; i <= numSegments; ++i)
+        {
+            const float time = i == numSegments ? startTime + duration : startTime + duration * i / numSegments;
+            EvaluateSource(source, time + bias, &curve.keys[i * C]);
+        }
+    }
+
+    // Enough evenly spaced keys to land on every authored key when they are evenly spaced, or
+    // to be as fine as the closest two when they are not
+    uint32_t GetFullSegmentCount( const SourceCurve& source )
+    {
+        const uint32_t numSegments = std::max(source.numKeys - 1, 1u);
+        const float duration = source.times[source.numKeys - 1] - source.times[0];
+
+        float smallestGap = duration;
+        for (uint32_t key = 1; key < source.numKeys; ++key)
+        {
+            const float gap = source.times[key] - source.times[key - 1];
+            if (gap > 0.0f)
+                smallestGap = std::min(smallestGap, gap);
+        }
+
+        uint32_t fullSegments = numSegments;
+        if (smallestGap > 0.0f)
+            fullSegments = std::max(fullSegments, (uint32_t)std::min(std::ceil(duration / smallestGap - 1e-3f), (float)kMaxSegments));
+
+        // Splines need a few linear segments for each of their own
+        if (source.interpolation == AnimationCurve::kCubicSpline)
+            fullSegments *= 4;
+
+        return std::min(fullSegments, kMaxSegments);
+    }
+
+    // "Smallest three":  the largest component is made positive and rebuilt from the others
+    void EncodeRotation( int16_t* key, const float* q )
+    {
+        uint32_t largest = 0;
+        for (uint32_t i = 1; i < 4; ++i)
+        {
+            if (std::fabs(q[i]) > std::fabs(q[largest]))
+                largest = i;
+        }
+
+        const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+        for (uint32_t i = 0, j = 0; i < 4; ++i)
+        {
+            if (i == largest)
+                continue;
+            const float scaled = q[i] * sign / kInvSqrt2 * 32767.0f;
+            key[j++] = (int16_t)std::lround(std::min(std::max(scaled, -32767.0f), 32767.0f));
+        }
+        key[3] = (int16_t)largest;
+    }
+
+    // Matches ToQuat() in Animation.cpp
+    void DecodeRotation( float* q, const int16_t* key )
+    {
+        const float kScale = kInvSqrt2 / 32767.0f;
+        const float a = key[0] * kScale, b = key[1] * kScale, c = key[2] * kScale;
+        const float largest = sqrtf(std::max(1.0f - a * a - b * b - c * c, 0.0f));
+        const float others[3] = { a, b, c };
+
+        for (uint32_t i = 0, j = 0; i < 4; ++i)
+            q[i] = i == (uint32_t)(key[3] & 3) ? largest : others[j++];
+    }
+
+    template <typename T>
+    void Append( std::vector<uint8_t>& data, const T* values, size_t count )
+    {
+        const uint8_t* bytes = (const uint8_t*)values;
+        data.insert(data.end(), bytes, bytes + count * sizeof(T));
+    }
+
+    void CopyAuthoredCurve( AnimationCurve& curve, std::vector<uint8_t>& keyFrameData, const glTF::AnimSampler& sampler )
+    {
+        const glTF::Accessor& output = *sampler.m_output;
+
+        curve.interpolation = sampler.m_interpolation;
+        curve.keyFrameOffset = (uint32_t)keyFrameData.size();
+        curve.keyFrameFormat = std::min<uint32_t>(output.componentType, AnimationCurve::kFloat);
+        curve.keyFrameStride = GetElementStride(output) / 4;
+        curve.numSegments = output.count - 1.0f;
+
+        const float* timeStamps = (const float*)sampler.m_input->dataPtr;
+        curve.startTime = timeStamps[0];
+        curve.rangeScale = curve.numSegments / (timeStamps[sampler.m_input->count - 1] - curve.startTime);
+
+        Append(keyFrameData, output.dataPtr, (size_t)output.count * curve.keyFrameStride * 4);
+    }
+}
+
+namespace AnimationCompression
+{
+    void CookCurve( AnimationCurve& curve, std::vector<uint8_t>& keyFrameData, const glTF::AnimSampler& sampler,
+        uint32_t targetPath, bool compress, CurveReport& report )
+    {
+        curve.targetPath = targetPath;
+
+        report.targetPath = targetPath;
+        report.interpolation = sampler.m_interpolation;
+        report.keysBefore = sampler.m_output->count;
+        report.bytesBefore = sampler.m_output->count * GetElementStride(*sampler.m_output);
+        report.tolerance = 0.0f;
+        report.maxError = 0.0f;
+
+        if (targetPath == AnimationCurve::kWeights)
+        {
+            CopyAuthoredCurve(curve, keyFrameData, sampler);
+            report.format = curve.keyFrameFormat;
+            report.keysAfter = report.keysBefore;
+            report.bytesAfter = report.bytesBefore;
+            return;
+        }
+
+        SourceCurve source;
+        Decode(source, sampler, targetPath);
+        const uint32_t C = source.numComponents;
+
+        if (source.isRotation)
+        {
+            report.tolerance = kRotationTolerance;
+        }
+        else
+        {
+            float largest = 1.0f;
+            for (uint32_t key = 0; key < source.numKeys; ++key)
+            {
+                for (uint32_t i = 0; i < C; ++i)
+                    largest = std::max(largest, std::fabs(source.GetKey(key)[i]));
+            }
+            report.tolerance = kLinearTolerance * largest;
+        }
+
+        const ErrorMeasure measure(source);
+        const uint32_t fullSegments = GetFullSegmentCount(source);
+
+        UniformCurve cooked;
+        if (!compress)
+        {
+            Resample(cooked, source, fullSegments);
+        }
+        else
+        {
+            // Keep only as many evenly spaced keys as the tolerance requires so that sampling
+            // stays a direct lookup.  Double the count until it fits, then search for the least.
+            const double budget = report.tolerance * kResampleShare;
+            auto Fits = [&]( uint32_t numSegments )
+            {
+                Resample(cooked, source, numSegments);
+                return measure.Measure(cooked, cooked.keys.data()) <= budget;
+            };
+
+            uint32_t tooFew = 0, enough = 1;
+            bool fits = Fits(enough);
+            while (!fits && enough < fullSegments)
+            {
+                tooFew = enough;
+                enough = std::min(enough * 2, fullSegments);
+                fits = Fits(enough);
+            }
+            while (fits && enough - tooFew > 1)
+            {
+                const uint32_t middle = tooFew + (enough - tooFew) / 2;
+                if (Fits(middle))
+                    enough = middle;
+                else
+                    tooFew = middle;
+            }
+            Resample(cooked, source, enough);
+        }
+
+        const uint32_t numKeys = cooked.numSegments + 1;
+        double error = measure.Measure(cooked, cooked.keys.data());
+
+        curve.interpolation = source.interpolation == AnimationCurve::kStep ? AnimationCurve::kStep : AnimationCurve::kLinear;
+        curve.numSegments = (float)cooked.numSegments;
+        curve.startTime = cooked.startTime;
+        curve.rangeScale = cooked.rangeScale;
+        curve.keyFrameFormat = AnimationCurve::kFloat;
+        curve.keyFrameStride = C;
+
+        const size_t curveStart = keyFrameData.size();
+        std::vector<float> decoded(numKeys * C);
+
+        if (compress && source.isRotation)
+        {
+            std::vector<int16_t> quantized(numKeys * 4);
+            for (uint32_t key = 0; key < numKeys; ++key)
+            {
+                EncodeRotation(&quantized[key * 4], &cooked.keys[key * 4]);
+                DecodeRotation(&decoded[key * 4], &quantized[key * 4]);
+            }
+
+            const double quantizedError = measure.Measure(cooked, decoded.data());
+            if (quantizedError <= report.tolerance)
+            {
+                curve.keyFrameFormat = AnimationCurve::kSNorm16;
+                curve.keyFrameStride = 2;
+                curve.keyFrameOffset = (uint32_t)keyFrameData.size();
+                Append(keyFrameData, quantized.data(), quantized.size());
+                error = quantizedError;
+            }
+        }
+        else if (compress)
+        {
+            AnimationKeyRange range;
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                float lowest = cooked.keys[i], highest = cooked.keys[i];
+                for (uint32_t key = 1; key < numKeys; ++key)
+                {
+                    lowest = std::min(lowest, cooked.keys[key * 3 + i]);
+                    highest = std::max(highest, cooked.keys[key * 3 + i]);
+                }
+                range.bias[i] = lowest;
+                range.scale[i] = (highest - lowest) / 65535.0f;
+            }
+
+            std::vector<uint16_t> quantized(numKeys * 4, 0);
+            for (uint32_t key = 0; key < numKeys; ++key)
+            {
+                for (uint32_t i = 0; i < 3; ++i)
+                {
+                    const float value = cooked.keys[key * 3 + i];
+                    const float scaled = range.scale[i] > 0.0f ? (value - range.bias[i]) / range.scale[i] : 0.0f;
+                    const uint16_t q = (uint16_t)std::lround(std::min(std::max(scaled, 0.0f), 65535.0f));
+                    quantized[key * 4 + i] = q;
+                    decoded[key * 3 + i] = range.bias[i] + range.scale[i] * q;
+                }
+            }
+
+            const double quantizedError = measure.Measure(cooked, decoded.data());
+            if (quantizedError <= report.tolerance)
+            {
+                curve.keyFrameFormat = AnimationCurve::kUNorm16;
+                curve.keyFrameStride = 2;
+                Append(keyFrameData, &range, 1);
+                curve.keyFrameOffset = (uint32_t)keyFrameData.size();
+                Append(keyFrameData, quantized.data(), quantized.size());
+                error = quantizedError;
+            }
+        }
+
+        if (curve.keyFrameFormat == AnimationCurve::kFloat)
+        {
+            curve.keyFrameOffset = (uint32_t)keyFrameData.size();
+            Append(keyFrameData, cooked.keys.data(), cooked.keys.size());
+        }
+
+        ASSERT(keyFrameData.size() < (1u << 26), "Animation key frame data exceeds 64 MB");
+
+        report.format = curve.keyFrameFormat;
+        report.keysAfter = numKeys;
+        report.bytesAfter = (uint32_t)(keyFrameData.size() - curveStart);
+        report.maxError = (float)error;
+    }
+
+    bool WriteReport( const std::wstring& reportFile, const std::vector<CurveReport>& entries )
+    {
+        std::ofstream outFile(reportFile, std::ios::out | std::ios::trunc);
+        if (!outFile)
+        {
+            Utility::Printf(L"Unable to write animation report %ws\n", reportFile.c_str());
+            return false;
+        }
+
+        static const char* kPathNames[] = { "translation", "rotation", "scale", "weights" };
+        static const char* kInterpolationNames[] = { "linear", "step", "catmull_rom", "cubic_spline" };
+        static const char* kFormatNames[] = { "snorm8", "unorm8", "snorm16", "unorm16", "float" };
+
+        outFile << "animation,curve,node,path,interpolation,format,keys_before,keys_after,"
+            "bytes_before,bytes_after,tolerance,max_error\n";
+
+        uint64_t keysBefore = 0, keysAfter = 0, bytesBefore = 0, bytesAfter = 0;
+        uint32_t numQuantized = 0, numOverTolerance = 0;
+        float maxRotationError = 0.0f;
+
+        for (const CurveReport& e : entries)
+        {
+            outFile << e.animationIdx << ',' << e.curveIdx << ',' << e.targetNode << ',' << kPathNames[e.targetPath & 3] << ','
+                << kInterpolationNames[e.interpolation & 3] << ',' << kFormatNames[std::min(e.format, 4u)] << ','
+                << e.keysBefore << ',' << e.keysAfter << ',' << e.bytesBefore << ',' << e.bytesAfter << ','
+                << e.tolerance << ',' << e.maxError << '\n';
+
+            keysBefore += e.keysBefore;
+            keysAfter += e.keysAfter;
+            bytesBefore += e.bytesBefore;
+            bytesAfter += e.bytesAfter;
+            numQuantized += e.targetPath != AnimationCurve::kWeights && e.format != AnimationCurve::kFloat;
+            numOverTolerance += e.maxError > e.tolerance;
+            if (e.targetPath == AnimationCurve::kRotation)
+                maxRotationError = std::max(maxRotationError, e.maxError);
+        }
+
+        if (!entries.empty())
+        {
+            Utility::Printf(L"Animation report %ws (%zu curves):\n", reportFile.c_str(), entries.size());
+            Utility::Printf("  keys %llu -> %llu   bytes %llu -> %llu (%.2fx)   %u curves quantized   max rotation error %.2e rad   %u over tolerance\n",
+                keysBefore, keysAfter, bytesBefore, bytesAfter, bytesAfter > 0 ? (double)bytesBefore / bytesAfter : 0.0,
+                numQuantized, maxRotationError, numOverTolerance);
+        }
+
+        return (bool)outFile;
+    }
+}
@@ -0,0 +1,58 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "Animation.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace glTF { struct AnimSampler; }
+
+namespace AnimationCompression
+{
+    // Largest difference from the authored curve that cooking may introduce
+    const float kRotationTolerance = 5e-4f;     // Radians
+    const float kLinearTolerance = 1e-4f;       // Times max(1, largest translation or scale component)
+
+    struct CurveReport
+    {
+        uint32_t animationIdx;
+        uint32_t curveIdx;      // Within the animation
+        uint32_t targetNode;
+        uint32_t targetPath;
+        uint32_t interpolation; // As authored
+        uint32_t format;        // As cooked
+        uint32_t keysBefore;
+        uint32_t keysAfter;
+        uint32_t bytesBefore;   // Key frame values as authored, without time stamps
+        uint32_t bytesAfter;    // Including the key range of kUNorm16 curves
+        float tolerance;
+        float maxError;         // Radians for rotations, otherwise in the units of the curve
+    };
+
+    // Appends the key frames of a glTF sampler to keyFrameData and fills in everything about the
+    // curve except its target node.  Translation, rotation, and scale keys are evaluated with
+    // the authored interpolation and resampled at a uniform rate.  When compressing, that rate
+    // is the lowest one that stays within tolerance, and keys are quantized to 16 bits wherever
+    // that stays within tolerance too.  Otherwise keys are kept as floats at the authored rate,
+    // or at the rate of the closest authored keys when time stamps are uneven.  Blend shape
+    // weights are copied as authored.
+    void CookCurve( AnimationCurve& curve, std::vector<uint8_t>& keyFrameData, const glTF::AnimSampler& sampler,
+        uint32_t targetPath, bool compress, CurveReport& report );
+
+    // Writes one CSV row per curve and prints the totals
+    bool WriteReport( const std::wstring& reportFile, const std::vector<CurveReport>& entries );
+}
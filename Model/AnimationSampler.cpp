@@ -0,0 +1,582 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "AnimationSampler.h"
+#include "AnimationCompression.h"
+#include "Model.h"
+#include "glTF.h"
+#include "../Core/Utility.h"
+#include "../Core/SystemTime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <memory>
+#include <random>
+
+namespace
+{
+    inline __m128 LoadFloat3( const uint8_t* p )
+    {
+        // Never reads past the third float, which may end the key frame data
+        const __m128 xy = _mm_castpd_ps(_mm_load_sd((const double*)p));
+        return _mm_movelh_ps(xy, _mm_load_ss((const float*)(p + 8)));
+    }
+
+    inline __m128 LoadUNorm16x4( const uint8_t* p )
+    {
+        const __m128i v = _mm_loadl_epi64((const __m128i*)p);
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+    }
+
+    inline __m128i LoadSNorm16x4( const uint8_t* p )
+    {
+        const __m128i v = _mm_loadl_epi64((const __m128i*)p);
+        return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    }
+
+    inline __m128 Select( __m128 mask, __m128 a, __m128 b )
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    inline __m128 Lerp( __m128 a, __m128 b, __m128 t )
+    {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+    }
+
+    // Rebuilds four "smallest three" rotations in SoA form.  Matches ToQuat() in Animation.cpp.
+    inline void DecodeRotations( __m128i k0, __m128i k1, __m128i k2, __m128i k3, __m128 q[4] )
+    {
+        __m128 a = _mm_cvtepi32_ps(k0), b = _mm_cvtepi32_ps(k1), c = _mm_cvtepi32_ps(k2), index = _mm_cvtepi32_ps(k3);
+        _MM_TRANSPOSE4_PS(a, b, c, index);
+
+        const __m128 kScale = _mm_set1_ps(0.70710678f / 32767.0f);
+        a = _mm_mul_ps(a, kScale);
+        b = _mm_mul_ps(b, kScale);
+        c = _mm_mul_ps(c, kScale);
+
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c));
+        const __m128 largest = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), sum), _mm_setzero_ps()));
+
+        const __m128i i = _mm_and_si128(_mm_cvttps_epi32(index), _mm_set1_epi32(3));
+        const __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(i, _mm_setzero_si128()));
+        const __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(i, _mm_set1_epi32(1)));
+        const __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(i, _mm_set1_epi32(2)));
+        const __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(i, _mm_set1_epi32(3)));
+
+        q[0] = Select(is0, largest, a);
+        q[1] = Select(is0, a, Select(is1, largest, b));
+        q[2] = Select(is3, c, Select(is2, largest, b));
+        q[3] = Select(is3, largest, c);
+    }
+
+    // Normalized lerp along the shorter arc with the interpolation factor adjusted to follow
+    // slerp.  The correction is a fit to slerp over the angle between the keys and t.
+    inline void InterpolateRotations( const __m128 q1[4], const __m128 q2[4], __m128 t, __m128 q[4] )
+    {
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q1[0], q2[0]), _mm_mul_ps(q1[1], q2[1])),
+            _mm_add_ps(_mm_mul_ps(q1[2], q2[2]), _mm_mul_ps(q1[3], q2[3])));
+        const __m128 sign = _mm_and_ps(dot, _mm_set1_ps(-0.0f));
+        const __m128 d = _mm_xor_ps(dot, sign);
+
+        const __m128 A = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-3.2452f),
+            _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(1.43519f)))))));
+        const __m128 B = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-1.06021f),
+            _mm_mul_ps(d, _mm_set1_ps(0.215638f)))));
+
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 centered = _mm_sub_ps(t, half);
+        const __m128 k = _mm_add_ps(_mm_mul_ps(A, _mm_mul_ps(centered, centered)), B);
+        const __m128 adjusted = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(t, centered),
+            _mm_mul_ps(_mm_sub_ps(t, _mm_set1_ps(1.0f)), k)));
+
+        __m128 lengthSq = _mm_setzero_ps();
+        for (int i = 0; i < 4; ++i)
+        {
+            q[i] = Lerp(q1[i], _mm_xor_ps(q2[i], sign), adjusted);
+            lengthSq = _mm_add_ps(lengthSq, _mm_mul_ps(q[i], q[i]));
+        }
+
+        const __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSq));
+        for (int i = 0; i < 4; ++i)
+            q[i] = _mm_mul_ps(q[i], invLength);
+    }
+
+    inline void StoreFloat3( float* dest, __m128 v )
+    {
+        _mm_storel_pi((__m64*)dest, v);
+        _mm_store_ss(dest + 2, _mm_movehl_ps(v, v));
+    }
+
+    const uint32_t kTranslationFloat = AnimationCurve::kTranslation * 8 + AnimationCurve::kFloat;
+    const uint32_t kTranslationUNorm16 = AnimationCurve::kTranslation * 8 + AnimationCurve::kUNorm16;
+    const uint32_t kRotationFloat = AnimationCurve::kRotation * 8 + AnimationCurve::kFloat;
+    const uint32_t kRotationSNorm16 = AnimationCurve::kRotation * 8 + AnimationCurve::kSNorm16;
+    const uint32_t kScaleFloat = AnimationCurve::kScale * 8 + AnimationCurve::kFloat;
+    const uint32_t kScaleUNorm16 = AnimationCurve::kScale * 8 + AnimationCurve::kUNorm16;
+
+    // The order in which groups are sampled
+    const uint32_t kGroupTypes[] = { kTranslationFloat, kTranslationUNorm16, kRotationFloat, kRotationSNorm16,
+        kScaleFloat, kScaleUNorm16 };
+}
+
+template <uint32_t TargetPath, uint32_t Format>
+void AnimationSampler::SampleGroup( const CurveBatch* batches, uint32_t numBatches, const uint8_t* keyFrameData,
+    float time, GraphNode* nodes )
+{
+    const uint32_t kStride = Format == AnimationCurve::kFloat ? (TargetPath == AnimationCurve::kRotation ? 16 : 12) : 8;
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 t = _mm_set1_ps(time);
+
+    for (uint32_t batchIdx = 0; batchIdx < numBatches; ++batchIdx)
+    {
+        const CurveBatch& batch = batches[batchIdx];
+
+        // Find the segment and the position within it the way SampleAnimationCurve does
+        const __m128 numSegments = _mm_load_ps(batch.numSegments);
+        const __m128 progress = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(t, _mm_load_ps(batch.startTime)),
+            _mm_load_ps(batch.rangeScale)), _mm_setzero_ps()), numSegments);
+        const __m128 segment = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(progress)), _mm_sub_ps(numSegments, one));
+        __m128 lerpT = _mm_sub_ps(progress, segment);
+
+        const __m128 step = _mm_load_ps((const float*)batch.stepMask);
+        lerpT = Select(step, _mm_and_ps(_mm_cmpge_ps(lerpT, one), one), lerpT);
+
+        __declspec(align(16)) uint32_t offsets[4];
+        _mm_store_si128((__m128i*)offsets, _mm_add_epi32(_mm_load_si128((const __m128i*)batch.keyOffset),
+            _mm_cvttps_epi32(_mm_mul_ps(segment, _mm_set1_ps((float)kStride)))));
+
+        const uint8_t* key0 = keyFrameData + offsets[0];
+        const uint8_t* key1 = keyFrameData + offsets[1];
+        const uint8_t* key2 = keyFrameData + offsets[2];
+        const uint8_t* key3 = keyFrameData + offsets[3];
+
+        __m128 result[4];
+
+        if (TargetPath == AnimationCurve::kRotation)
+        {
+            __m128 q1[4], q2[4];
+            if (Format == AnimationCurve::kSNorm16)
+            {
+                DecodeRotations(LoadSNorm16x4(key0), LoadSNorm16x4(key1), LoadSNorm16x4(key2), LoadSNorm16x4(key3), q1);
+                DecodeRotations(LoadSNorm16x4(key0 + kStride), LoadSNorm16x4(key1 + kStride),
+                    LoadSNorm16x4(key2 + kStride), LoadSNorm16x4(key3 + kStride), q2);
+            }
+            else
+            {
+                q1[0] = _mm_loadu_ps((const float*)key0);
+                q1[1] = _mm_loadu_ps((const float*)key1);
+                q1[2] = _mm_loadu_ps((const float*)key2);
+                q1[3] = _mm_loadu_ps((const float*)key3);
+                _MM_TRANSPOSE4_PS(q1[0], q1[1], q1[2], q1[3]);
+                q2[0] = _mm_loadu_ps((const float*)(key0 + kStride));
+                q2[1] = _mm_loadu_ps((const float*)(key1 + kStride));
+                q2[2] = _mm_loadu_ps((const float*)(key2 + kStride));
+                q2[3] = _mm_loadu_ps((const float*)(key3 + kStride));
+                _MM_TRANSPOSE4_PS(q2[0], q2[1], q2[2], q2[3]);
+            }
+            InterpolateRotations(q1, q2, lerpT, result);
+        }
+        else
+        {
+            __m128 v1[4], v2[4];
+            if (Format == AnimationCurve::kUNorm16)
+            {
+                v1[0] = LoadUNorm16x4(key0);
+                v1[1] = LoadUNorm16x4(key1);
+                v1[2] = LoadUNorm16x4(key2);
+                v1[3] = LoadUNorm16x4(key3);
+                v2[0] = LoadUNorm16x4(key0 + kStride);
+                v2[1] = LoadUNorm16x4(key1 + kStride);
+                v2[2] = LoadUNorm16x4(key2 + kStride);
+                v2[3] = LoadUNorm16x4(key3 + kStride);
+            }
+            else
+            {
+                v1[0] = LoadFloat3(key0);
+                v1[1] = LoadFloat3(key1);
+                v1[2] = LoadFloat3(key2);
+                v1[3] = LoadFloat3(key3);
+                v2[0] = LoadFloat3(key0 + kStride);
+                v2[1] = LoadFloat3(key1 + kStride);
+                v2[2] = LoadFloat3(key2 + kStride);
+                v2[3] = LoadFloat3(key3 + kStride);
+            }
+            _MM_TRANSPOSE4_PS(v1[0], v1[1], v1[2], v1[3]);
+            _MM_TRANSPOSE4_PS(v2[0], v2[1], v2[2], v2[3]);
+
+            for (int i = 0; i < 3; ++i)
+            {
+                if (Format == AnimationCurve::kUNorm16)
+                {
+                    const __m128 bias = _mm_load_ps(batch.bias[i]);
+                    const __m128 scale = _mm_load_ps(batch.scale[i]);
+                    v1[i] = _mm_add_ps(bias, _mm_mul_ps(scale, v1[i]));
+                    v2[i] = _mm_add_ps(bias, _mm_mul_ps(scale, v2[i]));
+                }
+                result[i] = Lerp(v1[i], v2[i], lerpT);
+            }
+            result[3] = _mm_setzero_ps();
+        }
+
+        _MM_TRANSPOSE4_PS(result[0], result[1], result[2], result[3]);
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            GraphNode& node = nodes[batch.targetNode[lane]];
+            switch (TargetPath)
+            {
+            case AnimationCurve::kTranslation:
+                StoreFloat3((float*)&node.xform + 12, result[lane]);
+                break;
+            case AnimationCurve::kRotation:
+                _mm_store_ps((float*)&node.rotation, result[lane]);
+                node.staleMatrix = true;
+                break;
+            default:
+                StoreFloat3((float*)&node.scale, result[lane]);
+                node.staleMatrix = true;
+                break;
+            }
+        }
+    }
+}
+
+void AnimationSampler::Create( const AnimationSet* animations, uint32_t numAnimations, const AnimationCurve* curves,
+    const uint8_t* keyFrameData )
+{
+    Destroy();
+
+    m_KeyFrameData = keyFrameData;
+
+    std::vector<const AnimationCurve*> groupCurves;
+
+    for (uint32_t animIdx = 0; animIdx < numAnimations; ++animIdx)
+    {
+        const AnimationSet& animation = animations[animIdx];
+        m_FirstGroup.push_back((uint32_t)m_Groups.size());
+
+        // Blend shape weights are not sampled
+        for (uint32_t groupType : kGroupTypes)
+        {
+            groupCurves.clear();
+            for (uint32_t i = 0; i < animation.numCurves; ++i)
+            {
+                const AnimationCurve& curve = curves[animation.firstCurve + i];
+                if ((uint32_t)curve.targetPath * 8 + curve.keyFrameFormat == groupType)
+                    groupCurves.push_back(&curve);
+            }
+
+            if (groupCurves.empty())
+                continue;
+
+            CurveGroup group;
+            group.firstBatch = (uint32_t)m_Batches.size();
+            group.numBatches = ((uint32_t)groupCurves.size() + 3) / 4;
+
+            switch (groupType)
+            {
+            case kTranslationFloat:   group.sample = SampleGroup<AnimationCurve::kTranslation, AnimationCurve::kFloat>; break;
+            case kTranslationUNorm16: group.sample = SampleGroup<AnimationCurve::kTranslation, AnimationCurve::kUNorm16>; break;
+            case kRotationFloat:      group.sample = SampleGroup<AnimationCurve::kRotation, AnimationCurve::kFloat>; break;
+            case kRotationSNorm16:    group.sample = SampleGroup<AnimationCurve::kRotation, AnimationCurve::kSNorm16>; break;
+            case kScaleFloat:         group.sample = SampleGroup<AnimationCurve::kScale, AnimationCurve::kFloat>; break;
+            default:                  group.sample = SampleGroup<AnimationCurve::kScale, AnimationCurve::kUNorm16>; break;
+            }
+
+            m_Batches.resize(m_Batches.size() + group.numBatches);
+            for (uint32_t i = 0; i < group.numBatches * 4; ++i)
+            {
+                const AnimationCurve& curve = *groupCurves[std::min<size_t>(i, groupCurves.size() - 1)];
+                CurveBatch& batch = m_Batches[group.firstBatch + i / 4];
+                const uint32_t lane = i % 4;
+
+                batch.startTime[lane] = curve.startTime;
+                batch.rangeScale[lane] = curve.rangeScale;
+                batch.numSegments[lane] = curve.numSegments;
+                batch.stepMask[lane] = curve.interpolation == AnimationCurve::kStep ? 0xFFFFFFFF : 0;
+                batch.keyOffset[lane] = curve.keyFrameOffset;
+                batch.targetNode[lane] = curve.targetNode;
+
+                AnimationKeyRange range = {};
+                if (curve.keyFrameFormat == AnimationCurve::kUNorm16)
+                    std::memcpy(&range, keyFrameData + curve.keyFrameOffset - sizeof(AnimationKeyRange), sizeof(range));
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    batch.bias[c][lane] = range.bias[c];
+                    batch.scale[c][lane] = range.scale[c];
+                }
+            }
+
+            m_Groups.push_back(group);
+        }
+    }
+
+    m_FirstGroup.push_back((uint32_t)m_Groups.size());
+}
+
+void AnimationSampler::Destroy( void )
+{
+    m_KeyFrameData = nullptr;
+    m_Batches.clear();
+    m_Groups.clear();
+    m_FirstGroup.clear();
+}
+
+void AnimationSampler::Sample( uint32_t animIdx, const float* times, GraphNode* const* nodes, uint32_t numInstances ) const
+{
+    ASSERT(animIdx < GetNumAnimations());
+
+    const CurveGroup* firstGroup = m_Groups.data() + m_FirstGroup[animIdx];
+    const CurveGroup* endGroup = m_Groups.data() + m_FirstGroup[animIdx + 1];
+
+    for (uint32_t i = 0; i < numInstances; ++i)
+    {
+        for (const CurveGroup* group = firstGroup; group != endGroup; ++group)
+            group->sample(m_Batches.data() + group->firstBatch, group->numBatches, m_KeyFrameData, times[i], nodes[i]);
+    }
+}
+
+namespace
+{
+    // A glTF sampler over generated key frames
+    struct SyntheticSampler
+    {
+        std::vector<float> times;
+        std::vector<float> values;
+        glTF::Accessor input;
+        glTF::Accessor output;
+        glTF::AnimSampler sampler;
+
+        SyntheticSampler( uint32_t numComponents, glTF::AnimSampler::eInterpolation interpolation )
+        {
+            std::memset(&input, 0, sizeof(input));
+            std::memset(&output, 0, sizeof(output));
+            input.componentType = output.componentType = glTF::Accessor::kFloat;
+            input.type = glTF::Accessor::kScalar;
+            output.type = (uint16_t)(numComponents - 1);
+            sampler.m_input = &input;
+            sampler.m_output = &output;
+            sampler.m_interpolation = interpolation;
+        }
+
+        void Finish( void )
+        {
+            input.dataPtr = (byte*)times.data();
+            input.count = (uint32_t)times.size();
+            output.dataPtr = (byte*)values.data();
+            output.count = (uint32_t)times.size();
+        }
+    };
+}
+
+void BuildSyntheticAnimations( SyntheticAnimations& result, uint32_t numAnimations )
+{
+    const uint32_t kNumJoints = SyntheticAnimations::kNumJoints;
+    const uint32_t kNumKeys = 61;
+    const float kFrameTime = 1.0f / 30.0f;
+
+    enum { kRoot, kSwing, kStepped, kPulse };
+    struct CurveDesc { uint32_t kind; uint32_t targetNode; uint32_t targetPath; };
+
+    std::vector<CurveDesc> descs;
+    descs.push_back({ kRoot, 0, AnimationCurve::kTranslation });
+    for (uint32_t joint = 0; joint < kNumJoints; ++joint)
+        descs.push_back({ kSwing, joint, AnimationCurve::kRotation });
+    descs.push_back({ kStepped, 5, AnimationCurve::kTranslation });
+    descs.push_back({ kPulse, 3, AnimationCurve::kScale });
+    descs.push_back({ kPulse, 4, AnimationCurve::kScale });
+
+    for (uint32_t animIdx = 0; animIdx < numAnimations; ++animIdx)
+    {
+        AnimationSet animation;
+        animation.duration = (kNumKeys - 1) * kFrameTime;
+        animation.firstCurve = (uint32_t)result.curves.size();
+        animation.numCurves = (uint32_t)descs.size();
+
+        for (const CurveDesc& desc : descs)
+        {
+            SyntheticSampler synthetic(desc.targetPath == AnimationCurve::kRotation ? 4 : 3,
+                desc.kind == kStepped ? glTF::AnimSampler::kStep : glTF::AnimSampler::kLinear);
+
+            for (uint32_t key = 0; key < kNumKeys; ++key)
+            {
+                const float time = key * kFrameTime;
+                const float phase = time * 3.14159265f + desc.targetNode * 0.4f + animIdx * 1.1f;
+                synthetic.times.push_back(time);
+
+                float value[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+                switch (desc.kind)
+                {
+                case kRoot:
+                    value[0] = 0.5f * time;
+                    value[1] = 1.0f + 0.05f * fabsf(sinf(phase));
+                    value[2] = 0.02f * sinf(phase);
+                    break;
+                case kSwing:
+                {
+                    const float halfAngle = 0.3f * sinf(phase);
+                    const float spin = desc.targetNode * 1.3f + animIdx * 0.7f;
+                    value[0] = 0.8f * sinf(halfAngle);
+                    value[1] = 0.6f * cosf(spin) * sinf(halfAngle);
+                    value[2] = 0.6f * sinf(spin) * sinf(halfAngle);
+                    value[3] = cosf(halfAngle);
+                    break;
+                }
+                case kStepped:
+                    value[0] = (float)(key / 10);
+                    value[2] = 1.0f;
+                    break;
+                default:
+                    value[0] = 1.0f + 0.1f * sinf(phase * 2.0f);
+                    value[1] = 1.0f;
+                    value[2] = 1.0f + 0.1f * cosf(phase * 2.0f);
+                    break;
+                }
+                synthetic.values.insert(synthetic.values.end(), value,
+                    value + (desc.targetPath == AnimationCurve::kRotation ? 4 : 3));
+            }
+            synthetic.Finish();
+
+            AnimationCurve curve;
+            curve.targetNode = desc.targetNode;
+            AnimationCompression::CurveReport report;
+            AnimationCompression::CookCurve(curve, result.keyFrameData, synthetic.sampler, desc.targetPath,
+                animIdx % 2 == 0, report);
+            result.curves.push_back(curve);
+        }
+
+        result.animations.push_back(animation);
+    }
+}
+
+namespace
+{
+    const uint32_t kNumJoints = SyntheticAnimations::kNumJoints;
+
+    float RotationDifference( const GraphNode& a, const GraphNode& b )
+    {
+        const float* qa = (const float*)&a.rotation;
+        const float* qb = (const float*)&b.rotation;
+        double difference = 0.0, sum = 0.0;
+        for (int i = 0; i < 4; ++i)
+        {
+            difference += ((double)qa[i] - qb[i]) * ((double)qa[i] - qb[i]);
+            sum += ((double)qa[i] + qb[i]) * ((double)qa[i] + qb[i]);
+        }
+        return (float)(4.0 * std::asin(std::min(std::sqrt(std::min(difference, sum)) * 0.5, 1.0)));
+    }
+
+    float LinearDifference( const GraphNode& a, const GraphNode& b )
+    {
+        const float* ta = (const float*)&a.xform + 12;
+        const float* tb = (const float*)&b.xform + 12;
+        const float* sa = (const float*)&a.scale;
+        const float* sb = (const float*)&b.scale;
+        float largest = 0.0f;
+        for (int i = 0; i < 3; ++i)
+            largest = std::max(largest, std::max(std::fabs(ta[i] - tb[i]), std::fabs(sa[i] - sb[i])));
+        return largest;
+    }
+}
+
+void BenchmarkAnimationSampler( void )
+{
+    SyntheticAnimations synthetic;
+    BuildSyntheticAnimations(synthetic, 2);
+
+    const uint32_t numAnimations = (uint32_t)synthetic.animations.size();
+    const uint8_t* keyFrameData = synthetic.keyFrameData.data();
+
+    AnimationSampler sampler;
+    sampler.Create(synthetic.animations.data(), numAnimations, synthetic.curves.data(), keyFrameData);
+
+    Utility::Printf("Animation sampler benchmark (%u joints, %u animations, %zu curves per instance)\n",
+        kNumJoints, numAnimations, synthetic.curves.size());
+
+    const uint32_t instanceCounts[] = { 1000, 10000, 100000 };
+    for (uint32_t numInstances : instanceCounts)
+    {
+        std::unique_ptr<GraphNode[]> nodes(new GraphNode[(size_t)numInstances * kNumJoints]);
+        std::memset(nodes.get(), 0, (size_t)numInstances * kNumJoints * sizeof(GraphNode));
+
+        std::vector<GraphNode*> instanceNodes(numInstances);
+        std::vector<float> times((size_t)numAnimations * numInstances);
+        std::mt19937 rng(numInstances);
+        for (uint32_t i = 0; i < numInstances; ++i)
+        {
+            instanceNodes[i] = nodes.get() + (size_t)i * kNumJoints;
+            for (uint32_t a = 0; a < numAnimations; ++a)
+                times[a * numInstances + i] = synthetic.animations[a].duration * (rng() % 10000) / 9999.0f;
+        }
+
+        auto SampleScalar = [&]( uint32_t first, uint32_t count, GraphNode* const* output )
+        {
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                for (uint32_t a = 0; a < numAnimations; ++a)
+                {
+                    const AnimationSet& animation = synthetic.animations[a];
+                    for (uint32_t c = 0; c < animation.numCurves; ++c)
+                    {
+                        const AnimationCurve& curve = synthetic.curves[animation.firstCurve + c];
+                        SampleAnimationCurve(curve, keyFrameData, times[a * numInstances + i], output[i][curve.targetNode]);
+                    }
+                }
+            }
+        };
+
+        auto SampleBatched = [&]( uint32_t first, uint32_t count, GraphNode* const* output )
+        {
+            for (uint32_t a = 0; a < numAnimations; ++a)
+                sampler.Sample(a, times.data() + a * numInstances + first, output + first, count);
+        };
+
+        // Keep the total work about the same for every instance count
+        const uint32_t numPasses = std::max(1u, 200000 / numInstances);
+
+        int64_t startTick = SystemTime::GetCurrentTick();
+        for (uint32_t pass = 0; pass < numPasses; ++pass)
+            SampleScalar(0, numInstances, instanceNodes.data());
+        const double scalarSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / numPasses;
+
+        startTick = SystemTime::GetCurrentTick();
+        for (uint32_t pass = 0; pass < numPasses; ++pass)
+            SampleBatched(0, numInstances, instanceNodes.data());
+        const double batchedSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / numPasses;
+
+        // Compare the first few thousand instances
+        const uint32_t numCompared = std::min(numInstances, 4096u);
+        std::unique_ptr<GraphNode[]> reference(new GraphNode[(size_t)numCompared * kNumJoints]);
+        std::memset(reference.get(), 0, (size_t)numCompared * kNumJoints * sizeof(GraphNode));
+        std::vector<GraphNode*> referenceNodes(numCompared);
+        for (uint32_t i = 0; i < numCompared; ++i)
+            referenceNodes[i] = reference.get() + (size_t)i * kNumJoints;
+
+        SampleScalar(0, numCompared, referenceNodes.data());
+
+        float maxRotationDifference = 0.0f, maxLinearDifference = 0.0f;
+        for (size_t n = 0; n < (size_t)numCompared * kNumJoints; ++n)
+        {
+            maxRotationDifference = std::max(maxRotationDifference, RotationDifference(nodes[n], reference[n]));
+            maxLinearDifference = std::max(maxLinearDifference, LinearDifference(nodes[n], reference[n]));
+        }
+
+        const bool passed = maxRotationDifference <= 2e-4f && maxLinearDifference <= 1e-5f;
+        Utility::Printf("  %6u instances:  per curve %8.2f ms   batched %8.2f ms   (%4.1fx)   difference %.1e rad, %.1e   %s\n",
+            numInstances, scalarSeconds * 1000.0, batchedSeconds * 1000.0, scalarSeconds / batchedSeconds,
+            maxRotationDifference, maxLinearDifference, passed ? "passed" : "FAILED");
+    }
+}
@@ -0,0 +1,97 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "Animation.h"
+
+#include <cstdint>
+#include <vector>
+
+struct GraphNode;
+
+// The curves of a model regrouped when it is loaded so that they can be sampled four at a time
+// with SSE.  The curves of each animation are grouped by target path and key frame format, and
+// each group is stored in batches of four with every parameter in SoA form.  Groups are padded
+// with copies of their last curve, which write the same value to the same node again.
+//
+// Rotations use normalized linear interpolation with a correction to the interpolation factor
+// that follows slerp to within 1e-4 radians for segments of up to two radians.  Everything else
+// matches SampleAnimationCurve exactly.
+class AnimationSampler
+{
+public:
+    AnimationSampler() : m_KeyFrameData(nullptr) {}
+
+    void Create( const AnimationSet* animations, uint32_t numAnimations, const AnimationCurve* curves,
+        const uint8_t* keyFrameData );
+    void Destroy( void );
+
+    uint32_t GetNumAnimations( void ) const { return m_FirstGroup.empty() ? 0 : (uint32_t)m_FirstGroup.size() - 1; }
+
+    // Samples one animation for many instances of the model.  Instance i is at times[i] and
+    // writes to nodes[i], its animated copy of the scene graph.  Each instance is finished before
+    // the next is started so that its nodes are written while they are in cache.
+    void Sample( uint32_t animIdx, const float* times, GraphNode* const* nodes, uint32_t numInstances ) const;
+
+    void Sample( uint32_t animIdx, float time, GraphNode* nodes ) const { Sample(animIdx, &time, &nodes, 1); }
+
+private:
+    __declspec(align(16)) struct CurveBatch
+    {
+        float startTime[4];
+        float rangeScale[4];
+        float numSegments[4];
+        uint32_t stepMask[4];       // All bits set for step interpolation
+        uint32_t keyOffset[4];      // Byte offset of the first key frame
+        uint32_t targetNode[4];
+        float bias[3][4];           // kUNorm16 translation and scale only
+        float scale[3][4];
+    };
+
+    // One kernel for each target path and key frame format
+    template <uint32_t TargetPath, uint32_t Format>
+    static void SampleGroup( const CurveBatch* batches, uint32_t numBatches, const uint8_t* keyFrameData,
+        float time, GraphNode* nodes );
+
+    struct CurveGroup
+    {
+        void (*sample)( const CurveBatch*, uint32_t, const uint8_t*, float, GraphNode* );
+        uint32_t firstBatch;
+        uint32_t numBatches;
+    };
+
+    const uint8_t* m_KeyFrameData;
+    std::vector<CurveBatch> m_Batches;
+    std::vector<CurveGroup> m_Groups;
+    std::vector<uint32_t> m_FirstGroup;     // First group of each animation, plus the end
+};
+
+// Animations of a walk-like cycle on a synthetic skeleton, for benchmarks:  a bobbing root, a
+// swinging rotation on every joint, a pulsing scale on two of them, and a stepped translation.
+// Each animation is offset in phase.  Even numbered ones are compressed and odd numbered ones
+// keep float keys so that every group type is sampled.
+struct SyntheticAnimations
+{
+    static const uint32_t kNumJoints = 16;
+
+    std::vector<AnimationSet> animations;
+    std::vector<AnimationCurve> curves;
+    std::vector<uint8_t> keyFrameData;
+};
+
+void BuildSyntheticAnimations( SyntheticAnimations& result, uint32_t numAnimations );
+
+// Samples synthetic skeletons for 1K to 100K instances with SampleAnimationCurve one curve at a
+// time and with AnimationSampler, and reports the time per instance and the largest difference.
+void BenchmarkAnimationSampler( void );
@@ -0,0 +1,436 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "AnimationScheduler.h"
+#include "AnimationSampler.h"
+#include "Model.h"
+#include "../Core/Utility.h"
+#include "../Core/SystemTime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace Math;
+
+namespace
+{
+    // Moves one channel of the pose the given fraction of the way to the target
+    void StepToward( float* pose, const float* target, uint32_t targetPath, float fraction )
+    {
+        if (targetPath != AnimationCurve::kRotation)
+        {
+            for (int i = 0; i < 3; ++i)
+                pose[i] += (target[i] - pose[i]) * fraction;
+            return;
+        }
+
+        float dot = 0.0f;
+        for (int i = 0; i < 4; ++i)
+            dot += pose[i] * target[i];
+        const float sign = dot < 0.0f ? -1.0f : 1.0f;
+
+        float lengthSq = 0.0f;
+        for (int i = 0; i < 4; ++i)
+        {
+            pose[i] += (sign * target[i] - pose[i]) * fraction;
+            lengthSq += pose[i] * pose[i];
+        }
+
+        const float invLength = 1.0f / std::sqrt(lengthSq);
+        for (int i = 0; i < 4; ++i)
+            pose[i] *= invLength;
+    }
+}
+
+uint32_t AnimationScheduler::AddAgent( const AnimationBlender& blender, AnimationState* states, GraphNode* pose )
+{
+    Agent agent;
+    agent.blender = &blender;
+    agent.states = states;
+    agent.pose = pose;
+    agent.position[0] = agent.position[1] = agent.position[2] = 0.0f;
+    agent.level = 0;
+    agent.framesToTarget = 0;
+    agent.framesDeferred = 0;
+    agent.numEvaluations = 0;
+
+    m_Agents.push_back(std::move(agent));
+    return (uint32_t)m_Agents.size() - 1;
+}
+
+void AnimationScheduler::SetAgentPosition( uint32_t agentIdx, const Vector3& position )
+{
+    ASSERT(agentIdx < m_Agents.size());
+    Agent& agent = m_Agents[agentIdx];
+    agent.position[0] = position.GetX();
+    agent.position[1] = position.GetY();
+    agent.position[2] = position.GetZ();
+}
+
+void AnimationScheduler::Clear( void )
+{
+    m_Agents.clear();
+    m_DueAgents.clear();
+    m_LookAhead.clear();
+}
+
+void AnimationScheduler::Evaluate( Agent& agent, uint32_t agentIdx )
+{
+    const AnimationBlender& blender = *agent.blender;
+    const uint32_t numAnimations = blender.GetNumAnimations();
+
+    // The first pose is exact.  The interval after it is shortened by a different amount for
+    // each agent so that agents of the same level are not all due on the same frame.
+    uint32_t interval = 1u << agent.level;
+    if (agent.numEvaluations == 0)
+        interval = 1;
+    else if (agent.numEvaluations == 1)
+        interval = 1 + agentIdx % interval;
+
+    if (agent.target == nullptr)
+    {
+        agent.target.reset(new GraphNode[blender.GetNumNodes()]);
+        std::memcpy(agent.target.get(), agent.pose, blender.GetNumNodes() * sizeof(GraphNode));
+    }
+
+    // Pose the agent as it will be on the last frame of the interval
+    m_LookAhead.assign(agent.states, agent.states + numAnimations);
+    AdvanceAnimations(m_LookAhead.data(), blender.GetAnimations(), numAnimations, (interval - 1) * m_FrameTime);
+    blender.Evaluate(m_LookAhead.data(), agent.target.get(), m_Workspace);
+
+    agent.framesToTarget = interval;
+    agent.framesDeferred = 0;
+    ++agent.numEvaluations;
+}
+
+AnimationScheduler::FrameStatistics AnimationScheduler::Update( float deltaTime, const Vector3& viewerPosition )
+{
+    FrameStatistics stats;
+    std::memset(&stats, 0, sizeof(stats));
+
+    m_FrameTime = deltaTime;
+    m_DueAgents.clear();
+
+    const float viewer[3] = { viewerPosition.GetX(), viewerPosition.GetY(), viewerPosition.GetZ() };
+    float levelDistanceSq[kNumLevels - 1];
+    for (uint32_t i = 0; i < kNumLevels - 1; ++i)
+        levelDistanceSq[i] = m_Settings.levelDistance[i] * m_Settings.levelDistance[i];
+
+    for (uint32_t agentIdx = 0; agentIdx < (uint32_t)m_Agents.size(); ++agentIdx)
+    {
+        Agent& agent = m_Agents[agentIdx];
+        AdvanceAnimations(agent.states, agent.blender->GetAnimations(), agent.blender->GetNumAnimations(), deltaTime);
+
+        const float dx = agent.position[0] - viewer[0];
+        const float dy = agent.position[1] - viewer[1];
+        const float dz = agent.position[2] - viewer[2];
+        const float distanceSq = dx * dx + dy * dy + dz * dz;
+
+        uint32_t level = 0;
+        while (level < kNumLevels - 1 && distanceSq > levelDistanceSq[level])
+            ++level;
+        agent.level = level;
+        ++stats.agentsPerLevel[level];
+
+        if (agent.framesToTarget > 0)
+        {
+            ++stats.interpolatedAgents;
+        }
+        else
+        {
+            const uint64_t priority = level > agent.framesDeferred ? level - agent.framesDeferred : 0;
+            m_DueAgents.push_back(priority << 32 | agentIdx);
+        }
+    }
+
+    // Nearest (and longest waiting) first
+    std::sort(m_DueAgents.begin(), m_DueAgents.end());
+
+    for (uint64_t entry : m_DueAgents)
+    {
+        const uint32_t agentIdx = (uint32_t)entry;
+        Agent& agent = m_Agents[agentIdx];
+
+        // Agents that fit in what is left of the budget may still go after one that does not
+        const uint32_t cost = agent.blender->GetEvaluationCost(agent.states);
+        if (m_Settings.curveBudget > 0 && stats.evaluatedAgents > 0 && stats.evaluatedCurves + cost > m_Settings.curveBudget)
+        {
+            ++agent.framesDeferred;
+            ++stats.deferredAgents;
+            continue;
+        }
+
+        Evaluate(agent, agentIdx);
+        stats.evaluatedCurves += cost;
+        ++stats.evaluatedAgents;
+    }
+
+    for (Agent& agent : m_Agents)
+    {
+        if (agent.framesToTarget == 0)
+            continue;
+
+        const float fraction = 1.0f / agent.framesToTarget--;
+        for (const AnimationBlender::Channel& channel : agent.blender->GetAnimatedChannels())
+        {
+            GraphNode& node = agent.pose[channel.targetNode];
+            StepToward(AnimationBlender::GetChannel(node, channel.targetPath),
+                AnimationBlender::GetChannel(agent.target[channel.targetNode], channel.targetPath), channel.targetPath, fraction);
+
+            if (channel.targetPath != AnimationCurve::kTranslation)
+                node.staleMatrix = true;
+        }
+    }
+
+    return stats;
+}
+
+namespace
+{
+    const uint32_t kNumJoints = SyntheticAnimations::kNumJoints;
+
+    float RotationDifference( const GraphNode& a, const GraphNode& b )
+    {
+        const float* qa = (const float*)&a.rotation;
+        const float* qb = (const float*)&b.rotation;
+        double difference = 0.0, sum = 0.0;
+        for (int i = 0; i < 4; ++i)
+        {
+            difference += ((double)qa[i] - qb[i]) * ((double)qa[i] - qb[i]);
+            sum += ((double)qa[i] + qb[i]) * ((double)qa[i] + qb[i]);
+        }
+        return (float)(4.0 * std::asin(std::min(std::sqrt(std::min(difference, sum)) * 0.5, 1.0)));
+    }
+
+    float LinearDifference( const GraphNode& a, const GraphNode& b )
+    {
+        const float* ta = (const float*)&a.xform + 12;
+        const float* tb = (const float*)&b.xform + 12;
+        const float* sa = (const float*)&a.scale;
+        const float* sb = (const float*)&b.scale;
+        float largest = 0.0f;
+        for (int i = 0; i < 3; ++i)
+            largest = std::max(largest, std::max(std::fabs(ta[i] - tb[i]), std::fabs(sa[i] - sb[i])));
+        return largest;
+    }
+
+    void MakeRestPose( GraphNode* nodes, uint32_t numNodes )
+    {
+        std::memset(nodes, 0, numNodes * sizeof(GraphNode));
+        for (uint32_t i = 0; i < numNodes; ++i)
+        {
+            float* rotation = (float*)&nodes[i].rotation;
+            float* scale = (float*)&nodes[i].scale;
+            rotation[3] = 1.0f;
+            scale[0] = scale[1] = scale[2] = 1.0f;
+        }
+    }
+
+    // Checks a few blends whose results are known from direct samples
+    bool CheckBlending( const AnimationSampler& sampler, const AnimationBlender& blender, const GraphNode* restPose )
+    {
+        AnimationBlender::Workspace workspace;
+        GraphNode blended[kNumJoints], expected[kNumJoints], other[kNumJoints];
+        AnimationState states[3];
+        float maxRotationDifference = 0.0f, maxLinearDifference = 0.0f;
+
+        auto Compare = [&]( void )
+        {
+            for (uint32_t n = 0; n < kNumJoints; ++n)
+            {
+                maxRotationDifference = std::max(maxRotationDifference, RotationDifference(blended[n], expected[n]));
+                maxLinearDifference = std::max(maxLinearDifference, LinearDifference(blended[n], expected[n]));
+            }
+        };
+
+        for (float time = 0.0f; time < 2.0f; time += 0.37f)
+        {
+            for (AnimationState& state : states)
+            {
+                state = AnimationState();
+                state.time = time;
+            }
+
+            // A dominant animation over a negligible one
+            states[0].state = states[1].state = AnimationState::kLooping;
+            states[1].weight = 1e-6f;
+            std::memcpy(blended, restPose, sizeof(blended));
+            std::memcpy(expected, restPose, sizeof(expected));
+            blender.Evaluate(states, blended, workspace);
+            sampler.Sample(0, time, expected);
+            Compare();
+
+            // An even blend of two animations
+            states[1].weight = 1.0f;
+            std::memcpy(other, restPose, sizeof(other));
+            sampler.Sample(1, time, other);
+            blender.Evaluate(states, blended, workspace);
+            for (uint32_t n = 0; n < kNumJoints; ++n)
+            {
+                float* position = (float*)&expected[n].xform + 12;
+                float* rotation = (float*)&expected[n].rotation;
+                float* scale = (float*)&expected[n].scale;
+                const float* otherPosition = (const float*)&other[n].xform + 12;
+                const float* otherRotation = (const float*)&other[n].rotation;
+                const float* otherScale = (const float*)&other[n].scale;
+
+                float dot = 0.0f, lengthSq = 0.0f;
+                for (int i = 0; i < 4; ++i)
+                    dot += rotation[i] * otherRotation[i];
+                for (int i = 0; i < 4; ++i)
+                {
+                    rotation[i] += dot < 0.0f ? -otherRotation[i] : otherRotation[i];
+                    lengthSq += rotation[i] * rotation[i];
+                }
+                for (int i = 0; i < 4; ++i)
+                    rotation[i] /= std::sqrt(lengthSq);
+                for (int i = 0; i < 3; ++i)
+                {
+                    position[i] = 0.5f * (position[i] + otherPosition[i]);
+                    scale[i] = 0.5f * (scale[i] + otherScale[i]);
+                }
+            }
+            Compare();
+
+            // An additive animation at full weight over the rest pose
+            states[0].state = states[1].state = AnimationState::kStopped;
+            states[2].state = AnimationState::kLooping;
+            states[2].additive = true;
+            std::memcpy(blended, restPose, sizeof(blended));
+            std::memcpy(expected, restPose, sizeof(expected));
+            blender.Evaluate(states, blended, workspace);
+            sampler.Sample(2, time, expected);
+            Compare();
+        }
+
+        const bool passed = maxRotationDifference <= 1e-3f && maxLinearDifference <= 1e-5f;
+        Utility::Printf("  Blending:  difference from direct samples %.1e rad, %.1e   %s\n",
+            maxRotationDifference, maxLinearDifference, passed ? "passed" : "FAILED");
+        return passed;
+    }
+}
+
+void BenchmarkAnimationScheduler( void )
+{
+    SyntheticAnimations synthetic;
+    BuildSyntheticAnimations(synthetic, 3);
+
+    const uint32_t numAnimations = (uint32_t)synthetic.animations.size();
+
+    AnimationSampler sampler;
+    sampler.Create(synthetic.animations.data(), numAnimations, synthetic.curves.data(), synthetic.keyFrameData.data());
+
+    GraphNode restPose[kNumJoints];
+    MakeRestPose(restPose, kNumJoints);
+
+    AnimationBlender blender;
+    blender.Create(sampler, synthetic.animations.data(), numAnimations, synthetic.curves.data(), restPose, kNumJoints);
+
+    Utility::Printf("Animation scheduler benchmark (%u joints, two blended animations and one additive, %zu curves per agent)\n",
+        kNumJoints, synthetic.curves.size());
+
+    CheckBlending(sampler, blender, restPose);
+
+    const float kFrameTime = 1.0f / 60.0f;
+    const uint32_t kNumFrames = 120;
+
+    const uint32_t agentCounts[] = { 1000, 10000, 30000 };
+    for (uint32_t numAgents : agentCounts)
+    {
+        std::unique_ptr<GraphNode[]> poses(new GraphNode[(size_t)numAgents * kNumJoints]);
+        std::vector<AnimationState> states((size_t)numAgents * numAnimations);
+        std::vector<Vector3> positions(numAgents);
+
+        // Agents scattered over a disc 100 units across
+        std::mt19937 rng(numAgents);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (uint32_t i = 0; i < numAgents; ++i)
+        {
+            const float radius = 50.0f * std::sqrt(unit(rng));
+            const float angle = 6.2831853f * unit(rng);
+            positions[i] = Vector3(radius * std::cos(angle), 0.0f, radius * std::sin(angle));
+        }
+
+        const char* configNames[] = { "every frame", "lod", "lod + budget" };
+        for (uint32_t config = 0; config < 3; ++config)
+        {
+            AnimationScheduler::Settings settings;
+            if (config == 0)
+                settings.levelDistance[0] = settings.levelDistance[1] = settings.levelDistance[2] = 1e10f;
+            if (config == 2)
+                settings.curveBudget = numAgents * (uint32_t)synthetic.curves.size() / 3;
+
+            AnimationScheduler scheduler;
+            scheduler.SetSettings(settings);
+
+            std::mt19937 timeRng(numAgents);
+            for (uint32_t i = 0; i < numAgents; ++i)
+            {
+                GraphNode* pose = poses.get() + (size_t)i * kNumJoints;
+                AnimationState* agentStates = states.data() + (size_t)i * numAnimations;
+                MakeRestPose(pose, kNumJoints);
+
+                for (uint32_t a = 0; a < numAnimations; ++a)
+                {
+                    agentStates[a] = AnimationState();
+                    agentStates[a].state = AnimationState::kLooping;
+                    agentStates[a].time = synthetic.animations[a].duration * (timeRng() % 10000) / 10000.0f;
+                }
+                agentStates[0].weight = 0.6f;
+                agentStates[1].weight = 0.4f;
+                agentStates[2].weight = 0.5f;
+                agentStates[2].additive = true;
+
+                scheduler.SetAgentPosition(scheduler.AddAgent(blender, agentStates, pose), positions[i]);
+            }
+
+            uint64_t totalCurves = 0;
+            uint32_t maxCurves = 0, totalDeferred = 0;
+            const int64_t startTick = SystemTime::GetCurrentTick();
+            for (uint32_t frame = 0; frame < kNumFrames; ++frame)
+            {
+                AnimationScheduler::FrameStatistics stats = scheduler.Update(kFrameTime, Vector3(kZero));
+                totalCurves += stats.evaluatedCurves;
+                maxCurves = std::max(maxCurves, stats.evaluatedCurves);
+                totalDeferred += stats.deferredAgents;
+            }
+            const double frameSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / kNumFrames;
+
+            // Compare the last frame to a full evaluation
+            AnimationBlender::Workspace workspace;
+            GraphNode exact[kNumJoints];
+            float maxRotationDifference = 0.0f, maxLinearDifference = 0.0f;
+            for (uint32_t i = 0; i < std::min(numAgents, 1000u); ++i)
+            {
+                const GraphNode* pose = poses.get() + (size_t)i * kNumJoints;
+                MakeRestPose(exact, kNumJoints);
+                blender.Evaluate(states.data() + (size_t)i * numAnimations, exact, workspace);
+                for (uint32_t n = 0; n < kNumJoints; ++n)
+                {
+                    maxRotationDifference = std::max(maxRotationDifference, RotationDifference(pose[n], exact[n]));
+                    maxLinearDifference = std::max(maxLinearDifference, LinearDifference(pose[n], exact[n]));
+                }
+            }
+
+            Utility::Printf("  %6u agents, %-12s:  %8.2f ms/frame   curves/frame %9.0f avg %9u max   deferred/frame %7.1f   "
+                "difference %.1e rad, %.1e\n", numAgents, configNames[config], frameSeconds * 1000.0,
+                (double)totalCurves / kNumFrames, maxCurves, (double)totalDeferred / kNumFrames,
+                maxRotationDifference, maxLinearDifference);
+
+            if (config == 0 && (maxRotationDifference > 1e-3f || maxLinearDifference > 1e-5f))
+                Utility::Printf("  Evaluating every frame does not match a full evaluation   FAILED\n");
+        }
+    }
+}
@@ -0,0 +1,98 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "AnimationBlender.h"
+#include "../Core/Math/Vector.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Time slices the animation of a crowd.  Each agent is given a level of detail by its distance
+// from the viewer, and level L evaluates its animations every 2^L frames.  An evaluation poses
+// the agent as it will be when the next one is due, and the frames in between move the pose
+// toward that target a step at a time, so a pose is exact every 2^L frames and interpolated in
+// between.  Interpolating is a blend per animated channel, which is much cheaper than sampling,
+// but it smooths steps and loop wraps over the interval.
+//
+// At most curveBudget curves are sampled per frame.  Agents that are due are evaluated nearest
+// first, and those that do not fit hold their pose until a later frame.  Every frame an agent
+// waits raises its priority by one level so that distant agents are never starved.
+class AnimationScheduler
+{
+public:
+    static const uint32_t kNumLevels = 4;   // Every 1, 2, 4, or 8 frames
+
+    struct Settings
+    {
+        float levelDistance[kNumLevels - 1];    // Agents beyond levelDistance[i] use level i + 1
+        uint32_t curveBudget;                   // Curves sampled per frame, or 0 for no limit
+
+        Settings() : levelDistance{ 10.0f, 25.0f, 50.0f }, curveBudget(0) {}
+    };
+
+    struct FrameStatistics
+    {
+        uint32_t evaluatedAgents;
+        uint32_t interpolatedAgents;
+        uint32_t deferredAgents;    // Due for evaluation but over budget
+        uint32_t evaluatedCurves;
+        uint32_t agentsPerLevel[kNumLevels];
+    };
+
+    AnimationScheduler() : m_FrameTime(0.0f) {}
+
+    void SetSettings( const Settings& settings ) { m_Settings = settings; }
+    const Settings& GetSettings( void ) const { return m_Settings; }
+
+    // The agent animates pose with one state per animation of the blender.  The caller owns the
+    // states and the pose, and may change the states between frames.  Returns the agent index.
+    uint32_t AddAgent( const AnimationBlender& blender, AnimationState* states, GraphNode* pose );
+    void SetAgentPosition( uint32_t agentIdx, const Math::Vector3& position );
+    void Clear( void );
+
+    uint32_t GetNumAgents( void ) const { return (uint32_t)m_Agents.size(); }
+
+    // Advances every agent's animations and updates its pose
+    FrameStatistics Update( float deltaTime, const Math::Vector3& viewerPosition );
+
+private:
+    struct Agent
+    {
+        const AnimationBlender* blender;
+        AnimationState* states;
+        GraphNode* pose;
+        std::unique_ptr<GraphNode[]> target;
+        float position[3];
+        uint32_t level;
+        uint32_t framesToTarget;    // Zero when due for evaluation
+        uint32_t framesDeferred;
+        uint32_t numEvaluations;
+    };
+
+    void Evaluate( Agent& agent, uint32_t agentIdx );
+
+    Settings m_Settings;
+    float m_FrameTime;
+    std::vector<Agent> m_Agents;
+    std::vector<uint64_t> m_DueAgents;      // Priority in the upper half, agent index in the lower
+    std::vector<AnimationState> m_LookAhead;
+    AnimationBlender::Workspace m_Workspace;
+};
+
+// Checks blending against direct sampling, then animates crowds of 1K to 30K synthetic agents
+// with and without levels of detail and a curve budget and reports the curves sampled and the
+// time spent per frame, and how far interpolated poses stray from evaluated ones.
+void BenchmarkAnimationScheduler( void );
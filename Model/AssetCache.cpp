@@ -0,0 +1,280 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "AssetCache.h"
+#include "json.hpp"
+#include "../Core/Utility.h"
+#include "../Core/Hash.h"
+#include "../Core/FileUtility.h"
+#include "../Core/SystemTime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace AssetCache
+{
+    std::wstring s_CacheDir;
+    std::once_flag s_InitFlag;
+    bool s_DirectoryOverridden = false;
+
+    std::atomic<uint32_t> s_Hits(0);
+    std::atomic<uint32_t> s_Misses(0);
+    std::atomic<uint32_t> s_Rejects(0);
+    std::atomic<uint32_t> s_Stores(0);
+    std::atomic<uint64_t> s_BytesHashed(0);
+    std::atomic<int64_t> s_TicksHashing(0);
+
+    // Entries this process found corrupt, which Store overwrites
+    std::mutex s_RejectedMutex;
+    std::vector<std::wstring> s_RejectedEntries;
+
+    bool WasRejected( const std::wstring& entry )
+    {
+        std::lock_guard<std::mutex> lock(s_RejectedMutex);
+        return std::find(s_RejectedEntries.begin(), s_RejectedEntries.end(), entry) != s_RejectedEntries.end();
+    }
+
+    bool CreateDirectoryRecursive( const std::wstring& dir )
+    {
+        if (dir.empty())
+            return false;
+
+        DWORD attribs = GetFileAttributesW(dir.c_str());
+        if (attribs != INVALID_FILE_ATTRIBUTES)
+            return (attribs & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+        std::wstring trimmed = dir;
+        while (!trimmed.empty() && (trimmed.back() == L'\\' || trimmed.back() == L'/'))
+            trimmed.pop_back();
+
+        size_t parentEnd = trimmed.find_last_of(L"\\/");
+        if (parentEnd != std::wstring::npos && parentEnd > 0 && trimmed[parentEnd - 1] != L':')
+            CreateDirectoryRecursive(trimmed.substr(0, parentEnd));
+
+        return CreateDirectoryW(trimmed.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+    }
+
+    void InitializeDirectory( void )
+    {
+        if (s_DirectoryOverridden)
+            return;
+
+        std::wstring cacheDir;
+        if (!CommandLineArgs::GetString(L"asset_cache", cacheDir) || cacheDir == L"none")
+        {
+            cacheDir.clear();
+        }
+        else if (cacheDir == L"default")
+        {
+            cacheDir.clear();
+
+            wchar_t* localAppData = nullptr;
+            size_t length = 0;
+            if (_wdupenv_s(&localAppData, &length, L"LOCALAPPDATA") == 0 && localAppData != nullptr)
+            {
+                cacheDir = std::wstring(localAppData) + L"\\MiniEngine\\AssetCache";
+                free(localAppData);
+            }
+        }
+
+        SetDirectory(cacheDir);
+    }
+
+    std::wstring EntryPath( uint64_t key, const wchar_t* extension )
+    {
+        wchar_t keyString[17];
+        swprintf_s(keyString, L"%016llx", key);
+        return s_CacheDir + keyString + extension;
+    }
+
+    // A .gltf file is only a description.  Its geometry lives in external buffers which must
+    // also be part of the key.
+    bool HashExternalBuffers( const std::wstring& sourceFile, const Utility::MappedFile& source, uint64_t& hash )
+    {
+        json root = json::parse((const char*)source.GetData(), (const char*)source.GetData() + source.GetSize(), nullptr, false);
+        if (root.is_discarded())
+            return false;
+
+        auto buffers = root.find("buffers");
+        if (buffers == root.end())
+            return true;
+
+        const std::wstring basePath = Utility::GetBasePath(sourceFile);
+
+        for (json& buffer : *buffers)
+        {
+            auto uri = buffer.find("uri");
+            if (uri == buffer.end())
+                continue;
+
+            const std::string& uriString = uri->get_ref<const std::string&>();
+            if (uriString.compare(0, 5, "data:") == 0)
+                continue;   // Embedded data was already hashed with the .gltf
+
+            Utility::MappedFile bin;
+            if (!bin.Open(basePath + Utility::UTF8ToWideString(uriString)))
+                return false;
+
+            hash = Utility::HashBytes64(bin.GetData(), bin.GetSize(), hash);
+            s_BytesHashed += bin.GetSize();
+        }
+
+        return true;
+    }
+}
+
+void AssetCache::SetDirectory( const std::wstring& cacheDir )
+{
+    s_DirectoryOverridden = true;
+    s_CacheDir = cacheDir;
+
+    if (s_CacheDir.empty())
+        return;
+
+    if (s_CacheDir.back() != L'\\' && s_CacheDir.back() != L'/')
+        s_CacheDir += L'\\';
+
+    if (!CreateDirectoryRecursive(s_CacheDir))
+    {
+        Utility::Printf(L"Unable to create asset cache directory %ws.  Asset cache disabled.\n", s_CacheDir.c_str());
+        s_CacheDir.clear();
+    }
+}
+
+const std::wstring& AssetCache::GetDirectory( void )
+{
+    std::call_once(s_InitFlag, InitializeDirectory);
+    return s_CacheDir;
+}
+
+bool AssetCache::IsEnabled( void )
+{
+    return !GetDirectory().empty();
+}
+
+bool AssetCache::ComputeKey( const std::wstring& sourceFile, uint32_t flags, uint32_t formatVersion, uint64_t& key )
+{
+    int64_t startTick = SystemTime::GetCurrentTick();
+
+    Utility::MappedFile source;
+    if (!source.Open(sourceFile))
+        return false;
+
+    // The format version and flags seed the hash so that changing either invalidates the entry
+    const uint32_t header[2] = { formatVersion, flags };
+    uint64_t hash = Utility::HashBytes64(header, sizeof(header));
+    hash = Utility::HashBytes64(source.GetData(), source.GetSize(), hash);
+    s_BytesHashed += source.GetSize();
+
+    bool succeeded = true;
+    if (Utility::ToLower(Utility::GetFileExtension(sourceFile)) == L"gltf")
+        succeeded = HashExternalBuffers(sourceFile, source, hash);
+
+    s_TicksHashing += SystemTime::GetCurrentTick() - startTick;
+
+    key = hash;
+    return succeeded;
+}
+
+bool AssetCache::Find( uint64_t key, const wchar_t* extension, std::wstring& cachedFile )
+{
+    if (!IsEnabled())
+        return false;
+
+    std::wstring entry = EntryPath(key, extension);
+    if (GetFileAttributesW(entry.c_str()) == INVALID_FILE_ATTRIBUTES)
+    {
+        ++s_Misses;
+        return false;
+    }
+
+    ++s_Hits;
+    cachedFile = entry;
+    return true;
+}
+
+bool AssetCache::Store( uint64_t key, const wchar_t* extension, const std::wstring& cookedFile )
+{
+    if (!IsEnabled())
+        return false;
+
+    const std::wstring entry = EntryPath(key, extension);
+
+    // Another process may have published this entry while we were cooking.  The content is
+    // identical by definition, so keep theirs, unless it is the corrupt copy we rejected.
+    const bool replace = WasRejected(entry);
+    if (!replace && GetFileAttributesW(entry.c_str()) != INVALID_FILE_ATTRIBUTES)
+        return true;
+
+    wchar_t uniqueSuffix[32];
+    swprintf_s(uniqueSuffix, L".%u.%u.tmp", GetCurrentProcessId(), GetCurrentThreadId());
+    const std::wstring tempFile = entry + uniqueSuffix;
+
+    if (!CopyFileW(cookedFile.c_str(), tempFile.c_str(), FALSE))
+        return false;
+
+    // A rejected entry may still be mapped by a model loaded before it was found corrupt
+    const bool moved = replace ? Utility::ReplaceMappedFile(tempFile, entry) :
+        MoveFileExW(tempFile.c_str(), entry.c_str(), MOVEFILE_WRITE_THROUGH) != 0;
+    if (!moved)
+    {
+        DeleteFileW(tempFile.c_str());
+        return GetFileAttributesW(entry.c_str()) != INVALID_FILE_ATTRIBUTES;
+    }
+
+    ++s_Stores;
+    return true;
+}
+
+void AssetCache::Reject( uint64_t key, const wchar_t* extension )
+{
+    if (!IsEnabled())
+        return;
+
+    const std::wstring entry = EntryPath(key, extension);
+    Utility::Printf(L"Asset cache entry %ws is corrupt.  Evicting it.\n", entry.c_str());
+
+    // Deleting fails while another process has the entry open, so remember to overwrite it
+    DeleteFileW(entry.c_str());
+    {
+        std::lock_guard<std::mutex> lock(s_RejectedMutex);
+        s_RejectedEntries.push_back(entry);
+    }
+    ++s_Rejects;
+}
+
+AssetCache::Statistics AssetCache::GetStatistics( void )
+{
+    Statistics stats;
+    stats.hits = s_Hits;
+    stats.misses = s_Misses;
+    stats.rejects = s_Rejects;
+    stats.stores = s_Stores;
+    stats.bytesHashed = s_BytesHashed;
+    stats.secondsHashing = SystemTime::TicksToSeconds(s_TicksHashing);
+    return stats;
+}
+
+void AssetCache::PrintStatistics( void )
+{
+    if (!IsEnabled())
+        return;
+
+    Statistics stats = GetStatistics();
+    Utility::Printf("Asset cache:  %u hits, %u misses, %u rejected, %u stored, %.1f MB hashed in %.3f s\n",
+        stats.hits, stats.misses, stats.rejects, stats.stores, stats.bytesHashed / (1024.0 * 1024.0), stats.secondsHashing);
+}
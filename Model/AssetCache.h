@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//
+// A content-addressed store for cooked assets (.mini models and .dds textures).  Entries are
+// keyed by a hash of the source bytes, the conversion flags, and the output format version,
+// so time stamps never matter.  The cache directory can be shared by several checkouts or
+// mapped to a network share for build machines.
+//
+namespace AssetCache
+{
+    // The cache is off, and .mini files are rebuilt based on time stamps, unless the command line
+    // names a directory with "-asset_cache <dir>".  "-asset_cache default" uses
+    // %LOCALAPPDATA%\MiniEngine\AssetCache.  Passing an empty string here disables the cache.
+    void SetDirectory( const std::wstring& cacheDir );
+    const std::wstring& GetDirectory( void );
+    bool IsEnabled( void );
+
+    // Hashes the source file, any external .bin buffers referenced by a .gltf file, the
+    // conversion flags and the format version.  Returns false if the source can't be read.
+    bool ComputeKey( const std::wstring& sourceFile, uint32_t flags, uint32_t formatVersion, uint64_t& key );
+
+    // If an output for this key is cached, returns its path and records a hit.  Otherwise
+    // records a miss.
+    bool Find( uint64_t key, const wchar_t* extension, std::wstring& cachedFile );
+
+    // Publishes a freshly cooked file under this key.  The copy is written to a temporary
+    // file and renamed into place, so concurrent cooks of the same asset are harmless.  An
+    // existing entry is kept unless this process rejected it.
+    bool Store( uint64_t key, const wchar_t* extension, const std::wstring& cookedFile );
+
+    // Evicts an entry returned by Find that turned out to be truncated or corrupt.  The next
+    // Store of this key replaces it even if it could not be deleted.
+    void Reject( uint64_t key, const wchar_t* extension );
+
+    struct Statistics
+    {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t rejects;
+        uint32_t stores;
+        uint64_t bytesHashed;
+        double secondsHashing;
+    };
+
+    Statistics GetStatistics( void );
+    void PrintStatistics( void );
+}
@@ -205,7 +205,7 @@ bool ModelH3D::BuildModel(ModelData& model, const std::wstring& basePath) const
 
         BoundingSphere sphereOS;
         AxisAlignedBox boxOS;
-        Renderer::CompileMesh(model.m_Meshes, model.m_GeometryData, gltfMesh, 0, Matrix4(kIdentity), sphereOS, boxOS); 
+        Renderer::CompileMesh(model.m_Meshes, model.m_GeometryData, model.m_Meshlets, gltfMesh, 0, Matrix4(kIdentity), sphereOS, boxOS); 
         model.m_BoundingSphere = model.m_BoundingSphere.Union(sphereOS);
         model.m_BoundingBox.AddBoundingBox(boxOS);
     }
@@ -19,6 +19,9 @@
 #include "glTF.h"
 #include "Model.h"
 #include "IndexOptimizePostTransform.h"
+#include "VertexDeduplicate.h"
+#include "MeshletBuilder.h"
+#include "MeshMetrics.h"
 #include "../Core/VectorMath.h"
 #include "DirectXMesh.h"
 
@@ -428,6 +431,89 @@ void OptimizeMesh( Renderer::Primitive& outPrim, const glTF::Primitive& inPrim,
         dvbw.Write(weights.get(), "BLENDWEIGHT", 0, vertexCount);
     }
 
+    // Measure the authored index order against the cooked one for the cook report
+    outPrim.hasReport = CookReport::IsEnabled() && inPrim.indices != nullptr;
+    if (outPrim.hasReport)
+    {
+        // The analysis reads 16- or 32-bit indices, so 8-bit ones are widened first
+        const void* srcIndices = inPrim.indices->dataPtr;
+        bool srcIndex32 = inPrim.indices->componentType == Accessor::kUnsignedInt;
+        std::vector<uint32_t> widenedIndices;
+        if (inPrim.indices->componentType == Accessor::kUnsignedByte)
+        {
+            const uint8_t* ib = (const uint8_t*)inPrim.indices->dataPtr;
+            widenedIndices.assign(ib, ib + indexCount);
+            srcIndices = widenedIndices.data();
+            srcIndex32 = true;
+        }
+
+        CookReport::Entry& report = outPrim.report;
+        report.materialIdx = material.index;
+        report.triangleCount = indexCount / 3;
+        report.vertexCountBefore = vertexCount;
+        report.before = AnalyzeMesh(srcIndices, srcIndex32, indexCount, (const uint8_t*)position.get(),
+            sizeof(XMFLOAT3), vertexCount);
+        report.before.fetch = AnalyzeVertexFetch(srcIndices, srcIndex32, indexCount, vertexCount, stride);
+    }
+
+    // Generated index lists for non-indexed primitives reference past the end of the vertex
+    // buffer, so they are left alone.
+    if (maxIndex < vertexCount)
+    {
+        std::vector<uint32_t> vertexRemap(vertexCount);
+
+        // Weld vertices that are bit-identical after compression.  The depth-only vertex is built
+        // from a subset of the same attributes, so the remap applies to it as well.
+        uint32_t uniqueCount = DeduplicateVertices(outPrim.VB->data(), vertexCount, stride, vertexRemap.data());
+        if (uniqueCount < vertexCount)
+        {
+            CompactVertices(outPrim.VB->data(), vertexCount, stride, vertexRemap.data());
+            CompactVertices(outPrim.DepthVB->data(), vertexCount, depthStride, vertexRemap.data());
+            outPrim.VB->resize(stride * uniqueCount);
+            outPrim.DepthVB->resize(depthStride * uniqueCount);
+
+            if (b32BitIndices)
+                RemapIndices((uint32_t*)indices, indexCount, vertexRemap.data());
+            else
+                RemapIndices((uint16_t*)indices, indexCount, vertexRemap.data());
+        }
+
+        // Now that the index order is final, store vertices in the order they are first used
+        // so that vertex fetch streams through memory.  Unused vertices are dropped.
+        uint32_t usedCount = OptimizeVertexFetch(indices, b32BitIndices, indexCount, uniqueCount, vertexRemap.data());
+        PermuteVertices(outPrim.VB->data(), uniqueCount, stride, vertexRemap.data());
+        PermuteVertices(outPrim.DepthVB->data(), uniqueCount, depthStride, vertexRemap.data());
+        outPrim.VB->resize(stride * usedCount);
+        outPrim.DepthVB->resize(depthStride * usedCount);
+
+        if (b32BitIndices)
+            RemapIndices((uint32_t*)indices, indexCount, vertexRemap.data());
+        else
+            RemapIndices((uint16_t*)indices, indexCount, vertexRemap.data());
+    }
+
+    if (outPrim.hasReport)
+    {
+        uint32_t numVertices = (uint32_t)outPrim.VB->size() / stride;
+        outPrim.report.vertexCountAfter = numVertices;
+        outPrim.report.after = AnalyzeMesh(indices, b32BitIndices, indexCount, outPrim.VB->data(), stride, numVertices);
+    }
+
+    // Split into meshlets for cluster culling.  Two-sided and skinned triangles have no fixed
+    // facing, so their meshlets only get bounding spheres.
+    if (maxIndex < vertexCount)
+    {
+        uint32_t numVertices = (uint32_t)outPrim.VB->size() / stride;
+        BuildMeshlets(outPrim.meshlets, indices, b32BitIndices, indexCount, outPrim.VB->data(), stride,
+            numVertices, !material.twoSided && !HasSkin);
+
+#ifndef RELEASE
+        const Renderer::MeshletData& meshlets = outPrim.meshlets;
+        ASSERT(VerifyMeshlets(meshlets.m_Meshlets.data(), (uint32_t)meshlets.m_Meshlets.size(), meshlets.m_Vertices.data(),
+            meshlets.m_Triangles.data(), indices, b32BitIndices, indexCount, numVertices), "Meshlets do not cover the primitive");
+#endif
+    }
+
     ASSERT(material.index < 0x8000, "Only 15-bit material indices allowed");
 
     outPrim.vertexStride = (uint16_t)stride;
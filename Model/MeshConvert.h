@@ -14,6 +14,8 @@
 #pragma once
 
 #include "glTF.h"
+#include "ModelLoader.h"
+#include "MeshMetrics.h"
 #include "../Core/Math/BoundingSphere.h"
 #include "../Core/Math/BoundingBox.h"
 
@@ -44,6 +46,9 @@ namespace Renderer
             };
         };
         uint16_t vertexStride;
+        MeshletData meshlets;
+        bool hasReport;
+        CookReport::Entry report;
     };
 }
 
@@ -0,0 +1,354 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "MeshCulling.h"
+#include "Model.h"
+#include "../Core/Utility.h"
+#include "../Core/Camera.h"
+#include "../Core/SystemTime.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <immintrin.h>
+#include <intrin.h>
+#include <random>
+
+using namespace Math;
+using namespace Renderer;
+
+namespace
+{
+    // Broadcast copies of the view matrix rows and the frustum planes
+    struct CullConstants
+    {
+        float view[4][3];
+        float planes[6][4];
+    };
+
+    void GetCullConstants( const Matrix4& viewMat, const Frustum& viewFrustum, CullConstants& constants )
+    {
+        const Vector4 rows[4] = { viewMat.GetX(), viewMat.GetY(), viewMat.GetZ(), viewMat.GetW() };
+        for (int i = 0; i < 4; ++i)
+        {
+            constants.view[i][0] = rows[i].GetX();
+            constants.view[i][1] = rows[i].GetY();
+            constants.view[i][2] = rows[i].GetZ();
+        }
+
+        for (int i = 0; i < 6; ++i)
+        {
+            Vector4 plane = viewFrustum.GetFrustumPlane((Frustum::PlaneID)i);
+            XMStoreFloat4((XMFLOAT4*)constants.planes[i], plane);
+        }
+    }
+
+    bool CpuSupportsAVX( void )
+    {
+        int cpuInfo[4];
+        __cpuid(cpuInfo, 1);
+        const bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+        const bool avx = (cpuInfo[2] & (1 << 28)) != 0;
+        return osxsave && avx && (_xgetbv(0) & 6) == 6;
+    }
+
+    const bool s_UseAVX = CpuSupportsAVX();
+
+    // The operations below are ordered like AffineTransform * Vector3 (XMVector3TransformNormal plus
+    // the translation) and XMVector3Dot so that the batched kernels make the same decisions as
+    // Frustum::IntersectSphere, bit for bit.
+
+    uint32_t CullBatchesSSE( const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+        const uint32_t* nodeIdx, uint32_t first, uint32_t end, const ScaleAndTranslation sphereTransforms[],
+        const CullConstants& c, uint32_t* visibleIdx, float* visibleDist )
+    {
+        uint32_t numVisible = 0;
+
+        for (uint32_t i = first; i < end; i += 4)
+        {
+            // Gather the four node transforms and transpose them to SoA
+            __m128 tx = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 0]]);
+            __m128 ty = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 1]]);
+            __m128 tz = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 2]]);
+            __m128 scale = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 3]]);
+            _MM_TRANSPOSE4_PS(tx, ty, tz, scale);
+
+            __m128 wx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(centerX + i), scale), tx);
+            __m128 wy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(centerY + i), scale), ty);
+            __m128 wz = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(centerZ + i), scale), tz);
+            __m128 r = _mm_mul_ps(_mm_loadu_ps(radius + i), scale);
+
+            __m128 v[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                __m128 acc = _mm_mul_ps(wz, _mm_set1_ps(c.view[2][k]));
+                acc = _mm_add_ps(acc, _mm_mul_ps(wy, _mm_set1_ps(c.view[1][k])));
+                acc = _mm_add_ps(acc, _mm_mul_ps(wx, _mm_set1_ps(c.view[0][k])));
+                v[k] = _mm_add_ps(acc, _mm_set1_ps(c.view[3][k]));
+            }
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p)
+            {
+                __m128 d = _mm_add_ps(_mm_mul_ps(v[0], _mm_set1_ps(c.planes[p][0])), _mm_mul_ps(v[1], _mm_set1_ps(c.planes[p][1])));
+                d = _mm_add_ps(d, _mm_mul_ps(v[2], _mm_set1_ps(c.planes[p][2])));
+                d = _mm_add_ps(_mm_add_ps(d, _mm_set1_ps(c.planes[p][3])), r);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+            }
+
+            unsigned long mask = _mm_movemask_ps(inside);
+            if (i + 4 > end)
+                mask &= (1u << (end - i)) - 1;
+
+            if (mask == 0)
+                continue;
+
+            __m128 dist = _mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), v[2]), r);
+            __declspec(align(16)) float distances[4];
+            _mm_store_ps(distances, dist);
+
+            unsigned long lane;
+            while (_BitScanForward(&lane, mask))
+            {
+                mask &= mask - 1;
+                visibleIdx[numVisible] = i + lane;
+                visibleDist[numVisible] = distances[lane];
+                ++numVisible;
+            }
+        }
+
+        return numVisible;
+    }
+
+    uint32_t CullBatchesAVX( const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+        const uint32_t* nodeIdx, uint32_t first, uint32_t end, const ScaleAndTranslation sphereTransforms[],
+        const CullConstants& c, uint32_t* visibleIdx, float* visibleDist )
+    {
+        uint32_t numVisible = 0;
+
+        for (uint32_t i = first; i < end; i += 8)
+        {
+            __m128 tx0 = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 0]]);
+            __m128 ty0 = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 1]]);
+            __m128 tz0 = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 2]]);
+            __m128 s0 = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 3]]);
+            __m128 tx1 = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 4]]);
+            __m128 ty1 = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 5]]);
+            __m128 tz1 = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 6]]);
+            __m128 s1 = _mm_load_ps((const float*)&sphereTransforms[nodeIdx[i + 7]]);
+            _MM_TRANSPOSE4_PS(tx0, ty0, tz0, s0);
+            _MM_TRANSPOSE4_PS(tx1, ty1, tz1, s1);
+            __m256 tx = _mm256_insertf128_ps(_mm256_castps128_ps256(tx0), tx1, 1);
+            __m256 ty = _mm256_insertf128_ps(_mm256_castps128_ps256(ty0), ty1, 1);
+            __m256 tz = _mm256_insertf128_ps(_mm256_castps128_ps256(tz0), tz1, 1);
+            __m256 scale = _mm256_insertf128_ps(_mm256_castps128_ps256(s0), s1, 1);
+
+            __m256 wx = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(centerX + i), scale), tx);
+            __m256 wy = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(centerY + i), scale), ty);
+            __m256 wz = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(centerZ + i), scale), tz);
+            __m256 r = _mm256_mul_ps(_mm256_loadu_ps(radius + i), scale);
+
+            __m256 v[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                __m256 acc = _mm256_mul_ps(wz, _mm256_set1_ps(c.view[2][k]));
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(wy, _mm256_set1_ps(c.view[1][k])));
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(wx, _mm256_set1_ps(c.view[0][k])));
+                v[k] = _mm256_add_ps(acc, _mm256_set1_ps(c.view[3][k]));
+            }
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p)
+            {
+                __m256 d = _mm256_add_ps(_mm256_mul_ps(v[0], _mm256_set1_ps(c.planes[p][0])), _mm256_mul_ps(v[1], _mm256_set1_ps(c.planes[p][1])));
+                d = _mm256_add_ps(d, _mm256_mul_ps(v[2], _mm256_set1_ps(c.planes[p][2])));
+                d = _mm256_add_ps(_mm256_add_ps(d, _mm256_set1_ps(c.planes[p][3])), r);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+
+            unsigned long mask = _mm256_movemask_ps(inside);
+            if (i + 8 > end)
+                mask &= (1u << (end - i)) - 1;
+
+            if (mask == 0)
+                continue;
+
+            __m256 dist = _mm256_sub_ps(_mm256_sub_ps(_mm256_setzero_ps(), v[2]), r);
+            __declspec(align(32)) float distances[8];
+            _mm256_store_ps(distances, dist);
+
+            unsigned long lane;
+            while (_BitScanForward(&lane, mask))
+            {
+                mask &= mask - 1;
+                visibleIdx[numVisible] = i + lane;
+                visibleDist[numVisible] = distances[lane];
+                ++numVisible;
+            }
+        }
+
+        return numVisible;
+    }
+}
+
+void MeshBoundsList::Create( const uint8_t* meshData, uint32_t numMeshes )
+{
+    m_NumMeshes = numMeshes;
+
+    const uint32_t paddedCount = Math::AlignUp(numMeshes, kCullBatchSize);
+
+    // Padding spheres sit at the origin with a hugely negative radius and use node 0, so they
+    // fail every plane.  Their lanes are masked out as well.
+    m_CenterX.assign(paddedCount, 0.0f);
+    m_CenterY.assign(paddedCount, 0.0f);
+    m_CenterZ.assign(paddedCount, 0.0f);
+    m_Radius.assign(paddedCount, -FLT_MAX);
+    m_NodeIdx.assign(paddedCount, 0);
+    m_Meshes.resize(numMeshes);
+
+    for (uint32_t i = 0; i < numMeshes; ++i)
+    {
+        const Mesh& mesh = *(const Mesh*)meshData;
+        m_CenterX[i] = mesh.bounds[0];
+        m_CenterY[i] = mesh.bounds[1];
+        m_CenterZ[i] = mesh.bounds[2];
+        m_Radius[i] = mesh.bounds[3];
+        m_NodeIdx[i] = mesh.meshCBV;
+        m_Meshes[i] = &mesh;
+        meshData += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
+    }
+}
+
+void MeshBoundsList::Destroy( void )
+{
+    m_NumMeshes = 0;
+    m_CenterX.clear();
+    m_CenterY.clear();
+    m_CenterZ.clear();
+    m_Radius.clear();
+    m_NodeIdx.clear();
+    m_Meshes.clear();
+}
+
+uint32_t Renderer::CullMeshBounds( const MeshBoundsList& bounds, uint32_t first, uint32_t count,
+    const ScaleAndTranslation sphereTransforms[], const Matrix4& viewMat, const Frustum& viewFrustum,
+    uint32_t* visibleIdx, float* visibleDist )
+{
+    ASSERT(first % MeshBoundsList::kCullBatchSize == 0, "Batches must start on a multiple of 8");
+    ASSERT(first + count <= bounds.m_NumMeshes);
+
+    if (count == 0)
+        return 0;
+
+    CullConstants constants;
+    GetCullConstants(viewMat, viewFrustum, constants);
+
+    auto Kernel = s_UseAVX ? CullBatchesAVX : CullBatchesSSE;
+    return Kernel(bounds.m_CenterX.data(), bounds.m_CenterY.data(), bounds.m_CenterZ.data(), bounds.m_Radius.data(),
+        bounds.m_NodeIdx.data(), first, first + count, sphereTransforms, constants, visibleIdx, visibleDist);
+}
+
+uint32_t Renderer::CullMeshBoundsScalar( const MeshBoundsList& bounds, uint32_t first, uint32_t count,
+    const ScaleAndTranslation sphereTransforms[], const Matrix4& viewMat, const Frustum& viewFrustum,
+    uint32_t* visibleIdx, float* visibleDist )
+{
+    const AffineTransform& viewXform = (const AffineTransform&)viewMat;
+    uint32_t numVisible = 0;
+
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        const ScaleAndTranslation& sphereXform = sphereTransforms[bounds.m_NodeIdx[i]];
+        BoundingSphere sphereLS(Vector3(bounds.m_CenterX[i], bounds.m_CenterY[i], bounds.m_CenterZ[i]), Scalar(bounds.m_Radius[i]));
+        BoundingSphere sphereWS = sphereXform * sphereLS;
+        BoundingSphere sphereVS = BoundingSphere(viewXform * sphereWS.GetCenter(), sphereWS.GetRadius());
+
+        if (viewFrustum.IntersectSphere(sphereVS))
+        {
+            visibleIdx[numVisible] = i;
+            visibleDist[numVisible] = -sphereVS.GetCenter().GetZ() - sphereVS.GetRadius();
+            ++numVisible;
+        }
+    }
+
+    return numVisible;
+}
+
+void Renderer::BenchmarkFrustumCulling( void )
+{
+    const uint32_t kNumNodes = 1024;
+    const uint32_t kNumRepeats = 20;
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.5f, 20.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+    std::unique_ptr<__m128[]> sphereTransforms(new __m128[kNumNodes]);
+    for (uint32_t i = 0; i < kNumNodes; ++i)
+        sphereTransforms[i] = _mm_setr_ps(position(rng) * 0.1f, position(rng) * 0.1f, position(rng) * 0.1f, scale(rng));
+
+    Camera camera;
+    camera.SetEyeAtUp(Vector3(0.0f, 0.0f, 0.0f), Vector3(0.3f, -0.1f, -1.0f), Vector3(kYUnitVector));
+    camera.SetPerspectiveMatrix(XM_PIDIV4, 9.0f / 16.0f, 1.0f, 1000.0f);
+    camera.Update();
+
+    Utility::Printf("Frustum culling benchmark (%s kernel)\n", s_UseAVX ? "AVX" : "SSE");
+
+    for (uint32_t numMeshes = 1000; numMeshes <= 100000; numMeshes *= 10)
+    {
+        std::vector<uint8_t> meshData(numMeshes * sizeof(Mesh));
+        for (uint32_t i = 0; i < numMeshes; ++i)
+        {
+            Mesh& mesh = *(Mesh*)(meshData.data() + i * sizeof(Mesh));
+            std::memset(&mesh, 0, sizeof(Mesh));
+            mesh.bounds[0] = position(rng);
+            mesh.bounds[1] = position(rng);
+            mesh.bounds[2] = position(rng);
+            mesh.bounds[3] = size(rng);
+            mesh.meshCBV = (uint16_t)(i % kNumNodes);
+            mesh.numDraws = 1;
+        }
+
+        MeshBoundsList bounds;
+        bounds.Create(meshData.data(), numMeshes);
+
+        std::vector<uint32_t> scalarIdx(numMeshes), batchIdx(numMeshes);
+        std::vector<float> scalarDist(numMeshes), batchDist(numMeshes);
+        uint32_t scalarVisible = 0, batchVisible = 0;
+
+        const ScaleAndTranslation* xforms = (const ScaleAndTranslation*)sphereTransforms.get();
+
+        int64_t startTick = SystemTime::GetCurrentTick();
+        for (uint32_t n = 0; n < kNumRepeats; ++n)
+        {
+            scalarVisible = CullMeshBoundsScalar(bounds, 0, numMeshes, xforms, camera.GetViewMatrix(),
+                camera.GetViewSpaceFrustum(), scalarIdx.data(), scalarDist.data());
+        }
+        double scalarSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / kNumRepeats;
+
+        startTick = SystemTime::GetCurrentTick();
+        for (uint32_t n = 0; n < kNumRepeats; ++n)
+        {
+            batchVisible = CullMeshBounds(bounds, 0, numMeshes, xforms, camera.GetViewMatrix(),
+                camera.GetViewSpaceFrustum(), batchIdx.data(), batchDist.data());
+        }
+        double batchSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / kNumRepeats;
+
+        bool identical = scalarVisible == batchVisible &&
+            std::equal(scalarIdx.begin(), scalarIdx.begin() + scalarVisible, batchIdx.begin()) &&
+            std::equal(scalarDist.begin(), scalarDist.begin() + scalarVisible, batchDist.begin());
+
+        Utility::Printf("  %6u meshes:  scalar %8.3f us  batched %8.3f us  (%.2fx)  %u visible  %s\n", numMeshes,
+            scalarSeconds * 1e6, batchSeconds * 1e6, scalarSeconds / batchSeconds, batchVisible,
+            identical ? "identical" : "MISMATCH");
+    }
+}
@@ -0,0 +1,76 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "../Core/Math/Frustum.h"
+#include "../Core/Math/Transform.h"
+
+#include <cstdint>
+#include <vector>
+
+struct Mesh;
+
+namespace Renderer
+{
+    using namespace Math;
+
+    // Local space mesh bounding spheres gathered from the variable-length mesh records into SoA
+    // arrays so that they can be culled eight at a time.  The arrays are padded to a multiple of
+    // kCullBatchSize with spheres that are always rejected.
+    class MeshBoundsList
+    {
+    public:
+        static const uint32_t kCullBatchSize = 8;
+
+        MeshBoundsList() : m_NumMeshes(0) {}
+
+        void Create( const uint8_t* meshData, uint32_t numMeshes );
+        void Destroy( void );
+
+        uint32_t GetNumMeshes( void ) const { return m_NumMeshes; }
+        const Mesh& GetMesh( uint32_t i ) const { return *m_Meshes[i]; }
+
+    private:
+        friend uint32_t CullMeshBounds( const MeshBoundsList&, uint32_t, uint32_t, const ScaleAndTranslation[],
+            const Matrix4&, const Frustum&, uint32_t*, float* );
+        friend uint32_t CullMeshBoundsScalar( const MeshBoundsList&, uint32_t, uint32_t, const ScaleAndTranslation[],
+            const Matrix4&, const Frustum&, uint32_t*, float* );
+
+        uint32_t m_NumMeshes;
+        std::vector<float> m_CenterX;
+        std::vector<float> m_CenterY;
+        std::vector<float> m_CenterZ;
+        std::vector<float> m_Radius;
+        std::vector<uint32_t> m_NodeIdx;
+        std::vector<const Mesh*> m_Meshes;
+    };
+
+    // Transforms meshes [first, first + count) by their node's sphere transform and the view
+    // matrix, then tests them against all six planes of a view space frustum.  For every mesh that
+    // is at least partially inside, writes its index and the view depth of the near side of its
+    // sphere.  The output arrays must hold count entries.  Returns the number of visible meshes.
+    // Uses AVX when the CPU supports it, else SSE.
+    uint32_t CullMeshBounds( const MeshBoundsList& bounds, uint32_t first, uint32_t count,
+        const ScaleAndTranslation sphereTransforms[], const Matrix4& viewMat, const Frustum& viewFrustum,
+        uint32_t* visibleIdx, float* visibleDist );
+
+    // One sphere at a time with Frustum::IntersectSphere.  Kept as the reference for the benchmark.
+    uint32_t CullMeshBoundsScalar( const MeshBoundsList& bounds, uint32_t first, uint32_t count,
+        const ScaleAndTranslation sphereTransforms[], const Matrix4& viewMat, const Frustum& viewFrustum,
+        uint32_t* visibleIdx, float* visibleDist );
+
+    // Times the scalar and batched kernels on 1K, 10K, and 100K random spheres and checks that
+    // they agree.
+    void BenchmarkFrustumCulling( void );
+}
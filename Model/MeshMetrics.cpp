@@ -0,0 +1,263 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "MeshMetrics.h"
+#include "../Core/Utility.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const uint32_t kVertexCacheSize = 16;
+    const uint32_t kFetchCacheLineSize = 64;
+    const uint32_t kFetchCacheLines = 16 * 1024 / kFetchCacheLineSize;
+    const uint32_t kOverdrawGridSize = 256;
+
+    inline uint32_t ReadIndex( const void* indices, bool index32, size_t i )
+    {
+        return index32 ? ((const uint32_t*)indices)[i] : ((const uint16_t*)indices)[i];
+    }
+
+    // Rasterizes triangles (already projected to the grid, with z as depth) at pixel centers and
+    // counts the fragments that pass a less-than depth test.
+    void RasterizeOverdraw( const float* projected, uint32_t triangleCount, std::vector<float>& depth,
+        uint32_t& pixelsCovered, uint32_t& pixelsShaded )
+    {
+        const float kGrid = (float)kOverdrawGridSize;
+        depth.assign(kOverdrawGridSize * kOverdrawGridSize, FLT_MAX);
+
+        for (uint32_t t = 0; t < triangleCount; ++t)
+        {
+            const float* v = projected + t * 9;
+            float area = (v[3] - v[0]) * (v[7] - v[1]) - (v[6] - v[0]) * (v[4] - v[1]);
+            if (area == 0.0f)
+                continue;
+
+            int minX = std::max(0, (int)std::floor(std::min(v[0], std::min(v[3], v[6]))));
+            int minY = std::max(0, (int)std::floor(std::min(v[1], std::min(v[4], v[7]))));
+            int maxX = std::min((int)kGrid - 1, (int)std::ceil(std::max(v[0], std::max(v[3], v[6]))));
+            int maxY = std::min((int)kGrid - 1, (int)std::ceil(std::max(v[1], std::max(v[4], v[7]))));
+
+            const float invArea = 1.0f / area;
+
+            for (int y = minY; y <= maxY; ++y)
+            {
+                for (int x = minX; x <= maxX; ++x)
+                {
+                    float px = x + 0.5f, py = y + 0.5f;
+                    float w0 = ((v[6] - v[3]) * (py - v[4]) - (v[7] - v[4]) * (px - v[3])) * invArea;
+                    float w1 = ((v[0] - v[6]) * (py - v[7]) - (v[1] - v[7]) * (px - v[6])) * invArea;
+                    float w2 = 1.0f - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                        continue;
+
+                    float z = w0 * v[2] + w1 * v[5] + w2 * v[8];
+                    float& d = depth[y * kOverdrawGridSize + x];
+                    if (d == FLT_MAX)
+                        ++pixelsCovered;
+                    if (z < d)
+                    {
+                        d = z;
+                        ++pixelsShaded;
+                    }
+                }
+            }
+        }
+    }
+}
+
+VertexCacheStatistics AnalyzeVertexCache( const void* indices, bool index32, uint32_t indexCount, uint32_t vertexCount )
+{
+    // A vertex is still cached if fewer than kVertexCacheSize misses happened since it was loaded
+    std::vector<uint32_t> loadTime(vertexCount, 0);
+    uint32_t misses = 0;
+
+    for (uint32_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t v = ReadIndex(indices, index32, i);
+        ASSERT(v < vertexCount);
+        if (loadTime[v] == 0 || misses + 1 - loadTime[v] > kVertexCacheSize)
+            loadTime[v] = ++misses;
+    }
+
+    VertexCacheStatistics stats;
+    stats.vertexTransforms = misses;
+    stats.acmr = indexCount > 0 ? misses * 3.0f / indexCount : 0.0f;
+    stats.atvr = vertexCount > 0 ? (float)misses / vertexCount : 0.0f;
+    return stats;
+}
+
+VertexFetchStatistics AnalyzeVertexFetch( const void* indices, bool index32, uint32_t indexCount,
+    uint32_t vertexCount, uint32_t vertexStride )
+{
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t uniqueVertices = 0;
+
+    // Tags of a direct mapped cache; ~0 marks an empty line
+    std::vector<size_t> cacheTags(kFetchCacheLines, ~(size_t)0);
+    uint32_t bytesFetched = 0;
+
+    for (uint32_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t v = ReadIndex(indices, index32, i);
+        ASSERT(v < vertexCount);
+
+        if (!referenced[v])
+        {
+            referenced[v] = true;
+            ++uniqueVertices;
+        }
+
+        size_t firstLine = (size_t)v * vertexStride / kFetchCacheLineSize;
+        size_t lastLine = ((size_t)v * vertexStride + vertexStride - 1) / kFetchCacheLineSize;
+        for (size_t line = firstLine; line <= lastLine; ++line)
+        {
+            size_t& tag = cacheTags[line % kFetchCacheLines];
+            if (tag != line)
+            {
+                tag = line;
+                bytesFetched += kFetchCacheLineSize;
+            }
+        }
+    }
+
+    VertexFetchStatistics stats;
+    stats.bytesFetched = bytesFetched;
+    stats.overfetch = uniqueVertices > 0 ? (float)bytesFetched / ((float)uniqueVertices * vertexStride) : 0.0f;
+    return stats;
+}
+
+OverdrawStatistics AnalyzeOverdraw( const void* indices, bool index32, uint32_t indexCount,
+    const uint8_t* vertexData, uint32_t vertexStride, uint32_t vertexCount )
+{
+    OverdrawStatistics stats = {};
+
+    float minPos[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maxPos[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        float pos[3];
+        std::memcpy(pos, vertexData + (size_t)v * vertexStride, sizeof(pos));
+        for (int c = 0; c < 3; ++c)
+        {
+            minPos[c] = std::min(minPos[c], pos[c]);
+            maxPos[c] = std::max(maxPos[c], pos[c]);
+        }
+    }
+
+    float extent = std::max(maxPos[0] - minPos[0], std::max(maxPos[1] - minPos[1], maxPos[2] - minPos[2]));
+    if (indexCount == 0 || !(extent > 0.0f))
+        return stats;
+
+    // Normalize to the unit cube, then view it along each axis from both sides
+    const uint32_t triangleCount = indexCount / 3;
+    const float scale = (float)kOverdrawGridSize / extent;
+    std::vector<float> projected(triangleCount * 9);
+    std::vector<float> depth;
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const int u = (axis + 1) % 3;
+        const int w = (axis + 2) % 3;
+
+        for (int side = 0; side < 2; ++side)
+        {
+            for (uint32_t i = 0; i < triangleCount * 3; ++i)
+            {
+                float pos[3];
+                std::memcpy(pos, vertexData + (size_t)ReadIndex(indices, index32, i) * vertexStride, sizeof(pos));
+                projected[i * 3 + 0] = (pos[u] - minPos[u]) * scale;
+                projected[i * 3 + 1] = (pos[w] - minPos[w]) * scale;
+                projected[i * 3 + 2] = side == 0 ? pos[axis] - minPos[axis] : maxPos[axis] - pos[axis];
+            }
+
+            RasterizeOverdraw(projected.data(), triangleCount, depth, stats.pixelsCovered, stats.pixelsShaded);
+        }
+    }
+
+    stats.overdraw = stats.pixelsCovered > 0 ? (float)stats.pixelsShaded / stats.pixelsCovered : 0.0f;
+    return stats;
+}
+
+MeshStatistics AnalyzeMesh( const void* indices, bool index32, uint32_t indexCount,
+    const uint8_t* vertexData, uint32_t vertexStride, uint32_t vertexCount )
+{
+    MeshStatistics stats;
+    stats.cache = AnalyzeVertexCache(indices, index32, indexCount, vertexCount);
+    stats.fetch = AnalyzeVertexFetch(indices, index32, indexCount, vertexCount, vertexStride);
+    stats.overdraw = AnalyzeOverdraw(indices, index32, indexCount, vertexData, vertexStride, vertexCount);
+    return stats;
+}
+
+namespace CookReport
+{
+    bool IsEnabled( void )
+    {
+        static const bool s_Enabled = []()
+        {
+            uint32_t cookReport = 0;
+            return CommandLineArgs::GetInteger(L"cook_report", cookReport) && cookReport != 0;
+        }();
+        return s_Enabled;
+    }
+
+    bool Write( const std::wstring& reportFile, const std::vector<Entry>& entries )
+    {
+        std::ofstream outFile(reportFile, std::ios::out | std::ios::trunc);
+        if (!outFile)
+        {
+            Utility::Printf(L"Unable to write cook report %ws\n", reportFile.c_str());
+            return false;
+        }
+
+        outFile << "node,primitive,material,triangles,vertices_before,vertices_after,"
+            "acmr_before,acmr_after,atvr_before,atvr_after,overfetch_before,overfetch_after,"
+            "overdraw_before,overdraw_after\n";
+
+        double triangles = 0.0;
+        double totals[8] = {};
+
+        for (const Entry& e : entries)
+        {
+            const float values[8] = {
+                e.before.cache.acmr, e.after.cache.acmr, e.before.cache.atvr, e.after.cache.atvr,
+                e.before.fetch.overfetch, e.after.fetch.overfetch, e.before.overdraw.overdraw, e.after.overdraw.overdraw };
+
+            outFile << e.nodeIdx << ',' << e.primitiveIdx << ',' << e.materialIdx << ',' << e.triangleCount << ','
+                << e.vertexCountBefore << ',' << e.vertexCountAfter;
+            for (float value : values)
+                outFile << ',' << value;
+            outFile << '\n';
+
+            triangles += e.triangleCount;
+            for (int i = 0; i < 8; ++i)
+                totals[i] += (double)values[i] * e.triangleCount;
+        }
+
+        if (triangles > 0.0)
+        {
+            for (double& total : totals)
+                total /= triangles;
+
+            Utility::Printf(L"Cook report %ws (%zu primitives, triangle weighted):\n", reportFile.c_str(), entries.size());
+            Utility::Printf("  ACMR %.3f -> %.3f   ATVR %.3f -> %.3f   overfetch %.3f -> %.3f   overdraw %.3f -> %.3f\n",
+                totals[0], totals[1], totals[2], totals[3], totals[4], totals[5], totals[6], totals[7]);
+        }
+
+        return (bool)outFile;
+    }
+}
@@ -0,0 +1,88 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Offline estimates of how well a triangle list uses the GPU's vertex caches, plus the cook
+// report that tracks them for every primitive of a model.  The numbers come from simple cache
+// models rather than any particular GPU, so they are for spotting regressions, not absolutes.
+//
+
+// Post-transform cache efficiency, modeled as a 16 entry FIFO
+struct VertexCacheStatistics
+{
+    uint32_t vertexTransforms;  // Cache misses
+    float acmr;                 // Transforms per triangle (0.5 is ideal for a regular grid, 3 is the worst)
+    float atvr;                 // Transforms per vertex (1 is ideal)
+};
+
+// Pre-transform (vertex fetch) efficiency, modeled as a 16KB direct mapped cache of 64 byte lines
+struct VertexFetchStatistics
+{
+    uint32_t bytesFetched;
+    float overfetch;            // Bytes fetched per byte of referenced vertex data (1 is ideal)
+};
+
+// Pixels shaded per pixel covered when rasterizing in submission order with a depth test,
+// averaged over six axis-aligned views
+struct OverdrawStatistics
+{
+    uint32_t pixelsCovered;
+    uint32_t pixelsShaded;
+    float overdraw;             // 1 is ideal
+};
+
+struct MeshStatistics
+{
+    VertexCacheStatistics cache;
+    VertexFetchStatistics fetch;
+    OverdrawStatistics overdraw;
+};
+
+VertexCacheStatistics AnalyzeVertexCache( const void* indices, bool index32, uint32_t indexCount, uint32_t vertexCount );
+
+VertexFetchStatistics AnalyzeVertexFetch( const void* indices, bool index32, uint32_t indexCount,
+    uint32_t vertexCount, uint32_t vertexStride );
+
+// Positions are read as a float3 at the start of each vertex
+OverdrawStatistics AnalyzeOverdraw( const void* indices, bool index32, uint32_t indexCount,
+    const uint8_t* vertexData, uint32_t vertexStride, uint32_t vertexCount );
+
+MeshStatistics AnalyzeMesh( const void* indices, bool index32, uint32_t indexCount,
+    const uint8_t* vertexData, uint32_t vertexStride, uint32_t vertexCount );
+
+namespace CookReport
+{
+    // Enabled with "-cook_report 1".  Collecting statistics noticeably slows down cooking.
+    bool IsEnabled( void );
+
+    struct Entry
+    {
+        uint32_t nodeIdx;       // Scene graph node that instances the mesh
+        uint32_t primitiveIdx;  // Primitive within the glTF mesh
+        uint32_t materialIdx;
+        uint32_t triangleCount;
+        uint32_t vertexCountBefore;
+        uint32_t vertexCountAfter;
+        MeshStatistics before;  // As authored
+        MeshStatistics after;   // As cooked
+    };
+
+    // Writes one CSV row per primitive and prints triangle-weighted totals
+    bool Write( const std::wstring& reportFile, const std::vector<Entry>& entries );
+}
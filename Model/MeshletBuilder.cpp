@@ -0,0 +1,289 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "MeshletBuilder.h"
+#include "../Core/Utility.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const uint8_t kNoLocalIndex = 0xFF;
+
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    inline Float3 operator-( const Float3& a, const Float3& b ) { return Float3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline float Dot( const Float3& a, const Float3& b ) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Float3 Cross( const Float3& a, const Float3& b )
+    {
+        return Float3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    inline uint32_t ReadIndex( const void* indices, bool index32, size_t i )
+    {
+        return index32 ? ((const uint32_t*)indices)[i] : ((const uint16_t*)indices)[i];
+    }
+
+    inline Float3 ReadPosition( const uint8_t* vertexData, uint32_t vertexStride, uint32_t v )
+    {
+        Float3 pos;
+        std::memcpy(&pos, vertexData + (size_t)v * vertexStride, sizeof(Float3));
+        return pos;
+    }
+
+    inline uint32_t PackTriangle( uint32_t a, uint32_t b, uint32_t c ) { return a | b << 8 | c << 16; }
+
+    // Fills in the bounding sphere and normal cone of a finished meshlet.  The cone follows
+    // the construction in "Optimizing the Graphics Pipeline with Compute" (Wihlidal, GDC 2016):
+    // the axis is the average normal, and the apex is pulled back far enough that every
+    // triangle plane lies in front of it.
+    void ComputeMeshletBounds( Meshlet& meshlet, const uint32_t* vertices, const uint32_t* triangles,
+        const uint8_t* vertexData, uint32_t vertexStride, bool allowConeCulling )
+    {
+        Float3 minPos = { FLT_MAX, FLT_MAX, FLT_MAX };
+        Float3 maxPos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            Float3 p = ReadPosition(vertexData, vertexStride, vertices[i]);
+            minPos = Float3{ std::min(minPos.x, p.x), std::min(minPos.y, p.y), std::min(minPos.z, p.z) };
+            maxPos = Float3{ std::max(maxPos.x, p.x), std::max(maxPos.y, p.y), std::max(maxPos.z, p.z) };
+        }
+
+        Float3 center = { (minPos.x + maxPos.x) * 0.5f, (minPos.y + maxPos.y) * 0.5f, (minPos.z + maxPos.z) * 0.5f };
+        float radiusSq = 0.0f;
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            Float3 d = ReadPosition(vertexData, vertexStride, vertices[i]) - center;
+            radiusSq = std::max(radiusSq, Dot(d, d));
+        }
+
+        meshlet.bounds[0] = center.x;
+        meshlet.bounds[1] = center.y;
+        meshlet.bounds[2] = center.z;
+        meshlet.bounds[3] = std::sqrt(radiusSq);
+
+        // Default to a cone that never culls
+        meshlet.coneApex[0] = center.x;
+        meshlet.coneApex[1] = center.y;
+        meshlet.coneApex[2] = center.z;
+        meshlet.coneAxis[0] = 0.0f;
+        meshlet.coneAxis[1] = 0.0f;
+        meshlet.coneAxis[2] = 0.0f;
+        meshlet.coneCutoff = 1.0f;
+
+        if (!allowConeCulling)
+            return;
+
+        // Unit normals and one point on each triangle.  Degenerate triangles face every way at
+        // once, so they neither widen nor narrow the cone.
+        std::array<Float3, kMaxMeshletTriangles> normals;
+        std::array<Float3, kMaxMeshletTriangles> corners;
+        uint32_t numNormals = 0;
+        Float3 axis = { 0.0f, 0.0f, 0.0f };
+
+        for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+        {
+            uint32_t tri = triangles[i];
+            Float3 p0 = ReadPosition(vertexData, vertexStride, vertices[tri & 0xFF]);
+            Float3 p1 = ReadPosition(vertexData, vertexStride, vertices[(tri >> 8) & 0xFF]);
+            Float3 p2 = ReadPosition(vertexData, vertexStride, vertices[(tri >> 16) & 0xFF]);
+            Float3 n = Cross(p1 - p0, p2 - p0);
+            float len = std::sqrt(Dot(n, n));
+            if (len == 0.0f)
+                continue;
+
+            n = Float3{ n.x / len, n.y / len, n.z / len };
+            normals[numNormals] = n;
+            corners[numNormals] = p0;
+            ++numNormals;
+            axis = Float3{ axis.x + n.x, axis.y + n.y, axis.z + n.z };
+        }
+
+        float axisLen = std::sqrt(Dot(axis, axis));
+        if (numNormals == 0 || axisLen == 0.0f)
+            return;
+
+        axis = Float3{ axis.x / axisLen, axis.y / axisLen, axis.z / axisLen };
+
+        float minDot = 1.0f;
+        for (uint32_t i = 0; i < numNormals; ++i)
+            minDot = std::min(minDot, Dot(axis, normals[i]));
+
+        // Past roughly 84 degrees of spread the cone almost never rejects anything
+        if (minDot <= 0.1f)
+            return;
+
+        float maxT = 0.0f;
+        for (uint32_t i = 0; i < numNormals; ++i)
+        {
+            float t = Dot(center - corners[i], normals[i]) / Dot(axis, normals[i]);
+            maxT = std::max(maxT, t);
+        }
+
+        meshlet.coneApex[0] = center.x - axis.x * maxT;
+        meshlet.coneApex[1] = center.y - axis.y * maxT;
+        meshlet.coneApex[2] = center.z - axis.z * maxT;
+        meshlet.coneAxis[0] = axis.x;
+        meshlet.coneAxis[1] = axis.y;
+        meshlet.coneAxis[2] = axis.z;
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+void BuildMeshlets( Renderer::MeshletData& meshlets, const void* indices, bool index32, uint32_t indexCount,
+    const uint8_t* vertexData, uint32_t vertexStride, uint32_t vertexCount, bool allowConeCulling )
+{
+    ASSERT(indexCount % 3 == 0);
+
+    meshlets.m_Meshlets.clear();
+    meshlets.m_Vertices.clear();
+    meshlets.m_Triangles.clear();
+
+    // The meshlet-local index of each vertex, or kNoLocalIndex when it isn't in the current meshlet
+    std::vector<uint8_t> localIndex(vertexCount, kNoLocalIndex);
+
+    Meshlet current = {};
+
+    auto FinishMeshlet = [&]()
+    {
+        if (current.triangleCount == 0)
+            return;
+
+        ComputeMeshletBounds(current, meshlets.m_Vertices.data() + current.vertexOffset,
+            meshlets.m_Triangles.data() + current.triangleOffset, vertexData, vertexStride, allowConeCulling);
+
+        for (uint32_t i = 0; i < current.vertexCount; ++i)
+            localIndex[meshlets.m_Vertices[current.vertexOffset + i]] = kNoLocalIndex;
+
+        meshlets.m_Meshlets.push_back(current);
+
+        current = {};
+        current.vertexOffset = (uint32_t)meshlets.m_Vertices.size();
+        current.triangleOffset = (uint32_t)meshlets.m_Triangles.size();
+    };
+
+    auto LocalIndex = [&]( uint32_t v )
+    {
+        if (localIndex[v] == kNoLocalIndex)
+        {
+            localIndex[v] = current.vertexCount++;
+            meshlets.m_Vertices.push_back(v);
+        }
+        return (uint32_t)localIndex[v];
+    };
+
+    for (uint32_t i = 0; i < indexCount; i += 3)
+    {
+        uint32_t a = ReadIndex(indices, index32, i);
+        uint32_t b = ReadIndex(indices, index32, i + 1);
+        uint32_t c = ReadIndex(indices, index32, i + 2);
+        ASSERT(a < vertexCount && b < vertexCount && c < vertexCount);
+
+        uint32_t newVertices = (localIndex[a] == kNoLocalIndex) +
+            (localIndex[b] == kNoLocalIndex && b != a) +
+            (localIndex[c] == kNoLocalIndex && c != a && c != b);
+
+        if (current.vertexCount + newVertices > kMaxMeshletVertices || current.triangleCount == kMaxMeshletTriangles)
+            FinishMeshlet();
+
+        uint32_t la = LocalIndex(a);
+        uint32_t lb = LocalIndex(b);
+        uint32_t lc = LocalIndex(c);
+        meshlets.m_Triangles.push_back(PackTriangle(la, lb, lc));
+        ++current.triangleCount;
+    }
+
+    FinishMeshlet();
+}
+
+void AppendMeshlets( Renderer::MeshletData& dest, const Renderer::MeshletData& src, uint32_t meshIdx, uint16_t drawIdx )
+{
+    uint32_t vertexBase = (uint32_t)dest.m_Vertices.size();
+    uint32_t triangleBase = (uint32_t)dest.m_Triangles.size();
+
+    for (Meshlet meshlet : src.m_Meshlets)
+    {
+        meshlet.vertexOffset += vertexBase;
+        meshlet.triangleOffset += triangleBase;
+        meshlet.meshIdx = meshIdx;
+        meshlet.drawIdx = drawIdx;
+        dest.m_Meshlets.push_back(meshlet);
+    }
+
+    dest.m_Vertices.insert(dest.m_Vertices.end(), src.m_Vertices.begin(), src.m_Vertices.end());
+    dest.m_Triangles.insert(dest.m_Triangles.end(), src.m_Triangles.begin(), src.m_Triangles.end());
+}
+
+bool VerifyMeshlets( const Meshlet* meshlets, uint32_t numMeshlets, const uint32_t* meshletVertices,
+    const uint32_t* meshletTriangles, const void* indices, bool index32, uint32_t indexCount, uint32_t vertexCount )
+{
+    typedef std::array<uint32_t, 3> Triangle;
+
+    std::vector<Triangle> expected(indexCount / 3);
+    for (uint32_t i = 0; i < indexCount / 3; ++i)
+        expected[i] = Triangle{ ReadIndex(indices, index32, i * 3), ReadIndex(indices, index32, i * 3 + 1), ReadIndex(indices, index32, i * 3 + 2) };
+
+    std::vector<Triangle> found;
+    found.reserve(expected.size());
+
+    for (uint32_t m = 0; m < numMeshlets; ++m)
+    {
+        const Meshlet& meshlet = meshlets[m];
+        if (meshlet.vertexCount > kMaxMeshletVertices || meshlet.triangleCount > kMaxMeshletTriangles ||
+            meshlet.triangleCount == 0)
+        {
+            Utility::Printf("Meshlet %u exceeds size limits (%u vertices, %u triangles)\n", m,
+                (uint32_t)meshlet.vertexCount, (uint32_t)meshlet.triangleCount);
+            return false;
+        }
+
+        const uint32_t* vertices = meshletVertices + meshlet.vertexOffset;
+        for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+        {
+            uint32_t tri = meshletTriangles[meshlet.triangleOffset + i];
+            uint32_t local[3] = { tri & 0xFF, (tri >> 8) & 0xFF, (tri >> 16) & 0xFF };
+            if (local[0] >= meshlet.vertexCount || local[1] >= meshlet.vertexCount || local[2] >= meshlet.vertexCount)
+            {
+                Utility::Printf("Meshlet %u triangle %u references a missing vertex\n", m, i);
+                return false;
+            }
+
+            Triangle t = { vertices[local[0]], vertices[local[1]], vertices[local[2]] };
+            if (t[0] >= vertexCount || t[1] >= vertexCount || t[2] >= vertexCount)
+            {
+                Utility::Printf("Meshlet %u triangle %u is out of the vertex buffer\n", m, i);
+                return false;
+            }
+            found.push_back(t);
+        }
+    }
+
+    // Comparing sorted lists catches missing, repeated, and rewound triangles alike
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    if (found != expected)
+    {
+        Utility::Printf("Meshlets cover %zu triangles, but the index list has %zu (or they differ)\n",
+            found.size(), expected.size());
+        return false;
+    }
+
+    return true;
+}
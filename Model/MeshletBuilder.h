@@ -0,0 +1,50 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "ModelLoader.h"
+
+#include <cstdint>
+
+static const uint32_t kMaxMeshletVertices = 64;
+static const uint32_t kMaxMeshletTriangles = 124;
+
+//-----------------------------------------------------------------------------
+//  BuildMeshlets
+//-----------------------------------------------------------------------------
+//  Splits a triangle list into meshlets by walking it in order, so the
+//  triangles of each meshlet stay contiguous and keep the locality of an
+//  already cache-optimized index list.
+//
+//  Parameters:
+//      meshlets
+//          receives the meshlets (meshIdx and drawIdx are left 0)
+//      indices
+//          the triangle list, 16- or 32-bit
+//      vertexData
+//          vertices with a float3 position at offset 0
+//      allowConeCulling
+//          false for two-sided or skinned geometry, which must never be
+//          rejected by its normal cone
+//-----------------------------------------------------------------------------
+void BuildMeshlets( Renderer::MeshletData& meshlets, const void* indices, bool index32, uint32_t indexCount,
+    const uint8_t* vertexData, uint32_t vertexStride, uint32_t vertexCount, bool allowConeCulling );
+
+// Appends one primitive's meshlets to a model's, rebasing their list offsets
+void AppendMeshlets( Renderer::MeshletData& dest, const Renderer::MeshletData& src, uint32_t meshIdx, uint16_t drawIdx );
+
+// Checks that every triangle of the index list appears in exactly one meshlet, with its original
+// winding, and that no meshlet exceeds the size limits or references a missing vertex.
+bool VerifyMeshlets( const Meshlet* meshlets, uint32_t numMeshlets, const uint32_t* meshletVertices,
+    const uint32_t* meshletTriangles, const void* indices, bool index32, uint32_t indexCount, uint32_t vertexCount );
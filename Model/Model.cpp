@@ -14,10 +14,124 @@
 #include "Model.h"
 #include "Renderer.h"
 #include "ConstantBuffers.h"
+#include "Skinning.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 using namespace Math;
 using namespace Renderer;
 
+namespace
+{
+    // Meshes are culled in chunks so that the survivor lists fit on the stack
+    const uint32_t kChunkSize = 256;
+
+    // Smaller models are submitted on the calling thread.  Waking the workers costs more than
+    // culling and sorting a few thousand meshes.
+    const uint32_t kParallelSubmitMinMeshes = 2048;
+
+    // Threads for parallel mesh submission.  They live for the whole run so that each keeps its
+    // own frame allocator page rather than taking a fresh one every frame.
+    class SubmitWorkers
+    {
+    public:
+        SubmitWorkers() : m_Task(nullptr), m_Generation(0), m_NumTasks(0), m_NextTask(0), m_Pending(0), m_Exit(false)
+        {
+            uint32_t numWorkers = std::min(std::max(std::thread::hardware_concurrency(), 1u) - 1, 7u);
+            for (uint32_t i = 0; i < numWorkers; ++i)
+                m_Threads.push_back(std::thread(&SubmitWorkers::WorkerMain, this));
+        }
+
+        ~SubmitWorkers()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Exit = true;
+            }
+            m_WakeWorkers.notify_all();
+            for (std::thread& thread : m_Threads)
+                thread.join();
+        }
+
+        // The calling thread takes tasks too
+        uint32_t MaxTasks( void ) const { return (uint32_t)m_Threads.size() + 1; }
+
+        // Runs task(0) through task(numTasks - 1) and returns when all of them are done.  Only one
+        // thread may call this at a time.
+        void Run( uint32_t numTasks, const std::function<void(uint32_t)>& task )
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Task = &task;
+                m_NumTasks = numTasks;
+                m_NextTask = 0;
+                m_Pending = numTasks;
+                ++m_Generation;
+            }
+            m_WakeWorkers.notify_all();
+
+            RunTasks();
+
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_TasksDone.wait(lock, [this] { return m_Pending == 0; });
+            m_Task = nullptr;
+        }
+
+    private:
+        void RunTasks( void )
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            while (m_NextTask < m_NumTasks)
+            {
+                const uint32_t taskIdx = m_NextTask++;
+                const std::function<void(uint32_t)>& task = *m_Task;
+                lock.unlock();
+                task(taskIdx);
+                lock.lock();
+                if (--m_Pending == 0)
+                    m_TasksDone.notify_one();
+            }
+        }
+
+        void WorkerMain( void )
+        {
+            uint64_t generation = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_WakeWorkers.wait(lock, [&] { return m_Exit || m_Generation != generation; });
+                    if (m_Exit)
+                        return;
+                    generation = m_Generation;
+                }
+                RunTasks();
+            }
+        }
+
+        std::vector<std::thread> m_Threads;
+        std::mutex m_Mutex;
+        std::condition_variable m_WakeWorkers;
+        std::condition_variable m_TasksDone;
+        const std::function<void(uint32_t)>* m_Task;
+        uint64_t m_Generation;
+        uint32_t m_NumTasks;
+        uint32_t m_NextTask;
+        uint32_t m_Pending;
+        bool m_Exit;
+    };
+
+    SubmitWorkers& GetSubmitWorkers( void )
+    {
+        static SubmitWorkers s_Workers;
+        return s_Workers;
+    }
+}
+
 void Model::Destroy()
 {
     m_BoundingSphere = BoundingSphere(kZero);
@@ -25,8 +139,25 @@ void Model::Destroy()
     m_MaterialConstants.Destroy();
     m_NumNodes = 0;
     m_NumMeshes = 0;
+    m_NumAnimations = 0;
+    m_NumJoints = 0;
     m_MeshData = nullptr;
+    m_GeometryData = nullptr;
     m_SceneGraph = nullptr;
+    m_KeyFrameData = nullptr;
+    m_CurveData = nullptr;
+    m_Animations = nullptr;
+    m_JointIndices = nullptr;
+    m_JointIBMs = nullptr;
+    m_NumMeshlets = 0;
+    m_Meshlets = nullptr;
+    m_MeshletVertices = nullptr;
+    m_MeshletTriangles = nullptr;
+    m_MeshBounds.Destroy();
+    m_Hierarchy.Destroy();
+    m_AnimationSampler.Destroy();
+    m_AnimationBlender.Destroy();
+    m_FileMapping.Close();
 }
 
 void Model::Render(
@@ -35,32 +166,50 @@ void Model::Render(
     const ScaleAndTranslation sphereTransforms[],
     const Joint* skeleton ) const
 {
-    // Pointer to current mesh
-    const uint8_t* pMesh = m_MeshData.get();
-
     const Frustum& frustum = sorter.GetViewFrustum();
-    const AffineTransform& viewMat = (const AffineTransform&)sorter.GetViewMatrix();
+    const Matrix4& viewMat = sorter.GetViewMatrix();
+    const uint32_t numChunks = (m_NumMeshes + kChunkSize - 1) / kChunkSize;
 
-    for (uint32_t i = 0; i < m_NumMeshes; ++i)
+    auto SubmitChunks = [&](uint32_t firstChunk, uint32_t lastChunk, uint32_t bucketIdx)
     {
-        const Mesh& mesh = *(const Mesh*)pMesh;
-
-        const ScaleAndTranslation& sphereXform = sphereTransforms[mesh.meshCBV];
-        BoundingSphere sphereLS((const XMFLOAT4*)mesh.bounds);
-        BoundingSphere sphereWS = sphereXform * sphereLS;
-        BoundingSphere sphereVS = BoundingSphere(viewMat * sphereWS.GetCenter(), sphereWS.GetRadius());
+        uint32_t visibleIdx[kChunkSize];
+        float visibleDist[kChunkSize];
 
-        if (frustum.IntersectSphere(sphereVS))
+        for (uint32_t chunk = firstChunk; chunk < lastChunk; ++chunk)
         {
-            float distance = -sphereVS.GetCenter().GetZ() - sphereVS.GetRadius();
-            sorter.AddMesh(mesh, distance,
-                meshConstants.GetGpuVirtualAddress() + sizeof(MeshConstants) * mesh.meshCBV,
-                m_MaterialConstants.GetGpuVirtualAddress() + sizeof(MaterialConstants) * mesh.materialCBV,
-                m_DataBuffer.GetGpuVirtualAddress(), skeleton);
+            uint32_t first = chunk * kChunkSize;
+            uint32_t count = std::min(kChunkSize, m_NumMeshes - first);
+            uint32_t numVisible = CullMeshBounds(m_MeshBounds, first, count, sphereTransforms, viewMat, frustum,
+                visibleIdx, visibleDist);
+
+            for (uint32_t i = 0; i < numVisible; ++i)
+            {
+                const Mesh& mesh = m_MeshBounds.GetMesh(visibleIdx[i]);
+                sorter.AddMesh(mesh, visibleDist[i],
+                    meshConstants.GetGpuVirtualAddress() + sizeof(MeshConstants) * mesh.meshCBV,
+                    m_MaterialConstants.GetGpuVirtualAddress() + sizeof(MaterialConstants) * mesh.materialCBV,
+                    m_DataBuffer.GetGpuVirtualAddress(), skeleton, bucketIdx);
+            }
         }
+    };
 
-        pMesh += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
+    if (!ParallelSubmission || m_NumMeshes < kParallelSubmitMinMeshes)
+    {
+        SubmitChunks(0, numChunks, 0);
+        return;
     }
+
+    // Each task fills its own bucket with a contiguous run of chunks, so once the buckets are
+    // merged the draws are in the same order as if one thread had added them all.
+    SubmitWorkers& workers = GetSubmitWorkers();
+    const uint32_t numTasks = std::min(workers.MaxTasks(), numChunks);
+
+    sorter.SetNumBuckets(numTasks);
+    workers.Run(numTasks, [&](uint32_t taskIdx)
+    {
+        SubmitChunks(numChunks * taskIdx / numTasks, numChunks * (taskIdx + 1) / numTasks, taskIdx);
+    });
+    sorter.SetNumBuckets(1);
 }
 
 void ModelInstance::Render(MeshSorter& sorter) const
@@ -82,6 +231,8 @@ ModelInstance::ModelInstance( std::shared_ptr<const Model> sourceModel )
         m_MeshConstantsCPU.Destroy();
         m_MeshConstantsGPU.Destroy();
         m_BoundingSphereTransforms = nullptr;
+        m_MeshConstantsStaging = nullptr;
+        m_WorldTransforms.clear();
         m_AnimGraph = nullptr;
         m_AnimState.clear();
         m_Skeleton = nullptr;
@@ -91,12 +242,13 @@ ModelInstance::ModelInstance( std::shared_ptr<const Model> sourceModel )
         m_MeshConstantsCPU.Create(L"Mesh Constant Upload Buffer", sourceModel->m_NumNodes * sizeof(MeshConstants));
         m_MeshConstantsGPU.Create(L"Mesh Constant GPU Buffer", sourceModel->m_NumNodes, sizeof(MeshConstants));
         m_BoundingSphereTransforms.reset(new __m128[sourceModel->m_NumNodes]);
+        m_MeshConstantsStaging.reset(new __m128[sourceModel->m_NumNodes * sizeof(MeshConstants) / sizeof(__m128)]());
         m_Skeleton.reset(new Joint[sourceModel->m_NumJoints]);
 
         if (sourceModel->m_NumAnimations > 0)
         {
             m_AnimGraph.reset(new GraphNode[sourceModel->m_NumNodes]);
-            std::memcpy(m_AnimGraph.get(), sourceModel->m_SceneGraph.get(), sourceModel->m_NumNodes * sizeof(GraphNode));
+            std::memcpy(m_AnimGraph.get(), sourceModel->m_SceneGraph, sourceModel->m_NumNodes * sizeof(GraphNode));
             m_AnimState.resize(sourceModel->m_NumAnimations);
         }
         else
@@ -121,6 +273,8 @@ ModelInstance& ModelInstance::operator=( std::shared_ptr<const Model> sourceMode
         m_MeshConstantsCPU.Destroy();
         m_MeshConstantsGPU.Destroy();
         m_BoundingSphereTransforms = nullptr;
+        m_MeshConstantsStaging = nullptr;
+        m_WorldTransforms.clear();
         m_AnimGraph = nullptr;
         m_AnimState.clear();
         m_Skeleton = nullptr;
@@ -130,12 +284,13 @@ ModelInstance& ModelInstance::operator=( std::shared_ptr<const Model> sourceMode
         m_MeshConstantsCPU.Create(L"Mesh Constant Upload Buffer", sourceModel->m_NumNodes * sizeof(MeshConstants));
         m_MeshConstantsGPU.Create(L"Mesh Constant GPU Buffer", sourceModel->m_NumNodes, sizeof(MeshConstants));
         m_BoundingSphereTransforms.reset(new __m128[sourceModel->m_NumNodes]);
+        m_MeshConstantsStaging.reset(new __m128[sourceModel->m_NumNodes * sizeof(MeshConstants) / sizeof(__m128)]());
         m_Skeleton.reset(new Joint[sourceModel->m_NumJoints]);
 
         if (sourceModel->m_NumAnimations > 0)
         {
             m_AnimGraph.reset(new GraphNode[sourceModel->m_NumNodes]);
-            std::memcpy(m_AnimGraph.get(), sourceModel->m_SceneGraph.get(), sourceModel->m_NumNodes * sizeof(GraphNode));
+            std::memcpy(m_AnimGraph.get(), sourceModel->m_SceneGraph, sourceModel->m_NumNodes * sizeof(GraphNode));
             m_AnimState.resize(sourceModel->m_NumAnimations);
         }
         else
@@ -152,15 +307,6 @@ void ModelInstance::Update(GraphicsContext& gfxContext, float deltaTime)
     if (m_Model == nullptr)
         return;
 
-    static const size_t kMaxStackDepth = 32;
-
-    size_t stackIdx = 0;
-    Matrix4 matrixStack[kMaxStackDepth];
-    Matrix4 ParentMatrix = Matrix4((AffineTransform)m_Locator);
-
-    ScaleAndTranslation* boundingSphereTransforms = (ScaleAndTranslation*)m_BoundingSphereTransforms.get();
-    MeshConstants* cb = (MeshConstants*)m_MeshConstantsCPU.Map();
-
     if (m_AnimGraph)
     {
         UpdateAnimations(deltaTime);
@@ -178,61 +324,16 @@ void ModelInstance::Update(GraphicsContext& gfxContext, float deltaTime)
         }
     }
 
-    const GraphNode* sceneGraph = m_AnimGraph ? m_AnimGraph.get() : m_Model->m_SceneGraph.get();
-
-    // Traverse the scene graph in depth first order.  This is the same as linear order
-    // for how the nodes are stored in memory.  Uses a matrix stack instead of recursion.
-    for (const GraphNode* Node = sceneGraph; ; ++Node)
-    {
-        Matrix4 xform = Node->xform;
-        if (!Node->skeletonRoot)
-            xform = ParentMatrix * xform;
-
-        // Concatenate the transform with the parent's matrix and update the matrix list
-        {
-            // Scoped so that I don't forget that I'm pointing to write-combined memory and
-            // should not read from it.
-            MeshConstants& cbv = cb[Node->matrixIdx];
-            cbv.World = xform;
-            cbv.WorldIT = InverseTranspose(xform.Get3x3());
-
-            Scalar scaleXSqr = LengthSquare((Vector3)xform.GetX());
-            Scalar scaleYSqr = LengthSquare((Vector3)xform.GetY());
-            Scalar scaleZSqr = LengthSquare((Vector3)xform.GetZ());
-            Scalar sphereScale = Sqrt(Max(Max(scaleXSqr, scaleYSqr), scaleZSqr));
-            boundingSphereTransforms[Node->matrixIdx] = ScaleAndTranslation((Vector3)xform.GetW(), sphereScale);
-        }
-
-        // If the next node will be a descendent, replace the parent matrix with our new matrix
-        if (Node->hasChildren)
-        {
-            // ...but if we have siblings, make sure to backup our current parent matrix on the stack
-            if (Node->hasSibling)
-            {
-                ASSERT(stackIdx < kMaxStackDepth, "Overflowed the matrix stack");
-                matrixStack[stackIdx++] = ParentMatrix;
-            }
-            ParentMatrix = xform;
-        }
-        else if (!Node->hasSibling)
-        {
-            // There are no more siblings.  If the stack is empty, we are done.  Otherwise, pop
-            // a matrix off the stack and continue.
-            if (stackIdx == 0)
-                break;
-
-            ParentMatrix = matrixStack[--stackIdx];
-        }
-    }
+    // Compute the node transforms level by level into cacheable memory
+    MeshConstants* cb = (MeshConstants*)m_MeshConstantsStaging.get();
+    m_Model->m_Hierarchy.Update(Matrix4((AffineTransform)m_Locator), m_AnimGraph.get(), m_WorldTransforms,
+        cb, (ScaleAndTranslation*)m_BoundingSphereTransforms.get());
 
     // Update skeletal joints
-    for (uint32_t i = 0; i < m_Model->m_NumJoints; ++i)
-    {
-        Joint& joint = m_Skeleton[i];
-        joint.posXform = cb[m_Model->m_JointIndices[i]].World * m_Model->m_JointIBMs[i];
-        joint.nrmXform = InverseTranspose(joint.posXform.Get3x3());
-    }
+    BuildJointPalette(cb, m_Model->m_JointIndices, m_Model->m_JointIBMs, m_Model->m_NumJoints, m_Skeleton.get());
 
+    // One sequential write to the write-combined upload buffer
+    std::memcpy(m_MeshConstantsCPU.Map(), cb, m_Model->m_NumNodes * sizeof(MeshConstants));
     m_MeshConstantsCPU.Unmap();
 
     gfxContext.TransitionResource(m_MeshConstantsGPU, D3D12_RESOURCE_STATE_COPY_DEST, true);
@@ -279,3 +380,47 @@ Math::OrientedBox ModelInstance::GetBoundingBox() const
 
     return m_Locator * m_Model->m_BoundingBox;
 }
+
+bool ModelInstance::SkinMesh(uint32_t meshIdx, std::vector<XMFLOAT3>& positions, AxisAlignedBox& bounds) const
+{
+    if (m_Model == nullptr || meshIdx >= m_Model->m_NumMeshes)
+        return false;
+
+    const Mesh& mesh = m_Model->m_MeshBounds.GetMesh(meshIdx);
+    if ((mesh.psoFlags & PSOFlags::kHasSkin) == 0)
+        return false;
+
+    // Fold the mesh's world matrix into the joints as DefaultVS applies it after skinning
+    const MeshConstants* cb = (const MeshConstants*)m_MeshConstantsStaging.get();
+    const Matrix4& world = cb[mesh.meshCBV].World;
+    std::vector<Matrix4> palette(mesh.numJoints);
+    for (uint32_t i = 0; i < mesh.numJoints; ++i)
+        palette[i] = world * m_Skeleton[mesh.startJoint + i].posXform;
+
+    // The depth-only vertex holds the position, a UV when alpha tested, and the skin
+    const uint32_t stride = 12 + (mesh.psoFlags & PSOFlags::kAlphaTest ? 4 : 0) + 16;
+    const uint32_t numVertices = mesh.vbDepthSize / stride;
+    positions.resize(numVertices);
+
+    XMFLOAT3 boundsMin, boundsMax;
+    SkinPositions(m_Model->m_GeometryData + mesh.vbDepthOffset, stride, numVertices, palette.data(), positions.data(),
+        boundsMin, boundsMax);
+    bounds = AxisAlignedBox(Vector3(boundsMin), Vector3(boundsMax));
+    return true;
+}
+
+AxisAlignedBox ModelInstance::GetSkinnedBounds() const
+{
+    AxisAlignedBox bounds;
+    if (m_Model == nullptr)
+        return bounds;
+
+    std::vector<XMFLOAT3> positions;
+    for (uint32_t i = 0; i < m_Model->m_NumMeshes; ++i)
+    {
+        AxisAlignedBox meshBounds;
+        if (SkinMesh(i, positions, meshBounds) && !positions.empty())
+            bounds.AddBoundingBox(meshBounds);
+    }
+    return bounds;
+}
@@ -14,14 +14,19 @@
 #pragma once
 
 #include "Animation.h"
+#include "AnimationSampler.h"
+#include "AnimationBlender.h"
 #include "../Core/GpuBuffer.h"
 #include "../Core/VectorMath.h"
 #include "../Core/Camera.h"
 #include "../Core/CommandContext.h"
 #include "../Core/UploadBuffer.h"
 #include "../Core/TextureManager.h"
+#include "../Core/FileUtility.h"
 #include "../Core/Math/BoundingBox.h"
 #include "../Core/Math/BoundingSphere.h"
+#include "MeshCulling.h"
+#include "TransformHierarchy.h"
 #include <cstdint>
 
 namespace Renderer
@@ -79,6 +84,25 @@ struct Mesh
     Draw draw[1];           // Actually 1 or more draws
 };
 
+// A cluster of up to 64 vertices and 124 triangles from one draw, used to cull geometry below
+// mesh granularity.  Vertex indices are relative to the draw's baseVertex, and each triangle is
+// three 8-bit meshlet-local vertex indices packed into a uint32.  The whole meshlet faces away
+// from the camera when dot(normalize(coneApex - cameraPos), coneAxis) >= coneCutoff.
+struct Meshlet // 64 bytes
+{
+    float    bounds[4];      // A bounding sphere in mesh local space
+    float    coneApex[3];
+    float    coneCutoff;     // 1 when the triangles are too divergent (or two-sided) to cull
+    float    coneAxis[3];
+    uint32_t vertexOffset;   // First entry in the meshlet vertex list
+    uint32_t triangleOffset; // First entry in the meshlet triangle list
+    uint32_t meshIdx;        // Index of the mesh record that owns the draw
+    uint16_t drawIdx;        // Index of the draw within that mesh
+    uint8_t  vertexCount;
+    uint8_t  triangleCount;
+    uint32_t reserved;
+};
+
 struct GraphNode // 96 bytes
 {
     Math::Matrix4 xform;
@@ -102,6 +126,10 @@ class Model
 {
 public:
 
+    Model() : m_NumNodes(0), m_NumMeshes(0), m_NumAnimations(0), m_NumJoints(0),
+        m_MeshData(nullptr), m_GeometryData(nullptr), m_SceneGraph(nullptr), m_KeyFrameData(nullptr), m_CurveData(nullptr),
+        m_Animations(nullptr), m_JointIndices(nullptr), m_JointIBMs(nullptr), m_NumMeshlets(0),
+        m_Meshlets(nullptr), m_MeshletVertices(nullptr), m_MeshletTriangles(nullptr) {}
     ~Model() { Destroy(); }
 
     void Render(Renderer::MeshSorter& sorter,
@@ -117,14 +145,37 @@ public:
     uint32_t m_NumMeshes;
     uint32_t m_NumAnimations;
     uint32_t m_NumJoints;
-    std::unique_ptr<uint8_t[]> m_MeshData;
-    std::unique_ptr<GraphNode[]> m_SceneGraph;
     std::vector<TextureRef> textures;
-    std::unique_ptr<uint8_t[]> m_KeyFrameData;
-    std::unique_ptr<AnimationCurve[]> m_CurveData;
-    std::unique_ptr<AnimationSet[]> m_Animations;
-    std::unique_ptr<uint16_t[]> m_JointIndices;
-    std::unique_ptr<Math::Matrix4[]> m_JointIBMs;
+
+    // These point directly into the memory mapped .mini file, which is kept open for the
+    // lifetime of the model.
+    Utility::MappedFile m_FileMapping;
+    uint8_t* m_MeshData;
+    const uint8_t* m_GeometryData;      // Vertex and index buffers, also uploaded to m_DataBuffer
+    const GraphNode* m_SceneGraph;
+    const uint8_t* m_KeyFrameData;
+    const AnimationCurve* m_CurveData;
+    const AnimationSet* m_Animations;
+    const uint16_t* m_JointIndices;
+    const Math::Matrix4* m_JointIBMs;
+
+    // Optional cluster data for culling below mesh granularity (sorted by mesh and draw)
+    uint32_t m_NumMeshlets;
+    const Meshlet* m_Meshlets;
+    const uint32_t* m_MeshletVertices;
+    const uint32_t* m_MeshletTriangles;
+
+    // Mesh bounding spheres in SoA form for batched frustum culling
+    Renderer::MeshBoundsList m_MeshBounds;
+
+    // The scene graph in level order for updating node transforms
+    TransformHierarchy m_Hierarchy;
+
+    // Animation curves grouped for batched sampling
+    AnimationSampler m_AnimationSampler;
+
+    // The channels of each animation and the rest pose for blending
+    AnimationBlender m_AnimationBlender;
 
 protected:
     void Destroy();
@@ -154,11 +205,19 @@ public:
     Math::BoundingSphere GetBoundingSphere() const;
     Math::OrientedBox GetBoundingBox() const;
 
+    // World space positions of a skinned mesh as the last Update posed it, skinned on the CPU
+    // for picking and validation.  Returns false if the mesh has no skin.
+    bool SkinMesh(uint32_t meshIdx, std::vector<Math::XMFLOAT3>& positions, Math::AxisAlignedBox& bounds) const;
+
+    // World space bounds of every skinned mesh as the last Update posed it
+    Math::AxisAlignedBox GetSkinnedBounds() const;
+
     size_t GetNumAnimations(void) const { return m_AnimState.size(); }
     void PlayAnimation(uint32_t animIdx, bool loop);
     void PauseAnimation(uint32_t animIdx);
     void ResetAnimation(uint32_t animIdx);
     void StopAnimation(uint32_t animIdx);
+    void SetAnimationWeight(uint32_t animIdx, float weight, bool additive = false);
     void UpdateAnimations(float deltaTime);
     void LoopAllAnimations(void);
 
@@ -167,9 +226,12 @@ private:
     UploadBuffer m_MeshConstantsCPU;
     ByteAddressBuffer m_MeshConstantsGPU;
     std::unique_ptr<__m128[]> m_BoundingSphereTransforms;
+    std::unique_ptr<__m128[]> m_MeshConstantsStaging;  // Cacheable copy of m_MeshConstantsCPU
+    TransformHierarchy::Workspace m_WorldTransforms;
     Math::UniformTransform m_Locator;
 
     std::unique_ptr<GraphNode[]> m_AnimGraph;   // A copy of the scene graph when instancing animation
     std::vector<AnimationState> m_AnimState;    // Per-animation (not per-curve)
+    AnimationBlender::Workspace m_AnimWorkspace;
     std::unique_ptr<Joint[]> m_Skeleton;
 };
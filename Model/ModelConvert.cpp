@@ -19,14 +19,23 @@
 #include "glTF.h"
 #include "TextureConvert.h"
 #include "MeshConvert.h"
+#include "MeshletBuilder.h"
+#include "AnimationCompression.h"
 #include "TextureManager.h"
 #include "GraphicsCommon.h"
+#include "SystemTime.h"
 #include "../Core/Utility.h"
 #include "../Core/Math/Common.h"
 
 #include <fstream>
 #include <map>
 #include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <cstring>
+#include <cmath>
 
 using namespace DirectX;
 using namespace Math;
@@ -39,12 +48,14 @@ static inline Vector3 SafeNormalize(Vector3 x)
     return lenSq < 1e-10f ? Vector3(kXUnitVector) : x * RecipSqrt(lenSq);
 }
 
-void Renderer::CompileMesh(
+void Renderer::MergeMesh(
     std::vector<Mesh*>& meshList,
     std::vector<byte>& bufferMemory,
-    glTF::Mesh& srcMesh,
+    MeshletData& meshletData,
+    Primitive* primitives,
+    uint32_t numPrimitives,
+    int32_t skinIdx,
     uint32_t matrixIdx,
-    const Matrix4& localToObject,
     BoundingSphere& boundingSphere,
     AxisAlignedBox& boundingBox
     )
@@ -61,10 +72,8 @@ void Renderer::CompileMesh(
     BoundingSphere sphereOS(kZero);
     AxisAlignedBox bboxOS(kZero);
 
-    std::vector<Primitive> primitives(srcMesh.primitives.size());
-    for (uint32_t i = 0; i < primitives.size(); ++i)
+    for (uint32_t i = 0; i < numPrimitives; ++i)
     {
-        OptimizeMesh(primitives[i], srcMesh.primitives[i], localToObject);
         sphereOS = sphereOS.Union(primitives[i].m_BoundsOS);
         bboxOS.AddBoundingBox(primitives[i].m_BBoxOS);
     }
@@ -73,8 +82,9 @@ void Renderer::CompileMesh(
     boundingBox = bboxOS;
 
     std::map<uint32_t, std::vector<Primitive*>> renderMeshes;
-    for (auto& prim : primitives)
+    for (uint32_t i = 0; i < numPrimitives; ++i)
     {
+        Primitive& prim = primitives[i];
         uint32_t hash = prim.hash;
         renderMeshes[hash].push_back(&prim);
         totalVertexSize += prim.VB->size();
@@ -127,10 +137,10 @@ void Renderer::CompileMesh(
         mesh->materialCBV = iter.second[0]->materialIdx;
         mesh->psoFlags = iter.second[0]->psoFlags;
         mesh->pso = 0xFFFF;
-        if (srcMesh.skin >= 0)
+        if (skinIdx >= 0)
         {
             mesh->numJoints = 0xFFFF;
-            mesh->startJoint = (uint16_t)srcMesh.skin;
+            mesh->startJoint = (uint16_t)skinIdx;
         }
         else
         {
@@ -154,6 +164,7 @@ void Renderer::CompileMesh(
             std::memcpy(uploadMem + curDepthVBOffset, draw->DepthVB->data(), draw->DepthVB->size());
             std::memcpy(uploadMem + curIBOffset + curIndexOffset, draw->IB->data(), draw->IB->size());
             curIndexOffset += (uint32_t)draw->IB->size() >> (draw->index32 + 1);
+            AppendMeshlets(meshletData, draw->meshlets, (uint32_t)meshList.size(), (uint16_t)(drawIdx - 1));
         }
 
         curVBOffset += (uint32_t)vbSize;
@@ -167,13 +178,39 @@ void Renderer::CompileMesh(
     bufferMemory.insert(bufferMemory.end(), stagingBuffer->begin(), stagingBuffer->end());
 }
 
+void Renderer::CompileMesh(
+    std::vector<Mesh*>& meshList,
+    std::vector<byte>& bufferMemory,
+    MeshletData& meshletData,
+    glTF::Mesh& srcMesh,
+    uint32_t matrixIdx,
+    const Matrix4& localToObject,
+    BoundingSphere& boundingSphere,
+    AxisAlignedBox& boundingBox
+    )
+{
+    std::vector<Primitive> primitives(srcMesh.primitives.size());
+    for (uint32_t i = 0; i < primitives.size(); ++i)
+        OptimizeMesh(primitives[i], srcMesh.primitives[i], localToObject);
+
+    MergeMesh(meshList, bufferMemory, meshletData, primitives.data(), (uint32_t)primitives.size(), srcMesh.skin,
+        matrixIdx, boundingSphere, boundingBox);
+}
+
+// A mesh instance found while walking the scene graph.  Its primitives are cooked later,
+// possibly out of order on worker threads, and then merged in the order they were found.
+struct MeshJob
+{
+    Matrix4 localToObject;
+    glTF::Mesh* srcMesh;
+    uint32_t matrixIdx;
+    uint32_t firstPrimitive;
+};
 
 static uint32_t WalkGraph(
     std::vector<GraphNode>& sceneGraph,
-    BoundingSphere& modelBSphere,
-    AxisAlignedBox& modelBBox,
-    std::vector<Mesh*>& meshList,
-    std::vector<byte>& bufferMemory,
+    std::vector<MeshJob>& meshJobs,
+    uint32_t& numPrimitives,
     const std::vector<glTF::Node*>& siblings,
     uint32_t curPos,
     const Matrix4& xform
@@ -212,11 +249,13 @@ static uint32_t WalkGraph(
 
         if (!curNode->pointsToCamera && curNode->mesh != nullptr)
         {
-            BoundingSphere sphereOS;
-            AxisAlignedBox boxOS;
-            CompileMesh(meshList, bufferMemory, *curNode->mesh, curPos, LocalXform, sphereOS, boxOS);
-            modelBSphere = modelBSphere.Union(sphereOS);
-            modelBBox.AddBoundingBox(boxOS);
+            MeshJob job;
+            job.localToObject = LocalXform;
+            job.srcMesh = curNode->mesh;
+            job.matrixIdx = curPos;
+            job.firstPrimitive = numPrimitives;
+            meshJobs.push_back(job);
+            numPrimitives += (uint32_t)curNode->mesh->primitives.size();
         }
 
         uint32_t nextPos = curPos + 1;
@@ -224,7 +263,7 @@ static uint32_t WalkGraph(
         if (curNode->children.size() > 0)
         {
             thisGraphNode.hasChildren = 1;
-            nextPos = WalkGraph(sceneGraph, modelBSphere, modelBBox, meshList, bufferMemory, curNode->children, nextPos, LocalXform);
+            nextPos = WalkGraph(sceneGraph, meshJobs, numPrimitives, curNode->children, nextPos, LocalXform);
         }
 
         // Are there more siblings?
@@ -239,6 +278,30 @@ static uint32_t WalkGraph(
     return curPos;
 }
 
+// Runs func(0) .. func(numItems-1) on up to numThreads threads (including the caller).  Items
+// are handed out one at a time because primitive cost varies by orders of magnitude.
+static void ParallelFor(uint32_t numItems, uint32_t numThreads, const std::function<void(uint32_t)>& func)
+{
+    std::atomic<uint32_t> nextItem(0);
+
+    auto WorkerFunc = [&]()
+    {
+        for (uint32_t item = nextItem++; item < numItems; item = nextItem++)
+            func(item);
+    };
+
+    numThreads = std::max(1u, std::min(numThreads, numItems));
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < numThreads; ++i)
+        threads.push_back(std::thread(WorkerFunc));
+
+    WorkerFunc();
+
+    for (std::thread& t : threads)
+        t.join();
+}
+
 inline void CompileTexture(const std::wstring& basePath, const std::string& fileName, uint8_t flags)
 {
     CompileTextureOnDemand(basePath + Utility::UTF8ToWideString(fileName), flags);
@@ -335,7 +398,7 @@ void BuildMaterials(ModelData& model, const glTF::Asset& asset)
     ASSERT(model.m_TextureOptions.size() == model.m_TextureNames.size());
 }
 
-void BuildAnimations(ModelData& model, const glTF::Asset& asset)
+void BuildAnimations(ModelData& model, const glTF::Asset& asset, bool compress = true)
 {
     size_t numAnimations = asset.m_animations.size();
     if (numAnimations == 0)
@@ -346,7 +409,7 @@ void BuildAnimations(ModelData& model, const glTF::Asset& asset)
 
     for (const glTF::Animation& anim : asset.m_animations)
     {
-        AnimationSet& animSet = model.m_Animations[animIdx++];
+        AnimationSet& animSet = model.m_Animations[animIdx];
         animSet.duration = 0.0f;
         animSet.firstCurve = (uint32_t)model.m_AnimationCurves.size();
         animSet.numCurves = (uint32_t)anim.m_channels.size();
@@ -358,44 +421,23 @@ void BuildAnimations(ModelData& model, const glTF::Asset& asset)
 
             ASSERT(channel.m_target->linearIdx >= 0);
 
+            AnimationCompression::CurveReport report;
+            report.animationIdx = animIdx;
+            report.curveIdx = (uint32_t)i;
+            report.targetNode = channel.m_target->linearIdx;
+
             AnimationCurve curve;
             curve.targetNode = channel.m_target->linearIdx;
-            curve.targetPath = channel.m_path;
-            curve.interpolation = sampler.m_interpolation;
-            curve.keyFrameOffset = model.m_AnimationKeyFrameData.size();
-            curve.keyFrameFormat = std::min<uint32_t>(sampler.m_output->componentType, AnimationCurve::kFloat);
-            curve.numSegments = sampler.m_output->count - 1.0f;
-
-            // In glTF, stride==0 means "packed tightly"
-            if (sampler.m_output->stride == 0)
-            {
-                uint32_t numComponents = sampler.m_output->type + 1;
-                uint32_t bytesPerComponent = sampler.m_output->componentType / 2 + 1;
-                curve.keyFrameStride = numComponents * bytesPerComponent / 4;
-            }
-            else
-            {
-                ASSERT(sampler.m_output->stride <= 16 && sampler.m_output->stride % 4 == 0);
-                curve.keyFrameStride = sampler.m_output->stride / 4;
-            }
+            AnimationCompression::CookCurve(curve, model.m_AnimationKeyFrameData, sampler, channel.m_path, compress, report);
 
-            // Determine start and stop time stamps
             const float* timeStamps = (float*)sampler.m_input->dataPtr;
-            curve.startTime = timeStamps[0];
-
-            const float endTime = timeStamps[sampler.m_output->count - 1];
-            curve.rangeScale = curve.numSegments / (endTime - curve.startTime);
-
-            animSet.duration = std::max<float>(animSet.duration, endTime);
-
-            // Append this curve data
-            model.m_AnimationKeyFrameData.insert(
-                model.m_AnimationKeyFrameData.end(),
-                sampler.m_output->dataPtr,
-                sampler.m_output->dataPtr + sampler.m_output->count * curve.keyFrameStride * 4);
+            animSet.duration = std::max<float>(animSet.duration, timeStamps[sampler.m_input->count - 1]);
 
             model.m_AnimationCurves.push_back(curve);
+            model.m_AnimationReport.push_back(report);
         }
+
+        ++animIdx;
     }
 }
 
@@ -441,7 +483,7 @@ void BuildSkins(ModelData& model, const glTF::Asset& asset)
     }
 }
 
-bool Renderer::BuildModel(ModelData& model, const glTF::Asset& asset, int sceneIdx)
+bool Renderer::BuildModel(ModelData& model, const glTF::Asset& asset, int sceneIdx, uint32_t numThreads)
 {
     BuildMaterials(model, asset);
 
@@ -451,13 +493,59 @@ bool Renderer::BuildModel(ModelData& model, const glTF::Asset& asset, int sceneI
     if (scene == nullptr)
         return false;
 
-    // Aggregate all of the vertex and index buffers in this unified buffer
+    // Lay out the scene graph and gather every mesh instance in depth-first order
+    std::vector<MeshJob> meshJobs;
+    uint32_t numPrimitives = 0;
+    uint32_t numNodes = WalkGraph(model.m_SceneGraph, meshJobs, numPrimitives, scene->nodes, 0, Matrix4(kIdentity));
+    model.m_SceneGraph.resize(numNodes);
+
+    // Cook every primitive independently.  This is where nearly all of the time goes (vertex
+    // cache optimization, normal and tangent generation, bounds, vertex compression).
+    std::vector<Primitive> primitives(numPrimitives);
+    std::vector<uint32_t> primToJob(numPrimitives);
+    for (uint32_t i = 0; i < meshJobs.size(); ++i)
+    {
+        uint32_t count = (uint32_t)meshJobs[i].srcMesh->primitives.size();
+        std::fill_n(primToJob.begin() + meshJobs[i].firstPrimitive, count, i);
+    }
+
+    if (numThreads == 0)
+        numThreads = std::thread::hardware_concurrency();
+
+    ParallelFor(numPrimitives, numThreads, [&](uint32_t primIdx)
+    {
+        const MeshJob& job = meshJobs[primToJob[primIdx]];
+        const glTF::Primitive& srcPrim = job.srcMesh->primitives[primIdx - job.firstPrimitive];
+        OptimizeMesh(primitives[primIdx], srcPrim, job.localToObject);
+    });
+
+    // Aggregate all of the vertex and index buffers in this unified buffer.  Merging happens
+    // in scene graph order so the output does not depend on the number of threads.
     std::vector<byte>& bufferMemory = model.m_GeometryData;
 
     model.m_BoundingSphere = BoundingSphere(kZero);
     model.m_BoundingBox = AxisAlignedBox(kZero);
-    uint32_t numNodes = WalkGraph(model.m_SceneGraph, model.m_BoundingSphere, model.m_BoundingBox, model.m_Meshes, bufferMemory, scene->nodes, 0, Matrix4(kIdentity));
-    model.m_SceneGraph.resize(numNodes);
+
+    for (const MeshJob& job : meshJobs)
+    {
+        BoundingSphere sphereOS;
+        AxisAlignedBox boxOS;
+        MergeMesh(model.m_Meshes, bufferMemory, model.m_Meshlets, primitives.data() + job.firstPrimitive,
+            (uint32_t)job.srcMesh->primitives.size(), job.srcMesh->skin, job.matrixIdx, sphereOS, boxOS);
+        model.m_BoundingSphere = model.m_BoundingSphere.Union(sphereOS);
+        model.m_BoundingBox.AddBoundingBox(boxOS);
+
+        for (uint32_t i = 0; i < (uint32_t)job.srcMesh->primitives.size(); ++i)
+        {
+            Primitive& prim = primitives[job.firstPrimitive + i];
+            if (!prim.hasReport)
+                continue;
+
+            prim.report.nodeIdx = job.matrixIdx;
+            prim.report.primitiveIdx = i;
+            model.m_CookReport.push_back(prim.report);
+        }
+    }
 
     BuildAnimations(model, asset);
     BuildSkins(model, asset);
@@ -467,7 +555,13 @@ bool Renderer::BuildModel(ModelData& model, const glTF::Asset& asset, int sceneI
 
 bool Renderer::SaveModel(const std::wstring& filePath, const ModelData& data)
 {
-    std::ofstream outFile(filePath, std::ios::out | std::ios::binary);
+    // Written under a temporary name and then moved into place, so models that still map the
+    // previous file keep working and a failed write never leaves a truncated file behind
+    wchar_t tempSuffix[32];
+    swprintf_s(tempSuffix, L".%u.%u.tmp", GetCurrentProcessId(), GetCurrentThreadId());
+    const std::wstring tempFile = filePath + tempSuffix;
+
+    std::ofstream outFile(tempFile, std::ios::out | std::ios::binary);
     if (!outFile)
         return false;
 
@@ -489,6 +583,9 @@ bool Renderer::SaveModel(const std::wstring& filePath, const ModelData& data)
     header.numAnimationCurves = (uint32_t)data.m_AnimationCurves.size();
     header.numAnimations = (uint32_t)data.m_Animations.size();
     header.numJoints = (uint32_t)data.m_JointIndices.size();
+    header.numMeshlets = (uint32_t)data.m_Meshlets.m_Meshlets.size();
+    header.numMeshletVertices = (uint32_t)data.m_Meshlets.m_Vertices.size();
+    header.numMeshletTriangles = (uint32_t)data.m_Meshlets.m_Triangles.size();
     header.boundingSphere[0] = data.m_BoundingSphere.GetCenter().GetX();
     header.boundingSphere[1] = data.m_BoundingSphere.GetCenter().GetY();
     header.boundingSphere[2] = data.m_BoundingSphere.GetCenter().GetZ();
@@ -500,23 +597,37 @@ bool Renderer::SaveModel(const std::wstring& filePath, const ModelData& data)
     header.maxPos[1] = data.m_BoundingBox.GetMax().GetY();
     header.maxPos[2] = data.m_BoundingBox.GetMax().GetZ();
 
+    // Each section is zero-padded to begin at the offset the loader expects
+    const FileLayout layout = ComputeFileLayout(header);
+
+    auto WriteSection = [&outFile](size_t offset, const void* data, size_t size)
+    {
+        static const char kZeroPadding[kMiniSectionAlignment] = {};
+        size_t curPos = (size_t)outFile.tellp();
+        ASSERT(curPos <= offset && offset - curPos < kMiniSectionAlignment);
+        outFile.write(kZeroPadding, offset - curPos);
+        outFile.write((const char*)data, size);
+    };
+
     outFile.write((char*)&header, sizeof(FileHeader));
-    outFile.write((char*)data.m_GeometryData.data(), header.geometrySize);
-    outFile.write((char*)data.m_SceneGraph.data(), header.numNodes * sizeof(GraphNode));
+    WriteSection(layout.geometry, data.m_GeometryData.data(), header.geometrySize);
+    WriteSection(layout.sceneGraph, data.m_SceneGraph.data(), header.numNodes * sizeof(GraphNode));
+    WriteSection(layout.meshData, nullptr, 0);
     for (const Mesh* mesh : data.m_Meshes)
         outFile.write((char*)mesh, sizeof(Mesh) + (mesh->numDraws - 1) * sizeof(Mesh::Draw));
-    outFile.write((char*)data.m_MaterialConstants.data(), header.numMaterials * sizeof(MaterialConstantData));
-    outFile.write((char*)data.m_MaterialTextures.data(), header.numMaterials * sizeof(MaterialTextureData));
+    WriteSection(layout.materialConstants, data.m_MaterialConstants.data(), header.numMaterials * sizeof(MaterialConstantData));
+    WriteSection(layout.materialTextures, data.m_MaterialTextures.data(), header.numMaterials * sizeof(MaterialTextureData));
+    WriteSection(layout.stringTable, nullptr, 0);
     for (uint32_t i = 0; i < header.numTextures; ++i)
         outFile << data.m_TextureNames[i] << '\0';
-    outFile.write((char*)data.m_TextureOptions.data(), header.numTextures * sizeof(uint8_t));
+    WriteSection(layout.textureOptions, data.m_TextureOptions.data(), header.numTextures * sizeof(uint8_t));
 
     if (header.numAnimations > 0)
     {
         ASSERT(header.keyFrameDataSize > 0 && header.numAnimationCurves > 0);
-        outFile.write((char*)data.m_AnimationKeyFrameData.data(), header.keyFrameDataSize);
-        outFile.write((char*)data.m_AnimationCurves.data(), header.numAnimationCurves * sizeof(AnimationCurve));
-        outFile.write((char*)data.m_Animations.data(), header.numAnimations * sizeof(AnimationSet));
+        WriteSection(layout.keyFrameData, data.m_AnimationKeyFrameData.data(), header.keyFrameDataSize);
+        WriteSection(layout.curveData, data.m_AnimationCurves.data(), header.numAnimationCurves * sizeof(AnimationCurve));
+        WriteSection(layout.animations, data.m_Animations.data(), header.numAnimations * sizeof(AnimationSet));
     }
     else
     {
@@ -526,9 +637,227 @@ bool Renderer::SaveModel(const std::wstring& filePath, const ModelData& data)
     if (header.numJoints)
     {
         ASSERT(header.numJoints == (uint32_t)data.m_JointIBMs.size());
-        outFile.write((char*)data.m_JointIndices.data(), header.numJoints * sizeof(uint16_t));
-        outFile.write((char*)data.m_JointIBMs.data(), header.numJoints * sizeof(Matrix4));
+        WriteSection(layout.jointIndices, data.m_JointIndices.data(), header.numJoints * sizeof(uint16_t));
+        WriteSection(layout.jointIBMs, data.m_JointIBMs.data(), header.numJoints * sizeof(Matrix4));
+    }
+
+    if (header.numMeshlets > 0)
+    {
+        WriteSection(layout.meshlets, data.m_Meshlets.m_Meshlets.data(), header.numMeshlets * sizeof(Meshlet));
+        WriteSection(layout.meshletVertices, data.m_Meshlets.m_Vertices.data(), header.numMeshletVertices * sizeof(uint32_t));
+        WriteSection(layout.meshletTriangles, data.m_Meshlets.m_Triangles.data(), header.numMeshletTriangles * sizeof(uint32_t));
+    }
+
+    // Pad the file out to the full layout size so that it can be validated against the header
+    WriteSection(layout.endOfFile, nullptr, 0);
+
+    outFile.close();
+    if (outFile.fail() || !Utility::ReplaceMappedFile(tempFile, filePath))
+    {
+        DeleteFileW(tempFile.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static bool SameCookedGeometry(const ModelData& a, const ModelData& b)
+{
+    if (a.m_GeometryData != b.m_GeometryData || a.m_Meshes.size() != b.m_Meshes.size() ||
+        a.m_SceneGraph.size() != b.m_SceneGraph.size())
+        return false;
+
+    if (std::memcmp(a.m_SceneGraph.data(), b.m_SceneGraph.data(), a.m_SceneGraph.size() * sizeof(GraphNode)) != 0)
+        return false;
+
+    const MeshletData& meshletsA = a.m_Meshlets;
+    const MeshletData& meshletsB = b.m_Meshlets;
+    if (meshletsA.m_Meshlets.size() != meshletsB.m_Meshlets.size() ||
+        std::memcmp(meshletsA.m_Meshlets.data(), meshletsB.m_Meshlets.data(), meshletsA.m_Meshlets.size() * sizeof(Meshlet)) != 0 ||
+        meshletsA.m_Vertices != meshletsB.m_Vertices || meshletsA.m_Triangles != meshletsB.m_Triangles)
+        return false;
+
+    for (size_t i = 0; i < a.m_Meshes.size(); ++i)
+    {
+        const Mesh* meshA = a.m_Meshes[i];
+        const Mesh* meshB = b.m_Meshes[i];
+        if (meshA->numDraws != meshB->numDraws ||
+            std::memcmp(meshA, meshB, sizeof(Mesh) + (meshA->numDraws - 1) * sizeof(Mesh::Draw)) != 0)
+            return false;
     }
 
     return true;
 }
+
+static void FreeMeshes(ModelData& model)
+{
+    for (Mesh* mesh : model.m_Meshes)
+        free(mesh);
+    model.m_Meshes.clear();
+}
+
+void Renderer::BenchmarkBuildModel(const std::wstring& filePath)
+{
+    glTF::Asset asset(filePath);
+
+    // The serial build is the reference.  It also compiles any textures that are out of date
+    // so that later runs only measure geometry.
+    ModelData reference;
+    if (!BuildModel(reference, asset, -1, 1))
+        return;
+
+    uint32_t numPrimitives = 0;
+    for (const Mesh* mesh : reference.m_Meshes)
+        numPrimitives += mesh->numDraws;
+
+    Utility::Printf(L"Cook benchmark for %ws (%u primitives)\n", Utility::RemoveBasePath(filePath).c_str(), numPrimitives);
+
+    const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (uint32_t numThreads = 1; ; numThreads = std::min(numThreads * 2, maxThreads))
+    {
+        ModelData model;
+        int64_t startTick = SystemTime::GetCurrentTick();
+        bool succeeded = BuildModel(model, asset, -1, numThreads);
+        double seconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        bool identical = succeeded && SameCookedGeometry(reference, model);
+        Utility::Printf("  %2u threads:  %8.3f s  %10.1f primitives/s  %s\n", numThreads, seconds,
+            numPrimitives / seconds, identical ? "identical" : "MISMATCH");
+
+        FreeMeshes(model);
+
+        if (numThreads == maxThreads)
+            break;
+    }
+
+    FreeMeshes(reference);
+}
+
+namespace
+{
+    // Bytes of key frame data that sampling a curve reads
+    size_t GetBytesPerSample(const AnimationCurve& curve)
+    {
+        size_t bytes = curve.keyFrameStride * 8;
+        if (curve.targetPath != AnimationCurve::kRotation && curve.keyFrameFormat == AnimationCurve::kUNorm16)
+            bytes += sizeof(AnimationKeyRange);
+        return bytes;
+    }
+
+    // Samples every translation, rotation, and scale curve of every animation at numFrames times
+    void SampleAllCurves(const ModelData& model, GraphNode* nodes, uint32_t frame, uint32_t numFrames)
+    {
+        for (const AnimationSet& animSet : model.m_Animations)
+        {
+            const float time = animSet.duration * frame / numFrames;
+            for (uint32_t i = 0; i < animSet.numCurves; ++i)
+            {
+                const AnimationCurve& curve = model.m_AnimationCurves[animSet.firstCurve + i];
+                if (curve.targetPath != AnimationCurve::kWeights)
+                    SampleAnimationCurve(curve, model.m_AnimationKeyFrameData.data(), time, nodes[curve.targetNode]);
+            }
+        }
+    }
+}
+
+void Renderer::BenchmarkAnimationCompression(const std::wstring& filePath)
+{
+    glTF::Asset asset(filePath);
+    if (asset.m_animations.empty())
+    {
+        Utility::Printf(L"Animation benchmark:  %ws has no animations\n", Utility::RemoveBasePath(filePath).c_str());
+        return;
+    }
+
+    ModelData models[2];
+    BuildAnimations(models[0], asset, false);
+    BuildAnimations(models[1], asset, true);
+
+    uint32_t numNodes = 0, numCurves = 0;
+    size_t bytesPerUpdate[2] = {};
+    for (uint32_t m = 0; m < 2; ++m)
+    {
+        numCurves = 0;
+        for (const AnimationCurve& curve : models[m].m_AnimationCurves)
+        {
+            if (curve.targetPath == AnimationCurve::kWeights)
+                continue;
+            numNodes = std::max<uint32_t>(numNodes, curve.targetNode + 1);
+            bytesPerUpdate[m] += GetBytesPerSample(curve);
+            ++numCurves;
+        }
+    }
+
+    Utility::Printf(L"Animation benchmark for %ws (%zu animations, %u curves)\n", Utility::RemoveBasePath(filePath).c_str(),
+        asset.m_animations.size(), numCurves);
+
+    const uint32_t kNumFrames = 997;
+    const uint32_t kNumPasses = 20;
+
+    std::unique_ptr<GraphNode[]> nodes[2];
+    double seconds[2];
+    for (uint32_t m = 0; m < 2; ++m)
+    {
+        nodes[m].reset(new GraphNode[numNodes]);
+        std::memset(nodes[m].get(), 0, numNodes * sizeof(GraphNode));
+
+        int64_t startTick = SystemTime::GetCurrentTick();
+        for (uint32_t pass = 0; pass < kNumPasses; ++pass)
+        {
+            for (uint32_t frame = 0; frame <= kNumFrames; ++frame)
+                SampleAllCurves(models[m], nodes[m].get(), frame, kNumFrames);
+        }
+        seconds[m] = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / (kNumPasses * (kNumFrames + 1));
+    }
+
+    // Compare both at every frame.  Rotations are compared by angle.
+    float maxRotationError = 0.0f, maxLinearError = 0.0f;
+    for (uint32_t frame = 0; frame <= kNumFrames; ++frame)
+    {
+        SampleAllCurves(models[0], nodes[0].get(), frame, kNumFrames);
+        SampleAllCurves(models[1], nodes[1].get(), frame, kNumFrames);
+
+        for (uint32_t n = 0; n < numNodes; ++n)
+        {
+            const GraphNode& a = nodes[0][n];
+            const GraphNode& b = nodes[1][n];
+            const float* ta = (const float*)&a.xform + 12;
+            const float* tb = (const float*)&b.xform + 12;
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                maxLinearError = std::max(maxLinearError, std::fabs(ta[i] - tb[i]));
+                maxLinearError = std::max(maxLinearError, std::fabs((&a.scale.x)[i] - (&b.scale.x)[i]));
+            }
+
+            // The chord between the quaternions is more accurate than the arc cosine of their dot product
+            XMFLOAT4 qa, qb;
+            XMStoreFloat4(&qa, a.rotation);
+            XMStoreFloat4(&qb, b.rotation);
+            double difference = 0.0, sum = 0.0;
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                const double da = (&qa.x)[i], db = (&qb.x)[i];
+                difference += (da - db) * (da - db);
+                sum += (da + db) * (da + db);
+            }
+            const double chord = std::sqrt(std::min(difference, sum));
+            maxRotationError = std::max(maxRotationError, (float)(4.0 * std::asin(std::min(chord * 0.5, 1.0))));
+        }
+    }
+
+    uint32_t overTolerance = 0;
+    for (const AnimationCompression::CurveReport& report : models[1].m_AnimationReport)
+        overTolerance += report.maxError > report.tolerance;
+
+    const char* kNames[2] = { "float keys", "compressed" };
+    for (uint32_t m = 0; m < 2; ++m)
+    {
+        Utility::Printf("  %s:  %8zu key bytes   %7zu bytes read per update   %8.2f us per update\n", kNames[m],
+            models[m].m_AnimationKeyFrameData.size(), bytesPerUpdate[m], seconds[m] * 1e6);
+    }
+    Utility::Printf("  key data %.2fx smaller, %.2fx fewer bytes read, largest difference %.2e rad, %.2e units   %s\n",
+        (double)models[0].m_AnimationKeyFrameData.size() / std::max<size_t>(models[1].m_AnimationKeyFrameData.size(), 1),
+        (double)bytesPerUpdate[0] / std::max<size_t>(bytesPerUpdate[1], 1), maxRotationError, maxLinearError,
+        overTolerance == 0 ? "passed" : "FAILED");
+}
@@ -21,15 +21,19 @@
 #include "ModelH3D.h"
 #include "TextureManager.h"
 #include "TextureConvert.h"
+#include "AssetCache.h"
+#include "MeshletBuilder.h"
 #include "GraphicsCommon.h"
 
+#include "../Core/Math/Common.h"
+#include "../Core/ConcurrentHashMap.h"
+
 #include <fstream>
-#include <unordered_map>
 
 using namespace Renderer;
 using namespace Graphics;
 
-std::unordered_map<uint32_t, uint32_t> g_SamplerPermutations;
+ConcurrentHashMap<uint32_t> g_SamplerPermutations;
 
 D3D12_CPU_DESCRIPTOR_HANDLE GetSampler(uint32_t addressModes)
 {
@@ -40,9 +44,10 @@ D3D12_CPU_DESCRIPTOR_HANDLE GetSampler(uint32_t addressModes)
 }
 
 void LoadMaterials(Model& model,
-    const std::vector<MaterialTextureData>& materialTextures,
+    const MaterialTextureData* materialTextures,
+    uint32_t numMaterials,
     const std::vector<std::wstring>& textureNames,
-    const std::vector<uint8_t>& textureOptions,
+    const uint8_t* textureOptions,
     const std::wstring& basePath)
 {
     static_assert((_alignof(MaterialConstants) & 255) == 0, "CBVs need 256 byte alignment");
@@ -53,14 +58,11 @@ void LoadMaterials(Model& model,
     for (size_t ti = 0; ti < numTextures; ++ti)
     {
         std::wstring originalFile = basePath + textureNames[ti];
-        CompileTextureOnDemand(originalFile, textureOptions[ti]);
-
-        std::wstring ddsFile = Utility::RemoveExtension(originalFile) + L".dds";
+        std::wstring ddsFile = CompileTextureOnDemand(originalFile, textureOptions[ti]);
         model.textures[ti] = TextureManager::LoadDDSFromFile(ddsFile);
     }
 
     // Generate descriptor tables and record offsets for each material
-    const uint32_t numMaterials = (uint32_t)materialTextures.size();
     std::vector<uint32_t> tableOffsets(numMaterials);
 
     for (uint32_t matIdx = 0; matIdx < numMaterials; ++matIdx)
@@ -96,16 +98,11 @@ void LoadMaterials(Model& model,
 
         // See if this combination of samplers has been used before.  If not, allocate more from the heap
         // and copy in the descriptors.
-        uint32_t addressModes = srcMat.addressModes;
-        auto samplerMapLookup = g_SamplerPermutations.find(addressModes);
-
-        if (samplerMapLookup == g_SamplerPermutations.end())
+        uint32_t SamplerDescriptorTable = g_SamplerPermutations.GetOrCreate(srcMat.addressModes, [&]( void )
         {
             DescriptorHandle SamplerHandles = Renderer::s_SamplerHeap.Alloc(kNumTextures);
-            uint32_t SamplerDescriptorTable = Renderer::s_SamplerHeap.GetOffsetOfHandle(SamplerHandles);
-            g_SamplerPermutations[addressModes] = SamplerDescriptorTable;
-            tableOffsets[matIdx] = SRVDescriptorTable | SamplerDescriptorTable << 16;
 
+            uint32_t addressModes = srcMat.addressModes;
             D3D12_CPU_DESCRIPTOR_HANDLE SourceSamplers[kNumTextures];
             for (uint32_t j = 0; j < kNumTextures; ++j)
             {
@@ -114,15 +111,14 @@ void LoadMaterials(Model& model,
             }
             g_Device->CopyDescriptors(1, &SamplerHandles, &DestCount,
                 DestCount, SourceSamplers, SourceCounts, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
-        }
-        else
-        {
-            tableOffsets[matIdx] = SRVDescriptorTable | samplerMapLookup->second << 16;
-        }
+
+            return Renderer::s_SamplerHeap.GetOffsetOfHandle(SamplerHandles);
+        });
+        tableOffsets[matIdx] = SRVDescriptorTable | SamplerDescriptorTable << 16;
     }
 
     // Update table offsets for each mesh
-    uint8_t* meshPtr = model.m_MeshData.get();
+    uint8_t* meshPtr = model.m_MeshData;
     for (uint32_t i = 0; i < model.m_NumMeshes; ++i)
     {
         Mesh& mesh = *(Mesh*)meshPtr;
@@ -134,6 +130,365 @@ void LoadMaterials(Model& model,
     }
 }
 
+FileLayout Renderer::ComputeFileLayout(const FileHeader& header)
+{
+    size_t offset = sizeof(FileHeader);
+
+    auto NextSection = [&offset](size_t sectionSize)
+    {
+        size_t sectionStart = Math::AlignUp(offset, kMiniSectionAlignment);
+        offset = sectionStart + sectionSize;
+        return sectionStart;
+    };
+
+    FileLayout layout;
+    layout.geometry = NextSection(header.geometrySize);
+    layout.sceneGraph = NextSection(header.numNodes * sizeof(GraphNode));
+    layout.meshData = NextSection(header.meshDataSize);
+    layout.materialConstants = NextSection(header.numMaterials * sizeof(MaterialConstantData));
+    layout.materialTextures = NextSection(header.numMaterials * sizeof(MaterialTextureData));
+    layout.stringTable = NextSection(header.stringTableSize);
+    layout.textureOptions = NextSection(header.numTextures * sizeof(uint8_t));
+    layout.keyFrameData = NextSection(header.keyFrameDataSize);
+    layout.curveData = NextSection(header.numAnimationCurves * sizeof(AnimationCurve));
+    layout.animations = NextSection(header.numAnimations * sizeof(AnimationSet));
+    layout.jointIndices = NextSection(header.numJoints * sizeof(uint16_t));
+    layout.jointIBMs = NextSection(header.numJoints * sizeof(Matrix4));
+    layout.meshlets = NextSection(header.numMeshlets * sizeof(Meshlet));
+    layout.meshletVertices = NextSection(header.numMeshletVertices * sizeof(uint32_t));
+    layout.meshletTriangles = NextSection(header.numMeshletTriangles * sizeof(uint32_t));
+    layout.endOfFile = offset;
+    return layout;
+}
+
+bool Renderer::ParseModelFile(byte* fileData, size_t fileSize, FileSections& sections)
+{
+    if (fileSize < sizeof(FileHeader))
+    {
+        Utility::Printf("Model file truncated:  missing header\n");
+        return false;
+    }
+
+    FileHeader& header = sections.header;
+    std::memcpy(&header, fileData, sizeof(FileHeader));
+
+    if (strncmp(header.id, "MINI", 4) != 0 || header.version != CURRENT_MINI_FILE_VERSION)
+    {
+        Utility::Printf("Model file version deprecated\n");
+        return false;
+    }
+
+    const FileLayout layout = ComputeFileLayout(header);
+    if (layout.endOfFile > fileSize)
+    {
+        Utility::Printf("Model file truncated:  expected %zu bytes, found %zu\n", layout.endOfFile, fileSize);
+        return false;
+    }
+
+    if ((header.numAnimations > 0) != (header.numAnimationCurves > 0 && header.keyFrameDataSize > 0))
+    {
+        Utility::Printf("Model file corrupt:  inconsistent animation sizes\n");
+        return false;
+    }
+
+    sections.geometry = fileData + layout.geometry;
+    sections.sceneGraph = (GraphNode*)(fileData + layout.sceneGraph);
+    sections.meshData = fileData + layout.meshData;
+    sections.materialConstants = (const MaterialConstantData*)(fileData + layout.materialConstants);
+    sections.materialTextures = (const MaterialTextureData*)(fileData + layout.materialTextures);
+    sections.stringTable = (const char*)(fileData + layout.stringTable);
+    sections.textureOptions = fileData + layout.textureOptions;
+    sections.keyFrameData = fileData + layout.keyFrameData;
+    sections.curveData = (const AnimationCurve*)(fileData + layout.curveData);
+    sections.animations = (const AnimationSet*)(fileData + layout.animations);
+    sections.jointIndices = (const uint16_t*)(fileData + layout.jointIndices);
+    sections.jointIBMs = (const Matrix4*)(fileData + layout.jointIBMs);
+    sections.meshlets = (const Meshlet*)(fileData + layout.meshlets);
+    sections.meshletVertices = (const uint32_t*)(fileData + layout.meshletVertices);
+    sections.meshletTriangles = (const uint32_t*)(fileData + layout.meshletTriangles);
+
+    // Walk the variable-length mesh records and make sure they reference valid data
+    std::vector<const Mesh*> meshes(header.numMeshes);
+    size_t meshOffset = 0;
+    for (uint32_t i = 0; i < header.numMeshes; ++i)
+    {
+        if (meshOffset + sizeof(Mesh) > header.meshDataSize)
+        {
+            Utility::Printf("Model file corrupt:  mesh %u overruns mesh data\n", i);
+            return false;
+        }
+
+        const Mesh& mesh = *(const Mesh*)(sections.meshData + meshOffset);
+        meshes[i] = &mesh;
+        meshOffset += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
+
+        if (mesh.numDraws == 0 || meshOffset > header.meshDataSize ||
+            mesh.meshCBV >= header.numNodes || mesh.materialCBV >= header.numMaterials ||
+            (size_t)mesh.vbOffset + mesh.vbSize > header.geometrySize ||
+            (size_t)mesh.vbDepthOffset + mesh.vbDepthSize > header.geometrySize ||
+            (size_t)mesh.ibOffset + mesh.ibSize > header.geometrySize)
+        {
+            Utility::Printf("Model file corrupt:  mesh %u has invalid ranges\n", i);
+            return false;
+        }
+    }
+
+    if (meshOffset != header.meshDataSize)
+    {
+        Utility::Printf("Model file corrupt:  mesh data size mismatch\n");
+        return false;
+    }
+
+    // The string table must contain exactly one null-terminated name per texture
+    uint32_t numStrings = 0;
+    for (uint32_t i = 0; i < header.stringTableSize; ++i)
+        numStrings += sections.stringTable[i] == '\0' ? 1 : 0;
+
+    if (numStrings != header.numTextures ||
+        header.stringTableSize > 0 && sections.stringTable[header.stringTableSize - 1] != '\0')
+    {
+        Utility::Printf("Model file corrupt:  bad texture string table\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.numMaterials; ++i)
+    {
+        for (uint32_t j = 0; j < kNumTextures; ++j)
+        {
+            uint16_t stringIdx = sections.materialTextures[i].stringIdx[j];
+            if (stringIdx != 0xFFFF && stringIdx >= header.numTextures)
+            {
+                Utility::Printf("Model file corrupt:  material %u references missing texture\n", i);
+                return false;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < header.numAnimations; ++i)
+    {
+        const AnimationSet& animSet = sections.animations[i];
+        if ((size_t)animSet.firstCurve + animSet.numCurves > header.numAnimationCurves)
+        {
+            Utility::Printf("Model file corrupt:  animation %u references missing curves\n", i);
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header.numAnimationCurves; ++i)
+    {
+        const AnimationCurve& curve = sections.curveData[i];
+        bool isCooked = curve.targetPath != AnimationCurve::kWeights;
+        bool hasRange = isCooked && curve.targetPath != AnimationCurve::kRotation && curve.keyFrameFormat == AnimationCurve::kUNorm16;
+
+        // Range check the segment count before converting it.  NaN fails both comparisons.  Cooked
+        // curves have at least one segment, but an authored weight curve may be a single key.
+        const float minSegments = isCooked ? 1.0f : 0.0f;
+        if (!(curve.numSegments >= minSegments && curve.numSegments <= (float)header.keyFrameDataSize))
+        {
+            Utility::Printf("Model file corrupt:  animation curve %u has a bad segment count\n", i);
+            return false;
+        }
+
+        // The segment count is now at most 2^32 and the stride at most 7 words, so this can't overflow
+        uint64_t curveEnd = curve.keyFrameOffset + ((uint64_t)curve.numSegments + 1) * curve.keyFrameStride * 4;
+        if (curve.targetNode >= header.numNodes || curveEnd > header.keyFrameDataSize ||
+            (hasRange && curve.keyFrameOffset < sizeof(AnimationKeyRange)))
+        {
+            Utility::Printf("Model file corrupt:  animation curve %u out of range\n", i);
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header.numJoints; ++i)
+    {
+        if (sections.jointIndices[i] >= header.numNodes)
+        {
+            Utility::Printf("Model file corrupt:  joint %u references missing node\n", i);
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header.numMeshlets; ++i)
+    {
+        const Meshlet& meshlet = sections.meshlets[i];
+        if (meshlet.meshIdx >= header.numMeshes || meshlet.drawIdx >= meshes[meshlet.meshIdx]->numDraws ||
+            (size_t)meshlet.vertexOffset + meshlet.vertexCount > header.numMeshletVertices ||
+            (size_t)meshlet.triangleOffset + meshlet.triangleCount > header.numMeshletTriangles)
+        {
+            Utility::Printf("Model file corrupt:  meshlet %u out of range\n", i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// A rebuild replaces the .mini file while models loaded from it may still map it.  Try that on a
+// scratch copy:  map it as a live model would, replace it with an edited copy the way SaveModel
+// does, then check that the old view is untouched and that reopening the file sees the new one.
+static bool VerifyReplaceWhileMapped(const std::wstring& miniFileName, const Utility::MappedFile& original)
+{
+    const std::wstring scratchFile = miniFileName + L".verify";
+    const std::wstring replacementFile = miniFileName + L".verify.tmp";
+
+    bool passed = false;
+    if (CopyFileW(miniFileName.c_str(), scratchFile.c_str(), FALSE))
+    {
+        Utility::MappedFile loaded;
+        FileSections loadedSections;
+        if (loaded.Open(scratchFile) && ParseModelFile(loaded.GetData(), loaded.GetSize(), loadedSections))
+        {
+            // The replacement differs only in its bounding sphere radius
+            FileHeader header = loadedSections.header;
+            header.boundingSphere[3] += 1.0f;
+            {
+                std::ofstream outFile(replacementFile, std::ios::out | std::ios::binary);
+                outFile.write((const char*)&header, sizeof(FileHeader));
+                outFile.write((const char*)original.GetData() + sizeof(FileHeader), original.GetSize() - sizeof(FileHeader));
+            }
+
+            if (!Utility::ReplaceMappedFile(replacementFile, scratchFile))
+            {
+                Utility::Printf("Could not replace %ws while it was mapped\n", scratchFile.c_str());
+            }
+            else
+            {
+                Utility::MappedFile reloaded;
+                FileSections reloadedSections;
+                passed = loaded.GetSize() == original.GetSize() &&
+                    std::memcmp(loaded.GetData(), original.GetData(), original.GetSize()) == 0 &&
+                    reloaded.Open(scratchFile) &&
+                    ParseModelFile(reloaded.GetData(), reloaded.GetSize(), reloadedSections) &&
+                    reloadedSections.header.boundingSphere[3] == header.boundingSphere[3];
+
+                if (!passed)
+                    Utility::Printf("Replacing %ws while it was mapped changed the old view or lost the new file\n", scratchFile.c_str());
+            }
+        }
+    }
+
+    DeleteFileW(scratchFile.c_str());
+    DeleteFileW(replacementFile.c_str());
+    return passed;
+}
+
+bool Renderer::VerifyModelFile(const std::wstring& miniFileName)
+{
+    Utility::MappedFile mapping;
+    FileSections sections;
+    if (!mapping.Open(miniFileName) || !ParseModelFile(mapping.GetData(), mapping.GetSize(), sections))
+        return false;
+
+    // The reference is a sequential read like LoadModel's before files were mapped:  the header,
+    // then every section in file order with its size from the header.  It does not use
+    // ComputeFileLayout.  It only knows that each section is zero-padded to start on a
+    // kMiniSectionAlignment boundary.
+    std::ifstream inFile(miniFileName, std::ios::in | std::ios::binary);
+    if (!inFile)
+        return false;
+
+    FileHeader header;
+    inFile.read((char*)&header, sizeof(FileHeader));
+    if (!inFile || std::memcmp(&header, &sections.header, sizeof(FileHeader)) != 0)
+    {
+        Utility::Printf("Mismatched header in %ws\n", miniFileName.c_str());
+        return false;
+    }
+
+    bool identical = true;
+    std::vector<byte> streamedData;
+
+    auto CompareSection = [&](const char* sectionName, const void* mappedData, size_t size)
+    {
+        const size_t position = inFile ? (size_t)inFile.tellg() : 0;
+        const size_t paddingSize = Math::AlignUp(position, kMiniSectionAlignment) - position;
+        streamedData.resize(paddingSize + size);
+        inFile.read((char*)streamedData.data(), streamedData.size());
+
+        bool matches = !inFile.fail();
+        for (size_t i = 0; i < paddingSize && matches; ++i)
+            matches = streamedData[i] == 0;
+        if (matches && size > 0)
+            matches = std::memcmp(streamedData.data() + paddingSize, mappedData, size) == 0;
+
+        if (!matches)
+        {
+            Utility::Printf("Mismatched %s section in %ws\n", sectionName, miniFileName.c_str());
+            identical = false;
+        }
+    };
+
+    CompareSection("geometry", sections.geometry, header.geometrySize);
+    CompareSection("scene graph", sections.sceneGraph, header.numNodes * sizeof(GraphNode));
+    CompareSection("mesh", sections.meshData, header.meshDataSize);
+    CompareSection("material constant", sections.materialConstants, header.numMaterials * sizeof(MaterialConstantData));
+    CompareSection("material texture", sections.materialTextures, header.numMaterials * sizeof(MaterialTextureData));
+    CompareSection("string table", sections.stringTable, header.stringTableSize);
+    CompareSection("texture option", sections.textureOptions, header.numTextures * sizeof(uint8_t));
+    CompareSection("key frame", sections.keyFrameData, header.keyFrameDataSize);
+    CompareSection("animation curve", sections.curveData, header.numAnimationCurves * sizeof(AnimationCurve));
+    CompareSection("animation", sections.animations, header.numAnimations * sizeof(AnimationSet));
+    CompareSection("joint index", sections.jointIndices, header.numJoints * sizeof(uint16_t));
+    CompareSection("joint IBM", sections.jointIBMs, header.numJoints * sizeof(Matrix4));
+    CompareSection("meshlet", sections.meshlets, header.numMeshlets * sizeof(Meshlet));
+    CompareSection("meshlet vertex", sections.meshletVertices, header.numMeshletVertices * sizeof(uint32_t));
+    CompareSection("meshlet triangle", sections.meshletTriangles, header.numMeshletTriangles * sizeof(uint32_t));
+
+    // The last section ends the file
+    if (inFile.peek() != std::ifstream::traits_type::eof())
+    {
+        Utility::Printf("Unexpected data after the last section in %ws\n", miniFileName.c_str());
+        identical = false;
+    }
+
+    // Meshlets are sorted by mesh and draw.  Each draw's run must cover its triangles exactly once.
+    const uint8_t* meshPtr = sections.meshData;
+    uint32_t firstMeshlet = 0;
+    for (uint32_t meshIdx = 0; meshIdx < header.numMeshes && header.numMeshlets > 0; ++meshIdx)
+    {
+        const Mesh& mesh = *(const Mesh*)meshPtr;
+        meshPtr += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
+
+        const bool index32 = mesh.ibFormat == DXGI_FORMAT_R32_UINT;
+        const uint32_t meshVertexCount = mesh.vbSize / mesh.vbStride;
+
+        for (uint16_t drawIdx = 0; drawIdx < mesh.numDraws; ++drawIdx)
+        {
+            uint32_t endMeshlet = firstMeshlet;
+            while (endMeshlet < header.numMeshlets && sections.meshlets[endMeshlet].meshIdx == meshIdx &&
+                sections.meshlets[endMeshlet].drawIdx == drawIdx)
+            {
+                ++endMeshlet;
+            }
+
+            // Primitives that were not split (such as non-indexed ones) have no meshlets at all
+            if (endMeshlet == firstMeshlet)
+                continue;
+
+            const Mesh::Draw& draw = mesh.draw[drawIdx];
+            const byte* indices = sections.geometry + mesh.ibOffset + (draw.startIndex << (index32 ? 2 : 1));
+            if (!VerifyMeshlets(sections.meshlets + firstMeshlet, endMeshlet - firstMeshlet, sections.meshletVertices,
+                sections.meshletTriangles, indices, index32, draw.primCount, meshVertexCount - draw.baseVertex))
+            {
+                Utility::Printf("Bad meshlets for mesh %u draw %u in %ws\n", meshIdx, (uint32_t)drawIdx, miniFileName.c_str());
+                identical = false;
+            }
+            firstMeshlet = endMeshlet;
+        }
+    }
+
+    if (firstMeshlet != header.numMeshlets)
+    {
+        Utility::Printf("Meshlets are out of order in %ws\n", miniFileName.c_str());
+        identical = false;
+    }
+
+    if (!VerifyReplaceWhileMapped(miniFileName, mapping))
+        identical = false;
+
+    return identical;
+}
+
 std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool forceRebuild)
 {
     const std::wstring miniFileName = Utility::RemoveExtension(filePath) + L".mini";
@@ -141,8 +496,6 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
 
     struct _stat64 sourceFileStat;
     struct _stat64 miniFileStat;
-    std::ifstream inFile;
-    FileHeader header;
 
     bool sourceFileMissing = _wstat64(filePath.c_str(), &sourceFileStat) == -1;
     bool miniFileMissing = _wstat64(miniFileName.c_str(), &miniFileStat) == -1;
@@ -158,20 +511,44 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
 
     bool needBuild = forceRebuild;
 
+    // The file to load, which is either the cooked .mini next to the source or an asset
+    // cache entry for an identical source
+    std::wstring loadFileName = miniFileName;
+
+    uint64_t cacheKey;
+    const bool useCache = !sourceFileMissing && AssetCache::IsEnabled() &&
+        AssetCache::ComputeKey(filePath, 0, CURRENT_MINI_FILE_VERSION, cacheKey);
+
+    if (useCache)
+    {
+        if (!forceRebuild && !AssetCache::Find(cacheKey, L".mini", loadFileName))
+            needBuild = true;
+    }
     // Check if .mini file exists and it is newer than source file
-    if (miniFileMissing || !sourceFileMissing && sourceFileStat.st_mtime > miniFileStat.st_mtime)
+    else if (miniFileMissing || !sourceFileMissing && sourceFileStat.st_mtime > miniFileStat.st_mtime)
+    {
         needBuild = true;
+    }
 
-    // Check if it's an older version of .mini
+    std::shared_ptr<Model> model(new Model);
+    Utility::MappedFile& mapping = model->m_FileMapping;
+    FileSections sections;
+
+    // Check if it's an older version of .mini.  SaveModel can replace the file even while other
+    // models still map it, and they keep the old contents.
     if (!needBuild)
     {
-        inFile = std::ifstream(miniFileName, std::ios::in | std::ios::binary);
-        inFile.read((char*)&header, sizeof(FileHeader));
-        if (strncmp(header.id, "MINI", 4) != 0 || header.version != CURRENT_MINI_FILE_VERSION)
+        if (!mapping.Open(loadFileName) || !ParseModelFile(mapping.GetData(), mapping.GetSize(), sections))
         {
-            Utility::Printf("Model version deprecated.  Rebuilding %ws...\n", fileName.c_str());
+            Utility::Printf("Model file out of date.  Rebuilding %ws...\n", fileName.c_str());
             needBuild = true;
-            inFile.close();
+            loadFileName = miniFileName;
+            mapping.Close();
+
+            // The cache key covers the format version, so a cached copy that fails to parse
+            // is truncated or corrupt
+            if (useCache)
+                AssetCache::Reject(cacheKey, L".mini");
         }
     }
 
@@ -209,92 +586,90 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
         if (!SaveModel(miniFileName, modelData))
             return nullptr;
 
-        inFile = std::ifstream(miniFileName, std::ios::in | std::ios::binary);
-        inFile.read((char*)&header, sizeof(FileHeader));
+        if (!modelData.m_CookReport.empty())
+            CookReport::Write(Utility::RemoveExtension(filePath) + L".cook.csv", modelData.m_CookReport);
+
+        if (CookReport::IsEnabled() && !modelData.m_AnimationReport.empty())
+            AnimationCompression::WriteReport(Utility::RemoveExtension(filePath) + L".anim.csv", modelData.m_AnimationReport);
+
+        if (useCache)
+            AssetCache::Store(cacheKey, L".mini", miniFileName);
+
+        if (!mapping.Open(miniFileName) || !ParseModelFile(mapping.GetData(), mapping.GetSize(), sections))
+            return nullptr;
     }
 
-    if (!inFile)
-        return nullptr;
+    uint32_t verifyMini = 0;
+    if (CommandLineArgs::GetInteger(L"verify_mini", verifyMini) && verifyMini != 0)
+        Utility::Printf("Mapped model file matches stream I/O:  %ws  %s\n", fileName.c_str(), VerifyModelFile(loadFileName) ? "passed" : "FAILED");
 
-    ASSERT(strncmp(header.id, "MINI", 4) == 0 && header.version == CURRENT_MINI_FILE_VERSION);
+    const FileHeader& header = sections.header;
 
     std::wstring basePath = Utility::GetBasePath(filePath);
 
-    std::shared_ptr<Model> model(new Model);
-
     model->m_NumNodes = header.numNodes;
-    model->m_SceneGraph.reset(new GraphNode[header.numNodes]);
+    model->m_SceneGraph = sections.sceneGraph;
+    model->m_GeometryData = sections.geometry;
+    model->m_Hierarchy.Create(model->m_SceneGraph, header.numNodes);
     model->m_NumMeshes = header.numMeshes;
-    model->m_MeshData.reset(new uint8_t[header.meshDataSize]);
-
-	if (header.geometrySize > 0)
-	{
-		UploadBuffer modelData;
-		modelData.Create(L"Model Data Upload", header.geometrySize);
-		inFile.read((char*)modelData.Map(), header.geometrySize);
-		modelData.Unmap();
-		model->m_DataBuffer.Create(L"Model Data", header.geometrySize, 1, modelData);
-	}
-
-    inFile.read((char*)model->m_SceneGraph.get(), header.numNodes * sizeof(GraphNode));
-    inFile.read((char*)model->m_MeshData.get(), header.meshDataSize);
-
-	if (header.numMaterials > 0)
-	{
-		UploadBuffer materialConstants;
-		materialConstants.Create(L"Material Constant Upload", header.numMaterials * sizeof(MaterialConstants));
-		MaterialConstants* materialCBV = (MaterialConstants*)materialConstants.Map();
-		for (uint32_t i = 0; i < header.numMaterials; ++i)
-		{
-			inFile.read((char*)materialCBV, sizeof(MaterialConstantData));
-			materialCBV++;
-		}
-		materialConstants.Unmap();
-		model->m_MaterialConstants.Create(L"Material Constants", header.numMaterials, sizeof(MaterialConstants), materialConstants);
-	}
-
-    // Read material texture and sampler properties so we can load the material
-    std::vector<MaterialTextureData> materialTextures(header.numMaterials);
-    inFile.read((char*)materialTextures.data(), header.numMaterials * sizeof(MaterialTextureData));
+    model->m_MeshData = sections.meshData;
+    model->m_MeshBounds.Create(model->m_MeshData, header.numMeshes);
+
+    // Geometry is copied once, straight from the mapped file into the GPU upload heap
+    if (header.geometrySize > 0)
+        model->m_DataBuffer.Create(L"Model Data", header.geometrySize, 1, sections.geometry);
+
+    if (header.numMaterials > 0)
+    {
+        UploadBuffer materialConstants;
+        materialConstants.Create(L"Material Constant Upload", header.numMaterials * sizeof(MaterialConstants));
+        MaterialConstants* materialCBV = (MaterialConstants*)materialConstants.Map();
+        for (uint32_t i = 0; i < header.numMaterials; ++i)
+            std::memcpy(materialCBV + i, sections.materialConstants + i, sizeof(MaterialConstantData));
+        materialConstants.Unmap();
+        model->m_MaterialConstants.Create(L"Material Constants", header.numMaterials, sizeof(MaterialConstants), materialConstants);
+    }
 
     std::vector<std::wstring> textureNames(header.numTextures);
+    const char* utf8TextureName = sections.stringTable;
     for (uint32_t i = 0; i < header.numTextures; ++i)
     {
-        std::string utf8TextureName;
-        std::getline(inFile, utf8TextureName, '\0');
         textureNames[i] = Utility::UTF8ToWideString(utf8TextureName);
+        utf8TextureName += strlen(utf8TextureName) + 1;
     }
 
-    std::vector<uint8_t> textureOptions(header.numTextures);
-    inFile.read((char*)textureOptions.data(), header.numTextures * sizeof(uint8_t));
-
-    LoadMaterials(*model, materialTextures, textureNames, textureOptions, basePath);
+    LoadMaterials(*model, sections.materialTextures, header.numMaterials, textureNames, sections.textureOptions, basePath);
 
     model->m_BoundingSphere = BoundingSphere(*(XMFLOAT4*)header.boundingSphere);
     model->m_BoundingBox = AxisAlignedBox(Vector3(*(XMFLOAT3*)header.minPos), Vector3(*(XMFLOAT3*)header.maxPos));
 
-    // Load animation data
+    // Animation data is used in place
     model->m_NumAnimations = header.numAnimations;
 
     if (header.numAnimations > 0)
     {
-        ASSERT(header.keyFrameDataSize > 0 && header.numAnimationCurves > 0);
-        model->m_KeyFrameData.reset(new uint8_t[header.keyFrameDataSize]);
-        inFile.read((char*)model->m_KeyFrameData.get(), header.keyFrameDataSize);
-        model->m_CurveData.reset(new AnimationCurve[header.numAnimationCurves]);
-        inFile.read((char*)model->m_CurveData.get(), header.numAnimationCurves * sizeof(AnimationCurve));
-        model->m_Animations.reset(new AnimationSet[header.numAnimations]);
-        inFile.read((char*)model->m_Animations.get(), header.numAnimations * sizeof(AnimationSet));
+        model->m_KeyFrameData = sections.keyFrameData;
+        model->m_CurveData = sections.curveData;
+        model->m_Animations = sections.animations;
+        model->m_AnimationSampler.Create(sections.animations, header.numAnimations, sections.curveData, sections.keyFrameData);
+        model->m_AnimationBlender.Create(model->m_AnimationSampler, sections.animations, header.numAnimations,
+            sections.curveData, sections.sceneGraph, header.numNodes);
     }
 
     model->m_NumJoints = header.numJoints;
 
+    model->m_NumMeshlets = header.numMeshlets;
+    if (header.numMeshlets > 0)
+    {
+        model->m_Meshlets = sections.meshlets;
+        model->m_MeshletVertices = sections.meshletVertices;
+        model->m_MeshletTriangles = sections.meshletTriangles;
+    }
+
     if (header.numJoints > 0)
     {
-        model->m_JointIndices.reset(new uint16_t[header.numJoints]);
-        inFile.read((char*)model->m_JointIndices.get(), header.numJoints * sizeof(uint16_t));
-        model->m_JointIBMs.reset(new Matrix4[header.numJoints]);
-        inFile.read((char*)model->m_JointIBMs.get(), header.numJoints * sizeof(Matrix4));
+        model->m_JointIndices = sections.jointIndices;
+        model->m_JointIBMs = sections.jointIBMs;
     }
 
     return model;
@@ -15,7 +15,9 @@
 
 #include "Model.h"
 #include "Animation.h"
+#include "AnimationCompression.h"
 #include "ConstantBuffers.h"
+#include "MeshMetrics.h"
 #include "../Core/Math/BoundingSphere.h"
 #include "../Core/Math/BoundingBox.h"
 
@@ -24,7 +26,7 @@
 
 namespace glTF { class Asset; struct Mesh; }
 
-#define CURRENT_MINI_FILE_VERSION 13
+#define CURRENT_MINI_FILE_VERSION 18
 
 namespace Renderer
 {
@@ -48,6 +50,14 @@ namespace Renderer
         uint32_t addressModes;
     };
 
+    // Meshlets with the vertex and triangle lists they index
+    struct MeshletData
+    {
+        std::vector<Meshlet> m_Meshlets;
+        std::vector<uint32_t> m_Vertices;
+        std::vector<uint32_t> m_Triangles;
+    };
+
     // All of the information that needs to be written to a .mini data file
     struct ModelData
     {
@@ -65,6 +75,9 @@ namespace Renderer
         std::vector<GraphNode> m_SceneGraph;
         std::vector<std::string> m_TextureNames;
         std::vector<uint8_t> m_TextureOptions;
+        MeshletData m_Meshlets;
+        std::vector<CookReport::Entry> m_CookReport;  // Not saved; only collected with -cook_report 1
+        std::vector<AnimationCompression::CurveReport> m_AnimationReport;  // Not saved; written with -cook_report 1
     };
 
     struct FileHeader
@@ -82,14 +95,89 @@ namespace Renderer
         uint32_t numAnimationCurves;
         uint32_t numAnimations;
         uint32_t numJoints;     // All joints for all skins
+        uint32_t numMeshlets;   // Optional, may be 0
+        uint32_t numMeshletVertices;
+        uint32_t numMeshletTriangles;
         float    boundingSphere[4];
         float    minPos[3];
         float    maxPos[3];
     };
 
+    // Every section of a .mini file starts on a 16-byte boundary so that a memory mapped file
+    // can be used in place, including the SIMD types in GraphNode and Matrix4.
+    static const uint32_t kMiniSectionAlignment = 16;
+
+    // Byte offsets of each section of a .mini file.  These are derived from the header alone,
+    // and the writer and readers must agree on them.
+    struct FileLayout
+    {
+        size_t geometry;
+        size_t sceneGraph;
+        size_t meshData;
+        size_t materialConstants;
+        size_t materialTextures;
+        size_t stringTable;
+        size_t textureOptions;
+        size_t keyFrameData;
+        size_t curveData;
+        size_t animations;
+        size_t jointIndices;
+        size_t jointIBMs;
+        size_t meshlets;
+        size_t meshletVertices;
+        size_t meshletTriangles;
+        size_t endOfFile;
+    };
+
+    FileLayout ComputeFileLayout( const FileHeader& header );
+
+    // Pointers to every section of a loaded .mini file.  They point into the memory of whoever
+    // parsed the file (usually a file mapping) and are only valid while it stays alive.
+    struct FileSections
+    {
+        FileHeader header;
+        const byte* geometry;
+        GraphNode* sceneGraph;
+        uint8_t* meshData;
+        const MaterialConstantData* materialConstants;
+        const MaterialTextureData* materialTextures;
+        const char* stringTable;
+        const uint8_t* textureOptions;
+        const uint8_t* keyFrameData;
+        const AnimationCurve* curveData;
+        const AnimationSet* animations;
+        const uint16_t* jointIndices;
+        const Matrix4* jointIBMs;
+        const Meshlet* meshlets;
+        const uint32_t* meshletVertices;
+        const uint32_t* meshletTriangles;
+    };
+
+    // Validates the header and every section offset against the file size before handing out
+    // pointers.  Returns false (and prints why) for truncated, corrupt, or out-of-date files.
+    bool ParseModelFile( byte* fileData, size_t fileSize, FileSections& sections );
+
+    struct Primitive;
+
+    // Groups already optimized primitives by vertex format and material, and appends their
+    // vertex and index data to bufferMemory.  Their meshlets are appended to meshletData.
+    // Output depends only on the order of primitives.
+    void MergeMesh(
+        std::vector<Mesh*>& meshList,
+        std::vector<byte>& bufferMemory,
+        MeshletData& meshletData,
+        Primitive* primitives,
+        uint32_t numPrimitives,
+        int32_t skinIdx,
+        uint32_t matrixIdx,
+        Math::BoundingSphere& boundingSphere,
+        Math::AxisAlignedBox& boundingBox
+    );
+
     void CompileMesh(
         std::vector<Mesh*>& meshList,
         std::vector<byte>& bufferMemory,
+        MeshletData& meshletData,
         glTF::Mesh& srcMesh,
         uint32_t matrixIdx,
         const Matrix4& localToObject,
@@ -97,8 +185,27 @@ namespace Renderer
         Math::AxisAlignedBox& boundingBox
     );
 
-    bool BuildModel( ModelData& model, const glTF::Asset& asset, int sceneIdx = -1 );
+    // Primitives are cooked on numThreads threads (0 means one per hardware thread).  The
+    // result is byte-for-byte identical regardless of the thread count.
+    bool BuildModel( ModelData& model, const glTF::Asset& asset, int sceneIdx = -1, uint32_t numThreads = 0 );
     bool SaveModel( const std::wstring& filePath, const ModelData& model );
     
     std::shared_ptr<Model> LoadModel( const std::wstring& filePath, bool forceRebuild = false );
+
+    // CPU-only check that reading a .mini file sequentially with stream I/O, taking section
+    // sizes from the header, yields exactly the same bytes as the memory mapped sections used
+    // by LoadModel, and that the meshlets of every draw cover each of its triangles exactly
+    // once.  It also replaces a mapped scratch copy of the file the way a rebuild does and checks
+    // that the old view survives.  No GPU resources are touched.  LoadModel runs it on every model it loads and
+    // prints the result when the command line has "-verify_mini 1", in any build.
+    bool VerifyModelFile( const std::wstring& miniFileName );
+
+    // Cooks a glTF file repeatedly with 1, 2, 4, ... threads and prints primitives per second
+    // for each.  Every result is checked against the single-threaded output.
+    void BenchmarkBuildModel( const std::wstring& filePath );
+
+    // Cooks the animations of a glTF file with float keys at the authored rate and again with
+    // compression, then samples every curve of both at many times.  Prints the key data size,
+    // the bytes read per update, the time per update, and the largest difference.
+    void BenchmarkAnimationCompression( const std::wstring& filePath );
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "RadixSort.h"
+#include "../Core/Utility.h"
+
+#include <cstring>
+#include <utility>
+
+bool RadixSortBuffers( uint64_t* keys, uint64_t* scratch, uint32_t* values, uint32_t* valueScratch,
+    size_t count, uint32_t firstBit )
+{
+    ASSERT(firstBit < 64);
+
+    if (count < 2)
+        return false;
+
+    const uint32_t firstByte = firstBit / 8;
+    const uint32_t numDigits = 8 - firstByte;
+
+    // Count every digit in one pass over the keys
+    size_t histograms[8][256];
+    std::memset(histograms, 0, sizeof(histograms));
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t key = keys[i] >> (firstByte * 8);
+        for (uint32_t d = 0; d < numDigits; ++d, key >>= 8)
+            ++histograms[d][key & 0xFF];
+    }
+
+    // The buffers trade roles after every pass that moves anything
+    bool inScratch = false;
+
+    for (uint32_t d = 0; d < numDigits; ++d)
+    {
+        size_t* histogram = histograms[d];
+        const uint32_t shift = (firstByte + d) * 8;
+
+        // A digit shared by every key would just copy the keys
+        if (histogram[(keys[0] >> shift) & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (uint32_t b = 0; b < 256; ++b)
+        {
+            size_t bucketSize = histogram[b];
+            histogram[b] = offset;
+            offset += bucketSize;
+        }
+
+        const uint64_t* src = keys;
+        uint64_t* dst = scratch;
+        if (values == nullptr)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                uint64_t key = src[i];
+                dst[histogram[(key >> shift) & 0xFF]++] = key;
+            }
+        }
+        else
+        {
+            const uint32_t* srcValues = values;
+            uint32_t* dstValues = valueScratch;
+            for (size_t i = 0; i < count; ++i)
+            {
+                uint64_t key = src[i];
+                size_t slot = histogram[(key >> shift) & 0xFF]++;
+                dst[slot] = key;
+                dstValues[slot] = srcValues[i];
+            }
+            std::swap(values, valueScratch);
+        }
+
+        std::swap(keys, scratch);
+        inScratch = !inScratch;
+    }
+
+    return inScratch;
+}
@@ -0,0 +1,75 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "../Core/Utility.h"
+
+#include <cstdint>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+//  RadixSortKeys
+//-----------------------------------------------------------------------------
+//  Stable LSD radix sort of 64-bit keys, one byte per pass.  All histograms are
+//  gathered in a single read of the keys, and any byte that is the same in
+//  every key is skipped, so bits that barely vary (pass IDs, PSO indices) cost
+//  almost nothing.
+//
+//  Parameters:
+//      keys
+//          the keys to sort.  On return, holds them in ascending order.
+//      scratch
+//          a second buffer for the ping-pong passes.  It is resized as needed
+//          and may swap storage with keys, so keep it around to avoid
+//          reallocating every frame.
+//      firstBit
+//          bits below this (rounded down to a byte) are not sorted on.  If the
+//          keys are already in ascending order of those low bits, the result
+//          is the same as a full sort because every pass is stable.
+//
+//  The vectors may use any allocator, such as the frame allocator's.
+//-----------------------------------------------------------------------------
+template <typename KeyVector>
+void RadixSortKeys(KeyVector& keys, KeyVector& scratch, uint32_t firstBit = 0);
+
+// Sorts the keys as above and applies the same permutation to a parallel array of 32-bit values,
+// such as indices of the objects the keys refer to.
+template <typename KeyVector, typename ValueVector>
+void RadixSortKeys(KeyVector& keys, KeyVector& scratch, ValueVector& values, ValueVector& valueScratch, uint32_t firstBit = 0);
+
+// The sort itself, on buffers of count elements.  values and valueScratch may be null.  Returns
+// true when the sorted data ended up in the scratch buffers.
+bool RadixSortBuffers(uint64_t* keys, uint64_t* scratch, uint32_t* values, uint32_t* valueScratch,
+    size_t count, uint32_t firstBit);
+
+template <typename KeyVector>
+void RadixSortKeys(KeyVector& keys, KeyVector& scratch, uint32_t firstBit)
+{
+    scratch.resize(keys.size());
+    if (RadixSortBuffers(keys.data(), scratch.data(), nullptr, nullptr, keys.size(), firstBit))
+        keys.swap(scratch);
+}
+
+template <typename KeyVector, typename ValueVector>
+void RadixSortKeys(KeyVector& keys, KeyVector& scratch, ValueVector& values, ValueVector& valueScratch, uint32_t firstBit)
+{
+    ASSERT(values.size() == keys.size());
+    scratch.resize(keys.size());
+    valueScratch.resize(values.size());
+    if (RadixSortBuffers(keys.data(), scratch.data(), values.data(), valueScratch.data(), keys.size(), firstBit))
+    {
+        keys.swap(scratch);
+        values.swap(valueScratch);
+    }
+}
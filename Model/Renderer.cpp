@@ -16,11 +16,14 @@
 #include "TextureManager.h"
 #include "ConstantBuffers.h"
 #include "LightManager.h"
+#include "AssetCache.h"
+#include "RadixSort.h"
 #include "../Core/RootSignature.h"
 #include "../Core/PipelineState.h"
 #include "../Core/GraphicsCommon.h"
 #include "../Core/BufferManager.h"
 #include "../Core/ShadowCamera.h"
+#include "../Core/SystemTime.h"
 
 #include "CompiledShaders/DefaultVS.h"
 #include "CompiledShaders/DefaultSkinVS.h"
@@ -42,6 +45,10 @@
 #include "CompiledShaders/SkyboxVS.h"
 #include "CompiledShaders/SkyboxPS.h"
 
+#include <algorithm>
+#include <random>
+#include <thread>
+
 #pragma warning(disable:4319) // '~': zero extending 'uint32_t' to 'uint64_t' of greater size
 
 using namespace Math;
@@ -51,6 +58,7 @@ using namespace Renderer;
 namespace Renderer
 {
     BoolVar SeparateZPass("Renderer/Separate Z Pass", true);
+    BoolVar ParallelSubmission("Renderer/Parallel Submission", true);
 
     bool s_Initialized = false;
 
@@ -358,6 +366,8 @@ void Renderer::SetIBLBias(float LODBias)
 
 void Renderer::Shutdown(void)
 {
+    AssetCache::PrintStatistics();
+
     s_RadianceCubeMap = nullptr;
     s_IrradianceCubeMap = nullptr;
     TextureManager::Shutdown();
@@ -535,10 +545,16 @@ void MeshSorter::AddMesh( const Mesh& mesh, float distance,
     D3D12_GPU_VIRTUAL_ADDRESS meshCBV,
     D3D12_GPU_VIRTUAL_ADDRESS materialCBV,
     D3D12_GPU_VIRTUAL_ADDRESS bufferPtr,
-    const Joint* skeleton)
+    const Joint* skeleton,
+    uint32_t bucketIdx)
 {
+    ASSERT(bucketIdx < m_Buckets.size());
+    SortBucket& bucket = m_Buckets[bucketIdx];
+
+    const uint32_t objectIdx = (uint32_t)bucket.objects.size();
+
     SortKey key;
-    key.value = m_SortObjects.size();
+    key.value = 0;
 
 	bool alphaBlend = (mesh.psoFlags & PSOFlags::kAlphaBlend) == PSOFlags::kAlphaBlend;
     bool alphaTest = (mesh.psoFlags & PSOFlags::kAlphaTest) == PSOFlags::kAlphaTest;
@@ -556,48 +572,274 @@ void MeshSorter::AddMesh( const Mesh& mesh, float distance,
 		key.passID = kZPass;
 		key.psoIdx = depthPSO + 4;
         key.key = dist.u;
-		m_SortKeys.push_back(key.value);
-		m_PassCounts[kZPass]++;
+		bucket.keys.push_back(key.value);
+		bucket.objectIndices.push_back(objectIdx);
+		bucket.passCounts[kZPass]++;
 	}
     else if (mesh.psoFlags & PSOFlags::kAlphaBlend)
     {
         key.passID = kTransparent;
         key.psoIdx = mesh.pso;
         key.key = ~dist.u;
-        m_SortKeys.push_back(key.value);
-        m_PassCounts[kTransparent]++;
+        bucket.keys.push_back(key.value);
+        bucket.objectIndices.push_back(objectIdx);
+        bucket.passCounts[kTransparent]++;
     }
     else if (SeparateZPass || alphaTest)
     {
         key.passID = kZPass;
         key.psoIdx = depthPSO;
         key.key = dist.u;
-        m_SortKeys.push_back(key.value);
-        m_PassCounts[kZPass]++;
+        bucket.keys.push_back(key.value);
+        bucket.objectIndices.push_back(objectIdx);
+        bucket.passCounts[kZPass]++;
 
         key.passID = kOpaque;
         key.psoIdx = mesh.pso + 1;
         key.key = dist.u;
-        m_SortKeys.push_back(key.value);
-        m_PassCounts[kOpaque]++;
+        bucket.keys.push_back(key.value);
+        bucket.objectIndices.push_back(objectIdx);
+        bucket.passCounts[kOpaque]++;
     }
     else
     {
         key.passID = kOpaque;
         key.psoIdx = mesh.pso;
         key.key = dist.u;
-        m_SortKeys.push_back(key.value);
-        m_PassCounts[kOpaque]++;
+        bucket.keys.push_back(key.value);
+        bucket.objectIndices.push_back(objectIdx);
+        bucket.passCounts[kOpaque]++;
     }
 
     SortObject object = { &mesh, skeleton, meshCBV, materialCBV, bufferPtr };
-    m_SortObjects.push_back(object);
+    bucket.objects.push_back(object);
+}
+
+void MeshSorter::MergeBuckets()
+{
+    if (m_SortKeys.empty() && m_Buckets.size() == 1)
+    {
+        // Nothing to merge
+        SortBucket& bucket = m_Buckets[0];
+        m_SortObjects.swap(bucket.objects);
+        m_SortKeys.swap(bucket.keys);
+        m_SortObjectIndices.swap(bucket.objectIndices);
+        for (uint32_t p = 0; p < kNumPasses; ++p)
+            m_PassCounts[p] += bucket.passCounts[p];
+    }
+    else
+    {
+        size_t numObjects = m_SortObjects.size();
+        size_t numKeys = m_SortKeys.size();
+        for (const SortBucket& bucket : m_Buckets)
+        {
+            numObjects += bucket.objects.size();
+            numKeys += bucket.keys.size();
+        }
+        ASSERT(numObjects <= UINT32_MAX);
+        m_SortObjects.reserve(numObjects);
+        m_SortKeys.reserve(numKeys);
+        m_SortObjectIndices.reserve(numKeys);
+
+        for (SortBucket& bucket : m_Buckets)
+        {
+            const uint32_t objectBase = (uint32_t)m_SortObjects.size();
+            m_SortObjects.insert(m_SortObjects.end(), bucket.objects.begin(), bucket.objects.end());
+            m_SortKeys.insert(m_SortKeys.end(), bucket.keys.begin(), bucket.keys.end());
+            for (uint32_t objectIdx : bucket.objectIndices)
+                m_SortObjectIndices.push_back(objectIdx + objectBase);
+            for (uint32_t p = 0; p < kNumPasses; ++p)
+                m_PassCounts[p] += bucket.passCounts[p];
+        }
+    }
+
+    for (SortBucket& bucket : m_Buckets)
+    {
+        bucket.objects.clear();
+        bucket.keys.clear();
+        bucket.objectIndices.clear();
+        std::memset(bucket.passCounts, 0, sizeof(bucket.passCounts));
+    }
 }
 
 void MeshSorter::Sort()
 {
-    struct { bool operator()(uint64_t a, uint64_t b) const { return a < b; } } Cmp;
-    std::sort(m_SortKeys.begin(), m_SortKeys.end(), Cmp);
+    MergeBuckets();
+
+    // Keys are appended in object order, and objects added later get higher indices, so a
+    // stable sort orders equal keys by object, just as if the index were the lowest key bits.
+    RadixSortKeys(m_SortKeys, m_SortScratch, m_SortObjectIndices, m_SortIndexScratch);
+}
+
+void MeshSorter::SetNumBuckets( uint32_t numBuckets )
+{
+    ASSERT(numBuckets > 0);
+    MergeBuckets();
+    m_Buckets.resize(numBuckets);
+}
+
+void MeshSorter::Benchmark( void )
+{
+    const uint32_t kNumThreads = 4;
+    const uint32_t kNumPSOs = 64;
+    const uint32_t kNumUniqueMeshes = 4096;
+
+    const char* distributionNames[] = { "random depth", "front to back", "constant depth" };
+
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<uint32_t> psoDist(0, kNumPSOs - 1);
+    std::uniform_int_distribution<uint32_t> flagDist(0, 9);
+    std::uniform_real_distribution<float> depthDist(1.0f, 1000.0f);
+
+    // Draws reuse a small set of meshes so that a million of them fit comfortably in memory
+    std::vector<Mesh> meshes(kNumUniqueMeshes);
+    for (Mesh& mesh : meshes)
+    {
+        std::memset(&mesh, 0, sizeof(Mesh));
+        uint32_t flags = flagDist(rng);
+        mesh.psoFlags = flags == 0 ? PSOFlags::kAlphaBlend : flags < 3 ? PSOFlags::kAlphaTest : 0;
+        mesh.pso = (uint16_t)psoDist(rng);
+        mesh.numDraws = 1;
+    }
+
+    std::vector<float> distances;
+
+    auto AddMeshes = [&](MeshSorter& sorter, uint32_t first, uint32_t last, uint32_t bucketIdx)
+    {
+        for (uint32_t i = first; i < last; ++i)
+            sorter.AddMesh(meshes[i % kNumUniqueMeshes], distances[i], i * 256, 0, 0, nullptr, bucketIdx);
+    };
+
+    Utility::Printf("Mesh sorter benchmark (%u threads for concurrent AddMesh)\n", kNumThreads);
+
+    const uint32_t meshCounts[] = { 1000, 10000, 100000 };
+
+    for (uint32_t numMeshes : meshCounts)
+    {
+        for (uint32_t dist = 0; dist < _countof(distributionNames); ++dist)
+        {
+            // Each run's sorters last one "frame", so memory from earlier runs can be recycled
+            FrameAllocator::BeginFrame();
+
+            distances.resize(numMeshes);
+            for (uint32_t i = 0; i < numMeshes; ++i)
+                distances[i] = dist == 0 ? depthDist(rng) : dist == 1 ? (float)i : 100.0f;
+
+            // Single threaded submission
+            MeshSorter serial(kDefault);
+            int64_t startTick = SystemTime::GetCurrentTick();
+            AddMeshes(serial, 0, numMeshes, 0);
+            double addSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            // A comparison sort of (key, object) pairs gives the reference order
+            const SortBucket& unsorted = serial.m_Buckets[0];
+            std::vector<std::pair<uint64_t, uint32_t>> reference(unsorted.keys.size());
+            for (size_t i = 0; i < reference.size(); ++i)
+                reference[i] = std::make_pair(unsorted.keys[i], unsorted.objectIndices[i]);
+            startTick = SystemTime::GetCurrentTick();
+            std::sort(reference.begin(), reference.end());
+            double stdSortSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            startTick = SystemTime::GetCurrentTick();
+            serial.Sort();
+            double radixSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            // Concurrent submission into per-thread buckets, then merged by Sort
+            MeshSorter parallel(kDefault);
+            parallel.SetNumBuckets(kNumThreads);
+            startTick = SystemTime::GetCurrentTick();
+            {
+                std::vector<std::thread> threads;
+                for (uint32_t t = 0; t < kNumThreads; ++t)
+                {
+                    threads.push_back(std::thread(AddMeshes, std::ref(parallel),
+                        numMeshes * t / kNumThreads, numMeshes * (t + 1) / kNumThreads, t));
+                }
+                for (std::thread& thread : threads)
+                    thread.join();
+            }
+            double parallelAddSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            startTick = SystemTime::GetCurrentTick();
+            parallel.Sort();
+            double mergeSortSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            bool identical = serial.m_SortKeys == parallel.m_SortKeys &&
+                serial.m_SortObjectIndices == parallel.m_SortObjectIndices &&
+                std::memcmp(serial.m_PassCounts, parallel.m_PassCounts, sizeof(m_PassCounts)) == 0;
+            for (size_t i = 0; identical && i < reference.size(); ++i)
+            {
+                identical = serial.m_SortKeys[i] == reference[i].first &&
+                    serial.m_SortObjectIndices[i] == reference[i].second;
+            }
+
+            Utility::Printf("  %6u meshes, %-14s  AddMesh %7.3f ms (%u threads %7.3f ms)  std::sort %7.3f ms  "
+                "radix %7.3f ms (merged %7.3f ms)  %s\n", numMeshes, distributionNames[dist], addSeconds * 1000.0,
+                kNumThreads, parallelAddSeconds * 1000.0, stdSortSeconds * 1000.0, radixSeconds * 1000.0,
+                mergeSortSeconds * 1000.0, identical ? "identical" : "MISMATCH");
+        }
+    }
+
+    // Compare against the former layout, which packed a 16-bit object index into the low bits of
+    // the key.  Past 64K objects those indices alias, so only the timings are meaningful there.
+    Utility::Printf("Sort key layouts (random depth):\n");
+
+    const uint32_t largeMeshCounts[] = { 65536, 262144, 1048576 };
+
+    for (uint32_t numMeshes : largeMeshCounts)
+    {
+        FrameAllocator::BeginFrame();
+
+        distances.resize(numMeshes);
+        for (uint32_t i = 0; i < numMeshes; ++i)
+            distances[i] = depthDist(rng);
+
+        MeshSorter sorter(kDefault);
+        AddMeshes(sorter, 0, numMeshes, 0);
+
+        const SortBucket& unsorted = sorter.m_Buckets[0];
+        std::vector<uint64_t> packedKeys(unsorted.keys.size());
+        for (size_t i = 0; i < packedKeys.size(); ++i)
+            packedKeys[i] = unsorted.keys[i] << 16 | (unsorted.objectIndices[i] & 0xFFFF);
+        std::vector<uint64_t> packedScratch;
+
+        // Old layout:  sort the packed keys, then walk them like RenderMeshes does
+        int64_t startTick = SystemTime::GetCurrentTick();
+        RadixSortKeys(packedKeys, packedScratch, 16);
+        double packedSortSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        uint64_t packedChecksum = 0;
+        startTick = SystemTime::GetCurrentTick();
+        for (uint64_t packed : packedKeys)
+        {
+            SortKey key;
+            key.value = packed >> 16;
+            const SortObject& object = unsorted.objects[packed & 0xFFFF];
+            packedChecksum += object.meshCBV + object.mesh->pso + key.psoIdx;
+        }
+        double packedWalkSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        // New layout:  keys plus a parallel object index array
+        startTick = SystemTime::GetCurrentTick();
+        sorter.Sort();
+        double indexedSortSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        uint64_t indexedChecksum = 0;
+        startTick = SystemTime::GetCurrentTick();
+        for (size_t i = 0; i < sorter.m_SortKeys.size(); ++i)
+        {
+            SortKey key;
+            key.value = sorter.m_SortKeys[i];
+            const SortObject& object = sorter.m_SortObjects[sorter.m_SortObjectIndices[i]];
+            indexedChecksum += object.meshCBV + object.mesh->pso + key.psoIdx;
+        }
+        double indexedWalkSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        Utility::Printf("  %7u meshes:  16-bit index in key: sort %8.3f ms  walk %7.3f ms   "
+            "index array: sort %8.3f ms  walk %7.3f ms   (checksums %llx %llx)\n", numMeshes,
+            packedSortSeconds * 1000.0, packedWalkSeconds * 1000.0, indexedSortSeconds * 1000.0,
+            indexedWalkSeconds * 1000.0, packedChecksum, indexedChecksum);
+    }
 }
 
 void MeshSorter::RenderMeshes(
@@ -718,7 +960,7 @@ void MeshSorter::RenderMeshes(
         {
             SortKey key;
             key.value = m_SortKeys[m_CurrentDraw];
-            const SortObject& object = m_SortObjects[key.objectIdx];
+            const SortObject& object = m_SortObjects[m_SortObjectIndices[m_CurrentDraw]];
             const Mesh& mesh = *object.mesh;
 
             context.SetConstantBuffer(kMeshConstants, object.meshCBV);
@@ -19,6 +19,7 @@
 #include "../Core/CommandContext.h"
 #include "../Core/UploadBuffer.h"
 #include "../Core/TextureManager.h"
+#include "../Core/FrameAllocator.h"
 #include <cstdint>
 #include <vector>
 #include "VRS.h"
@@ -36,6 +37,7 @@ struct Joint;
 namespace Renderer
 {
     extern BoolVar SeparateZPass;
+    extern BoolVar ParallelSubmission;
 
     using namespace Math;
 
@@ -92,6 +94,8 @@ namespace Renderer
 			m_DSV = nullptr;
 			m_SortObjects.clear();
 			m_SortKeys.clear();
+			m_SortObjectIndices.clear();
+			m_Buckets.resize(1);
 			std::memset(m_PassCounts, 0, sizeof(m_PassCounts));
 			m_CurrentPass = kZPass;
 			m_CurrentDraw = 0;
@@ -111,18 +115,36 @@ namespace Renderer
         const Frustum& GetViewFrustum() const { return m_Camera->GetViewSpaceFrustum(); }
         const Matrix4& GetViewMatrix() const { return m_Camera->GetViewMatrix(); }
 
+        // Threads that add meshes concurrently must each pass a different bucket index to
+        // AddMesh.  No thread may be adding meshes during this call.  Meshes already added are
+        // merged first and stay ahead of anything added to the new buckets, so filling bucket i
+        // with the i-th slice of a serial submission gives exactly the serial draw order.
+        void SetNumBuckets( uint32_t numBuckets );
+
         void AddMesh( const Mesh& mesh, float distance,
             D3D12_GPU_VIRTUAL_ADDRESS meshCBV,
             D3D12_GPU_VIRTUAL_ADDRESS materialCBV,
             D3D12_GPU_VIRTUAL_ADDRESS bufferPtr,
-            const Joint* skeleton = nullptr);
+            const Joint* skeleton = nullptr,
+            uint32_t bucketIdx = 0);
 
+        // Merges the buckets in order and radix sorts the draws
         void Sort();
 
+        // Times AddMesh and Sort on synthetic draws against a std::sort of the same keys, and the
+        // sort and traversal cost of the object index array against 16-bit indices in the key
+        static void Benchmark( void );
+
         void RenderMeshes(DrawPass pass, GraphicsContext& context, GlobalConstants& globals);
 
     private:
 
+        // Appends the buckets, in order, to the sorter's lists and empties them
+        void MergeBuckets();
+
+        // Draws are ordered by pass, then depth key, then PSO.  The object a key refers to is not
+        // part of the key.  It travels through the sort in a parallel index array, so the number
+        // of objects is not limited by the key width.  The radix sort skips the unused top bits.
         struct SortKey
         {
             union
@@ -130,7 +152,6 @@ namespace Renderer
                 uint64_t value;
                 struct
                 {
-                    uint64_t objectIdx : 16;
                     uint64_t psoIdx : 12;
                     uint64_t key : 32;
                     uint64_t passID : 4;
@@ -147,8 +168,28 @@ namespace Renderer
             D3D12_GPU_VIRTUAL_ADDRESS bufferPtr;
         };
 
-        std::vector<SortObject> m_SortObjects;
-        std::vector<uint64_t> m_SortKeys;
+        // Meshes added by one thread.  Object indices are local to the bucket until Sort rebases
+        // them.
+        struct SortBucket
+        {
+            FrameVector<SortObject> objects;
+            FrameVector<uint64_t> keys;
+            FrameVector<uint32_t> objectIndices;
+            uint32_t passCounts[kNumPasses];
+
+            // Keeps buckets written by different threads off each other's cache lines
+            uint8_t padding[64];
+
+            SortBucket() { std::memset(passCounts, 0, sizeof(passCounts)); }
+        };
+
+        // A sorter lives for one frame, so its lists come from the frame allocator
+        FrameVector<SortBucket> m_Buckets;
+        FrameVector<SortObject> m_SortObjects;
+        FrameVector<uint64_t> m_SortKeys;
+        FrameVector<uint32_t> m_SortObjectIndices;  // Parallel to m_SortKeys
+        FrameVector<uint64_t> m_SortScratch;
+        FrameVector<uint32_t> m_SortIndexScratch;
 		BatchType m_BatchType;
         uint32_t m_PassCounts[kNumPasses];
         DrawPass m_CurrentPass;
@@ -0,0 +1,477 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "Skinning.h"
+#include "Model.h"
+#include "ConstantBuffers.h"
+#include "../Core/Utility.h"
+#include "../Core/SystemTime.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <memory>
+#include <ppl.h>
+#include <random>
+#include <vector>
+
+using namespace Math;
+
+namespace
+{
+    const uint32_t kMinParallelJobs = 64;
+    const uint32_t kJobsPerTask = 16;
+    const uint32_t kVerticesPerTask = 16384;
+
+    inline __m128 Cross( __m128 ay, __m128 az, __m128 by, __m128 bz )
+    {
+        return _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+    }
+
+    // Four matrices in SoA form:  M[r * 4 + c] holds element c of row r of each matrix
+    inline void LoadTransposed( const float* const* matrices, __m128* M )
+    {
+        for (uint32_t r = 0; r < 4; ++r)
+        {
+            __m128 rows[4] = { _mm_load_ps(matrices[0] + r * 4), _mm_load_ps(matrices[1] + r * 4),
+                _mm_load_ps(matrices[2] + r * 4), _mm_load_ps(matrices[3] + r * 4) };
+            _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+            for (uint32_t c = 0; c < 4; ++c)
+                M[r * 4 + c] = rows[c];
+        }
+    }
+
+    // Up to four consecutive joints.  Missing lanes repeat the last joint and are not stored.
+    // The arithmetic mirrors Matrix4::operator* and InverseTranspose(Matrix3).
+    void BuildJointBatch( const MeshConstants* meshConstants, const uint16_t* jointIndices, const Matrix4* jointIBMs,
+        uint32_t first, uint32_t count, Joint* skeleton )
+    {
+        const float* world[4];
+        const float* ibm[4];
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            const uint32_t joint = first + std::min(lane, count - 1);
+            world[lane] = (const float*)&meshConstants[jointIndices[joint]].World;
+            ibm[lane] = (const float*)&jointIBMs[joint];
+        }
+
+        __m128 P[16], L[16];
+        LoadTransposed(world, P);
+        LoadTransposed(ibm, L);
+
+        // World * IBM, i.e. each IBM row is transformed by the world rows
+        __m128 W[16];
+        for (uint32_t r = 0; r < 4; ++r)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                __m128 xz = _mm_add_ps(_mm_mul_ps(L[r * 4 + 0], P[0 + c]), _mm_mul_ps(L[r * 4 + 2], P[8 + c]));
+                __m128 yw = _mm_add_ps(_mm_mul_ps(L[r * 4 + 1], P[4 + c]), _mm_mul_ps(L[r * 4 + 3], P[12 + c]));
+                W[r * 4 + c] = _mm_add_ps(xz, yw);
+            }
+        }
+
+        // Normal matrix:  the adjoint of the upper 3x3 divided by its determinant
+        const __m128 x[3] = { W[0], W[1], W[2] };
+        const __m128 y[3] = { W[4], W[5], W[6] };
+        const __m128 z[3] = { W[8], W[9], W[10] };
+
+        __m128 inv0[3] = { Cross(y[1], y[2], z[1], z[2]), Cross(y[2], y[0], z[2], z[0]), Cross(y[0], y[1], z[0], z[1]) };
+        __m128 inv1[3] = { Cross(z[1], z[2], x[1], x[2]), Cross(z[2], z[0], x[2], x[0]), Cross(z[0], z[1], x[0], x[1]) };
+        __m128 inv2[3] = { Cross(x[1], x[2], y[1], y[2]), Cross(x[2], x[0], y[2], y[0]), Cross(x[0], x[1], y[0], y[1]) };
+
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(z[0], inv2[0]), _mm_mul_ps(z[1], inv2[1])), _mm_mul_ps(z[2], inv2[2]));
+        __m128 rDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        // Back to one joint per register
+        __m128 posRows[4][4];
+        for (uint32_t r = 0; r < 4; ++r)
+        {
+            posRows[r][0] = W[r * 4 + 0];
+            posRows[r][1] = W[r * 4 + 1];
+            posRows[r][2] = W[r * 4 + 2];
+            posRows[r][3] = W[r * 4 + 3];
+            _MM_TRANSPOSE4_PS(posRows[r][0], posRows[r][1], posRows[r][2], posRows[r][3]);
+        }
+
+        const __m128* invRows[3] = { inv0, inv1, inv2 };
+        __m128 normalRows[3][4];
+        for (uint32_t r = 0; r < 3; ++r)
+        {
+            normalRows[r][0] = _mm_mul_ps(invRows[r][0], rDet);
+            normalRows[r][1] = _mm_mul_ps(invRows[r][1], rDet);
+            normalRows[r][2] = _mm_mul_ps(invRows[r][2], rDet);
+            normalRows[r][3] = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(normalRows[r][0], normalRows[r][1], normalRows[r][2], normalRows[r][3]);
+        }
+
+        for (uint32_t lane = 0; lane < count; ++lane)
+        {
+            float* posXform = (float*)&skeleton[first + lane].posXform;
+            float* nrmXform = (float*)&skeleton[first + lane].nrmXform;
+            for (uint32_t r = 0; r < 4; ++r)
+                _mm_store_ps(posXform + r * 4, posRows[r][lane]);
+            for (uint32_t r = 0; r < 3; ++r)
+                _mm_store_ps(nrmXform + r * 4, normalRows[r][lane]);
+        }
+    }
+
+    inline void AccumulateJoint( const Matrix4& joint, __m128 weight, __m128* skin )
+    {
+        const float* m = (const float*)&joint;
+        for (uint32_t r = 0; r < 4; ++r)
+            skin[r] = _mm_add_ps(skin[r], _mm_mul_ps(_mm_load_ps(m + r * 4), weight));
+    }
+
+    void SkinRange( const uint8_t* depthVertices, uint32_t stride, uint32_t first, uint32_t last, const Matrix4* palette,
+        XMFLOAT3* positions, __m128& boundsMin, __m128& boundsMax )
+    {
+        __m128 lo = _mm_set1_ps(FLT_MAX);
+        __m128 hi = _mm_set1_ps(-FLT_MAX);
+
+        for (uint32_t i = first; i < last; ++i)
+        {
+            const uint8_t* vertex = depthVertices + (size_t)i * stride;
+            const float* position = (const float*)vertex;
+            const uint16_t* indices = (const uint16_t*)(vertex + stride - 16);
+
+            // Normalized by their sum, which the UNORM scale cancels out of.  All zero weights
+            // give the origin rather than the NaN the shader would.
+            __m128 weights = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(indices + 4)),
+                _mm_setzero_si128()));
+            __m128 sum = _mm_add_ps(weights, _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 3, 0, 1)));
+            sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            weights = _mm_div_ps(weights, _mm_max_ps(sum, _mm_set1_ps(1.0f)));
+
+            __m128 skin[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+            AccumulateJoint(palette[indices[0]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0)), skin);
+            AccumulateJoint(palette[indices[1]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1)), skin);
+            AccumulateJoint(palette[indices[2]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2)), skin);
+            AccumulateJoint(palette[indices[3]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(3, 3, 3, 3)), skin);
+
+            const __m128 xz = _mm_add_ps(_mm_mul_ps(_mm_load1_ps(position + 0), skin[0]), _mm_mul_ps(_mm_load1_ps(position + 2), skin[2]));
+            const __m128 yw = _mm_add_ps(_mm_mul_ps(_mm_load1_ps(position + 1), skin[1]), skin[3]);
+            const __m128 result = _mm_add_ps(xz, yw);
+
+            _mm_storel_pi((__m64*)&positions[i], result);
+            _mm_store_ss(&positions[i].z, _mm_movehl_ps(result, result));
+
+            lo = _mm_min_ps(lo, result);
+            hi = _mm_max_ps(hi, result);
+        }
+
+        boundsMin = lo;
+        boundsMax = hi;
+    }
+}
+
+void BuildJointPalette( const MeshConstants* meshConstants, const uint16_t* jointIndices, const Matrix4* jointIBMs,
+    uint32_t numJoints, Joint* skeleton )
+{
+    for (uint32_t first = 0; first < numJoints; first += 4)
+        BuildJointBatch(meshConstants, jointIndices, jointIBMs, first, std::min(4u, numJoints - first), skeleton);
+}
+
+void BuildJointPalettes( const JointPaletteJob* jobs, uint32_t numJobs )
+{
+    if (numJobs < kMinParallelJobs)
+    {
+        for (uint32_t i = 0; i < numJobs; ++i)
+            BuildJointPalette(jobs[i].meshConstants, jobs[i].jointIndices, jobs[i].jointIBMs, jobs[i].numJoints, jobs[i].skeleton);
+        return;
+    }
+
+    const uint32_t numTasks = (numJobs + kJobsPerTask - 1) / kJobsPerTask;
+    concurrency::parallel_for(0u, numTasks, [&](uint32_t task)
+    {
+        const uint32_t lastJob = std::min(numJobs, (task + 1) * kJobsPerTask);
+        for (uint32_t i = task * kJobsPerTask; i < lastJob; ++i)
+            BuildJointPalette(jobs[i].meshConstants, jobs[i].jointIndices, jobs[i].jointIBMs, jobs[i].numJoints, jobs[i].skeleton);
+    });
+}
+
+void SkinPositions( const uint8_t* depthVertices, uint32_t stride, uint32_t numVertices, const Matrix4* palette,
+    XMFLOAT3* positions, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax )
+{
+    ASSERT(stride >= 28 && stride % 4 == 0, "Not a skinned depth vertex");
+
+    __m128 lo, hi;
+    const uint32_t numTasks = (numVertices + kVerticesPerTask - 1) / kVerticesPerTask;
+    if (numTasks < 2)
+    {
+        SkinRange(depthVertices, stride, 0, numVertices, palette, positions, lo, hi);
+    }
+    else
+    {
+        std::unique_ptr<__m128[]> taskBounds(new __m128[numTasks * 2]);
+        concurrency::parallel_for(0u, numTasks, [&](uint32_t task)
+        {
+            SkinRange(depthVertices, stride, task * kVerticesPerTask, std::min(numVertices, (task + 1) * kVerticesPerTask),
+                palette, positions, taskBounds[task * 2], taskBounds[task * 2 + 1]);
+        });
+
+        lo = taskBounds[0];
+        hi = taskBounds[1];
+        for (uint32_t task = 1; task < numTasks; ++task)
+        {
+            lo = _mm_min_ps(lo, taskBounds[task * 2]);
+            hi = _mm_max_ps(hi, taskBounds[task * 2 + 1]);
+        }
+    }
+
+    __declspec(align(16)) float bounds[2][4];
+    _mm_store_ps(bounds[0], lo);
+    _mm_store_ps(bounds[1], hi);
+    boundsMin = XMFLOAT3(bounds[0][0], bounds[0][1], bounds[0][2]);
+    boundsMax = XMFLOAT3(bounds[1][0], bounds[1][1], bounds[1][2]);
+}
+
+namespace
+{
+    // The loop that ModelInstance::Update used before, kept as the reference for the benchmark
+    void BuildJointPaletteReference( const MeshConstants* meshConstants, const uint16_t* jointIndices,
+        const Matrix4* jointIBMs, uint32_t numJoints, Joint* skeleton )
+    {
+        for (uint32_t i = 0; i < numJoints; ++i)
+        {
+            Joint& joint = skeleton[i];
+            joint.posXform = meshConstants[jointIndices[i]].World * jointIBMs[i];
+            joint.nrmXform = InverseTranspose(joint.posXform.Get3x3());
+        }
+    }
+
+    // DefaultVS one vertex at a time
+    void SkinPositionsReference( const uint8_t* depthVertices, uint32_t stride, uint32_t numVertices,
+        const Matrix4* palette, XMFLOAT3* positions )
+    {
+        for (uint32_t i = 0; i < numVertices; ++i)
+        {
+            const uint8_t* vertex = depthVertices + (size_t)i * stride;
+            const float* position = (const float*)vertex;
+            const uint16_t* indices = (const uint16_t*)(vertex + stride - 16);
+            const uint16_t* weights = indices + 4;
+
+            const float sum = std::max((float)weights[0] + weights[1] + weights[2] + weights[3], 1.0f);
+
+            float skin[16] = {};
+            for (uint32_t k = 0; k < 4; ++k)
+            {
+                const float* m = (const float*)&palette[indices[k]];
+                for (uint32_t e = 0; e < 16; ++e)
+                    skin[e] += m[e] * (weights[k] / sum);
+            }
+
+            float* result = (float*)&positions[i];
+            for (uint32_t c = 0; c < 3; ++c)
+                result[c] = position[0] * skin[c] + position[1] * skin[4 + c] + position[2] * skin[8 + c] + skin[12 + c];
+        }
+    }
+
+    // A rotation with a little non-uniform scale and a translation
+    void RandomTransform( std::mt19937& rng, float* m )
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> scaleDist(0.8f, 1.2f);
+
+        float q[4], lengthSq;
+        do
+        {
+            lengthSq = 0.0f;
+            for (int i = 0; i < 4; ++i)
+            {
+                q[i] = unit(rng);
+                lengthSq += q[i] * q[i];
+            }
+        } while (lengthSq < 0.01f || lengthSq > 1.0f);
+
+        const float s = 2.0f / lengthSq;
+        const float x = q[0], y = q[1], z = q[2], w = q[3];
+        const float rows[3][3] = {
+            { 1.0f - s * (y * y + z * z), s * (x * y + w * z), s * (x * z - w * y) },
+            { s * (x * y - w * z), 1.0f - s * (x * x + z * z), s * (y * z + w * x) },
+            { s * (x * z + w * y), s * (y * z - w * x), 1.0f - s * (x * x + y * y) } };
+
+        for (int r = 0; r < 3; ++r)
+        {
+            const float scale = scaleDist(rng);
+            for (int c = 0; c < 3; ++c)
+                m[r * 4 + c] = rows[r][c] * scale;
+            m[r * 4 + 3] = 0.0f;
+        }
+        m[12] = unit(rng);
+        m[13] = unit(rng);
+        m[14] = unit(rng);
+        m[15] = 1.0f;
+    }
+
+    float RelativeDifference( const float* a, const float* b, uint32_t count )
+    {
+        float largest = 0.0f;
+        for (uint32_t i = 0; i < count; ++i)
+            largest = std::max(largest, std::fabs(a[i] - b[i]) / std::max(1.0f, std::fabs(b[i])));
+        return largest;
+    }
+}
+
+void BenchmarkSkinning( void )
+{
+    const uint32_t kNumJoints = 64;
+    std::mt19937 rng(1234);
+
+    std::unique_ptr<Matrix4[]> jointIBMs(new Matrix4[kNumJoints]);
+    std::vector<uint16_t> jointIndices(kNumJoints);
+    for (uint32_t i = 0; i < kNumJoints; ++i)
+    {
+        RandomTransform(rng, (float*)&jointIBMs[i]);
+        jointIndices[i] = (uint16_t)(i * 37 % kNumJoints);
+    }
+
+    Utility::Printf("Joint palette benchmark (%u joints per instance)\n", kNumJoints);
+
+    const uint32_t instanceCounts[] = { 100, 1000, 4000 };
+    for (uint32_t numInstances : instanceCounts)
+    {
+        // Mesh constants need more alignment than new provides
+        const size_t numNodes = (size_t)numInstances * kNumJoints;
+        std::unique_ptr<__m128[]> meshConstantStorage(new __m128[numNodes * sizeof(MeshConstants) / sizeof(__m128)]());
+        MeshConstants* meshConstants = (MeshConstants*)meshConstantStorage.get();
+        for (size_t n = 0; n < numNodes; ++n)
+            RandomTransform(rng, (float*)&meshConstants[n].World);
+
+        std::unique_ptr<Joint[]> reference(new Joint[numNodes]);
+        std::unique_ptr<Joint[]> skeletons(new Joint[numNodes]);
+
+        std::vector<JointPaletteJob> jobs(numInstances);
+        for (uint32_t i = 0; i < numInstances; ++i)
+        {
+            jobs[i].meshConstants = meshConstants + (size_t)i * kNumJoints;
+            jobs[i].jointIndices = jointIndices.data();
+            jobs[i].jointIBMs = jointIBMs.get();
+            jobs[i].numJoints = kNumJoints;
+            jobs[i].skeleton = skeletons.get() + (size_t)i * kNumJoints;
+        }
+
+        const uint32_t numPasses = std::max(1u, 20000 / numInstances);
+
+        int64_t startTick = SystemTime::GetCurrentTick();
+        for (uint32_t pass = 0; pass < numPasses; ++pass)
+        {
+            for (uint32_t i = 0; i < numInstances; ++i)
+                BuildJointPaletteReference(jobs[i].meshConstants, jointIndices.data(), jointIBMs.get(), kNumJoints,
+                    reference.get() + (size_t)i * kNumJoints);
+        }
+        const double referenceSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / numPasses;
+
+        startTick = SystemTime::GetCurrentTick();
+        for (uint32_t pass = 0; pass < numPasses; ++pass)
+        {
+            for (uint32_t i = 0; i < numInstances; ++i)
+                BuildJointPalette(jobs[i].meshConstants, jointIndices.data(), jointIBMs.get(), kNumJoints, jobs[i].skeleton);
+        }
+        const double batchedSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / numPasses;
+
+        std::memset(skeletons.get(), 0, numNodes * sizeof(Joint));
+        startTick = SystemTime::GetCurrentTick();
+        for (uint32_t pass = 0; pass < numPasses; ++pass)
+            BuildJointPalettes(jobs.data(), numInstances);
+        const double parallelSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / numPasses;
+
+        float maxPosDifference = 0.0f, maxNrmDifference = 0.0f;
+        for (size_t n = 0; n < numNodes; ++n)
+        {
+            maxPosDifference = std::max(maxPosDifference, RelativeDifference((const float*)&skeletons[n].posXform,
+                (const float*)&reference[n].posXform, 16));
+            maxNrmDifference = std::max(maxNrmDifference, RelativeDifference((const float*)&skeletons[n].nrmXform,
+                (const float*)&reference[n].nrmXform, 12));
+        }
+
+        const bool passed = maxPosDifference <= 1e-5f && maxNrmDifference <= 1e-4f;
+        Utility::Printf("  %5u instances:  per joint %7.3f ms   batched %7.3f ms (%4.1fx)   parallel %7.3f ms (%4.1fx)   "
+            "difference %.1e, %.1e   %s\n", numInstances, referenceSeconds * 1000.0, batchedSeconds * 1000.0,
+            referenceSeconds / batchedSeconds, parallelSeconds * 1000.0, referenceSeconds / parallelSeconds,
+            maxPosDifference, maxNrmDifference, passed ? "passed" : "FAILED");
+    }
+
+    Utility::Printf("Skinning benchmark (%u joints, four influences per vertex)\n", kNumJoints);
+
+    std::unique_ptr<Matrix4[]> palette(new Matrix4[kNumJoints]);
+    for (uint32_t i = 0; i < kNumJoints; ++i)
+        RandomTransform(rng, (float*)&palette[i]);
+
+    const uint32_t kStride = 28;    // Position, joint indices, and joint weights
+    const uint32_t vertexCounts[] = { 10000, 100000, 1000000 };
+    for (uint32_t numVertices : vertexCounts)
+    {
+        std::vector<uint8_t> vertices((size_t)numVertices * kStride);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        for (uint32_t i = 0; i < numVertices; ++i)
+        {
+            uint8_t* vertex = vertices.data() + (size_t)i * kStride;
+            float* position = (float*)vertex;
+            uint16_t* indices = (uint16_t*)(vertex + 12);
+            uint16_t* weights = indices + 4;
+
+            position[0] = unit(rng);
+            position[1] = unit(rng);
+            position[2] = unit(rng);
+
+            // Weights that sum to about one, with some influences unused
+            uint32_t remaining = 65535;
+            for (uint32_t k = 0; k < 4; ++k)
+            {
+                indices[k] = (uint16_t)(rng() % kNumJoints);
+                weights[k] = (uint16_t)(k == 3 ? remaining : rng() % (remaining + 1));
+                remaining -= weights[k];
+            }
+        }
+
+        std::vector<XMFLOAT3> reference(numVertices);
+        std::vector<XMFLOAT3> positions(numVertices);
+        const uint32_t numPasses = std::max(1u, 2000000 / numVertices);
+
+        int64_t startTick = SystemTime::GetCurrentTick();
+        for (uint32_t pass = 0; pass < numPasses; ++pass)
+            SkinPositionsReference(vertices.data(), kStride, numVertices, palette.get(), reference.data());
+        const double referenceSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / numPasses;
+
+        XMFLOAT3 boundsMin, boundsMax;
+        startTick = SystemTime::GetCurrentTick();
+        for (uint32_t pass = 0; pass < numPasses; ++pass)
+            SkinPositions(vertices.data(), kStride, numVertices, palette.get(), positions.data(), boundsMin, boundsMax);
+        const double skinSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick()) / numPasses;
+
+        float referenceMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float referenceMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (const XMFLOAT3& p : reference)
+        {
+            const float* v = (const float*)&p;
+            for (int c = 0; c < 3; ++c)
+            {
+                referenceMin[c] = std::min(referenceMin[c], v[c]);
+                referenceMax[c] = std::max(referenceMax[c], v[c]);
+            }
+        }
+
+        const float maxDifference = RelativeDifference((const float*)positions.data(), (const float*)reference.data(),
+            numVertices * 3);
+        const float boundsDifference = std::max(RelativeDifference((const float*)&boundsMin, referenceMin, 3),
+            RelativeDifference((const float*)&boundsMax, referenceMax, 3));
+
+        const bool passed = maxDifference <= 1e-5f && boundsDifference <= 1e-5f;
+        Utility::Printf("  %7u vertices:  per vertex %8.3f ms   SIMD %8.3f ms (%5.1fx, %6.1f M vertices/s)   difference %.1e   %s\n",
+            numVertices, referenceSeconds * 1000.0, skinSeconds * 1000.0, referenceSeconds / skinSeconds,
+            numVertices / skinSeconds * 1e-6, std::max(maxDifference, boundsDifference), passed ? "passed" : "FAILED");
+    }
+}
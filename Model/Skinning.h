@@ -0,0 +1,55 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "../Core/VectorMath.h"
+
+#include <cstdint>
+
+struct Joint;
+struct MeshConstants;
+
+// Fills in a skeleton:  posXform = World * IBM for each joint, where World is the world matrix
+// of the joint's node, and nrmXform is the inverse transpose of its upper 3x3.  Four joints are
+// computed at a time with SSE, and the inverse transpose is taken from the product while it is
+// still in registers.
+void BuildJointPalette( const MeshConstants* meshConstants, const uint16_t* jointIndices, const Math::Matrix4* jointIBMs,
+    uint32_t numJoints, Joint* skeleton );
+
+struct JointPaletteJob
+{
+    const MeshConstants* meshConstants;     // The instance's node transforms
+    const uint16_t* jointIndices;
+    const Math::Matrix4* jointIBMs;
+    uint32_t numJoints;
+    Joint* skeleton;
+};
+
+// Builds the skeletons of many instances, spread across threads when there are enough of them
+void BuildJointPalettes( const JointPaletteJob* jobs, uint32_t numJobs );
+
+// Linear blend skinning of the positions in the depth-only vertex buffer of a skinned mesh,
+// where each vertex is a float3 POSITION, a half2 TEXCOORD when alpha tested, and then uint16x4
+// BLENDINDICES and unorm16x4 BLENDWEIGHT.  As in DefaultVS, the weights are divided by their
+// sum and the weighted sum of joint matrices transforms the position.  Each palette matrix should
+// already include the world matrix of the mesh.  Large meshes are split across threads.
+//
+// Writes one position per vertex and returns their bounds.
+void SkinPositions( const uint8_t* depthVertices, uint32_t stride, uint32_t numVertices, const Math::Matrix4* palette,
+    Math::XMFLOAT3* positions, Math::XMFLOAT3& boundsMin, Math::XMFLOAT3& boundsMax );
+
+// Times BuildJointPalette and BuildJointPalettes against computing one joint at a time, and
+// SkinPositions against a scalar copy of DefaultVS for 10K to 1M vertices, and reports the
+// largest differences.
+void BenchmarkSkinning( void );
@@ -15,14 +15,49 @@
 //
 
 #include "TextureConvert.h"
+#include "AssetCache.h"
 #include "../Core/Utility.h"
 #include "DirectXTex.h"
 
+#include <algorithm>
+
 using namespace DirectX;
 
 #define GetFlag(f) ((Flags & f) != 0)
 
-void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags)
+// A DDS file must have a valid header and be at least as large as the surfaces it describes
+static bool IsCompleteDDSFile(const std::wstring& ddsFile)
+{
+    TexMetadata info;
+    if (FAILED(GetMetadataFromDDSFile(ddsFile.c_str(), DDS_FLAGS_NONE, info)))
+        return false;
+
+    const size_t bitsPerPixel = BitsPerPixel(info.format);
+    const bool compressed = IsCompressed(info.format);
+    if (bitsPerPixel == 0 || !compressed && bitsPerPixel % 8 != 0)
+        return true;    // Packed and planar formats are never written by ConvertToDDS
+
+    size_t surfaceSize = 0;
+    for (size_t mip = 0; mip < info.mipLevels; ++mip)
+    {
+        const size_t width = std::max<size_t>(info.width >> mip, 1);
+        const size_t height = std::max<size_t>(info.height >> mip, 1);
+        const size_t depth = info.IsVolumemap() ? std::max<size_t>(info.depth >> mip, 1) : 1;
+
+        // Block compressed formats store 4x4 blocks of 16 pixels each
+        const size_t sliceSize = compressed ?
+            ((width + 3) / 4) * ((height + 3) / 4) * bitsPerPixel * 2 :
+            width * height * bitsPerPixel / 8;
+        surfaceSize += sliceSize * depth;
+    }
+    surfaceSize *= info.arraySize;
+
+    // The magic number and the smallest header precede the surfaces
+    struct _stat64 fileStat;
+    return _wstat64(ddsFile.c_str(), &fileStat) == 0 && (size_t)fileStat.st_size >= 128 + surfaceSize;
+}
+
+std::wstring CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags)
 {
     std::wstring ddsFile = Utility::RemoveExtension(originalFile) + L".dds";
 
@@ -34,7 +69,29 @@ void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags)
     if (srcFileMissing && ddsFileMissing)
     {
         Utility::Printf("Texture %ws is missing.\n", Utility::RemoveBasePath(originalFile).c_str());
-        return;
+        return ddsFile;
+    }
+
+    // Source DDS files are converted in place, so their content can't key the cache
+    const bool sourceIsDDS = Utility::ToLower(originalFile) == Utility::ToLower(ddsFile);
+
+    uint64_t cacheKey;
+    if (!srcFileMissing && !sourceIsDDS && AssetCache::IsEnabled() &&
+        AssetCache::ComputeKey(originalFile, flags, CURRENT_DDS_CONVERTER_VERSION, cacheKey))
+    {
+        std::wstring cachedFile;
+        if (AssetCache::Find(cacheKey, L".dds", cachedFile))
+        {
+            if (IsCompleteDDSFile(cachedFile))
+                return cachedFile;
+            AssetCache::Reject(cacheKey, L".dds");
+        }
+
+        Utility::Printf("DDS texture %ws not in asset cache.  Rebuilding.\n", Utility::RemoveBasePath(originalFile).c_str());
+        if (ConvertToDDS(originalFile, flags))
+            AssetCache::Store(cacheKey, L".dds", ddsFile);
+
+        return ddsFile;
     }
 
     // If we can find the source texture and the DDS file is older, reconvert.
@@ -43,6 +100,8 @@ void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags)
         Utility::Printf("DDS texture %ws missing or older than source.  Rebuilding.\n", Utility::RemoveBasePath(originalFile).c_str());
         ConvertToDDS(originalFile, flags);
     }
+
+    return ddsFile;
 }
 
 bool ConvertToDDS( const std::wstring& filePath, uint32_t Flags )
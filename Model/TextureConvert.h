@@ -32,8 +32,13 @@ inline uint8_t TextureOptions(bool sRGB, bool hasAlpha=false, bool invertY=false
     return (sRGB ? kSRGB : 0) | (hasAlpha ? kPreserveAlpha : 0) | (invertY ? kFlipVertical : 0);
 }
 
-// If the DDS version of the texture specified does not exist or is older than the source texture, reconvert it.
-void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags);
+// Bump this when ConvertToDDS changes its output so that cached textures are rebuilt
+#define CURRENT_DDS_CONVERTER_VERSION 1
+
+// Returns the path of a DDS file converted from the source texture with these flags.  With the
+// asset cache enabled, the DDS is looked up by the content of the source and only converted on
+// a miss.  Otherwise, the DDS next to the source is reconverted when missing or out of date.
+std::wstring CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags);
 
 // Loads a non-DDS texture such as TGA, PNG, or JPG, then converts it to a more optimal
 // DDS format with a full mip chain.  Resultant file has the same path with the file extension
@@ -0,0 +1,466 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "TransformHierarchy.h"
+#include "Model.h"
+#include "ConstantBuffers.h"
+#include "../Core/Utility.h"
+#include "../Core/SystemTime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ppl.h>
+#include <random>
+
+using namespace Math;
+
+namespace
+{
+    // Slots 0 and 1 hold the parents of top level nodes and skeleton roots.  Real nodes start at
+    // slot 4 so that every level stays 16-byte aligned.
+    const uint32_t kLocatorSlot = 0;
+    const uint32_t kIdentitySlot = 1;
+    const uint32_t kFirstNodeSlot = 4;
+
+    const uint32_t kNoParent = 0xFFFFFFFF;
+    const uint32_t kPaddingNode = 0xFFFFFFFF;
+
+    // Levels with fewer batches than this are cheaper to do on the calling thread
+    const uint32_t kMinParallelBatches = 1024;
+    const uint32_t kBatchesPerTask = 256;
+
+    const float kIdentity[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+
+    struct BatchContext
+    {
+        uint32_t numSlots;
+        float* world;
+        const float* localXforms;
+        const GraphNode* animGraph;
+        const uint32_t* parentSlot;
+        const uint32_t* nodeIdx;
+        const uint32_t* matrixIdx;
+        MeshConstants* meshConstants;
+        ScaleAndTranslation* sphereTransforms;
+    };
+
+    inline __m128 Cross( __m128 ay, __m128 az, __m128 by, __m128 bz )
+    {
+        return _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+    }
+
+    // Transforms four consecutive slots.  The arithmetic mirrors XMMatrixMultiply and
+    // InverseTranspose(Matrix3), just with one node per lane.
+    void UpdateBatch( uint32_t slot, const BatchContext& ctx )
+    {
+        const uint32_t N = ctx.numSlots;
+        const uint32_t* parents = ctx.parentSlot + slot;
+
+        __m128 P[16];
+        for (uint32_t k = 0; k < 16; ++k)
+        {
+            const float* src = ctx.world + k * N;
+            P[k] = _mm_setr_ps(src[parents[0]], src[parents[1]], src[parents[2]], src[parents[3]]);
+        }
+
+        __m128 L[16];
+        if (ctx.animGraph == nullptr)
+        {
+            for (uint32_t k = 0; k < 16; ++k)
+                L[k] = _mm_load_ps(ctx.localXforms + k * N + slot);
+        }
+        else
+        {
+            for (uint32_t r = 0; r < 4; ++r)
+            {
+                __m128 rows[4];
+                for (uint32_t lane = 0; lane < 4; ++lane)
+                {
+                    uint32_t node = ctx.nodeIdx[slot + lane];
+                    const float* local = node == kPaddingNode ? kIdentity : (const float*)&ctx.animGraph[node].xform;
+                    rows[lane] = _mm_loadu_ps(local + r * 4);
+                }
+                _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+                for (uint32_t c = 0; c < 4; ++c)
+                    L[r * 4 + c] = rows[c];
+            }
+        }
+
+        // World = Parent * Local, i.e. each local row is transformed by the parent's rows
+        __m128 W[16];
+        for (uint32_t r = 0; r < 4; ++r)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                __m128 xz = _mm_add_ps(_mm_mul_ps(L[r * 4 + 0], P[0 + c]), _mm_mul_ps(L[r * 4 + 2], P[8 + c]));
+                __m128 yw = _mm_add_ps(_mm_mul_ps(L[r * 4 + 1], P[4 + c]), _mm_mul_ps(L[r * 4 + 3], P[12 + c]));
+                W[r * 4 + c] = _mm_add_ps(xz, yw);
+            }
+        }
+
+        for (uint32_t k = 0; k < 16; ++k)
+            _mm_store_ps(ctx.world + k * N + slot, W[k]);
+
+        // Normal matrix:  the adjoint of the upper 3x3 divided by its determinant
+        const __m128 x[3] = { W[0], W[1], W[2] };
+        const __m128 y[3] = { W[4], W[5], W[6] };
+        const __m128 z[3] = { W[8], W[9], W[10] };
+
+        __m128 inv0[3] = { Cross(y[1], y[2], z[1], z[2]), Cross(y[2], y[0], z[2], z[0]), Cross(y[0], y[1], z[0], z[1]) };
+        __m128 inv1[3] = { Cross(z[1], z[2], x[1], x[2]), Cross(z[2], z[0], x[2], x[0]), Cross(z[0], z[1], x[0], x[1]) };
+        __m128 inv2[3] = { Cross(x[1], x[2], y[1], y[2]), Cross(x[2], x[0], y[2], y[0]), Cross(x[0], x[1], y[0], y[1]) };
+
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(z[0], inv2[0]), _mm_mul_ps(z[1], inv2[1])), _mm_mul_ps(z[2], inv2[2]));
+        __m128 rDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        // Bounding sphere scale:  the length of the longest axis
+        auto LengthSq = [](const __m128* v) {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(v[0], v[0]), _mm_mul_ps(v[1], v[1])), _mm_mul_ps(v[2], v[2])); };
+        __m128 scale = _mm_sqrt_ps(_mm_max_ps(_mm_max_ps(LengthSq(x), LengthSq(y)), LengthSq(z)));
+
+        // Back to one node per register
+        __m128 worldRows[4][4];
+        for (uint32_t r = 0; r < 4; ++r)
+        {
+            worldRows[r][0] = W[r * 4 + 0];
+            worldRows[r][1] = W[r * 4 + 1];
+            worldRows[r][2] = W[r * 4 + 2];
+            worldRows[r][3] = W[r * 4 + 3];
+            _MM_TRANSPOSE4_PS(worldRows[r][0], worldRows[r][1], worldRows[r][2], worldRows[r][3]);
+        }
+
+        const __m128* invRows[3] = { inv0, inv1, inv2 };
+        __m128 normalRows[3][4];
+        for (uint32_t r = 0; r < 3; ++r)
+        {
+            normalRows[r][0] = _mm_mul_ps(invRows[r][0], rDet);
+            normalRows[r][1] = _mm_mul_ps(invRows[r][1], rDet);
+            normalRows[r][2] = _mm_mul_ps(invRows[r][2], rDet);
+            normalRows[r][3] = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(normalRows[r][0], normalRows[r][1], normalRows[r][2], normalRows[r][3]);
+        }
+
+        __m128 spheres[4] = { W[12], W[13], W[14], scale };
+        _MM_TRANSPOSE4_PS(spheres[0], spheres[1], spheres[2], spheres[3]);
+
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            uint32_t matrixIdx = ctx.matrixIdx[slot + lane];
+            if (matrixIdx == kPaddingNode)
+                continue;
+
+            float* world = (float*)&ctx.meshConstants[matrixIdx].World;
+            float* worldIT = (float*)&ctx.meshConstants[matrixIdx].WorldIT;
+            for (uint32_t r = 0; r < 4; ++r)
+                _mm_store_ps(world + r * 4, worldRows[r][lane]);
+            for (uint32_t r = 0; r < 3; ++r)
+                _mm_store_ps(worldIT + r * 4, normalRows[r][lane]);
+            _mm_store_ps((float*)&ctx.sphereTransforms[matrixIdx], spheres[lane]);
+        }
+    }
+
+    // The depth first walk that ModelInstance::Update used before, with an unbounded stack.
+    // Kept as the reference for the benchmark.
+    void UpdateDepthFirst( const GraphNode* sceneGraph, const Matrix4& rootXform,
+        MeshConstants* meshConstants, ScaleAndTranslation* sphereTransforms )
+    {
+        std::vector<Matrix4> matrixStack;
+        Matrix4 ParentMatrix = rootXform;
+
+        for (const GraphNode* Node = sceneGraph; ; ++Node)
+        {
+            Matrix4 xform = Node->xform;
+            if (!Node->skeletonRoot)
+                xform = ParentMatrix * xform;
+
+            MeshConstants& cbv = meshConstants[Node->matrixIdx];
+            cbv.World = xform;
+            cbv.WorldIT = InverseTranspose(xform.Get3x3());
+
+            Scalar scaleXSqr = LengthSquare((Vector3)xform.GetX());
+            Scalar scaleYSqr = LengthSquare((Vector3)xform.GetY());
+            Scalar scaleZSqr = LengthSquare((Vector3)xform.GetZ());
+            Scalar sphereScale = Sqrt(Max(Max(scaleXSqr, scaleYSqr), scaleZSqr));
+            sphereTransforms[Node->matrixIdx] = ScaleAndTranslation((Vector3)xform.GetW(), sphereScale);
+
+            if (Node->hasChildren)
+            {
+                if (Node->hasSibling)
+                    matrixStack.push_back(ParentMatrix);
+                ParentMatrix = xform;
+            }
+            else if (!Node->hasSibling)
+            {
+                if (matrixStack.empty())
+                    break;
+
+                ParentMatrix = matrixStack.back();
+                matrixStack.pop_back();
+            }
+        }
+    }
+}
+
+void TransformHierarchy::Create( const GraphNode* sceneGraph, uint32_t numNodes )
+{
+    Destroy();
+
+    if (numNodes == 0)
+        return;
+
+    // Walk the depth first flags exactly like the matrix stack traversal did
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> depths;
+    std::vector<uint32_t> stack;
+    uint32_t curParent = kNoParent;
+    uint32_t numLevels = 0;
+
+    parents.reserve(numNodes);
+    depths.reserve(numNodes);
+
+    for (uint32_t i = 0; i < numNodes; ++i)
+    {
+        const GraphNode& node = sceneGraph[i];
+        const uint32_t depth = curParent == kNoParent ? 0 : depths[curParent] + 1;
+        parents.push_back(curParent);
+        depths.push_back(depth);
+        numLevels = std::max(numLevels, depth + 1);
+
+        if (node.hasChildren)
+        {
+            if (node.hasSibling)
+                stack.push_back(curParent);
+            curParent = i;
+        }
+        else if (!node.hasSibling)
+        {
+            if (stack.empty())
+                break;
+
+            curParent = stack.back();
+            stack.pop_back();
+        }
+    }
+
+    m_NumNodes = (uint32_t)parents.size();
+
+    // Pad every level to whole batches
+    std::vector<uint32_t> levelCounts(numLevels, 0);
+    for (uint32_t depth : depths)
+        ++levelCounts[depth];
+
+    m_LevelStart.resize(numLevels + 1);
+    m_LevelStart[0] = kFirstNodeSlot;
+    for (uint32_t level = 0; level < numLevels; ++level)
+        m_LevelStart[level + 1] = m_LevelStart[level] + Math::AlignUp(levelCounts[level], 4);
+    m_NumSlots = m_LevelStart[numLevels];
+
+    m_ParentSlot.assign(m_NumSlots, kIdentitySlot);
+    m_NodeIdx.assign(m_NumSlots, kPaddingNode);
+    m_MatrixIdx.assign(m_NumSlots, kPaddingNode);
+    m_LocalXforms.resize(16 * m_NumSlots);
+    for (uint32_t k = 0; k < 16; ++k)
+        std::fill(m_LocalXforms.begin() + k * m_NumSlots, m_LocalXforms.begin() + (k + 1) * m_NumSlots, kIdentity[k]);
+
+    // Within a level, nodes keep their depth first order, which keeps siblings together and
+    // parents ascending
+    std::vector<uint32_t> nodeSlots(m_NumNodes);
+    std::vector<uint32_t> levelFill(m_LevelStart.begin(), m_LevelStart.end() - 1);
+    for (uint32_t i = 0; i < m_NumNodes; ++i)
+    {
+        const GraphNode& node = sceneGraph[i];
+        const uint32_t slot = levelFill[depths[i]]++;
+        nodeSlots[i] = slot;
+
+        if (node.skeletonRoot)
+            m_ParentSlot[slot] = kIdentitySlot;
+        else if (parents[i] == kNoParent)
+            m_ParentSlot[slot] = kLocatorSlot;
+        else
+            m_ParentSlot[slot] = nodeSlots[parents[i]];
+
+        m_NodeIdx[slot] = i;
+        m_MatrixIdx[slot] = node.matrixIdx;
+
+        const float* local = (const float*)&node.xform;
+        for (uint32_t k = 0; k < 16; ++k)
+            m_LocalXforms[k * m_NumSlots + slot] = local[k];
+    }
+}
+
+void TransformHierarchy::Destroy( void )
+{
+    m_NumNodes = 0;
+    m_NumSlots = 0;
+    m_LevelStart.clear();
+    m_ParentSlot.clear();
+    m_NodeIdx.clear();
+    m_MatrixIdx.clear();
+    m_LocalXforms.clear();
+}
+
+void TransformHierarchy::Update( const Matrix4& rootXform, const GraphNode* animGraph, Workspace& workspace,
+    MeshConstants* meshConstants, ScaleAndTranslation* sphereTransforms ) const
+{
+    if (m_NumNodes == 0)
+        return;
+
+    workspace.resize(16 * m_NumSlots);
+
+    // The virtual parents
+    const float* root = (const float*)&rootXform;
+    for (uint32_t k = 0; k < 16; ++k)
+    {
+        workspace[k * m_NumSlots + kLocatorSlot] = root[k];
+        workspace[k * m_NumSlots + kIdentitySlot] = kIdentity[k];
+    }
+
+    BatchContext ctx;
+    ctx.numSlots = m_NumSlots;
+    ctx.world = workspace.data();
+    ctx.localXforms = m_LocalXforms.data();
+    ctx.animGraph = animGraph;
+    ctx.parentSlot = m_ParentSlot.data();
+    ctx.nodeIdx = m_NodeIdx.data();
+    ctx.matrixIdx = m_MatrixIdx.data();
+    ctx.meshConstants = meshConstants;
+    ctx.sphereTransforms = sphereTransforms;
+
+    for (uint32_t level = 0; level < GetNumLevels(); ++level)
+    {
+        const uint32_t firstSlot = m_LevelStart[level];
+        const uint32_t numBatches = (m_LevelStart[level + 1] - firstSlot) / 4;
+
+        if (numBatches < kMinParallelBatches)
+        {
+            for (uint32_t b = 0; b < numBatches; ++b)
+                UpdateBatch(firstSlot + b * 4, ctx);
+        }
+        else
+        {
+            const uint32_t numTasks = (numBatches + kBatchesPerTask - 1) / kBatchesPerTask;
+            concurrency::parallel_for(0u, numTasks, [&](uint32_t task)
+            {
+                const uint32_t lastBatch = std::min(numBatches, (task + 1) * kBatchesPerTask);
+                for (uint32_t b = task * kBatchesPerTask; b < lastBatch; ++b)
+                    UpdateBatch(firstSlot + b * 4, ctx);
+            });
+        }
+    }
+}
+
+void BenchmarkTransformHierarchy( void )
+{
+    const char* shapeNames[] = { "bushy", "chains" };
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scaleDist(0.98f, 1.02f);
+
+    Utility::Printf("Transform hierarchy benchmark\n");
+
+    for (uint32_t numNodes = 10000; numNodes <= 1000000; numNodes *= 10)
+    {
+        for (uint32_t shape = 0; shape < _countof(shapeNames); ++shape)
+        {
+            // Random tree where each node's parent precedes it.  Chains mostly extend the
+            // previous node, which makes the tree a few hundred levels deep.
+            std::vector<uint32_t> parents(numNodes, kNoParent);
+            for (uint32_t i = 1; i < numNodes; ++i)
+            {
+                if (shape == 0 || rng() % 8 == 0)
+                    parents[i] = rng() % i;
+                else
+                    parents[i] = i - 1;
+            }
+
+            std::vector<std::vector<uint32_t>> children(numNodes);
+            for (uint32_t i = 1; i < numNodes; ++i)
+                children[parents[i]].push_back(i);
+
+            // Flatten in depth first order with sibling and child flags
+            std::vector<GraphNode> sceneGraph(numNodes);
+            std::vector<uint32_t> stack(1, 0);
+            uint32_t numEmitted = 0;
+            while (!stack.empty())
+            {
+                uint32_t n = stack.back();
+                stack.pop_back();
+
+                GraphNode& node = sceneGraph[numEmitted];
+                std::memset(&node, 0, sizeof(GraphNode));
+                node.matrixIdx = numEmitted++;
+                node.hasChildren = children[n].empty() ? 0 : 1;
+                node.hasSibling = n != 0 && children[parents[n]].back() != n ? 1 : 0;
+                node.rotation = Quaternion(Normalize(Vector3(unit(rng), unit(rng), unit(rng))), Scalar(unit(rng) * XM_PI));
+                node.xform = Matrix4(AffineTransform(Matrix3(node.rotation) * Matrix3::MakeScale(scaleDist(rng)),
+                    Vector3(unit(rng), unit(rng), unit(rng))));
+
+                for (auto it = children[n].rbegin(); it != children[n].rend(); ++it)
+                    stack.push_back(*it);
+            }
+
+            TransformHierarchy hierarchy;
+            int64_t startTick = SystemTime::GetCurrentTick();
+            hierarchy.Create(sceneGraph.data(), numNodes);
+            double createSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            const size_t cbVectors = numNodes * sizeof(MeshConstants) / sizeof(__m128);
+            std::unique_ptr<__m128[]> referenceCB(new __m128[cbVectors]());
+            std::unique_ptr<__m128[]> referenceSpheres(new __m128[numNodes]());
+            std::unique_ptr<__m128[]> levelCB(new __m128[cbVectors]());
+            std::unique_ptr<__m128[]> levelSpheres(new __m128[numNodes]());
+            TransformHierarchy::Workspace workspace;
+
+            const Matrix4 rootXform(AffineTransform(Matrix3::MakeScale(2.0f), Vector3(10.0f, 0.0f, -5.0f)));
+
+            startTick = SystemTime::GetCurrentTick();
+            UpdateDepthFirst(sceneGraph.data(), rootXform, (MeshConstants*)referenceCB.get(),
+                (ScaleAndTranslation*)referenceSpheres.get());
+            double depthFirstSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            // Once to size the workspace, then timed
+            hierarchy.Update(rootXform, nullptr, workspace, (MeshConstants*)levelCB.get(), (ScaleAndTranslation*)levelSpheres.get());
+            startTick = SystemTime::GetCurrentTick();
+            hierarchy.Update(rootXform, nullptr, workspace, (MeshConstants*)levelCB.get(), (ScaleAndTranslation*)levelSpheres.get());
+            double levelSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            startTick = SystemTime::GetCurrentTick();
+            hierarchy.Update(rootXform, sceneGraph.data(), workspace, (MeshConstants*)levelCB.get(), (ScaleAndTranslation*)levelSpheres.get());
+            double animatedSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            // Relative difference, ignoring the padding lanes of MeshConstants
+            float maxError = 0.0f;
+            for (uint32_t i = 0; i < numNodes; ++i)
+            {
+                const float* a = (const float*)&((const MeshConstants*)referenceCB.get())[i];
+                const float* b = (const float*)&((const MeshConstants*)levelCB.get())[i];
+                for (uint32_t k = 0; k < 16 + 12; ++k)
+                {
+                    if (k >= 16 && (k - 16) % 4 == 3)
+                        continue;
+                    maxError = std::max(maxError, std::fabs(a[k] - b[k]) / std::max(1.0f, std::fabs(a[k])));
+                }
+                const float* sa = (const float*)&referenceSpheres[i];
+                const float* sb = (const float*)&levelSpheres[i];
+                for (uint32_t k = 0; k < 4; ++k)
+                    maxError = std::max(maxError, std::fabs(sa[k] - sb[k]) / std::max(1.0f, std::fabs(sa[k])));
+            }
+
+            Utility::Printf("  %7u nodes, %-6s %4u levels:  create %8.3f ms  depth first %8.3f ms  "
+                "by level %8.3f ms (%.2fx, animated %8.3f ms)  max error %g\n", numNodes, shapeNames[shape],
+                hierarchy.GetNumLevels(), createSeconds * 1000.0, depthFirstSeconds * 1000.0, levelSeconds * 1000.0,
+                depthFirstSeconds / levelSeconds, animatedSeconds * 1000.0, maxError);
+        }
+    }
+}
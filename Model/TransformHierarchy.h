@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "../Core/Math/Matrix4.h"
+#include "../Core/Math/Transform.h"
+
+#include <cstdint>
+#include <vector>
+
+struct GraphNode;
+struct MeshConstants;
+
+// The scene graph reordered by depth so that every node of a level can be transformed at once
+// after the level above it is done.  There is no limit on depth.  Each level is padded to a
+// multiple of four nodes so that it can be processed in SSE batches, and matrices are stored
+// in SoA form (one array per matrix element) with one slot per node.
+class TransformHierarchy
+{
+public:
+    // World matrices of one instance in SoA form.  Update sizes it as needed.
+    typedef std::vector<float> Workspace;
+
+    TransformHierarchy() : m_NumNodes(0), m_NumSlots(0) {}
+
+    // Recovers the parent of each node from the depth first sibling and child flags
+    void Create( const GraphNode* sceneGraph, uint32_t numNodes );
+    void Destroy( void );
+
+    uint32_t GetNumLevels( void ) const { return m_LevelStart.empty() ? 0 : (uint32_t)m_LevelStart.size() - 1; }
+
+    // Computes the world matrix, normal matrix, and bounding sphere transform of every node and
+    // writes them at the node's matrixIdx.  Outputs should be cacheable memory; copy them to
+    // upload heaps in bulk afterwards.  Local transforms come from animGraph when it is given
+    // (an animated copy of the scene graph), otherwise from the scene graph passed to Create.
+    // Large levels are split across worker threads.
+    void Update( const Math::Matrix4& rootXform, const GraphNode* animGraph, Workspace& workspace,
+        MeshConstants* meshConstants, Math::ScaleAndTranslation* sphereTransforms ) const;
+
+private:
+    uint32_t m_NumNodes;                    // Nodes reachable by the depth first walk
+    uint32_t m_NumSlots;                    // Including padding and the two virtual parents
+    std::vector<uint32_t> m_LevelStart;     // First slot of each level, plus the end
+    std::vector<uint32_t> m_ParentSlot;     // Slot holding each slot's parent world matrix
+    std::vector<uint32_t> m_NodeIdx;        // Scene graph node of each slot
+    std::vector<uint32_t> m_MatrixIdx;      // Output index of each slot
+    std::vector<float> m_LocalXforms;       // SoA local matrices from the scene graph
+};
+
+// Times the level ordered update against the depth first walk on synthetic hierarchies of 10K
+// to 1M nodes and reports the largest difference between them.
+void BenchmarkTransformHierarchy( void );
@@ -0,0 +1,242 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "VertexDeduplicate.h"
+#include "../Core/Utility.h"
+#include "../Core/Hash.h"
+#include "../Core/SystemTime.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const uint32_t kEmptySlot = 0xFFFFFFFF;
+
+    struct HashSlot
+    {
+        uint32_t hash;
+        uint32_t vertex;
+    };
+
+    // Hashes one vertex a qword at a time.  Vertices are rarely 8-byte aligned, so the loads go
+    // through memcpy which compiles to a plain unaligned mov.
+    inline uint32_t HashVertex( const uint8_t* data, uint32_t stride )
+    {
+        uint32_t i = 0;
+#if ENABLE_SSE_CRC32
+        uint64_t hash = 2166136261U;
+        for (; i + 8 <= stride; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            hash = _mm_crc32_u64(hash, word);
+        }
+        uint32_t hash32 = (uint32_t)hash;
+        if (i + 4 <= stride)
+        {
+            uint32_t word;
+            memcpy(&word, data + i, 4);
+            hash32 = _mm_crc32_u32(hash32, word);
+            i += 4;
+        }
+        for (; i < stride; ++i)
+            hash32 = _mm_crc32_u8(hash32, data[i]);
+#else
+        uint32_t hash32 = 2166136261U;
+        for (; i < stride; ++i)
+            hash32 = (hash32 ^ data[i]) * 16777619U;
+#endif
+        // Finalize so that the low bits used to pick a bucket depend on every input bit
+        hash32 ^= hash32 >> 16;
+        hash32 *= 0x85EBCA6B;
+        hash32 ^= hash32 >> 13;
+        return hash32;
+    }
+
+    // The original pairwise scan, kept as the reference for the benchmark
+    uint32_t DeduplicateVerticesQuadratic( const uint8_t* vertexData, uint32_t vertexCount, uint32_t vertexStride, uint32_t* vertexRemap )
+    {
+        memset(vertexRemap, 0xFF, sizeof(uint32_t) * vertexCount);
+
+        uint32_t uniqueCount = 0;
+        for (uint32_t v1 = 0; v1 < vertexCount; ++v1)
+        {
+            if (vertexRemap[v1] != kEmptySlot)
+                continue;
+
+            const uint8_t* v1Data = vertexData + (size_t)v1 * vertexStride;
+            vertexRemap[v1] = uniqueCount;
+
+            for (uint32_t v2 = v1 + 1; v2 < vertexCount; ++v2)
+            {
+                if (vertexRemap[v2] == kEmptySlot && memcmp(v1Data, vertexData + (size_t)v2 * vertexStride, vertexStride) == 0)
+                    vertexRemap[v2] = uniqueCount;
+            }
+
+            ++uniqueCount;
+        }
+        return uniqueCount;
+    }
+}
+
+uint32_t DeduplicateVertices( const void* vertexData, uint32_t vertexCount, uint32_t vertexStride, uint32_t* vertexRemap )
+{
+    ASSERT(vertexStride > 0);
+
+    if (vertexCount == 0)
+        return 0;
+
+    // Keep the load factor under 2/3 so linear probe chains stay short
+    size_t tableSize = 16;
+    while (tableSize < (size_t)vertexCount + vertexCount / 2)
+        tableSize *= 2;
+    const size_t tableMask = tableSize - 1;
+
+    std::vector<HashSlot> table(tableSize, HashSlot{ 0, kEmptySlot });
+
+    const uint8_t* vertices = (const uint8_t*)vertexData;
+    uint32_t uniqueCount = 0;
+
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        const uint8_t* data = vertices + (size_t)v * vertexStride;
+        const uint32_t hash = HashVertex(data, vertexStride);
+
+        for (size_t s = hash & tableMask; ; s = (s + 1) & tableMask)
+        {
+            HashSlot& slot = table[s];
+            if (slot.vertex == kEmptySlot)
+            {
+                slot.hash = hash;
+                slot.vertex = v;
+                vertexRemap[v] = uniqueCount++;
+                break;
+            }
+            if (slot.hash == hash && memcmp(vertices + (size_t)slot.vertex * vertexStride, data, vertexStride) == 0)
+            {
+                vertexRemap[v] = vertexRemap[slot.vertex];
+                break;
+            }
+        }
+    }
+
+    return uniqueCount;
+}
+
+uint32_t CompactVertices( void* vertexData, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* vertexRemap )
+{
+    uint8_t* vertices = (uint8_t*)vertexData;
+    uint32_t nextSlot = 0;
+
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        // Duplicates always map to an earlier slot, so only first occurrences match here
+        if (vertexRemap[v] != nextSlot)
+            continue;
+
+        if (nextSlot != v)
+            memcpy(vertices + (size_t)nextSlot * vertexStride, vertices + (size_t)v * vertexStride, vertexStride);
+        ++nextSlot;
+    }
+
+    return nextSlot;
+}
+
+uint32_t OptimizeVertexFetch( const void* indexList, bool index32, size_t indexCount, uint32_t vertexCount, uint32_t* vertexRemap )
+{
+    memset(vertexRemap, 0xFF, sizeof(uint32_t) * vertexCount);
+
+    uint32_t nextSlot = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t v = index32 ? ((const uint32_t*)indexList)[i] : ((const uint16_t*)indexList)[i];
+        ASSERT(v < vertexCount);
+        if (vertexRemap[v] == kEmptySlot)
+            vertexRemap[v] = nextSlot++;
+    }
+
+    return nextSlot;
+}
+
+void PermuteVertices( void* vertexData, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* vertexRemap )
+{
+    uint8_t* vertices = (uint8_t*)vertexData;
+    std::vector<uint8_t> original(vertices, vertices + (size_t)vertexCount * vertexStride);
+
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        if (vertexRemap[v] != kEmptySlot)
+            memcpy(vertices + (size_t)vertexRemap[v] * vertexStride, original.data() + (size_t)v * vertexStride, vertexStride);
+    }
+}
+
+void BenchmarkVertexDeduplication( void )
+{
+    // Roughly what a position/normal/tangent/UV vertex compresses to
+    struct SyntheticVertex
+    {
+        float position[3];
+        uint32_t normal;
+        uint32_t tangent;
+        uint16_t texcoord[2];
+    };
+
+    // The quadratic scan takes minutes beyond this
+    const uint32_t kMaxReferenceCount = 20000;
+
+    Utility::Printf("Vertex deduplication benchmark (%u byte stride)\n", (uint32_t)sizeof(SyntheticVertex));
+
+    for (uint32_t vertexCount = 10000; vertexCount <= 10000000; vertexCount *= 10)
+    {
+        // Flattened meshes typically repeat each vertex a few times.  Scatter the repeats so
+        // that duplicates are not adjacent.
+        const uint32_t uniqueTarget = vertexCount / 3;
+        std::vector<SyntheticVertex> vertices(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; ++v)
+        {
+            uint32_t id = (uint32_t)(((uint64_t)v * 2654435761U) % uniqueTarget);
+            SyntheticVertex& vert = vertices[v];
+            vert.position[0] = (float)(id % 1024);
+            vert.position[1] = (float)((id / 1024) % 1024);
+            vert.position[2] = (float)(id / (1024 * 1024));
+            vert.normal = id * 0x9E3779B9;
+            vert.tangent = ~id;
+            vert.texcoord[0] = (uint16_t)id;
+            vert.texcoord[1] = (uint16_t)(id >> 16);
+        }
+
+        std::vector<uint32_t> remap(vertexCount);
+
+        int64_t startTick = SystemTime::GetCurrentTick();
+        uint32_t uniqueCount = DeduplicateVertices(vertices.data(), vertexCount, sizeof(SyntheticVertex), remap.data());
+        double seconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+        Utility::Printf("  %9u vertices:  %9.3f ms  %8.1f Mverts/s  %u unique", vertexCount, seconds * 1000.0,
+            vertexCount / seconds / 1000000.0, uniqueCount);
+
+        if (vertexCount <= kMaxReferenceCount)
+        {
+            std::vector<uint32_t> referenceRemap(vertexCount);
+            startTick = SystemTime::GetCurrentTick();
+            uint32_t referenceCount = DeduplicateVerticesQuadratic((const uint8_t*)vertices.data(), vertexCount,
+                sizeof(SyntheticVertex), referenceRemap.data());
+            double referenceSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+
+            bool identical = referenceCount == uniqueCount && referenceRemap == remap;
+            Utility::Printf("  (quadratic %9.3f ms, %s)", referenceSeconds * 1000.0, identical ? "identical" : "MISMATCH");
+        }
+
+        Utility::Print("\n");
+    }
+}
@@ -0,0 +1,65 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+//-----------------------------------------------------------------------------
+//  DeduplicateVertices
+//-----------------------------------------------------------------------------
+//  Finds vertices that are bit-for-bit identical using a hash table keyed on
+//  the raw vertex bytes.  Runs in expected linear time.
+//
+//  Parameters:
+//      vertexData
+//          interleaved vertices, vertexStride bytes apart (no alignment needed)
+//      vertexCount
+//          the number of vertices
+//      vertexStride
+//          the size of one vertex in bytes
+//      vertexRemap
+//          a preallocated array of vertexCount entries.  Receives the new
+//          index of each vertex.  Unique vertices are numbered in order of
+//          their first appearance, and duplicates map to the first copy,
+//          which is exactly what a pairwise memcmp scan produces.
+//
+//  Returns the number of unique vertices.
+//-----------------------------------------------------------------------------
+uint32_t DeduplicateVertices(const void* vertexData, uint32_t vertexCount, uint32_t vertexStride, uint32_t* vertexRemap);
+
+// Moves each unique vertex to its remapped slot.  Works in place because a slot is never
+// greater than the index of the vertex that first claimed it.  Returns the unique count.
+uint32_t CompactVertices(void* vertexData, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* vertexRemap);
+
+// Rewrites an index list through a vertex remap table
+template <typename IndexType>
+void RemapIndices(IndexType* indexList, size_t indexCount, const uint32_t* vertexRemap)
+{
+    for (size_t i = 0; i < indexCount; ++i)
+        indexList[i] = (IndexType)vertexRemap[indexList[i]];
+}
+
+// Renumbers vertices in the order the index list first references them, so that vertex fetch
+// walks the buffer mostly forward.  Unreferenced vertices are remapped to 0xFFFFFFFF and dropped.
+// Returns the number of referenced vertices.
+uint32_t OptimizeVertexFetch(const void* indexList, bool index32, size_t indexCount, uint32_t vertexCount, uint32_t* vertexRemap);
+
+// Moves every vertex to its remapped slot (dropping those remapped to 0xFFFFFFFF).  Unlike
+// CompactVertices, this handles any permutation, at the cost of a temporary copy.
+void PermuteVertices(void* vertexData, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* vertexRemap);
+
+// Times DeduplicateVertices on synthetic meshes from 10K to 10M vertices and checks the
+// result against the quadratic scan where that is still affordable.
+void BenchmarkVertexDeduplication(void);
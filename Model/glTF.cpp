@@ -19,8 +19,17 @@
 #include "../Core/GraphicsCore.h"
 #include "../Core/FileUtility.h"
 
+#include "../Core/SystemTime.h"
+
+#include <psapi.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <thread>
 
 using namespace glTF;
 using namespace Graphics;
@@ -746,16 +755,19 @@ void glTF::Asset::Parse(const std::wstring& filepath)
         chunk1Bin = make_shared<vector<byte>>(0);
     }
 
-    json root = json::parse((const char*)gltfFile->data());
-    if (!root.is_object())
-    {
-        Printf("Invalid glTF file: %s\n", filepath.c_str());
-        return;
-    }
-
     // Strip off file name to get root path to other related files
     m_basePath = Utility::GetBasePath(filepath);
 
+    if (!ParseJSON((const char*)gltfFile->data(), gltfFile->size() - 1, chunk1Bin))
+        Printf("Invalid glTF file: %ws\n", filepath.c_str());
+}
+
+bool glTF::Asset::ParseJSONDocument(const char* text, size_t length, ByteArray chunk1Bin)
+{
+    json root = json::parse(text, text + length);
+    if (!root.is_object())
+        return false;
+
     // Parse all state
 
     if (root.find("buffers") != root.end())
@@ -788,4 +800,1444 @@ void glTF::Asset::Parse(const std::wstring& filepath)
         ProcessAnimations(root.at("animations"));
     if (root.find("scene") != root.end())
         m_scene = &m_scenes[root.at("scene")];
+
+    return true;
+}
+
+namespace
+{
+    // Keys the streaming parser acts on.  Anything else, such as names, extras, and extensions,
+    // is skipped along with its value.  The attribute keys are in the order of eAttribType.
+    enum eKey : uint8_t
+    {
+        kUnknownKey,
+        kAttribPosition, kAttribNormal, kAttribTangent, kAttribTexcoord0, kAttribTexcoord1,
+        kAttribColor0, kAttribJoints0, kAttribWeights0,
+        kAccessors, kAlphaCutoff, kAlphaMode, kAnimations, kAspectRatio, kAttributes,
+        kBaseColorFactor, kBaseColorTexture, kBuffer, kBufferView, kBufferViews, kBuffers,
+        kByteLength, kByteOffset, kByteStride, kCamera, kCameras, kChannels, kChildren,
+        kComponentType, kCount, kDoubleSided, kEmissiveFactor, kEmissiveTexture, kImages,
+        kIndex, kIndices, kInput, kInterpolation, kInverseBindMatrices, kJoints, kMaterial,
+        kMaterials, kMatrix, kMax, kMesh, kMeshes, kMetallicFactor, kMetallicRoughnessTexture,
+        kMimeType, kMin, kMode, kNode, kNodes, kNormalTexture, kNormalTextureScale,
+        kOcclusionTexture, kOrthographic, kOutput, kPath, kPbrMetallicRoughness, kPerspective,
+        kPrimitives, kRotation, kRoughnessFactor, kSampler, kSamplers, kScale, kScene, kScenes,
+        kSkeleton, kSkin, kSkins, kSource, kTarget, kTexCoord, kTextures, kTranslation, kType,
+        kUri, kWrapS, kWrapT, kXmag, kYfov, kYmag, kZfar, kZnear
+    };
+
+    class KeyTable
+    {
+    public:
+        KeyTable()
+        {
+            static const Entry kKeys[] =
+            {
+                { "POSITION", kAttribPosition }, { "NORMAL", kAttribNormal }, { "TANGENT", kAttribTangent },
+                { "TEXCOORD_0", kAttribTexcoord0 }, { "TEXCOORD_1", kAttribTexcoord1 }, { "COLOR_0", kAttribColor0 },
+                { "JOINTS_0", kAttribJoints0 }, { "WEIGHTS_0", kAttribWeights0 },
+                { "accessors", kAccessors }, { "alphaCutoff", kAlphaCutoff }, { "alphaMode", kAlphaMode },
+                { "animations", kAnimations }, { "aspectRatio", kAspectRatio }, { "attributes", kAttributes },
+                { "baseColorFactor", kBaseColorFactor }, { "baseColorTexture", kBaseColorTexture },
+                { "buffer", kBuffer }, { "bufferView", kBufferView }, { "bufferViews", kBufferViews },
+                { "buffers", kBuffers }, { "byteLength", kByteLength }, { "byteOffset", kByteOffset },
+                { "byteStride", kByteStride }, { "camera", kCamera }, { "cameras", kCameras },
+                { "channels", kChannels }, { "children", kChildren }, { "componentType", kComponentType },
+                { "count", kCount }, { "doubleSided", kDoubleSided }, { "emissiveFactor", kEmissiveFactor },
+                { "emissiveTexture", kEmissiveTexture }, { "images", kImages }, { "index", kIndex },
+                { "indices", kIndices }, { "input", kInput }, { "interpolation", kInterpolation },
+                { "inverseBindMatrices", kInverseBindMatrices }, { "joints", kJoints }, { "material", kMaterial },
+                { "materials", kMaterials }, { "matrix", kMatrix }, { "max", kMax }, { "mesh", kMesh },
+                { "meshes", kMeshes }, { "metallicFactor", kMetallicFactor },
+                { "metallicRoughnessTexture", kMetallicRoughnessTexture }, { "mimeType", kMimeType },
+                { "min", kMin }, { "mode", kMode }, { "node", kNode }, { "nodes", kNodes },
+                { "normalTexture", kNormalTexture }, { "normalTextureScale", kNormalTextureScale },
+                { "occlusionTexture", kOcclusionTexture }, { "orthographic", kOrthographic },
+                { "output", kOutput }, { "path", kPath }, { "pbrMetallicRoughness", kPbrMetallicRoughness },
+                { "perspective", kPerspective }, { "primitives", kPrimitives }, { "rotation", kRotation },
+                { "roughnessFactor", kRoughnessFactor }, { "sampler", kSampler }, { "samplers", kSamplers },
+                { "scale", kScale }, { "scene", kScene }, { "scenes", kScenes }, { "skeleton", kSkeleton },
+                { "skin", kSkin }, { "skins", kSkins }, { "source", kSource }, { "target", kTarget },
+                { "texCoord", kTexCoord }, { "textures", kTextures }, { "translation", kTranslation },
+                { "type", kType }, { "uri", kUri }, { "wrapS", kWrapS }, { "wrapT", kWrapT },
+                { "xmag", kXmag }, { "yfov", kYfov }, { "ymag", kYmag }, { "zfar", kZfar }, { "znear", kZnear },
+            };
+
+            m_Entries.assign(std::begin(kKeys), std::end(kKeys));
+            std::sort(m_Entries.begin(), m_Entries.end(), Less);
+        }
+
+        eKey Find( const std::string& name ) const
+        {
+            const Entry probe = { name.c_str(), kUnknownKey };
+            auto it = std::lower_bound(m_Entries.begin(), m_Entries.end(), probe, Less);
+            return it != m_Entries.end() && strcmp(it->name, probe.name) == 0 ? it->key : kUnknownKey;
+        }
+
+    private:
+        struct Entry
+        {
+            const char* name;
+            eKey key;
+        };
+
+        static bool Less( const Entry& a, const Entry& b ) { return strcmp(a.name, b.name) < 0; }
+
+        std::vector<Entry> m_Entries;
+    };
+
+    // Strings that must outlive the event that delivered them are copied into large blocks
+    // rather than allocated one at a time
+    class StringArena
+    {
+    public:
+        StringArena() : m_Used(0), m_Capacity(0) {}
+
+        const char* Store( const std::string& str )
+        {
+            const size_t size = str.size() + 1;
+            if (m_Used + size > m_Capacity)
+            {
+                m_Capacity = size > kBlockSize ? size : kBlockSize;
+                m_Blocks.emplace_back(new char[m_Capacity]);
+                m_Used = 0;
+            }
+            char* dest = m_Blocks.back().get() + m_Used;
+            std::memcpy(dest, str.c_str(), size);
+            m_Used += size;
+            return dest;
+        }
+
+    private:
+        static const size_t kBlockSize = 64 * 1024;
+
+        std::vector<std::unique_ptr<char[]>> m_Blocks;
+        size_t m_Used;
+        size_t m_Capacity;
+    };
+
+    // Negative, fractional and huge values become kBadIndex, which is past the end of any array
+    const uint32_t kBadIndex = ~0u;
+
+    inline uint32_t ToIndex( double value )
+    {
+        return value >= 0.0 && value < (double)kBadIndex && value == std::floor(value) ? (uint32_t)value : kBadIndex;
+    }
+
+    // Elements can refer to elements that come later in the file, and the arrays move as they
+    // grow, so references hold index + 1 until the whole file has been read
+    template <typename T>
+    inline T* IndexToRef( double index )
+    {
+        return (T*)((uintptr_t)ToIndex(index) + 1);
+    }
+
+    template <typename T>
+    inline uint32_t RefToIndex( T* ref )
+    {
+        return (uint32_t)((uintptr_t)ref - 1);
+    }
+
+    // Returns false and clears the reference if it is past the end of the array
+    template <typename T>
+    inline bool ResolveRef( T*& ref, std::vector<T>& items )
+    {
+        if (ref == nullptr)
+            return true;
+        const uint32_t index = RefToIndex(ref);
+        if (index >= items.size())
+        {
+            ref = nullptr;
+            return false;
+        }
+        ref = &items[index];
+        return true;
+    }
+
+    // Fills in a glTF::Asset from SAX events.  A stack of open objects and arrays holds the key
+    // or index of the value being read at each level, which is all the context an event needs.
+    // Each element is appended to its array when it begins, and the few values that depend on
+    // other arrays (buffer pointers, bounds of position and index accessors, the skins of meshes)
+    // are kept to the side and applied in Finish(), which also rejects references to elements
+    // that do not exist.
+    class StreamingParser : public nlohmann::json_sax<json>
+    {
+    public:
+        StreamingParser( glTF::Asset& asset ) : m_Asset(asset), m_SkipDepth(0), m_Scene(nullptr)
+        {
+            m_Stack.reserve(16);
+        }
+
+        bool Finish( ByteArray chunk1Bin );
+
+        bool null() override { return Value(); }
+        bool boolean( bool val ) override { Boolean(val); return Value(); }
+        bool number_integer( number_integer_t val ) override { Number((double)val); return Value(); }
+        bool number_unsigned( number_unsigned_t val ) override { Number((double)val); return Value(); }
+        bool number_float( number_float_t val, const string_t& ) override { Number(val); return Value(); }
+        bool string( string_t& val ) override { String(val); return Value(); }
+        bool binary( binary_t& ) override { return Value(); }
+
+        bool start_object( std::size_t ) override { return Begin(false); }
+        bool start_array( std::size_t ) override { return Begin(true); }
+        bool end_object() override { return End(); }
+        bool end_array() override { return End(); }
+
+        bool key( string_t& val ) override
+        {
+            if (m_SkipDepth == 0)
+                m_Stack.back().key = s_Keys.Find(val);
+            return true;
+        }
+
+        bool parse_error( std::size_t, const std::string&, const nlohmann::detail::exception& ex ) override
+        {
+            Utility::Printf("glTF parse error:  %s\n", ex.what());
+            return false;
+        }
+
+    private:
+        struct Frame
+        {
+            uint32_t index;     // Of the current element of an array
+            eKey key;           // Of the current value of an object
+            bool isArray;
+        };
+
+        // Bounds are kept as read so that index bounds above 2^24 are exact
+        struct AccessorInfo
+        {
+            uint32_t bufferView;
+            uint32_t byteOffset;
+            double minValue[3];
+            double maxValue[3];
+        };
+
+        struct NodeInfo
+        {
+            glTF::Mesh* mesh;
+            glTF::Camera* camera;
+            bool hasMatrix;
+            float matrix[16];
+            float scale[3];
+            float rotation[4];
+            float translation[3];
+        };
+
+        // The value at the top of the stack is complete
+        bool Value( void )
+        {
+            if (m_SkipDepth == 0 && !m_Stack.empty() && m_Stack.back().isArray)
+                ++m_Stack.back().index;
+            return true;
+        }
+
+        bool Begin( bool isArray );
+        bool End( void );
+
+        eKey KeyAt( size_t depth ) const { return m_Stack[depth].key; }
+        uint32_t IndexAt( size_t depth ) const { return m_Stack[depth].index; }
+
+        // The stack is root object, section array, element object, ...
+        bool InElement( void ) const
+        {
+            return m_Stack.size() >= 3 && m_Stack[1].isArray && !m_Stack[2].isArray;
+        }
+
+        void BeginElement( eKey section );
+        void EndElement( eKey section );
+        void Number( double value );
+        void String( const std::string& value );
+        void Boolean( bool value );
+        void TextureInfo( glTF::Material& material, eKey texture, eKey field, double value );
+
+        static const KeyTable s_Keys;
+
+        glTF::Asset& m_Asset;
+        StringArena m_Strings;
+        std::vector<Frame> m_Stack;
+        uint32_t m_SkipDepth;     // Levels of an unwanted object or array
+        glTF::Scene* m_Scene;
+
+        std::vector<const char*> m_BufferUris;    // Null for the GLB chunk
+        std::vector<AccessorInfo> m_AccessorInfo;
+        std::vector<glTF::Skin*> m_NodeSkins;
+        NodeInfo m_Node;
+        uint32_t m_ImageBufferView;
+        const char* m_ImageMimeType;
+    };
+
+    const KeyTable StreamingParser::s_Keys;
+
+    bool StreamingParser::Begin( bool isArray )
+    {
+        if (m_SkipDepth > 0)
+        {
+            ++m_SkipDepth;
+            return true;
+        }
+
+        const size_t depth = m_Stack.size();
+
+        bool wanted;
+        if (depth == 0)
+            wanted = !isArray;
+        else if (depth == 1)
+            wanted = isArray && KeyAt(0) != kScene && KeyAt(0) != kUnknownKey;
+        else if (depth == 2)
+            wanted = !isArray;
+        else
+            wanted = m_Stack.back().isArray || KeyAt(depth - 1) != kUnknownKey;
+
+        if (!wanted)
+        {
+            // A root that is not an object is not glTF
+            if (depth == 0)
+                return false;
+            m_SkipDepth = 1;
+            return true;
+        }
+
+        if (depth == 2)
+            BeginElement(KeyAt(0));
+        else if (depth == 4 && InElement() && !isArray && m_Stack[3].isArray)
+        {
+            const eKey section = KeyAt(0);
+            const eKey field = KeyAt(2);
+            if (section == kMeshes && field == kPrimitives)
+            {
+                glTF::Primitive prim = {};
+                prim.mode = 4;
+                m_Asset.m_meshes.back().primitives.push_back(prim);
+            }
+            else if (section == kAnimations && field == kSamplers)
+            {
+                glTF::AnimSampler sampler = {};
+                sampler.m_interpolation = glTF::AnimSampler::kLinear;
+                m_Asset.m_animations.back().m_samplers.push_back(sampler);
+            }
+            else if (section == kAnimations && field == kChannels)
+            {
+                m_Asset.m_animations.back().m_channels.push_back(glTF::AnimChannel());
+            }
+        }
+
+        Frame frame = { 0, kUnknownKey, isArray };
+        m_Stack.push_back(frame);
+        return true;
+    }
+
+    bool StreamingParser::End( void )
+    {
+        if (m_SkipDepth > 0)
+        {
+            if (--m_SkipDepth > 0)
+                return true;
+        }
+        else
+        {
+            m_Stack.pop_back();
+            if (m_Stack.size() == 2 && m_Stack[1].isArray)
+                EndElement(KeyAt(0));
+        }
+        return Value();
+    }
+
+    void StreamingParser::BeginElement( eKey section )
+    {
+        glTF::Asset& asset = m_Asset;
+
+        switch (section)
+        {
+        case kBuffers:
+            m_BufferUris.push_back(nullptr);
+            break;
+
+        case kBufferViews:
+        {
+            glTF::BufferView bufferView = {};
+            asset.m_bufferViews.push_back(bufferView);
+            break;
+        }
+
+        case kAccessors:
+        {
+            glTF::Accessor accessor = {};
+            asset.m_accessors.push_back(accessor);
+            AccessorInfo info = {};
+            info.bufferView = ~0u;
+            m_AccessorInfo.push_back(info);
+            break;
+        }
+
+        case kImages:
+            asset.m_images.push_back(glTF::Image());
+            m_ImageBufferView = ~0u;
+            m_ImageMimeType = "";
+            break;
+
+        case kSamplers:
+        {
+            glTF::Sampler sampler;
+            sampler.filter = D3D12_FILTER_ANISOTROPIC;
+            sampler.wrapS = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+            sampler.wrapT = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+            asset.m_samplers.push_back(sampler);
+            break;
+        }
+
+        case kTextures:
+        {
+            glTF::Texture texture = {};
+            asset.m_textures.push_back(texture);
+            break;
+        }
+
+        case kMaterials:
+        {
+            glTF::Material material = {};
+            material.index = (uint32_t)asset.m_materials.size();
+            material.alphaCutoff = floatToHalf(0.5f);
+            material.normalTextureScale = 1.0f;
+            material.baseColorFactor[0] = 1.0f;
+            material.baseColorFactor[1] = 1.0f;
+            material.baseColorFactor[2] = 1.0f;
+            material.baseColorFactor[3] = 1.0f;
+            material.metallicFactor = 1.0f;
+            material.roughnessFactor = 1.0f;
+            asset.m_materials.push_back(material);
+            break;
+        }
+
+        case kMeshes:
+            asset.m_meshes.push_back(glTF::Mesh());
+            asset.m_meshes.back().skin = -1;
+            break;
+
+        case kCameras:
+        {
+            glTF::Camera camera = {};
+            camera.type = glTF::Camera::kOrthographic;
+            asset.m_cameras.push_back(camera);
+            break;
+        }
+
+        case kSkins:
+            asset.m_skins.push_back(glTF::Skin());
+            asset.m_skins.back().inverseBindMatrices = nullptr;
+            asset.m_skins.back().skeleton = nullptr;
+            break;
+
+        case kNodes:
+            asset.m_nodes.push_back(glTF::Node());
+            m_NodeSkins.push_back(nullptr);
+            m_Node.mesh = nullptr;
+            m_Node.camera = nullptr;
+            m_Node.hasMatrix = false;
+            m_Node.scale[0] = m_Node.scale[1] = m_Node.scale[2] = 1.0f;
+            m_Node.rotation[0] = m_Node.rotation[1] = m_Node.rotation[2] = 0.0f;
+            m_Node.rotation[3] = 1.0f;
+            m_Node.translation[0] = m_Node.translation[1] = m_Node.translation[2] = 0.0f;
+            break;
+
+        case kScenes:
+            asset.m_scenes.push_back(glTF::Scene());
+            break;
+
+        case kAnimations:
+            asset.m_animations.push_back(glTF::Animation());
+            break;
+        }
+    }
+
+    void StreamingParser::EndElement( eKey section )
+    {
+        if (section == kNodes)
+        {
+            // The transform and what the node points to are only known once all of its keys are read
+            glTF::Node& node = m_Asset.m_nodes.back();
+            node.flags = 0;
+            node.mesh = nullptr;
+            node.linearIdx = -1;
+
+            if (m_Node.camera != nullptr)
+            {
+                node.camera = m_Node.camera;
+                node.pointsToCamera = true;
+            }
+            else
+            {
+                node.mesh = m_Node.mesh;
+            }
+
+            if (m_Node.hasMatrix)
+            {
+                // TODO:  Should check for negative determinant to reverse triangle winding
+                std::memcpy(node.matrix, m_Node.matrix, sizeof(node.matrix));
+                node.hasMatrix = true;
+            }
+            else
+            {
+                std::memcpy(node.scale, m_Node.scale, sizeof(node.scale));
+                std::memcpy(node.rotation, m_Node.rotation, sizeof(node.rotation));
+                std::memcpy(node.translation, m_Node.translation, sizeof(node.translation));
+            }
+        }
+        else if (section == kImages)
+        {
+            if (m_ImageBufferView != ~0u)
+                Utility::Printf("GLB image at buffer view %d with mime type %s\n", m_ImageBufferView, m_ImageMimeType);
+            else
+                ASSERT(!m_Asset.m_images.back().path.empty());
+        }
+    }
+
+    void StreamingParser::TextureInfo( glTF::Material& material, eKey texture, eKey field, double value )
+    {
+        uint32_t slot;
+        switch (texture)
+        {
+        case kBaseColorTexture: slot = glTF::Material::kBaseColor; break;
+        case kMetallicRoughnessTexture: slot = glTF::Material::kMetallicRoughness; break;
+        case kOcclusionTexture: slot = glTF::Material::kOcclusion; break;
+        case kEmissiveTexture: slot = glTF::Material::kEmissive; break;
+        case kNormalTexture: slot = glTF::Material::kNormal; break;
+        default: return;
+        }
+
+        if (field == kIndex)
+        {
+            material.textures[slot] = IndexToRef<glTF::Texture>(value);
+        }
+        else if (field == kTexCoord)
+        {
+            const uint32_t uv = ToIndex(value) & 1;
+            switch (slot)
+            {
+            case glTF::Material::kBaseColor: material.baseColorUV = uv; break;
+            case glTF::Material::kMetallicRoughness: material.metallicRoughnessUV = uv; break;
+            case glTF::Material::kOcclusion: material.occlusionUV = uv; break;
+            case glTF::Material::kEmissive: material.emissiveUV = uv; break;
+            case glTF::Material::kNormal: material.normalUV = uv; break;
+            }
+        }
+    }
+
+    void StreamingParser::Number( double value )
+    {
+        if (m_SkipDepth > 0)
+            return;
+
+        const size_t depth = m_Stack.size();
+
+        if (depth == 1)
+        {
+            if (KeyAt(0) == kScene)
+                m_Scene = IndexToRef<glTF::Scene>(value);
+            return;
+        }
+
+        if (!InElement())
+            return;
+
+        const eKey field = KeyAt(2);
+        glTF::Asset& asset = m_Asset;
+
+        switch (KeyAt(0))
+        {
+        case kBufferViews:
+        {
+            glTF::BufferView& bufferView = asset.m_bufferViews.back();
+            if (depth != 3)
+                break;
+            switch (field)
+            {
+            case kBuffer: bufferView.buffer = ToIndex(value); break;
+            case kByteLength: bufferView.byteLength = (uint32_t)value; break;
+            case kByteOffset: bufferView.byteOffset = (uint32_t)value; break;
+            case kByteStride: bufferView.byteStride = (uint16_t)value; break;
+            // 34962 = ARRAY_BUFFER;  34963 = ELEMENT_ARRAY_BUFFER
+            case kTarget: bufferView.elementArrayBuffer = value == 34963; break;
+            }
+            break;
+        }
+
+        case kAccessors:
+        {
+            glTF::Accessor& accessor = asset.m_accessors.back();
+            AccessorInfo& info = m_AccessorInfo.back();
+            if (depth == 3)
+            {
+                switch (field)
+                {
+                case kBufferView: info.bufferView = ToIndex(value); break;
+                case kByteOffset: info.byteOffset = (uint32_t)value; break;
+                case kCount: accessor.count = (uint32_t)value; break;
+                case kComponentType: accessor.componentType = (uint16_t)value - 5120; break;
+                }
+            }
+            else if (depth == 4 && IndexAt(3) < 3)
+            {
+                // Only the bounds of positions and the first of indices are used
+                if (field == kMin)
+                    info.minValue[IndexAt(3)] = value;
+                else if (field == kMax)
+                    info.maxValue[IndexAt(3)] = value;
+            }
+            break;
+        }
+
+        case kImages:
+            if (depth == 3 && field == kBufferView)
+                m_ImageBufferView = ToIndex(value);
+            break;
+
+        case kSamplers:
+            if (depth == 3 && field == kWrapS)
+                asset.m_samplers.back().wrapS = GLtoD3DTextureAddressMode((int32_t)value);
+            else if (depth == 3 && field == kWrapT)
+                asset.m_samplers.back().wrapT = GLtoD3DTextureAddressMode((int32_t)value);
+            break;
+
+        case kTextures:
+            if (depth == 3 && field == kSource)
+                asset.m_textures.back().source = IndexToRef<glTF::Image>(value);
+            else if (depth == 3 && field == kSampler)
+                asset.m_textures.back().sampler = IndexToRef<glTF::Sampler>(value);
+            break;
+
+        case kMaterials:
+        {
+            glTF::Material& material = asset.m_materials.back();
+            if (depth == 3)
+            {
+                if (field == kAlphaCutoff)
+                    material.alphaCutoff = floatToHalf((float)value);
+                else if (field == kNormalTextureScale)
+                    material.normalTextureScale = (float)value;
+            }
+            else if (depth == 4)
+            {
+                if (field == kEmissiveFactor && IndexAt(3) < 3)
+                    material.emissiveFactor[IndexAt(3)] = (float)value;
+                else if (field == kPbrMetallicRoughness && KeyAt(3) == kMetallicFactor)
+                    material.metallicFactor = (float)value;
+                else if (field == kPbrMetallicRoughness && KeyAt(3) == kRoughnessFactor)
+                    material.roughnessFactor = (float)value;
+                else
+                    TextureInfo(material, field, KeyAt(3), value);
+            }
+            else if (depth == 5 && field == kPbrMetallicRoughness)
+            {
+                if (KeyAt(3) == kBaseColorFactor && IndexAt(4) < 4)
+                    material.baseColorFactor[IndexAt(4)] = (float)value;
+                else if (KeyAt(3) == kBaseColorTexture || KeyAt(3) == kMetallicRoughnessTexture)
+                    TextureInfo(material, KeyAt(3), KeyAt(4), value);
+            }
+            break;
+        }
+
+        case kMeshes:
+        {
+            if (field != kPrimitives || depth < 5 || m_Stack[4].isArray)
+                break;
+            glTF::Primitive& prim = asset.m_meshes.back().primitives.back();
+            if (depth == 5)
+            {
+                switch (KeyAt(4))
+                {
+                case kMode: prim.mode = (uint16_t)value; break;
+                case kIndices: prim.indices = IndexToRef<glTF::Accessor>(value); break;
+                case kMaterial: prim.material = IndexToRef<glTF::Material>(value); break;
+                }
+            }
+            else if (depth == 6 && KeyAt(4) == kAttributes && KeyAt(5) >= kAttribPosition && KeyAt(5) <= kAttribWeights0)
+            {
+                const uint32_t type = KeyAt(5) - kAttribPosition;
+                prim.attribMask |= 1 << type;
+                prim.attributes[type] = IndexToRef<glTF::Accessor>(value);
+            }
+            break;
+        }
+
+        case kCameras:
+        {
+            glTF::Camera& camera = asset.m_cameras.back();
+            if (depth != 4 || (field != kPerspective && field != kOrthographic))
+                break;
+            switch (KeyAt(3))
+            {
+            case kAspectRatio: camera.aspectRatio = (float)value; break;
+            case kYfov: camera.yfov = (float)value; break;
+            case kXmag: camera.xmag = (float)value; break;
+            case kYmag: camera.ymag = (float)value; break;
+            case kZnear: camera.znear = (float)value; break;
+            case kZfar: camera.zfar = (float)value; break;
+            }
+            break;
+        }
+
+        case kSkins:
+        {
+            glTF::Skin& skin = asset.m_skins.back();
+            if (depth == 3 && field == kInverseBindMatrices)
+                skin.inverseBindMatrices = IndexToRef<glTF::Accessor>(value);
+            else if (depth == 3 && field == kSkeleton)
+                skin.skeleton = IndexToRef<glTF::Node>(value);
+            else if (depth == 4 && field == kJoints)
+                skin.joints.push_back(IndexToRef<glTF::Node>(value));
+            break;
+        }
+
+        case kNodes:
+        {
+            if (depth == 3)
+            {
+                switch (field)
+                {
+                case kCamera: m_Node.camera = IndexToRef<glTF::Camera>(value); break;
+                case kMesh: m_Node.mesh = IndexToRef<glTF::Mesh>(value); break;
+                case kSkin: m_NodeSkins.back() = IndexToRef<glTF::Skin>(value); break;
+                }
+            }
+            else if (depth == 4)
+            {
+                const uint32_t i = IndexAt(3);
+                switch (field)
+                {
+                case kChildren:
+                    asset.m_nodes.back().children.push_back(IndexToRef<glTF::Node>(value));
+                    break;
+                case kMatrix:
+                    m_Node.hasMatrix = true;
+                    if (i < 16)
+                        m_Node.matrix[i] = (float)value;
+                    break;
+                case kScale: if (i < 3) m_Node.scale[i] = (float)value; break;
+                case kRotation: if (i < 4) m_Node.rotation[i] = (float)value; break;
+                case kTranslation: if (i < 3) m_Node.translation[i] = (float)value; break;
+                }
+            }
+            break;
+        }
+
+        case kScenes:
+            if (depth == 4 && field == kNodes)
+                asset.m_scenes.back().nodes.push_back(IndexToRef<glTF::Node>(value));
+            break;
+
+        case kAnimations:
+        {
+            glTF::Animation& animation = asset.m_animations.back();
+            if (depth < 5 || m_Stack[4].isArray)
+                break;
+
+            if (depth == 5 && field == kSamplers)
+            {
+                if (KeyAt(4) == kInput)
+                    animation.m_samplers.back().m_input = IndexToRef<glTF::Accessor>(value);
+                else if (KeyAt(4) == kOutput)
+                    animation.m_samplers.back().m_output = IndexToRef<glTF::Accessor>(value);
+            }
+            else if (depth == 5 && field == kChannels && KeyAt(4) == kSampler)
+            {
+                animation.m_channels.back().m_sampler = IndexToRef<glTF::AnimSampler>(value);
+            }
+            else if (depth == 6 && field == kChannels && KeyAt(4) == kTarget && KeyAt(5) == kNode)
+            {
+                animation.m_channels.back().m_target = IndexToRef<glTF::Node>(value);
+            }
+            break;
+        }
+        }
+    }
+
+    void StreamingParser::String( const std::string& value )
+    {
+        if (m_SkipDepth > 0 || !InElement())
+            return;
+
+        const size_t depth = m_Stack.size();
+        const eKey field = KeyAt(2);
+        glTF::Asset& asset = m_Asset;
+
+        switch (KeyAt(0))
+        {
+        case kBuffers:
+            if (depth == 3 && field == kUri)
+                m_BufferUris.back() = m_Strings.Store(value);
+            break;
+
+        case kAccessors:
+            if (depth == 3 && field == kType)
+                asset.m_accessors.back().type = TypeToEnum(value.c_str());
+            break;
+
+        case kImages:
+            if (depth == 3 && field == kUri)
+                asset.m_images.back().path = value;
+            else if (depth == 3 && field == kMimeType)
+                m_ImageMimeType = m_Strings.Store(value);
+            break;
+
+        case kMaterials:
+            if (depth == 3 && field == kAlphaMode)
+            {
+                if (value == "BLEND")
+                    asset.m_materials.back().alphaBlend = true;
+                else if (value == "MASK")
+                    asset.m_materials.back().alphaTest = true;
+            }
+            break;
+
+        case kCameras:
+            if (depth == 3 && field == kType)
+            {
+                asset.m_cameras.back().type = value == "perspective" ?
+                    glTF::Camera::kPerspective : glTF::Camera::kOrthographic;
+            }
+            break;
+
+        case kAnimations:
+            if (depth < 5 || m_Stack[4].isArray)
+                break;
+
+            if (depth == 5 && field == kSamplers && KeyAt(4) == kInterpolation)
+            {
+                glTF::AnimSampler& sampler = asset.m_animations.back().m_samplers.back();
+                if (value == "LINEAR")
+                    sampler.m_interpolation = glTF::AnimSampler::kLinear;
+                else if (value == "STEP")
+                    sampler.m_interpolation = glTF::AnimSampler::kStep;
+                else if (value == "CATMULLROMSPLINE")
+                    sampler.m_interpolation = glTF::AnimSampler::kCatmullRomSpline;
+                else if (value == "CUBICSPLINE")
+                    sampler.m_interpolation = glTF::AnimSampler::kCubicSpline;
+            }
+            else if (depth == 6 && field == kChannels && KeyAt(4) == kTarget && KeyAt(5) == kPath)
+            {
+                glTF::AnimChannel& channel = asset.m_animations.back().m_channels.back();
+                if (value == "translation")
+                    channel.m_path = glTF::AnimChannel::kTranslation;
+                else if (value == "rotation")
+                    channel.m_path = glTF::AnimChannel::kRotation;
+                else if (value == "scale")
+                    channel.m_path = glTF::AnimChannel::kScale;
+                else if (value == "weights")
+                    channel.m_path = glTF::AnimChannel::kWeights;
+            }
+            break;
+        }
+    }
+
+    void StreamingParser::Boolean( bool value )
+    {
+        if (m_SkipDepth == 0 && InElement() && KeyAt(0) == kMaterials && m_Stack.size() == 3 && KeyAt(2) == kDoubleSided)
+            m_Asset.m_materials.back().twoSided = value;
+    }
+
+    bool StreamingParser::Finish( ByteArray chunk1Bin )
+    {
+        glTF::Asset& asset = m_Asset;
+        bool valid = true;
+
+        asset.m_buffers.reserve(m_BufferUris.size());
+        for (size_t i = 0; i < m_BufferUris.size(); ++i)
+        {
+            if (m_BufferUris[i] != nullptr)
+            {
+                const std::string uri = m_BufferUris[i];
+                wstring filepath = asset.m_basePath + wstring(uri.begin(), uri.end());
+
+                ByteArray ba = ReadFileSync(filepath);
+                ASSERT(ba->size() > 0, "Missing bin file %ws", filepath.c_str());
+                asset.m_buffers.push_back(ba);
+            }
+            else
+            {
+                ASSERT(i == 0, "Only the 1st buffer allowed to be internal");
+                ASSERT(chunk1Bin->size() > 0, "GLB chunk1 missing data or not a GLB file");
+                asset.m_buffers.push_back(chunk1Bin);
+            }
+        }
+
+        for (size_t i = 0; i < asset.m_accessors.size(); ++i)
+        {
+            const AccessorInfo& info = m_AccessorInfo[i];
+            if (info.bufferView >= asset.m_bufferViews.size() ||
+                asset.m_bufferViews[info.bufferView].buffer >= asset.m_buffers.size())
+            {
+                Utility::Printf("glTF accessor %u has no valid buffer view\n", (uint32_t)i);
+                return false;
+            }
+            const glTF::BufferView& bufferView = asset.m_bufferViews[info.bufferView];
+            glTF::Accessor& accessor = asset.m_accessors[i];
+            accessor.dataPtr = asset.m_buffers[bufferView.buffer]->data() + bufferView.byteOffset + info.byteOffset;
+            accessor.stride = bufferView.byteStride;
+        }
+
+        for (glTF::Texture& texture : asset.m_textures)
+        {
+            valid = ResolveRef(texture.source, asset.m_images) && valid;
+            valid = ResolveRef(texture.sampler, asset.m_samplers) && valid;
+        }
+
+        for (glTF::Material& material : asset.m_materials)
+        {
+            for (uint32_t i = 0; i < glTF::Material::kNumTextures; ++i)
+                valid = ResolveRef(material.textures[i], asset.m_textures) && valid;
+        }
+
+        for (glTF::Mesh& mesh : asset.m_meshes)
+        {
+            for (glTF::Primitive& prim : mesh.primitives)
+            {
+                for (uint32_t i = 0; i < glTF::Primitive::kNumAttribs; ++i)
+                    valid = ResolveRef(prim.attributes[i], asset.m_accessors) && valid;
+                valid = ResolveRef(prim.indices, asset.m_accessors) && valid;
+                valid = ResolveRef(prim.material, asset.m_materials) && valid;
+
+                // Read position AABB
+                if (prim.attributes[glTF::Primitive::kPosition] == nullptr)
+                {
+                    valid = false;
+                    continue;
+                }
+                const AccessorInfo& position = m_AccessorInfo[prim.attributes[glTF::Primitive::kPosition] - asset.m_accessors.data()];
+                for (uint32_t i = 0; i < 3; ++i)
+                {
+                    prim.minPos[i] = (float)position.minValue[i];
+                    prim.maxPos[i] = (float)position.maxValue[i];
+                }
+
+                if (prim.indices != nullptr)
+                {
+                    const AccessorInfo& indices = m_AccessorInfo[prim.indices - asset.m_accessors.data()];
+                    prim.minIndex = ToIndex(indices.minValue[0]);
+                    prim.maxIndex = ToIndex(indices.maxValue[0]);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < asset.m_nodes.size(); ++i)
+        {
+            glTF::Node& node = asset.m_nodes[i];
+            if (node.pointsToCamera)
+                valid = ResolveRef(node.camera, asset.m_cameras) && valid;
+            else
+                valid = ResolveRef(node.mesh, asset.m_meshes) && valid;
+
+            for (glTF::Node*& child : node.children)
+                valid = ResolveRef(child, asset.m_nodes) && valid;
+
+            if (m_NodeSkins[i] != nullptr)
+            {
+                const uint32_t skin = RefToIndex(m_NodeSkins[i]);
+                if (skin < asset.m_skins.size() && node.mesh != nullptr && !node.pointsToCamera)
+                    node.mesh->skin = (int32_t)skin;
+                else
+                    valid = false;
+            }
+        }
+
+        for (glTF::Skin& skin : asset.m_skins)
+        {
+            valid = ResolveRef(skin.inverseBindMatrices, asset.m_accessors) && valid;
+            valid = ResolveRef(skin.skeleton, asset.m_nodes) && valid;
+            if (skin.skeleton != nullptr)
+                skin.skeleton->skeletonRoot = true;
+            for (glTF::Node*& joint : skin.joints)
+                valid = ResolveRef(joint, asset.m_nodes) && valid;
+        }
+
+        for (glTF::Scene& scene : asset.m_scenes)
+        {
+            for (glTF::Node*& node : scene.nodes)
+                valid = ResolveRef(node, asset.m_nodes) && valid;
+        }
+
+        for (glTF::Animation& animation : asset.m_animations)
+        {
+            for (glTF::AnimSampler& sampler : animation.m_samplers)
+            {
+                valid = ResolveRef(sampler.m_input, asset.m_accessors) && valid;
+                valid = ResolveRef(sampler.m_output, asset.m_accessors) && valid;
+            }
+            for (glTF::AnimChannel& channel : animation.m_channels)
+            {
+                valid = ResolveRef(channel.m_sampler, animation.m_samplers) && valid;
+                valid = ResolveRef(channel.m_target, asset.m_nodes) && valid;
+            }
+        }
+
+        valid = ResolveRef(m_Scene, asset.m_scenes) && valid;
+        asset.m_scene = m_Scene;
+
+        if (!valid)
+            Utility::Printf("glTF reference to an element that does not exist\n");
+        return valid;
+    }
+}
+
+bool glTF::Asset::ParseJSON(const char* text, size_t length, ByteArray chunk1Bin)
+{
+    StreamingParser parser(*this);
+    if (!json::sax_parse(text, text + length, &parser) || !parser.Finish(chunk1Bin))
+    {
+        // Drop what was read, since its references were never resolved or point nowhere
+        m_scene = nullptr;
+        m_scenes.clear();
+        m_nodes.clear();
+        m_cameras.clear();
+        m_meshes.clear();
+        m_images.clear();
+        m_samplers.clear();
+        m_textures.clear();
+        m_accessors.clear();
+        m_skins.clear();
+        m_materials.clear();
+        m_buffers.clear();
+        m_bufferViews.clear();
+        m_animations.clear();
+        return false;
+    }
+
+    return true;
+}
+
+namespace
+{
+    class SceneWriter
+    {
+    public:
+        SceneWriter( std::string& out ) : m_Out(out), m_Seed(1) {}
+
+        void Append( const char* text ) { m_Out += text; }
+
+        template <typename... Args>
+        void Append( const char* format, Args... args )
+        {
+            char buffer[512];
+            sprintf_s(buffer, format, args...);
+            m_Out += buffer;
+        }
+
+        void Floats( uint32_t count, float scale )
+        {
+            m_Out += '[';
+            for (uint32_t i = 0; i < count; ++i)
+                Append(i == 0 ? "%.6f" : ",%.6f", Random() * scale);
+            m_Out += ']';
+        }
+
+        float Random( void )
+        {
+            m_Seed = m_Seed * 1664525u + 1013904223u;
+            return (float)(m_Seed >> 8) / (float)(1u << 24);
+        }
+
+    private:
+        std::string& m_Out;
+        uint32_t m_Seed;
+    };
+
+    // A synthetic scene of numUnits units, each a node with a mesh of one primitive, its
+    // material, and four accessors and buffer views.  Every 64th node instead groups the next
+    // 63, every 4th is animated, and every 256th is skinned.  Names and extras are written as
+    // real exporters do.  All of the buffer views share one 1 MB buffer from the GLB chunk.
+    void WriteSyntheticScene( std::string& out, uint32_t numUnits )
+    {
+        const uint32_t kNumImages = 16;
+        const uint32_t numSkins = numUnits / 256 + 1;
+        SceneWriter writer(out);
+
+        writer.Append("{\"asset\":{\"version\":\"2.0\",\"generator\":\"MiniEngine glTF benchmark\"},\"scene\":0,\n");
+        writer.Append("\"buffers\":[{\"byteLength\":1048576}],\n\"bufferViews\":[");
+        for (uint32_t i = 0; i < numUnits * 4; ++i)
+        {
+            writer.Append("%s\n{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":4096,\"byteStride\":%u,\"target\":%u}",
+                i == 0 ? "" : ",", (i * 4096) % (1048576 - 4096), i % 4 == 3 ? 0 : 12, i % 4 == 3 ? 34963 : 34962);
+        }
+
+        writer.Append("],\n\"accessors\":[");
+        for (uint32_t u = 0; u < numUnits; ++u)
+        {
+            const uint32_t count = 100 + u % 200;
+            writer.Append("%s\n{\"bufferView\":%u,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\",\"min\":",
+                u == 0 ? "" : ",", u * 4, count);
+            writer.Floats(3, -10.0f);
+            writer.Append(",\"max\":");
+            writer.Floats(3, 10.0f);
+            writer.Append("},\n{\"bufferView\":%u,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\"}", u * 4 + 1, count);
+            writer.Append(",\n{\"bufferView\":%u,\"byteOffset\":4,\"componentType\":5126,\"count\":%u,\"type\":\"VEC2\"}", u * 4 + 2, count);
+            writer.Append(",\n{\"bufferView\":%u,\"componentType\":5125,\"count\":%u,\"type\":\"SCALAR\",\"min\":[0],\"max\":[%u]}",
+                u * 4 + 3, count * 3, count - 1);
+        }
+
+        writer.Append("],\n\"images\":[");
+        for (uint32_t i = 0; i < kNumImages; ++i)
+            writer.Append("%s{\"uri\":\"textures/texture%u.png\",\"name\":\"image%u\"}", i == 0 ? "" : ",", i, i);
+
+        writer.Append("],\n\"samplers\":[{\"magFilter\":9729,\"minFilter\":9987,\"wrapS\":10497,\"wrapT\":10497},"
+            "{\"magFilter\":9729,\"minFilter\":9729,\"wrapS\":33071,\"wrapT\":33648}],\n\"textures\":[");
+        for (uint32_t i = 0; i < kNumImages; ++i)
+            writer.Append("%s{\"source\":%u,\"sampler\":%u}", i == 0 ? "" : ",", i, i % 2);
+
+        writer.Append("],\n\"materials\":[");
+        for (uint32_t u = 0; u < numUnits; ++u)
+        {
+            static const char* kAlphaModes[] = { "OPAQUE", "MASK", "BLEND" };
+            writer.Append("%s\n{\"name\":\"material%u\",\"pbrMetallicRoughness\":{\"baseColorFactor\":", u == 0 ? "" : ",", u);
+            writer.Floats(4, 1.0f);
+            writer.Append(",\"metallicFactor\":%.6f,\"roughnessFactor\":%.6f,\"baseColorTexture\":{\"index\":%u},"
+                "\"metallicRoughnessTexture\":{\"index\":%u,\"texCoord\":1}},\"normalTexture\":{\"index\":%u,\"scale\":1.0},"
+                "\"emissiveFactor\":", writer.Random(), writer.Random(), u % kNumImages, (u + 1) % kNumImages, (u + 2) % kNumImages);
+            writer.Floats(3, 1.0f);
+            writer.Append(",\"alphaMode\":\"%s\",\"alphaCutoff\":%.6f,\"doubleSided\":%s,\"extras\":{\"id\":%u,\"tags\":[\"a\",\"b\"]}}",
+                kAlphaModes[u % 3], writer.Random(), u % 2 == 0 ? "true" : "false", u);
+        }
+
+        writer.Append("],\n\"meshes\":[");
+        for (uint32_t u = 0; u < numUnits; ++u)
+        {
+            writer.Append("%s\n{\"name\":\"mesh%u\",\"primitives\":[{\"attributes\":{\"POSITION\":%u,\"NORMAL\":%u,\"TEXCOORD_0\":%u},"
+                "\"indices\":%u,\"material\":%u,\"mode\":4}]}", u == 0 ? "" : ",", u, u * 4, u * 4 + 1, u * 4 + 2, u * 4 + 3, u);
+        }
+
+        writer.Append("],\n\"cameras\":[{\"type\":\"perspective\",\"perspective\":{\"aspectRatio\":1.777778,\"yfov\":0.7,\"znear\":0.1}},"
+            "{\"type\":\"orthographic\",\"orthographic\":{\"xmag\":10.0,\"ymag\":10.0,\"zfar\":100.0,\"znear\":0.1}}],\n\"skins\":[");
+        for (uint32_t s = 0; s < numSkins; ++s)
+        {
+            writer.Append("%s\n{\"inverseBindMatrices\":%u,\"skeleton\":%u,\"joints\":[", s == 0 ? "" : ",",
+                std::min(s * 256, numUnits - 1) * 4 + 1, std::min(s * 256, numUnits - 1));
+            for (uint32_t j = 0; j < 16; ++j)
+                writer.Append(j == 0 ? "%u" : ",%u", std::min(s * 256 + j, numUnits - 1));
+            writer.Append("]}");
+        }
+
+        writer.Append("],\n\"nodes\":[");
+        for (uint32_t u = 0; u < numUnits; ++u)
+        {
+            writer.Append("%s\n{", u == 0 ? "" : ",");
+            if (u % 64 == 0)
+            {
+                writer.Append("\"name\":\"group%u\",\"children\":[", u);
+                for (uint32_t c = u + 1; c < std::min(u + 64, numUnits); ++c)
+                    writer.Append(c == u + 1 ? "%u" : ",%u", c);
+                writer.Append("],");
+            }
+            else
+            {
+                writer.Append("\"name\":\"node%u\",\"mesh\":%u,", u, u);
+                if (u % 256 == 1)
+                    writer.Append("\"skin\":%u,", u / 256);
+                if (u == 2)
+                    writer.Append("\"camera\":0,");
+            }
+
+            if (u % 2 == 1)
+            {
+                writer.Append("\"matrix\":");
+                writer.Floats(16, 1.0f);
+            }
+            else
+            {
+                writer.Append("\"scale\":");
+                writer.Floats(3, 2.0f);
+                writer.Append(",\"rotation\":");
+                writer.Floats(4, 1.0f);
+                writer.Append(",\"translation\":");
+                writer.Floats(3, 100.0f);
+            }
+            writer.Append(",\"extras\":{\"id\":%u}}", u);
+        }
+
+        writer.Append("],\n\"scenes\":[{\"name\":\"scene\",\"nodes\":[");
+        for (uint32_t u = 0; u < numUnits; u += 64)
+            writer.Append(u == 0 ? "%u" : ",%u", u);
+
+        writer.Append("]}],\n\"animations\":[{\"name\":\"animation\",\"samplers\":[");
+        for (uint32_t u = 1, k = 0; u < numUnits; u += 4, ++k)
+        {
+            static const char* kInterpolation[] = { "LINEAR", "STEP", "CUBICSPLINE" };
+            writer.Append("%s\n{\"input\":%u,\"output\":%u,\"interpolation\":\"%s\"}", k == 0 ? "" : ",",
+                u * 4 + 2, u * 4 + 1, kInterpolation[k % 3]);
+        }
+        writer.Append("],\"channels\":[");
+        for (uint32_t u = 1, k = 0; u < numUnits; u += 4, ++k)
+        {
+            static const char* kPaths[] = { "translation", "rotation", "scale" };
+            writer.Append("%s\n{\"sampler\":%u,\"target\":{\"node\":%u,\"path\":\"%s\"}}", k == 0 ? "" : ",", k, u, kPaths[k % 3]);
+        }
+        writer.Append("]}]}\n");
+    }
+
+    template <typename T>
+    inline bool SameRef( const T* a, const std::vector<T>& arrayA, const T* b, const std::vector<T>& arrayB )
+    {
+        return (a == nullptr && b == nullptr) || (a != nullptr && b != nullptr && a - arrayA.data() == b - arrayB.data());
+    }
+
+    // Compares everything the parsers fill in, with references compared by index
+    bool SameAssets( const glTF::Asset& a, const glTF::Asset& b )
+    {
+        if (a.m_scenes.size() != b.m_scenes.size() || a.m_nodes.size() != b.m_nodes.size() ||
+            a.m_cameras.size() != b.m_cameras.size() || a.m_meshes.size() != b.m_meshes.size() ||
+            a.m_images.size() != b.m_images.size() || a.m_samplers.size() != b.m_samplers.size() ||
+            a.m_textures.size() != b.m_textures.size() || a.m_accessors.size() != b.m_accessors.size() ||
+            a.m_skins.size() != b.m_skins.size() || a.m_materials.size() != b.m_materials.size() ||
+            a.m_buffers.size() != b.m_buffers.size() || a.m_bufferViews.size() != b.m_bufferViews.size() ||
+            a.m_animations.size() != b.m_animations.size() || !SameRef(a.m_scene, a.m_scenes, b.m_scene, b.m_scenes))
+            return false;
+
+        for (size_t i = 0; i < a.m_bufferViews.size(); ++i)
+        {
+            const glTF::BufferView& x = a.m_bufferViews[i];
+            const glTF::BufferView& y = b.m_bufferViews[i];
+            if (x.buffer != y.buffer || x.byteLength != y.byteLength || x.byteOffset != y.byteOffset ||
+                x.byteStride != y.byteStride || x.elementArrayBuffer != y.elementArrayBuffer)
+                return false;
+        }
+
+        for (size_t i = 0; i < a.m_accessors.size(); ++i)
+        {
+            const glTF::Accessor& x = a.m_accessors[i];
+            const glTF::Accessor& y = b.m_accessors[i];
+            if (x.dataPtr != y.dataPtr || x.stride != y.stride || x.count != y.count ||
+                x.componentType != y.componentType || x.type != y.type)
+                return false;
+        }
+
+        for (size_t i = 0; i < a.m_images.size(); ++i)
+        {
+            if (a.m_images[i].path != b.m_images[i].path)
+                return false;
+        }
+
+        for (size_t i = 0; i < a.m_samplers.size(); ++i)
+        {
+            const glTF::Sampler& x = a.m_samplers[i];
+            const glTF::Sampler& y = b.m_samplers[i];
+            if (x.filter != y.filter || x.wrapS != y.wrapS || x.wrapT != y.wrapT)
+                return false;
+        }
+
+        for (size_t i = 0; i < a.m_textures.size(); ++i)
+        {
+            const glTF::Texture& x = a.m_textures[i];
+            const glTF::Texture& y = b.m_textures[i];
+            if (!SameRef(x.source, a.m_images, y.source, b.m_images) || !SameRef(x.sampler, a.m_samplers, y.sampler, b.m_samplers))
+                return false;
+        }
+
+        for (size_t i = 0; i < a.m_materials.size(); ++i)
+        {
+            const glTF::Material& x = a.m_materials[i];
+            const glTF::Material& y = b.m_materials[i];
+            if (std::memcmp(x.baseColorFactor, y.baseColorFactor, sizeof(x.baseColorFactor)) != 0 ||
+                x.metallicFactor != y.metallicFactor || x.roughnessFactor != y.roughnessFactor || x.flags != y.flags ||
+                std::memcmp(x.emissiveFactor, y.emissiveFactor, sizeof(x.emissiveFactor)) != 0 ||
+                x.normalTextureScale != y.normalTextureScale || x.index != y.index)
+                return false;
+            for (uint32_t t = 0; t < glTF::Material::kNumTextures; ++t)
+            {
+                if (!SameRef(x.textures[t], a.m_textures, y.textures[t], b.m_textures))
+                    return false;
+            }
+        }
+
+        for (size_t i = 0; i < a.m_meshes.size(); ++i)
+        {
+            const glTF::Mesh& x = a.m_meshes[i];
+            const glTF::Mesh& y = b.m_meshes[i];
+            if (x.skin != y.skin || x.primitives.size() != y.primitives.size())
+                return false;
+            for (size_t p = 0; p < x.primitives.size(); ++p)
+            {
+                const glTF::Primitive& px = x.primitives[p];
+                const glTF::Primitive& py = y.primitives[p];
+                if (px.attribMask != py.attribMask || px.mode != py.mode || px.minIndex != py.minIndex ||
+                    px.maxIndex != py.maxIndex || std::memcmp(px.minPos, py.minPos, sizeof(px.minPos)) != 0 ||
+                    std::memcmp(px.maxPos, py.maxPos, sizeof(px.maxPos)) != 0 ||
+                    !SameRef(px.indices, a.m_accessors, py.indices, b.m_accessors) ||
+                    !SameRef(px.material, a.m_materials, py.material, b.m_materials))
+                    return false;
+                for (uint32_t t = 0; t < glTF::Primitive::kNumAttribs; ++t)
+                {
+                    if (!SameRef(px.attributes[t], a.m_accessors, py.attributes[t], b.m_accessors))
+                        return false;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < a.m_cameras.size(); ++i)
+        {
+            const glTF::Camera& x = a.m_cameras[i];
+            const glTF::Camera& y = b.m_cameras[i];
+            if (x.type != y.type || x.aspectRatio != y.aspectRatio || x.yfov != y.yfov || x.znear != y.znear || x.zfar != y.zfar)
+                return false;
+        }
+
+        for (size_t i = 0; i < a.m_nodes.size(); ++i)
+        {
+            const glTF::Node& x = a.m_nodes[i];
+            const glTF::Node& y = b.m_nodes[i];
+            if (x.flags != y.flags || x.linearIdx != y.linearIdx || x.children.size() != y.children.size())
+                return false;
+            if (x.pointsToCamera ? !SameRef(x.camera, a.m_cameras, y.camera, b.m_cameras) : !SameRef(x.mesh, a.m_meshes, y.mesh, b.m_meshes))
+                return false;
+            for (size_t c = 0; c < x.children.size(); ++c)
+            {
+                if (!SameRef(x.children[c], a.m_nodes, y.children[c], b.m_nodes))
+                    return false;
+            }
+            if (x.hasMatrix ? std::memcmp(x.matrix, y.matrix, sizeof(x.matrix)) != 0 :
+                std::memcmp(x.scale, y.scale, sizeof(x.scale)) != 0 || std::memcmp(x.rotation, y.rotation, sizeof(x.rotation)) != 0 ||
+                std::memcmp(x.translation, y.translation, sizeof(x.translation)) != 0)
+                return false;
+        }
+
+        for (size_t i = 0; i < a.m_skins.size(); ++i)
+        {
+            const glTF::Skin& x = a.m_skins[i];
+            const glTF::Skin& y = b.m_skins[i];
+            if (!SameRef(x.inverseBindMatrices, a.m_accessors, y.inverseBindMatrices, b.m_accessors) ||
+                !SameRef(x.skeleton, a.m_nodes, y.skeleton, b.m_nodes) || x.joints.size() != y.joints.size())
+                return false;
+            for (size_t j = 0; j < x.joints.size(); ++j)
+            {
+                if (!SameRef(x.joints[j], a.m_nodes, y.joints[j], b.m_nodes))
+                    return false;
+            }
+        }
+
+        for (size_t i = 0; i < a.m_scenes.size(); ++i)
+        {
+            const glTF::Scene& x = a.m_scenes[i];
+            const glTF::Scene& y = b.m_scenes[i];
+            if (x.nodes.size() != y.nodes.size())
+                return false;
+            for (size_t n = 0; n < x.nodes.size(); ++n)
+            {
+                if (!SameRef(x.nodes[n], a.m_nodes, y.nodes[n], b.m_nodes))
+                    return false;
+            }
+        }
+
+        for (size_t i = 0; i < a.m_animations.size(); ++i)
+        {
+            const glTF::Animation& x = a.m_animations[i];
+            const glTF::Animation& y = b.m_animations[i];
+            if (x.m_samplers.size() != y.m_samplers.size() || x.m_channels.size() != y.m_channels.size())
+                return false;
+            for (size_t s = 0; s < x.m_samplers.size(); ++s)
+            {
+                const glTF::AnimSampler& sx = x.m_samplers[s];
+                const glTF::AnimSampler& sy = y.m_samplers[s];
+                if (sx.m_interpolation != sy.m_interpolation || !SameRef(sx.m_input, a.m_accessors, sy.m_input, b.m_accessors) ||
+                    !SameRef(sx.m_output, a.m_accessors, sy.m_output, b.m_accessors))
+                    return false;
+            }
+            for (size_t c = 0; c < x.m_channels.size(); ++c)
+            {
+                const glTF::AnimChannel& cx = x.m_channels[c];
+                const glTF::AnimChannel& cy = y.m_channels[c];
+                if (cx.m_path != cy.m_path || !SameRef(cx.m_sampler, x.m_samplers, cy.m_sampler, y.m_samplers) ||
+                    !SameRef(cx.m_target, a.m_nodes, cy.m_target, b.m_nodes))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    size_t GetWorkingSetSize( void )
+    {
+        PROCESS_MEMORY_COUNTERS counters = {};
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.WorkingSetSize;
+    }
+
+    // The peak working set the OS keeps cannot be reset between runs, so a thread samples the
+    // working set while a parse runs instead.  Trimming it first makes freed heap pages that
+    // are reused count again.
+    class WorkingSetMonitor
+    {
+    public:
+        WorkingSetMonitor() : m_Stop(false)
+        {
+            SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+            m_Baseline = GetWorkingSetSize();
+            m_Peak = m_Baseline;
+            m_Thread = std::thread([this]
+            {
+                while (!m_Stop)
+                {
+                    m_Peak = std::max(m_Peak, GetWorkingSetSize());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+        }
+
+        // Returns the largest growth of the working set in bytes
+        size_t Stop( void )
+        {
+            m_Stop = true;
+            m_Thread.join();
+            m_Peak = std::max(m_Peak, GetWorkingSetSize());
+            return m_Peak > m_Baseline ? m_Peak - m_Baseline : 0;
+        }
+
+    private:
+        std::atomic<bool> m_Stop;
+        std::thread m_Thread;
+        size_t m_Baseline;
+        size_t m_Peak;
+    };
+}
+
+void glTF::BenchmarkParser( void )
+{
+    Utility::Printf("glTF parser benchmark (document vs. streaming)\n");
+
+    ByteArray chunk1Bin = std::make_shared<std::vector<byte>>(1 << 20);
+
+    // Bytes per unit of the synthetic scene, to size it for each target
+    std::string text;
+    WriteSyntheticScene(text, 1024);
+    const double bytesPerUnit = text.size() / 1024.0;
+
+    const uint32_t kSizesMB[] = { 1, 10, 100, 500 };
+    for (uint32_t sizeMB : kSizesMB)
+    {
+        text.clear();
+        text.shrink_to_fit();
+        text.reserve((size_t)sizeMB * 1024 * 1024 + (1 << 20));
+        WriteSyntheticScene(text, std::max(64u, (uint32_t)(sizeMB * 1024.0 * 1024.0 / bytesPerUnit)));
+
+        // Both assets are kept to compare them, so the document is parsed with the streamed
+        // asset resident, which the working set baseline accounts for
+        std::unique_ptr<Asset> streamed(new Asset);
+        WorkingSetMonitor streamingMonitor;
+        int64_t startTick = SystemTime::GetCurrentTick();
+        bool streamingParsed = streamed->ParseJSON(text.data(), text.size(), chunk1Bin);
+        double streamingSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+        size_t streamingPeak = streamingMonitor.Stop();
+
+        std::unique_ptr<Asset> document(new Asset);
+        WorkingSetMonitor documentMonitor;
+        startTick = SystemTime::GetCurrentTick();
+        bool documentParsed = document->ParseJSONDocument(text.data(), text.size(), chunk1Bin);
+        double documentSeconds = SystemTime::TimeBetweenTicks(startTick, SystemTime::GetCurrentTick());
+        size_t documentPeak = documentMonitor.Stop();
+
+        const bool passed = streamingParsed && documentParsed && SameAssets(*document, *streamed);
+
+        const double kMB = 1.0 / (1024.0 * 1024.0);
+        Utility::Printf("  %6.1f MB, %7u nodes, %8u accessors:  document %8.1f ms %7.1f MB peak   "
+            "streaming %8.1f ms %7.1f MB peak (%4.1fx faster, %5.1fx less memory)   %s\n", text.size() * kMB,
+            (uint32_t)streamed->m_nodes.size(), (uint32_t)streamed->m_accessors.size(), documentSeconds * 1000.0,
+            documentPeak * kMB, streamingSeconds * 1000.0, streamingPeak * kMB, documentSeconds / streamingSeconds,
+            (double)documentPeak / std::max<size_t>(streamingPeak, 1), passed ? "passed" : "FAILED");
+    }
 }
@@ -246,6 +246,17 @@ namespace glTF
 
         void Parse(const std::wstring& filepath);
 
+        // Parses the JSON of a glTF file in one pass of SAX events, filling the arrays as their
+        // elements are read without building a document.  References are held as indices until
+        // the end and then turned into pointers.  chunk1Bin is the BIN chunk of a GLB file.
+        // Returns false if the JSON is malformed or refers to elements that do not exist, leaving
+        // the asset empty.
+        bool ParseJSON(const char* text, size_t length, ByteArray chunk1Bin);
+
+        // Builds the whole JSON document and then reads it.  This needs several times the size
+        // of the text in memory and is kept to check ParseJSON against.
+        bool ParseJSONDocument(const char* text, size_t length, ByteArray chunk1Bin);
+
         Scene* m_scene;
         std::wstring m_basePath;
         std::vector<Scene> m_scenes;
@@ -280,5 +291,8 @@ namespace glTF
         uint32_t ReadTextureInfo( json& info_json, glTF::Texture* &info );
     };
 
+    // Parses synthetic glTF scenes of 1 MB to 500 MB with ParseJSON and ParseJSONDocument, checks
+    // that the assets match, and prints the time and the peak growth of the working set of each.
+    void BenchmarkParser( void );
 
 } // namespace glTF
@@ -12,8 +12,11 @@
 //
 
 #include "ModelAssimp.h"
+#include "VertexDeduplicate.h"
+#include "../Core/SystemTime.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <iostream>
 
 void PrintHelp()
@@ -22,6 +25,7 @@ void PrintHelp()
 
     printf("usage:\n");
     printf("model_convert input_file output_file\n");
+    printf("model_convert -dedup_benchmark\n");
 }
 
 void AssimpModel::PrintModelStats()
@@ -98,6 +102,13 @@ void AssimpModel::PrintModelStats()
 
 int main(int argc, char **argv)
 {
+    if (argc == 2 && strcmp(argv[1], "-dedup_benchmark") == 0)
+    {
+        SystemTime::Initialize();
+        BenchmarkVertexDeduplication();
+        return 0;
+    }
+
     if (argc != 3)
     {
         PrintHelp();
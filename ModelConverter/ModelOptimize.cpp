@@ -13,6 +13,7 @@
 
 #include "ModelAssimp.h"
 #include "IndexOptimizePostTransform.h"
+#include "VertexDeduplicate.h"
 
 #include <string.h>
 
@@ -28,38 +29,18 @@ void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
         unsigned char *meshVertexData = depth ? (m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth) : (m_pVertexData + mesh->vertexDataByteOffset);
 
         unsigned char *meshDeduplicatedVertexData = deduplicatedVertexData + deduplicatedVertexDataSize;
-        unsigned int deduplicatedCount = 0;
 
         unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
         uint32_t *vertexRemap = new uint32_t [vertexCount];
-        memset(vertexRemap, (uint32_t)-1, sizeof(uint32_t) * vertexCount);
-        assert(vertexCount <= (uint32_t)-1);
-
-        for (unsigned int v1 = 0; v1 < vertexCount; v1++)
-        {
-            if (vertexRemap[v1] != (uint32_t)-1)
-                continue; // this was already found to be a duplicate
-
-            const unsigned char *v1Data = meshVertexData + v1 * vertexStride;
 
-            // this is a new unique vertex
-            uint32_t remappedSlot = deduplicatedCount++;
-            vertexRemap[v1] = remappedSlot;
-            memcpy(meshDeduplicatedVertexData + remappedSlot * vertexStride, v1Data, vertexStride);
+        // hash the raw vertex bytes rather than comparing every pair of vertices
+        unsigned int deduplicatedCount = DeduplicateVertices(meshVertexData, vertexCount, vertexStride, vertexRemap);
 
-            // scan for duplicates
-            for (unsigned int v2 = v1 + 1; v2 < vertexCount; v2++)
-            {
-                if (vertexRemap[v2] != (uint32_t)-1)
-                    continue; // this was already found to be a duplicate of another vertex
-
-                const unsigned char *v2Data = meshVertexData + v2 * vertexStride;
-
-                if (0 == memcmp(v1Data, v2Data, vertexStride))
-                {
-                    vertexRemap[v2] = remappedSlot;
-                }
-            }
+        // copy each unique vertex to its slot (duplicates always map to an earlier slot)
+        for (unsigned int v = 0, slot = 0; v < vertexCount; v++)
+        {
+            if (vertexRemap[v] == slot)
+                memcpy(meshDeduplicatedVertexData + slot++ * vertexStride, meshVertexData + v * vertexStride, vertexStride);
         }
 
         unsigned int indexCount = mesh->indexCount;
@@ -31,15 +31,27 @@
 #include "Renderer.h"
 #include "Model.h"
 #include "ModelLoader.h"
+#include "AnimationScheduler.h"
+#include "Skinning.h"
+#include "VertexDeduplicate.h"
 #include "ShadowCamera.h"
 #include "Display.h"
 #include "ReadbackBuffer.h"
+#include "ConcurrentHashMap.h"
+#include "FrameAllocator.h"
+#include "BuddyOffsetAllocator.h"
+#include "RetirementQueue.h"
+#include "PipelineCache.h"
 
 
 
 //VRS
 #include "VRS.h"
 #include "VRSTest.h"
+#include "VRSContrastAdaptiveCPU.h"
+#include "VRSShadingRateStats.h"
+#include "VRSRateFilter.h"
+#include "ImageMetrics.h"
 //#define LEGACY_RENDERER
 
 using namespace GameCore;
@@ -110,6 +122,7 @@ void ChangeIBLBias(EngineVar::ActionType)
 }
 
 #include <direct.h> // for _getcwd() to check data root path
+#include <functional>
 
 
 void LoadIBLTextures()
@@ -155,6 +168,47 @@ void LoadIBLTextures()
         g_IBLSet.Increment();
 }
 
+// Each benchmark runs at startup when its flag is nonzero, e.g. "-cull_benchmark 1".  Those that
+// cook a model use the one given with -model.
+void RunBenchmarks( const std::wstring& modelFile )
+{
+    struct Benchmark
+    {
+        const wchar_t* flag;
+        std::function<void(void)> run;
+    };
+
+    const Benchmark benchmarks[] =
+    {
+        { L"cook_benchmark", [&] { Renderer::BenchmarkBuildModel(modelFile.size() > 0 ? modelFile : L"Sponza/PBR/sponza2.gltf"); } },
+        { L"gltf_parse_benchmark", glTF::BenchmarkParser },
+        { L"anim_benchmark", [&] { Renderer::BenchmarkAnimationCompression(modelFile.size() > 0 ? modelFile : L"Hero/AntiqueCamera.glb"); } },
+        { L"anim_sampler_benchmark", BenchmarkAnimationSampler },
+        { L"anim_scheduler_benchmark", BenchmarkAnimationScheduler },
+        { L"skinning_benchmark", BenchmarkSkinning },
+        { L"dedup_benchmark", BenchmarkVertexDeduplication },
+        { L"cull_benchmark", Renderer::BenchmarkFrustumCulling },
+        { L"sort_benchmark", MeshSorter::Benchmark },
+        { L"transform_benchmark", BenchmarkTransformHierarchy },
+        { L"frame_alloc_benchmark", FrameAllocator::Benchmark },
+        { L"hashmap_benchmark", BenchmarkConcurrentHashMap },
+        { L"buddy_benchmark", BenchmarkBuddyAllocator },
+        { L"retire_benchmark", BenchmarkRetirementQueue },
+        { L"pso_cache_test", PipelineCache::Test },
+        { L"image_metrics_test", ImageMetrics::Test },
+        { L"vrs_benchmark", VRS::BenchmarkContrastAdaptiveCPU },
+        { L"vrs_stats_benchmark", VRS::BenchmarkShadingRateStats },
+        { L"vrs_filter_benchmark", VRS::BenchmarkRateFilter },
+    };
+
+    for (const Benchmark& benchmark : benchmarks)
+    {
+        uint32_t enabled = 0;
+        if (CommandLineArgs::GetInteger(benchmark.flag, enabled) && enabled != 0)
+            benchmark.run();
+    }
+}
+
 void ModelViewer::Startup( void )
 {
     MotionBlur::Enable = true;
@@ -213,11 +267,18 @@ void ModelViewer::Startup( void )
         }
     }
 
+    RunBenchmarks(gltfFileName);
+
     m_Camera.SetZRange(1.0f, 10000.0f);
     if (gltfFileName.size() == 0 || gltfFileName == L"C:\\BistroExterior\\bistro.gltf" || gltfFileName == L"C:\\BistroInterior\\BistroInterior.gltf")
         m_CameraController.reset(new FlyingFPSCamera(m_Camera, Vector3(kYUnitVector)));
     else
         m_CameraController.reset(new OrbitCamera(m_Camera, m_ModelInst.GetBoundingSphere(), Vector3(kYUnitVector)));
+
+    // Save the frames a later -vrs_batch run of the same script needs
+    std::wstring vrsCaptureScript;
+    if (CommandLineArgs::GetString(L"vrs_capture", vrsCaptureScript))
+        VRSTest::StartScriptCapture(vrsCaptureScript);
 }
 
 void ModelViewer::Cleanup( void )